@@ -0,0 +1,188 @@
+#include "AudioEngine.h"
+#include "RealtimeSafetyChecker.h"
+
+
+// Constructor for the AudioEngine class. Each deck gets its mix bus input and its place in the sync engine here,
+// once, before the audio starts.
+AudioEngine::AudioEngine(juce::AudioFormatManager& formatManager, const Options& options)
+{
+	const int numDecks = juce::jlimit(1, MixBus::maxInputs, options.numDecks);
+	for (auto index = 0; index < numDecks; ++index) {
+		auto* deck = new DJAudioPlayer(formatManager);
+		decks.add(deck);
+		beatSync.addDeck(deck);
+		mixInputs.add(mixBus.addInput());
+		deckOutputs[index] = &mixBus.getInputBuffer(mixInputs[index]);
+	}
+	volumes.resize(static_cast<size_t>(numDecks));
+	cueSends.resize(static_cast<size_t>(numDecks));
+
+	profiler.reset(new CallbackProfiler(numDecks));
+
+	renderPool.reset(new DeckRenderPool(*this, numDecks, juce::jmax(0, options.numRenderThreads)));
+}
+
+
+AudioEngine::~AudioEngine()
+{
+	recorder.stop();
+	renderPool.reset();
+}
+
+
+// Define the getNumDecks() method for the AudioEngine class.
+int AudioEngine::getNumDecks() const {
+	return decks.size();
+}
+
+
+// Define the getDeck() method for the AudioEngine class.
+DJAudioPlayer& AudioEngine::getDeck(int index) {
+	jassert(index >= 0 && index < decks.size());
+	return *decks[index];
+}
+
+
+// Define the getCrossfader() method for the AudioEngine class.
+Crossfader& AudioEngine::getCrossfader() {
+	return crossfader;
+}
+
+
+// Define the getMasterMeter() method for the AudioEngine class.
+LevelMeter& AudioEngine::getMasterMeter() {
+	return masterMeter;
+}
+
+
+// Define the getRecorder() method for the AudioEngine class.
+MasterRecorder& AudioEngine::getRecorder() {
+	return recorder;
+}
+
+
+// Define the getProfiler() method for the AudioEngine class.
+CallbackProfiler& AudioEngine::getProfiler() {
+	return *profiler;
+}
+
+
+// Define the getNumRenderThreads() method for the AudioEngine class.
+int AudioEngine::getNumRenderThreads() const {
+	return renderPool->getNumThreads();
+}
+
+
+// Define the setCueMix() method for the AudioEngine class.
+void AudioEngine::setCueMix(float newCueMix) {
+	targetCueMix.store(juce::jlimit(0.0f, 1.0f, newCueMix), std::memory_order_relaxed);
+}
+
+
+// Define the prepareToPlay() method for the AudioEngine class.
+void AudioEngine::prepareToPlay(int samplesPerBlockExpected, double sampleRate) {
+	for (auto index = 0; index < decks.size(); ++index) {
+		decks[index]->prepareToPlay(samplesPerBlockExpected, sampleRate);
+		volumes[index].reset(sampleRate, faderTimeSeconds);
+		volumes[index].setCurrentAndTargetValue(decks[index]->getVolume());
+		cueSends[index].reset(sampleRate, faderTimeSeconds);
+		cueSends[index].setCurrentAndTargetValue(decks[index]->isCueOn() ? 1.0f : 0.0f);
+	}
+	cueMix.reset(sampleRate, faderTimeSeconds);
+	cueMix.setCurrentAndTargetValue(targetCueMix.load(std::memory_order_relaxed));
+	mixBus.prepare(samplesPerBlockExpected);
+	crossfader.prepare(sampleRate);
+	masterMeter.prepare(sampleRate);
+	recorder.prepare(sampleRate);
+	beatSync.prepare(sampleRate);
+	profiler->prepare(sampleRate);
+}
+
+
+// Define the getNextAudioBlock() method for the AudioEngine class.
+// The mix bus buffers are sized before the audio starts, so a block longer than them is rendered in parts that fit.
+void AudioEngine::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
+	const int capacity = mixBus.getBlockCapacity();
+	if (capacity == 0) {
+		bufferToFill.clearActiveBufferRegion();
+		return;
+	}
+
+	for (auto done = 0; done < bufferToFill.numSamples; done += capacity) {
+		renderBlock(juce::AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done,
+			juce::jmin(capacity, bufferToFill.numSamples - done)));
+	}
+}
+
+
+// Define the renderBlock() method for the AudioEngine class.
+void AudioEngine::renderBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
+	// Set the rates of the synced decks for this block, from where every deck is at its start.
+	beatSync.process(bufferToFill.numSamples);
+
+	// Render every deck into its mix bus input; the pool returns once all of them are done, which is timed as the
+	// render of the decks.
+	blockSize = bufferToFill.numSamples;
+	{
+		const CallbackProfiler::ScopedTimer renderTimer(*profiler, CallbackProfiler::renderSlot, blockSize);
+		renderPool->render();
+	}
+
+	// Everything from here to the end of the callback is timed as the mix.
+	const CallbackProfiler::ScopedTimer mixTimer(*profiler, CallbackProfiler::mixSlot, blockSize);
+
+	// Ramp the decks to their gains at the end of each segment while summing them: on the master, the volume times the
+	// crossfader gain of their side, and in the headphones, the blend of that with their cue send. A segment is the
+	// whole block unless the crossfader is moving, when short segments keep the gains on its curve.
+	auto& output = *bufferToFill.buffer;
+	cueMix.setTargetValue(targetCueMix.load(std::memory_order_relaxed));
+	for (auto index = 0; index < decks.size(); ++index) {
+		volumes[index].setTargetValue(decks[index]->getVolume());
+		cueSends[index].setTargetValue(decks[index]->isCueOn() ? 1.0f : 0.0f);
+	}
+
+	const int segmentSize = crossfader.isMoving() ? Crossfader::segmentSamples : blockSize;
+	for (auto done = 0; done < blockSize; done += segmentSize) {
+		const int segment = juce::jmin(segmentSize, blockSize - done);
+		const auto gains = crossfader.advance(segment);
+		const float masterInCue = cueMix.skip(segment);
+		for (auto index = 0; index < decks.size(); ++index) {
+			const float masterGain = volumes[index].skip(segment) * (index % 2 == 0 ? gains.a : gains.b);
+			const float cueGain = cueSends[index].skip(segment) * (1.0f - masterInCue) + masterGain * masterInCue;
+			mixBus.setInputGain(mixInputs[index], MixBus::master, masterGain, masterGain);
+			mixBus.setInputGain(mixInputs[index], MixBus::cue, cueGain, cueGain);
+		}
+
+		mixBus.mix(MixBus::master, output, 0, bufferToFill.startSample + done, segment, done);
+		if (output.getNumChannels() > cueChannel) {
+			mixBus.mix(MixBus::cue, output, cueChannel, bufferToFill.startSample + done, segment, done);
+		}
+	}
+	for (auto channel = cueChannel + MixBus::numChannels; channel < output.getNumChannels(); ++channel) {
+		output.clear(channel, bufferToFill.startSample, blockSize);
+	}
+
+	// Record the master output and the decks as they were rendered.
+	recorder.write(output, bufferToFill.startSample, blockSize, deckOutputs, decks.size());
+
+	// Measure the master output for the master meter.
+	masterMeter.process(*bufferToFill.buffer, bufferToFill.startSample, blockSize);
+}
+
+
+// Define the releaseResources() method for the AudioEngine class.
+void AudioEngine::releaseResources() {
+	mixBus.releaseResources();
+	for (auto* deck : decks) {
+		deck->releaseResources();
+	}
+}
+
+
+// Define the renderDeck() method for the AudioEngine class.
+// The render workers are audio threads too, so each render is checked for realtime safety in debug builds.
+void AudioEngine::renderDeck(int index) {
+	const RealtimeSafetyChecker::ScopedRealtimeSection realtimeSection;
+	const CallbackProfiler::ScopedTimer deckTimer(*profiler, CallbackProfiler::firstDeckSlot + index, blockSize);
+	decks[index]->getNextAudioBlock(juce::AudioSourceChannelInfo(&mixBus.getInputBuffer(mixInputs[index]), 0, blockSize));
+}
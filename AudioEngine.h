@@ -0,0 +1,124 @@
+#pragma once
+#include <JuceHeader.h>
+#include "DJAudioPlayer.h"
+#include "BeatSync.h"
+#include "MixBus.h"
+#include "Crossfader.h"
+#include "LevelMeter.h"
+#include "DeckRenderPool.h"
+#include "MasterRecorder.h"
+#include "CallbackProfiler.h"
+
+
+// AudioEngine is everything that runs in the audio callback: the decks, the sync engine, the mix bus with the
+// crossfader, and the master meter. The number of decks is set when it is made.
+// In each callback the sync engine sets the rates of the decks, then every deck renders into its own input of the
+// mix bus, on the audio thread alone or spread over the workers of a DeckRenderPool, and the bus sums them into the
+// output once all are done. Even decks are on the A side of the crossfader and odd decks on the B side, as the
+// left and right columns of a four-deck controller are.
+// The decks render pre-fader. The master output, on the first two channels, has each deck at its volume times its
+// crossfader gain; the headphone output, on the next two channels when the device has them, blends the decks sent
+// to cue with the master by folding the blend into the gains, so it costs one more summing pass and nothing else.
+// The recorder takes the master output, and the pre-fader output of every deck, at the end of each callback.
+// The render of the decks, the mix after it and every deck are timed by the profiler; the owner of the audio callback
+// times the callback itself.
+class AudioEngine : public juce::AudioSource,
+	private DeckRenderPool::Client {
+public:
+
+	// Settings chosen when the engine is made.
+	struct Options {
+		int numDecks = 2;
+		int numRenderThreads = 0;
+	};
+
+	// Constructor for the AudioEngine class, which makes the decks and starts the render workers.
+	// Parameters:
+	// - formatManager: The formats used to open tracks.
+	// - options: The number of decks, from 1 to MixBus::maxInputs, and of render workers besides the audio thread.
+	AudioEngine(juce::AudioFormatManager& formatManager, const Options& options);
+
+	// Destructor that stops the render workers. The audio callback must have stopped.
+	~AudioEngine() override;
+
+	// Methods to return the number of decks and one of them.
+	int getNumDecks() const;
+	DJAudioPlayer& getDeck(int index);
+
+	// Method to return the crossfader, which the GUI moves.
+	Crossfader& getCrossfader();
+
+	// Method to return the meter of the master output.
+	LevelMeter& getMasterMeter();
+
+	// Method to return the recorder of the master output and the decks.
+	MasterRecorder& getRecorder();
+
+	// Method to return the profiler of the callback, the decks and the mix.
+	CallbackProfiler& getProfiler();
+
+	// Method to return the number of workers rendering decks besides the audio thread.
+	int getNumRenderThreads() const;
+
+	// Method to set the blend of the headphone output. Called from the message thread.
+	// Parameters:
+	// - newCueMix: 0 for the decks sent to cue alone, 1 for the master alone.
+	void setCueMix(float newCueMix);
+
+	// First output channel of the headphone cue bus.
+	static constexpr int cueChannel = 2;
+
+	// Time taken by the volume, the cue sends and the cue blend to reach a new setting, in seconds.
+	static constexpr double faderTimeSeconds = 0.02;
+
+	// Method to prepare the decks and the mix for playback.
+	// Parameters:
+	// - samplesPerBlockExpected: The usual block size.
+	// - sampleRate: The sample rate of the audio device.
+	void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+	// Method to render and mix the decks into the output.
+	// Parameters:
+	// - bufferToFill: Contains the buffer information to be filled with audio data.
+	void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+	// Method to release the resources of the decks and the mix.
+	void releaseResources() override;
+
+private:
+
+	// Method called on the audio thread or a render worker to render one deck into its mix bus input.
+	void renderDeck(int index) override;
+
+	// Method to render and mix a block that fits in the mix bus input buffers.
+	// Parameters:
+	// - bufferToFill: Contains the buffer information to be filled with audio data.
+	void renderBlock(const juce::AudioSourceChannelInfo& bufferToFill);
+
+	juce::OwnedArray<DJAudioPlayer> decks;
+	juce::Array<int> mixInputs;
+
+	// Volume and cue send of every deck, and the headphone blend, ramped on the audio thread between blocks.
+	std::vector<juce::SmoothedValue<float>> volumes;
+	std::vector<juce::SmoothedValue<float>> cueSends;
+	juce::SmoothedValue<float> cueMix{ 0.0f };
+	std::atomic<float> targetCueMix{ 0.0f };
+
+	BeatSync beatSync;
+	MixBus mixBus;
+	Crossfader crossfader;
+	LevelMeter masterMeter;
+	MasterRecorder recorder;
+
+	// Mix bus input of every deck, in deck order, as the recorder takes them.
+	const juce::AudioBuffer<float>* deckOutputs[MixBus::maxInputs] = {};
+
+	// Length of the block being rendered, set before the decks are rendered.
+	int blockSize = 0;
+
+	// Timings of the render, the mix and every deck.
+	std::unique_ptr<CallbackProfiler> profiler;
+
+	// Workers rendering the decks, made last and destroyed first.
+	std::unique_ptr<DeckRenderPool> renderPool;
+};
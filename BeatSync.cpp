@@ -0,0 +1,114 @@
+#include "BeatSync.h"
+
+namespace {
+
+	// Distance from a to the nearest beat of b, from -0.5 to 0.5 beats.
+	double phaseDifference(double a, double b) {
+		const double difference = a - b;
+		return difference - std::floor(difference + 0.5);
+	}
+
+	// Whether a deck can be the master.
+	bool canLead(const DJAudioPlayer::BeatState& state) {
+		return state.playing && !state.syncOn && state.bpm > 0 && state.speed > 0;
+	}
+}
+
+
+BeatSync::BeatSync()
+{
+}
+
+
+// Define the addDeck() method for the BeatSync class.
+void BeatSync::addDeck(DJAudioPlayer* deck) {
+	decks.add(deck);
+	states.resize(static_cast<size_t>(decks.size()));
+	integrals.resize(static_cast<size_t>(decks.size()), 0.0);
+}
+
+
+// Define the prepare() method for the BeatSync class.
+void BeatSync::prepare(double newSampleRate) {
+	sampleRate = newSampleRate;
+	clockBpm = 0;
+	std::fill(integrals.begin(), integrals.end(), 0.0);
+}
+
+
+// Define the process() method for the BeatSync class.
+void BeatSync::process(int numSamples) {
+	const int numDecks = decks.size();
+	for (auto i = 0; i < numDecks; ++i) {
+		states[static_cast<size_t>(i)] = decks[i]->getBeatState();
+	}
+
+	// Keep the master for as long as it can lead, so that switching sync on elsewhere does not move it.
+	int master = masterDeck.load();
+	if (master < 0 || master >= numDecks || !canLead(states[static_cast<size_t>(master)])) {
+		master = -1;
+		for (auto i = 0; i < numDecks && master < 0; ++i) {
+			if (canLead(states[static_cast<size_t>(i)])) {
+				master = i;
+			}
+		}
+		masterDeck.store(master);
+	}
+
+	// The clock follows a master that plays steadily, and otherwise runs on from where it was.
+	if (master >= 0) {
+		const auto& leader = states[static_cast<size_t>(master)];
+		if (leader.steady || clockBpm <= 0) {
+			clockBeats = leader.beats;
+			clockBpm = leader.bpm * leader.speed;
+		}
+	}
+
+	const double blockSeconds = numSamples / sampleRate;
+	for (auto i = 0; i < numDecks; ++i) {
+		const auto& follower = states[static_cast<size_t>(i)];
+		double& integral = integrals[static_cast<size_t>(i)];
+		const double followerBpm = follower.bpm * follower.speed;
+		double ratio = 1.0;
+
+		if (i != master && follower.syncOn && follower.playing && followerBpm > 0 && clockBpm > 0) {
+			// A track at about half or double the master's tempo locks to every other beat, or to every half beat.
+			double beatsPerClockBeat = 1.0;
+			while (clockBpm * beatsPerClockBeat > followerBpm * juce::MathConstants<double>::sqrt2) {
+				beatsPerClockBeat *= 0.5;
+			}
+			while (clockBpm * beatsPerClockBeat < followerBpm / juce::MathConstants<double>::sqrt2) {
+				beatsPerClockBeat *= 2.0;
+			}
+
+			const double targetBpm = clockBpm * beatsPerClockBeat;
+			ratio = targetBpm / followerBpm;
+
+			// A follower that is being scratched or has just jumped gets the tempo only, until it plays steadily again.
+			if (follower.steady) {
+				const double errorSeconds = phaseDifference(clockBeats * beatsPerClockBeat, follower.beats) * 60.0 / targetBpm;
+				integral = juce::jlimit(-maxCorrection, maxCorrection, integral + errorSeconds * blockSeconds / (lockTimeSeconds * integralTimeSeconds));
+				ratio *= 1.0 + juce::jlimit(-maxCorrection, maxCorrection, errorSeconds / lockTimeSeconds + integral);
+			}
+			else {
+				integral = 0;
+			}
+		}
+		else {
+			integral = 0;
+		}
+
+		decks[i]->setSyncRatio(ratio);
+	}
+
+	// Run the clock on to the end of the block, where it stays if the master is not playing steadily in the next one.
+	if (clockBpm > 0) {
+		clockBeats += clockBpm / 60.0 * blockSeconds;
+	}
+}
+
+
+// Define the getMasterDeck() method for the BeatSync class.
+int BeatSync::getMasterDeck() const {
+	return masterDeck.load();
+}
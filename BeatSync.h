@@ -0,0 +1,64 @@
+#pragma once
+#include <JuceHeader.h>
+#include "DJAudioPlayer.h"
+
+
+// BeatSync keeps the decks that have sync switched on locked to the tempo and beat phase of a master deck.
+// Once per audio callback, before the decks are rendered, it reads where every deck is on its beat grid and sets
+// the rate of each follower: the ratio that matches its tempo to the master's, corrected by a phase-locked loop that
+// pulls its beats onto the master's. Phases are worked out from the decks' sample positions rather than added up
+// block by block, so the lock does not drift however long the tracks are.
+// The master does not drive the followers directly but a beat clock. While the master is scratched, and for a moment
+// after it jumps, the clock runs on at the master's last tempo and the followers hold their phase; once the master
+// plays steadily again the clock locks back onto it and the followers slide back into phase at a bounded rate.
+// The master is the first deck that is playing, has a known tempo and has sync switched off.
+class BeatSync {
+public:
+
+	// Constructor for the BeatSync class, which starts with no decks.
+	BeatSync();
+
+	// Method to add a deck. Called from the message thread before the audio starts.
+	// Parameters:
+	// - deck: The player of the deck.
+	void addDeck(DJAudioPlayer* deck);
+
+	// Method to prepare for playback.
+	// Parameters:
+	// - sampleRate: The sample rate of the audio device.
+	void prepare(double sampleRate);
+
+	// Method called by the audio thread at the start of every callback, before the decks are rendered, to set the
+	// rates of the followers for the block.
+	// Parameters:
+	// - numSamples: The number of samples in the block.
+	void process(int numSamples);
+
+	// Method to return the index of the master deck, or -1 when there is none. Safe from any thread.
+	int getMasterDeck() const;
+
+	// Time over which a phase error is pulled in, and the slower time over which a constant error left by a slightly
+	// wrong tempo is removed, in seconds.
+	static constexpr double lockTimeSeconds = 1.0;
+	static constexpr double integralTimeSeconds = 4.0;
+
+	// Largest change of rate the phase correction makes, as a fraction of the tempo-matched rate.
+	static constexpr double maxCorrection = 0.04;
+
+private:
+
+	// Decks, where they were at the start of the block, and the integral of each follower's phase error.
+	juce::Array<DJAudioPlayer*> decks;
+	std::vector<DJAudioPlayer::BeatState> states;
+	std::vector<double> integrals;
+
+	// Sample rate of the audio device.
+	double sampleRate = 44100.0;
+
+	// Beat clock: its position in beats of the master track and its tempo, which is 0 until a master has been found.
+	double clockBeats = 0;
+	double clockBpm = 0;
+
+	// Index of the master deck, written by the audio thread.
+	std::atomic<int> masterDeck{ -1 };
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// BlockClock turns the time at which a GUI event happened into a sample offset inside the audio block that plays it.
+// The audio thread calls beginBlock() at the start of every callback. An event is placed in the next block at the
+// same distance from the start of that block as it was from the start of the previous callback, so every event is
+// delayed by exactly one callback period instead of being snapped to the start of whichever block picks it up.
+// This trades up to one block of latency for timing without jitter, which is what finger drumming needs.
+// An offline render asks for blocks faster than the wall clock runs, so there the clock is switched off and every
+// event takes effect at the start of the next block; the renderer cuts its blocks at the times of its events instead.
+class BlockClock {
+public:
+
+	// Method to return the current time in milliseconds, which is the clock events must be stamped with.
+	static double now() {
+		return juce::Time::getMillisecondCounterHiRes();
+	}
+
+	// Method to set the sample rate and forget the previous callbacks.
+	// Parameters:
+	// - sampleRate: The sample rate of the audio.
+	void prepare(double newSampleRate) {
+		sampleRate = newSampleRate;
+		previousBlockTime = 0;
+		currentBlockTime = 0;
+	}
+
+	// Method to switch between placing events by their time and placing them all at the start of the next block.
+	// Called before prepare().
+	// Parameters:
+	// - shouldBeRealtime: false when the blocks are not rendered in real time.
+	void setRealtime(bool shouldBeRealtime) {
+		realtime = shouldBeRealtime;
+	}
+
+	// Method called by the audio thread at the start of every block.
+	void beginBlock() {
+		previousBlockTime = currentBlockTime;
+		currentBlockTime = now();
+		if (previousBlockTime == 0) {
+			previousBlockTime = currentBlockTime;
+		}
+	}
+
+	// Method to return the offset inside the current block at which an event should take effect.
+	// Parameters:
+	// - eventTime: When the event happened, from now().
+	// - numSamples: The length of the current block.
+	int getSampleOffset(double eventTime, int numSamples) const {
+		if (!realtime) {
+			return 0;
+		}
+		const double offset = (eventTime - previousBlockTime) * 0.001 * sampleRate;
+		return juce::jlimit(0, juce::jmax(0, numSamples - 1), static_cast<int>(offset));
+	}
+
+private:
+
+	double sampleRate = 44100.0;
+	bool realtime = true;
+
+	// Times at which the previous and the current block started, in milliseconds.
+	double previousBlockTime = 0;
+	double currentBlockTime = 0;
+};
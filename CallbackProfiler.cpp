@@ -0,0 +1,161 @@
+#include "CallbackProfiler.h"
+
+
+namespace {
+	// Add to an atomic written by one thread at a time, without the cost of a read-modify-write.
+	template <typename Type>
+	void addTo(std::atomic<Type>& value, Type amount) {
+		value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	// Raise an atomic written by one thread at a time to a new value if it is higher.
+	void raiseTo(std::atomic<double>& value, double candidate) {
+		if (candidate > value.load(std::memory_order_relaxed)) {
+			value.store(candidate, std::memory_order_relaxed);
+		}
+	}
+}
+
+
+// Constructor for the CallbackProfiler class.
+CallbackProfiler::CallbackProfiler(int numDecks)
+	: numSlots(firstDeckSlot + juce::jmax(0, numDecks)),
+	counters(new Counters[static_cast<size_t>(firstDeckSlot + juce::jmax(0, numDecks))])
+{
+}
+
+
+// Define the prepare() method for the CallbackProfiler class.
+void CallbackProfiler::prepare(double newSampleRate) {
+	sampleRate = newSampleRate;
+	previousCallbackTicks = 0;
+	previousBudgetTicks = 0;
+}
+
+
+// Define the addBlock() method for the CallbackProfiler class.
+void CallbackProfiler::addBlock(int slot, int numSamples, juce::int64 startTicks, juce::int64 endTicks) {
+	if (slot < 0 || slot >= numSlots || numSamples <= 0) {
+		return;
+	}
+
+	const double budgetTicks = numSamples / sampleRate * ticksPerSecond;
+	const double loadPercent = static_cast<double>(endTicks - startTicks) / budgetTicks * 100.0;
+
+	if (slot == callbackSlot) {
+		if (resetRequested.exchange(false)) {
+			clear();
+		}
+
+		const bool late = previousCallbackTicks != 0
+			&& static_cast<double>(startTicks - previousCallbackTicks) > previousBudgetTicks * lateCallbackFactor;
+		if (late || loadPercent > 100.0) {
+			addTo(numXruns, static_cast<juce::int64>(1));
+		}
+		previousCallbackTicks = startTicks;
+		previousBudgetTicks = budgetTicks;
+	}
+
+	auto& part = counters[static_cast<size_t>(slot)];
+	addTo(part.numBlocks, static_cast<juce::int64>(1));
+	addTo(part.totalLoadPercent, loadPercent);
+	raiseTo(part.worstLoadPercent, loadPercent);
+	raiseTo(part.worstMs, static_cast<double>(endTicks - startTicks) / ticksPerSecond * 1000.0);
+
+	const int bin = juce::jlimit(0, numBins - 1, static_cast<int>(loadPercent / binWidthPercent));
+	addTo(part.histogram[bin], static_cast<juce::int64>(1));
+}
+
+
+// Define the getNumSlots() method for the CallbackProfiler class.
+int CallbackProfiler::getNumSlots() const {
+	return numSlots;
+}
+
+
+// Define the getSlotName() method for the CallbackProfiler class.
+juce::String CallbackProfiler::getSlotName(int slot) const {
+	switch (slot) {
+	case callbackSlot: return "Callback";
+	case renderSlot: return "Decks";
+	case mixSlot: return "Mix";
+	default: return "Deck " + juce::String(slot - firstDeckSlot + 1);
+	}
+}
+
+
+// Define the getStats() method for the CallbackProfiler class.
+CallbackProfiler::Stats CallbackProfiler::getStats(int slot) const {
+	Stats stats;
+	if (slot < 0 || slot >= numSlots) {
+		return stats;
+	}
+
+	const auto& part = counters[static_cast<size_t>(slot)];
+	stats.numBlocks = part.numBlocks.load(std::memory_order_relaxed);
+	stats.totalLoadPercent = part.totalLoadPercent.load(std::memory_order_relaxed);
+	stats.worstLoadPercent = part.worstLoadPercent.load(std::memory_order_relaxed);
+	stats.worstMs = part.worstMs.load(std::memory_order_relaxed);
+	for (auto bin = 0; bin < numBins; ++bin) {
+		stats.histogram[bin] = part.histogram[bin].load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+
+// Define the getNumXruns() method for the CallbackProfiler class.
+juce::int64 CallbackProfiler::getNumXruns() const {
+	return numXruns.load(std::memory_order_relaxed);
+}
+
+
+// Define the reset() method for the CallbackProfiler class.
+void CallbackProfiler::reset() {
+	resetRequested.store(true);
+}
+
+
+// Define the createReport() method for the CallbackProfiler class.
+juce::var CallbackProfiler::createReport() const {
+	juce::Array<juce::var> parts;
+	for (auto slot = 0; slot < numSlots; ++slot) {
+		const auto stats = getStats(slot);
+
+		juce::Array<juce::var> histogram;
+		for (auto bin = 0; bin < numBins; ++bin) {
+			histogram.add(stats.histogram[bin]);
+		}
+
+		auto* part = new juce::DynamicObject();
+		part->setProperty("name", getSlotName(slot));
+		part->setProperty("blocks", stats.numBlocks);
+		part->setProperty("meanLoadPercent", stats.numBlocks > 0 ? stats.totalLoadPercent / stats.numBlocks : 0.0);
+		part->setProperty("worstLoadPercent", stats.worstLoadPercent);
+		part->setProperty("worstMs", stats.worstMs);
+		part->setProperty("histogram", histogram);
+		parts.add(juce::var(part));
+	}
+
+	auto* root = new juce::DynamicObject();
+	root->setProperty("sampleRate", sampleRate);
+	root->setProperty("xruns", getNumXruns());
+	root->setProperty("binWidthPercent", binWidthPercent);
+	root->setProperty("parts", parts);
+	return juce::var(root);
+}
+
+
+// Define the clear() method for the CallbackProfiler class.
+void CallbackProfiler::clear() {
+	for (auto slot = 0; slot < numSlots; ++slot) {
+		auto& part = counters[static_cast<size_t>(slot)];
+		part.numBlocks.store(0, std::memory_order_relaxed);
+		part.totalLoadPercent.store(0, std::memory_order_relaxed);
+		part.worstLoadPercent.store(0, std::memory_order_relaxed);
+		part.worstMs.store(0, std::memory_order_relaxed);
+		for (auto& count : part.histogram) {
+			count.store(0, std::memory_order_relaxed);
+		}
+	}
+	numXruns.store(0, std::memory_order_relaxed);
+}
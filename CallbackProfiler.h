@@ -0,0 +1,126 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// CallbackProfiler times the parts of every audio callback with the high-resolution clock: the whole callback, the
+// render of all the decks, the mix after it, and each deck on its own. For each part it keeps a histogram of its time
+// as a percentage of the block budget, which is the length of audio the block holds, with the mean and the worst.
+// It also counts the xruns it can see from inside the callback: a callback that took longer than its budget, and a
+// callback that started more than lateCallbackFactor budgets after the one before, so the device ran dry in between.
+// Each part is timed by one thread at a time and every value is a separate atomic, so the audio threads never wait
+// and the GUI reads whenever it likes; a reading may be a block ahead in one value and not yet in another.
+class CallbackProfiler {
+public:
+
+	// The parts of the callback that are timed. Deck n is timed in firstDeckSlot + n.
+	enum Slot {
+		callbackSlot = 0,
+		renderSlot,
+		mixSlot,
+		firstDeckSlot
+	};
+
+	// Width of a histogram bin and number of bins, in percent of the budget. The last bin holds everything beyond.
+	static constexpr int binWidthPercent = 5;
+	static constexpr int numBins = 41;
+
+	// Gap between the starts of two callbacks, in budgets of the first, beyond which the second counts as an xrun.
+	static constexpr double lateCallbackFactor = 2.0;
+
+	// A reading of one part.
+	struct Stats {
+		juce::int64 numBlocks = 0;
+		// Sum of the loads of every block, so that the mean over any interval is a difference over the blocks.
+		double totalLoadPercent = 0;
+		double worstLoadPercent = 0;
+		double worstMs = 0;
+		juce::int64 histogram[numBins] = {};
+	};
+
+	// Times one block of a part while it lives.
+	class ScopedTimer {
+	public:
+		ScopedTimer(CallbackProfiler& _profiler, int _slot, int _numSamples)
+			: profiler(_profiler), slot(_slot), numSamples(_numSamples), startTicks(juce::Time::getHighResolutionTicks()) {
+		}
+
+		~ScopedTimer() {
+			profiler.addBlock(slot, numSamples, startTicks, juce::Time::getHighResolutionTicks());
+		}
+
+	private:
+		CallbackProfiler& profiler;
+		const int slot;
+		const int numSamples;
+		const juce::int64 startTicks;
+
+		JUCE_DECLARE_NON_COPYABLE(ScopedTimer)
+	};
+
+	// Constructor for the CallbackProfiler class.
+	// Parameters:
+	// - numDecks: The number of decks timed.
+	CallbackProfiler(int numDecks);
+
+	// Method to set the sample rate the budgets are worked out from, and forget the previous callback.
+	// Parameters:
+	// - sampleRate: The sample rate of the audio device.
+	void prepare(double sampleRate);
+
+	// Method to record the time of one block of a part. Called by ScopedTimer on the thread that did the work.
+	// A request to reset is carried out here, at the end of a callback, when no deck is being rendered.
+	// Parameters:
+	// - slot: The part timed.
+	// - numSamples: The length of the block.
+	// - startTicks: When the part started, from juce::Time::getHighResolutionTicks().
+	// - endTicks: When the part ended.
+	void addBlock(int slot, int numSamples, juce::int64 startTicks, juce::int64 endTicks);
+
+	// Methods to return the number of parts timed and the name of one.
+	int getNumSlots() const;
+	juce::String getSlotName(int slot) const;
+
+	// Method to read the statistics of a part. Safe to call from any thread.
+	Stats getStats(int slot) const;
+
+	// Method to return the number of xruns seen. Safe to call from any thread.
+	juce::int64 getNumXruns() const;
+
+	// Method to ask the audio thread to clear every statistic at the end of its next callback. Safe to call from any
+	// thread.
+	void reset();
+
+	// Method to gather every statistic, for saving as JSON.
+	// Returns:
+	// - An object with the sample rate, the xruns and, for every part, its statistics and histogram.
+	juce::var createReport() const;
+
+private:
+
+	// The statistics of one part, as the audio threads write them.
+	struct Counters {
+		std::atomic<juce::int64> numBlocks{ 0 };
+		std::atomic<double> totalLoadPercent{ 0 };
+		std::atomic<double> worstLoadPercent{ 0 };
+		std::atomic<double> worstMs{ 0 };
+		std::atomic<juce::int64> histogram[numBins] = {};
+	};
+
+	// Method to clear every statistic. Called on the audio thread.
+	void clear();
+
+	const int numSlots;
+	std::unique_ptr<Counters[]> counters;
+
+	double sampleRate = 44100.0;
+	double ticksPerSecond = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+
+	// Start and budget, in ticks, of the previous callback, or 0 when there was none since prepare().
+	juce::int64 previousCallbackTicks = 0;
+	double previousBudgetTicks = 0;
+
+	std::atomic<juce::int64> numXruns{ 0 };
+
+	// Flag raised by reset() and consumed by the audio thread.
+	std::atomic<bool> resetRequested{ false };
+};
@@ -0,0 +1,133 @@
+#include "CallbackProfilerDisplay.h"
+
+
+CallbackProfilerDisplay::CallbackProfilerDisplay(CallbackProfiler& profilerToShow, juce::AudioDeviceManager& _deviceManager)
+	: profiler(profilerToShow), deviceManager(_deviceManager),
+	shown(static_cast<size_t>(profilerToShow.getNumSlots())),
+	recentLoadPercent(static_cast<size_t>(profilerToShow.getNumSlots()), 0.0)
+{
+	// Slow enough for the numbers to be read, fast enough to catch a deck getting heavier.
+	startTimerHz(4);
+}
+
+CallbackProfilerDisplay::~CallbackProfilerDisplay()
+{
+	stopTimer();
+}
+
+int CallbackProfilerDisplay::getIdealHeight() const
+{
+	// A row per part, one for the xruns and the histogram, inside a margin of 4 pixels.
+	return (profiler.getNumSlots() + 1) * rowHeight + histogramHeight + 8;
+}
+
+void CallbackProfilerDisplay::paint(juce::Graphics& g)
+{
+	// See-through background, so the waveforms under it stay visible.
+	g.setColour(juce::Colours::black.withAlpha(0.75f));
+	g.fillRoundedRectangle(getLocalBounds().toFloat(), 4.0f);
+
+	auto area = getLocalBounds().reduced(4);
+	g.setFont(11.0f);
+
+	// A row per part: the mean load since the last refresh, then the worst load and how long it took.
+	for (auto slot = 0; slot < profiler.getNumSlots(); ++slot) {
+		const auto row = area.removeFromTop(rowHeight);
+		const auto& stats = shown[static_cast<size_t>(slot)];
+		const double load = recentLoadPercent[static_cast<size_t>(slot)];
+
+		g.setColour(load > 100.0 ? juce::Colours::red : load > 70.0 ? juce::Colours::orange : juce::Colours::white);
+		g.drawText(profiler.getSlotName(slot), row.withWidth(60), juce::Justification::centredLeft, false);
+		g.drawText(juce::String(load, 1) + "%", row.withTrimmedLeft(60).withWidth(50), juce::Justification::centredRight, false);
+
+		g.setColour(stats.worstLoadPercent > 100.0 ? juce::Colours::red : juce::Colours::grey);
+		g.drawText("max " + juce::String(stats.worstLoadPercent, 1) + "% " + juce::String(stats.worstMs, 2) + " ms",
+			row.withTrimmedLeft(115), juce::Justification::centredLeft, false);
+	}
+
+	// Xruns seen from the callback, and by the device when it counts them.
+	const auto xrunRow = area.removeFromTop(rowHeight);
+	g.setColour(numXruns > 0 ? juce::Colours::red : juce::Colours::white);
+	g.drawText("Xruns " + juce::String(numXruns) + (numDeviceXruns >= 0 ? " (device " + juce::String(numDeviceXruns) + ")" : juce::String()),
+		xrunRow, juce::Justification::centredLeft, false);
+
+	// Histogram of the callback load, on a log scale so that rare slow blocks still show, with the budget marked.
+	const auto& callback = shown[CallbackProfiler::callbackSlot];
+	juce::int64 tallest = 0;
+	for (const auto count : callback.histogram) {
+		tallest = juce::jmax(tallest, count);
+	}
+	const auto plot = area.toFloat();
+	const float binWidth = plot.getWidth() / CallbackProfiler::numBins;
+	for (auto bin = 0; bin < CallbackProfiler::numBins && tallest > 0; ++bin) {
+		const juce::int64 count = callback.histogram[bin];
+		if (count == 0) {
+			continue;
+		}
+		const float height = plot.getHeight() * static_cast<float>(std::log1p(static_cast<double>(count)) / std::log1p(static_cast<double>(tallest)));
+		g.setColour(bin * CallbackProfiler::binWidthPercent >= 100 ? juce::Colours::red : juce::Colours::aqua);
+		g.fillRect(plot.getX() + bin * binWidth, plot.getBottom() - height, juce::jmax(1.0f, binWidth - 1), height);
+	}
+	g.setColour(juce::Colours::white.withAlpha(0.5f));
+	g.fillRect(plot.getX() + 100.0f / CallbackProfiler::binWidthPercent * binWidth, plot.getY(), 1.0f, plot.getHeight());
+}
+
+void CallbackProfilerDisplay::mouseDown(const juce::MouseEvent& e)
+{
+	juce::PopupMenu menu;
+	menu.addItem("Export statistics...", [this]() { exportStatistics(); });
+	menu.addItem("Reset statistics", [this]() { profiler.reset(); });
+	menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this));
+}
+
+void CallbackProfilerDisplay::timerCallback()
+{
+	// The mean load of a part since the last refresh is the load it added over the blocks it added.
+	for (auto slot = 0; slot < profiler.getNumSlots(); ++slot) {
+		const auto stats = profiler.getStats(slot);
+		auto& previous = shown[static_cast<size_t>(slot)];
+		const juce::int64 newBlocks = stats.numBlocks - previous.numBlocks;
+		if (newBlocks > 0) {
+			recentLoadPercent[static_cast<size_t>(slot)] = (stats.totalLoadPercent - previous.totalLoadPercent) / newBlocks;
+		}
+		else if (newBlocks < 0) {
+			// The statistics were reset since the last refresh.
+			recentLoadPercent[static_cast<size_t>(slot)] = 0;
+		}
+		previous = stats;
+	}
+
+	numXruns = profiler.getNumXruns();
+	auto* device = deviceManager.getCurrentAudioDevice();
+	numDeviceXruns = device != nullptr ? device->getXRunCount() : -1;
+
+	repaint();
+}
+
+void CallbackProfilerDisplay::exportStatistics()
+{
+	auto chooserFlags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles | juce::FileBrowserComponent::warnAboutOverwriting;
+
+	exportChooser = std::make_unique<juce::FileChooser>("Export Audio Statistics To", juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("Audio statistics.json"), "*.json");
+
+	exportChooser->launchAsync(chooserFlags, [this](const juce::FileChooser& chooser)
+		{
+			auto file = chooser.getResult();
+			if (file == juce::File{}) {
+				return;
+			}
+
+			// Add what the device knows about itself to the profiler's own statistics.
+			auto report = profiler.createReport();
+			if (auto* object = report.getDynamicObject()) {
+				if (auto* device = deviceManager.getCurrentAudioDevice()) {
+					object->setProperty("device", device->getName());
+					object->setProperty("blockSize", device->getCurrentBufferSizeSamples());
+					object->setProperty("deviceXruns", device->getXRunCount());
+				}
+			}
+
+			const bool written = file.replaceWithText(juce::JSON::toString(report));
+			DBG("CallbackProfilerDisplay::exportStatistics: " << (written ? "Wrote " : "Could not write ") << file.getFullPathName());
+		});
+}
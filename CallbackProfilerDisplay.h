@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "CallbackProfiler.h"
+
+// The CallbackProfilerDisplay class is a small overlay showing the readings of a CallbackProfiler: for the callback,
+// the render of the decks, the mix and every deck, the mean load since the last refresh and the worst load, as
+// percentages of the block budget, then the xruns and the histogram of the callback load.
+// Clicking it offers to export every statistic to a JSON file or to reset them.
+// It polls the profiler on its own timer, so it never touches the audio thread.
+class CallbackProfilerDisplay : public juce::Component,
+	public juce::Timer
+{
+public:
+	// Constructor takes the profiler to display and the device manager whose device reports its own xruns.
+	CallbackProfilerDisplay(CallbackProfiler& profilerToShow, juce::AudioDeviceManager& _deviceManager);
+
+	// Destructor stops the refresh timer.
+	~CallbackProfilerDisplay() override;
+
+	// Returns the height that fits every part and the histogram.
+	int getIdealHeight() const;
+
+private:
+	// Paints a row per part, the xrun counts and the histogram of the callback load.
+	void paint(juce::Graphics& g) override;
+
+	// Clicking the display offers to export or reset the statistics.
+	void mouseDown(const juce::MouseEvent& e) override;
+
+	// Fetches new readings, works out the mean loads since the last refresh and repaints.
+	void timerCallback() override;
+
+	// Asks where to save the statistics and writes them there as JSON.
+	void exportStatistics();
+
+	// The profiler whose readings are shown.
+	CallbackProfiler& profiler;
+
+	// The device manager whose current device is asked for its xrun count.
+	juce::AudioDeviceManager& deviceManager;
+
+	// The readings at the last refresh, and the mean load of every part between the last two refreshes.
+	std::vector<CallbackProfiler::Stats> shown;
+	std::vector<double> recentLoadPercent;
+
+	// The xruns seen by the profiler, and by the device, or -1 when it does not count them.
+	juce::int64 numXruns = 0;
+	int numDeviceXruns = -1;
+
+	// Chooser of the file the statistics are exported to.
+	std::unique_ptr<juce::FileChooser> exportChooser;
+
+	// Height of a row of text and of the histogram.
+	static constexpr int rowHeight = 13;
+	static constexpr int histogramHeight = 24;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CallbackProfilerDisplay)
+};
@@ -0,0 +1,102 @@
+#include "Crossfader.h"
+
+
+namespace {
+	// Number of steps of the fader in each table. The gains between two steps are interpolated.
+	constexpr int tableSize = 1024;
+
+	// Gain of deck A at every step of every curve, with one more entry so that the interpolation can read past the
+	// last step.
+	struct CurveTables {
+		CurveTables() {
+			for (auto step = 0; step <= tableSize; ++step) {
+				const double position = static_cast<double>(step) / tableSize;
+				const double cutStart = 1.0 - Crossfader::sharpCutWidth;
+
+				gains[Crossfader::linear][step] = static_cast<float>(1.0 - position);
+				gains[Crossfader::constantPower][step] = static_cast<float>(std::cos(position * juce::MathConstants<double>::halfPi));
+				gains[Crossfader::sharpCut][step] = position <= cutStart ? 1.0f
+					: static_cast<float>(std::cos((position - cutStart) / Crossfader::sharpCutWidth * juce::MathConstants<double>::halfPi));
+			}
+
+			// The ends are exact, so that a fader at either end leaves the other deck silent.
+			for (auto curve = 0; curve < Crossfader::numCurves; ++curve) {
+				gains[curve][0] = 1.0f;
+				gains[curve][tableSize] = 0.0f;
+			}
+		}
+
+		float gains[Crossfader::numCurves][tableSize + 1];
+	};
+
+	// The tables are computed the first time they are asked for, which is when the first Crossfader is made.
+	const CurveTables& getCurveTables() {
+		static const CurveTables curveTables;
+		return curveTables;
+	}
+}
+
+
+// Constructor for the Crossfader class. Building the tables here keeps the work off the audio thread.
+Crossfader::Crossfader()
+{
+	getCurveTables();
+}
+
+
+// Define the setPosition() method for the Crossfader class.
+void Crossfader::setPosition(float newPosition) {
+	targetPosition.store(juce::jlimit(0.0f, 1.0f, newPosition), std::memory_order_relaxed);
+}
+
+
+// Define the setCurve() method for the Crossfader class.
+void Crossfader::setCurve(Curve newCurve) {
+	if (newCurve < 0 || newCurve >= numCurves) {
+		DBG("Crossfader::setCurve unknown curve");
+		return;
+	}
+	targetCurve.store(newCurve, std::memory_order_relaxed);
+}
+
+
+// Define the getCurve() method for the Crossfader class.
+Crossfader::Curve Crossfader::getCurve() const {
+	return static_cast<Curve>(targetCurve.load(std::memory_order_relaxed));
+}
+
+
+// Define the prepare() method for the Crossfader class.
+void Crossfader::prepare(double sampleRate) {
+	position.reset(sampleRate, rampTimeSeconds);
+	position.setCurrentAndTargetValue(targetPosition.load(std::memory_order_relaxed));
+}
+
+
+// Define the getGain() method for the Crossfader class, which interpolates between two steps of the table.
+float Crossfader::getGain(Curve curve, float position) {
+	const float* gains = getCurveTables().gains[curve];
+	const float index = juce::jlimit(0.0f, 1.0f, position) * tableSize;
+	const int step = juce::jmin(static_cast<int>(index), tableSize - 1);
+	const float fraction = index - static_cast<float>(step);
+	return gains[step] + fraction * (gains[step + 1] - gains[step]);
+}
+
+
+// Define the advance() method for the Crossfader class.
+Crossfader::Gains Crossfader::advance(int numSamples) {
+	position.setTargetValue(targetPosition.load(std::memory_order_relaxed));
+	const float current = position.skip(numSamples);
+	const Curve curve = getCurve();
+
+	Gains gains;
+	gains.a = getGain(curve, current);
+	gains.b = getGain(curve, 1.0f - current);
+	return gains;
+}
+
+
+// Define the isMoving() method for the Crossfader class.
+bool Crossfader::isMoving() const {
+	return position.isSmoothing() || position.getTargetValue() != targetPosition.load(std::memory_order_relaxed);
+}
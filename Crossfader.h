@@ -0,0 +1,87 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// Crossfader gives the gains of the two decks in the mix stage of the audio callback.
+// The message thread only stores the position of the fader and the curve; the audio thread ramps the position
+// towards the latest value and looks the gain of each deck up in a table of the curve at the end of every segment,
+// and the MixBus ramps each deck linearly to that gain over the segment. While the fader moves, the mix is made in
+// segments of segmentSamples, so the gains follow the curve rather than a straight line across the block; a cut with
+// the sharp curve is then spread over no more than one segment, which is what stops it clicking. When the fader is
+// still, a segment is the whole block.
+// The tables are computed once, the first time a Crossfader is made, and shared by every instance.
+class Crossfader {
+public:
+
+	// Shapes of the fade from one deck to the other.
+	enum Curve {
+		linear = 0,			// Gains fall in a straight line, so both decks are 6 dB down at the centre.
+		constantPower,		// Gains follow a quarter sine, so the summed power of uncorrelated tracks stays constant.
+		sharpCut,			// Both decks stay at full level until the fader is close to the other end.
+		numCurves
+	};
+
+	// Constructor for the Crossfader class, which starts at the centre with the constant power curve.
+	Crossfader();
+
+	// Method to move the fader. Called from the message thread.
+	// Parameters:
+	// - newPosition: 0 for deck A alone, 1 for deck B alone.
+	void setPosition(float newPosition);
+
+	// Method to choose the curve. Called from the message thread.
+	// Parameters:
+	// - newCurve: One of the Curve values.
+	void setCurve(Curve newCurve);
+
+	// Method to return the curve chosen last.
+	Curve getCurve() const;
+
+	// Gains of the two decks.
+	struct Gains {
+		float a = 1.0f;
+		float b = 1.0f;
+	};
+
+	// Method to prepare the ramp for a sample rate and jump to the latest position.
+	// Parameters:
+	// - sampleRate: The sample rate of the decks.
+	void prepare(double sampleRate);
+
+	// Method to move the ramp on by one segment and pick up the latest curve. Called on the audio thread.
+	// A new curve applies from the end of the segment, so the gains are blended from the old curve to the new one
+	// over the segment, which is a whole block unless the fader is moving too.
+	// Parameters:
+	// - numSamples: The length of the segment.
+	// Returns:
+	// - The gains of both decks at the end of the segment.
+	Gains advance(int numSamples);
+
+	// Method to return whether the position is still ramping, or has been moved since the last segment. Called on the
+	// audio thread, to choose the length of the segments of the next block.
+	bool isMoving() const;
+
+	// Method to look up the gain of deck A for a curve; deck B uses the mirrored position. Safe from any thread.
+	// Parameters:
+	// - curve: The curve to read.
+	// - position: The fader position, from 0 to 1.
+	static float getGain(Curve curve, float position);
+
+	// Time taken by the ramp to follow the fader, in seconds, which is about the interval between two slider events.
+	static constexpr double rampTimeSeconds = 0.01;
+
+	// Part of the travel over which the sharp curve fades out.
+	static constexpr float sharpCutWidth = 0.04f;
+
+	// Length of the segments the curve is read at while the fader moves, about a third of a millisecond.
+	static constexpr int segmentSamples = 16;
+
+private:
+
+	// Latest position and curve set from the message thread.
+	std::atomic<float> targetPosition{ 0.5f };
+	std::atomic<int> targetCurve{ constantPower };
+
+	// Position ramp, owned by the audio thread.
+	juce::SmoothedValue<float> position{ 0.5f };
+};
@@ -10,35 +10,33 @@ DJAudioPlayer::DJAudioPlayer(juce::AudioFormatManager& _formatManager)
 };
 
 
-DJAudioPlayer::~DJAudioPlayer() {};
+DJAudioPlayer::~DJAudioPlayer() {
+	stopTimer();
+};
 
 
 
 // Define the prepareToPlay() method for the DJAudioPlayer class, which prepares the audio components for playback.
 void DJAudioPlayer::prepareToPlay(int samplesPerBlockExpected, double sampleRate) {
-	// Prepare the transport source for playback, specifying the number of samples per block and the sample rate.
-	transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-	// Prepare the resample source for playback with the same parameters.
+	// Prepare the resample source for playback, which also prepares the time stretcher and the transport behind it.
+	// The transport remembers the block size and sample rate for the tracks loaded from now on.
 	resampleSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
 
-	// Prepare the low-pass filter for playback with the given parameters.
-	audioLPFilter.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	// Prepare the EQ/filter cascade for playback at the given sample rate.
+	deckFilter.prepare(sampleRate);
 
-	// Prepare the high-pass filter for playback with the given parameters.
-	audioHPFilter.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	// Prepare the output meter for the given sample rate.
+	meter.prepare(sampleRate);
 
-	// Prepare the low-band filter for playback with the given parameters.
-	audioLBFilter.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	// Restart the gain smoothing at the new sample rate, jumping straight to the current trim.
+	smoothedGain.reset(sampleRate, gainSmoothingTimeSeconds);
+	smoothedGain.setCurrentAndTargetValue(smoothedGain.getTargetValue());
 
-	// Prepare the mid-band filter for playback with the given parameters.
-	audioMBFilter.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	// Prepare the sample pads, which are resampled to the new rate if it has changed.
+	padEngine.prepareToPlay(samplesPerBlockExpected, sampleRate);
 
-	// Prepare the high-band filter for playback with the given parameters.
-	audioHBFilter.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-	// Prepare the drum transport source for playback with the given parameters.
-	//drumTransportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	// Restart the clock that places transport commands inside the block.
+	commandClock.prepare(sampleRate);
 
 	// Store the sample rate for use in other methods or calculations.
 	thisSampleRate = sampleRate;
@@ -46,13 +44,145 @@ void DJAudioPlayer::prepareToPlay(int samplesPerBlockExpected, double sampleRate
 
 
 
+// Define the getNextAudioBlock() method for the DJAudioPlayer class, which renders the deck.
+// The block is rendered in segments split at the queued transport commands, so that each one takes effect at the
+// sample matching when it was sent. Since the stretcher and resampler read slightly ahead of their output, a
+// command reaches the file a few samples before it is heard.
 void DJAudioPlayer::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
-	audioLPFilter.getNextAudioBlock(bufferToFill);
-	float rmsLevelLeft = juce::Decibels::gainToDecibels(bufferToFill.buffer->getRMSLevel(0, 0, bufferToFill.buffer->getNumSamples()));
-	float rmsLevelRight = juce::Decibels::gainToDecibels(bufferToFill.buffer->getRMSLevel(1, 0, bufferToFill.buffer->getNumSamples()));
-	level = (rmsLevelLeft + rmsLevelRight) / 2;
+	pullParameters();
+	commandClock.beginBlock();
+
+	int done = 0;
+	int start1, size1, start2, size2;
+	commandFifo.prepareToRead(commandFifo.getNumReady(), start1, size1, start2, size2);
+	for (auto i = 0; i < size1 + size2; ++i) {
+		const TransportCommand& command = commands[i < size1 ? start1 + i : start2 + i - size1];
+		const int offset = juce::jmax(done, commandClock.getSampleOffset(command.time, bufferToFill.numSamples));
+		if (offset > done) {
+			resampleSource.getNextAudioBlock(juce::AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, offset - done));
+			done = offset;
+		}
+		applyCommand(command);
+	}
+	commandFifo.finishedRead(size1 + size2);
+
+	if (done < bufferToFill.numSamples) {
+		resampleSource.getNextAudioBlock(juce::AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, bufferToFill.numSamples - done));
+	}
+
+	padEngine.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+	deckFilter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+	// Apply the track gain as a per-sample ramp from where the last block ended.
+	const float startGain = smoothedGain.getCurrentValue();
+	const float endGain = smoothedGain.skip(bufferToFill.numSamples);
+	if (startGain != endGain) {
+		bufferToFill.buffer->applyGainRamp(bufferToFill.startSample, bufferToFill.numSamples, startGain, endGain);
+	}
+	else if (endGain != 1.0f) {
+		bufferToFill.buffer->applyGain(bufferToFill.startSample, bufferToFill.numSamples, endGain);
+	}
+
+	// Measure the finished block for the GUI meters.
+	meter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+	samplesSinceJump += bufferToFill.numSamples;
 	};
 
+// Define the pushCommand() method for the DJAudioPlayer class, which stamps a transport command and queues it.
+bool DJAudioPlayer::pushCommand(TransportCommand::Type type, juce::int64 position, double rate) {
+	int start1, size1, start2, size2;
+	commandFifo.prepareToWrite(1, start1, size1, start2, size2);
+	if (size1 == 0) {
+		DBG("DJAudioPlayer::pushCommand command queue is full");
+		return false;
+	}
+
+	auto& command = commands[start1];
+	command.type = type;
+	command.position = position;
+	command.rate = rate;
+	command.time = BlockClock::now();
+	command.trackSerial = transport.getLatestSerial();
+	commandFifo.finishedWrite(1);
+	return true;
+}
+
+// Define the applyCommand() method for the DJAudioPlayer class, which applies a transport command on the audio thread.
+void DJAudioPlayer::applyCommand(const TransportCommand& command) {
+	switch (command.type) {
+	case TransportCommand::play:
+		transport.start();
+		break;
+	case TransportCommand::pause:
+		transport.stop();
+		break;
+	case TransportCommand::seek:
+		transport.seekTrack(command.trackSerial, command.position);
+		samplesSinceJump = 0;
+		break;
+	case TransportCommand::cueJump:
+		transport.seekTrack(command.trackSerial, command.position);
+		transport.start();
+		samplesSinceJump = 0;
+		break;
+	case TransportCommand::rateChange:
+		currentSpeed = command.rate;
+		updateRates();
+		break;
+	case TransportCommand::trimChange:
+		// The trim of the playing track ramps; that of a track still fading in behind the old one waits for the swap.
+		if (command.trackSerial == transport.getCurrentSerial()) {
+			smoothedGain.setTargetValue(static_cast<float>(command.rate));
+		}
+		else if (command.trackSerial > transport.getCurrentSerial()) {
+			deferredTrimSerial = command.trackSerial;
+			deferredTrim = static_cast<float>(command.rate);
+		}
+		break;
+	}
+}
+
+// Define the updateRates() method for the DJAudioPlayer class, which sets the ratios of the stretcher and resample source.
+// With key lock on the stretcher changes the tempo and the resampler only converts the file to the device rate;
+// otherwise the resampler does both. The speed is that of the deck's control times the ratio set by sync.
+void DJAudioPlayer::updateRates() {
+	const double speed = currentSpeed * syncRatio;
+	timeStretcher.setEnabled(currentKeyLock);
+	timeStretcher.setStretchRatio(currentKeyLock ? speed : 1.0);
+	resampleSource.setResamplingRatio((currentKeyLock ? 1.0 : speed) * currentRateRatio);
+}
+
+// Define the pullParameters() method for the DJAudioPlayer class, which hands the latest control values to the audio objects.
+// Runs on the audio thread, so every coefficient change happens between blocks instead of while a block is being rendered.
+void DJAudioPlayer::pullParameters() {
+	// Pick up a newly loaded track first, so that the rates below are those of the track about to be played. The swap
+	// happens on silence, so the trim of the new track is taken at once rather than ramped over its first samples.
+	const juce::uint32 previousSerial = transport.getCurrentSerial();
+	transport.swapPendingTrack();
+	if (transport.getCurrentSerial() != previousSerial) {
+		smoothedGain.setCurrentAndTargetValue(deferredTrimSerial == transport.getCurrentSerial() ? deferredTrim : 1.0f);
+		deferredTrimSerial = 0;
+	}
+
+	// The speed itself arrives as a transport command, so that it changes at the right sample.
+	const bool keyLock = parameters.get(DeckParameters::keyLock) > 0.5f;
+	const double fileRate = transport.getCurrentSampleRate();
+	const double rateRatio = fileRate > 0 ? fileRate / thisSampleRate : 1.0;
+	if (keyLock != currentKeyLock || rateRatio != currentRateRatio) {
+		currentKeyLock = keyLock;
+		currentRateRatio = rateRatio;
+		updateRates();
+	}
+
+	resampleSource.setQuality(static_cast<PolyphaseResampler::Quality>(static_cast<int>(parameters.get(DeckParameters::resamplerQuality))));
+
+	deckFilter.setBandGain(DeckFilter::lowBand, parameters.get(DeckParameters::lowBand));
+	deckFilter.setBandGain(DeckFilter::midBand, parameters.get(DeckParameters::midBand));
+	deckFilter.setBandGain(DeckFilter::highBand, parameters.get(DeckParameters::highBand));
+	deckFilter.setSweep(parameters.get(DeckParameters::filter));
+}
+
 //void DJAudioPlayer::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
 //	// Get the main track audio
 //	transportSource.getNextAudioBlock(bufferToFill);
@@ -77,26 +207,26 @@ void DJAudioPlayer::getNextAudioBlock(const juce::AudioSourceChannelInfo& buffer
 
 
 void DJAudioPlayer::releaseResources() {
-	audioLPFilter.releaseResources();
+	resampleSource.releaseResources();
 };
 
 
 void DJAudioPlayer::start() {
-	transportSource.start();
+	pushCommand(TransportCommand::play);
 };
 
 
 // Define the stop() method for the DJAudioPlayer class, which stops playback of the audio.
 void DJAudioPlayer::stop() {
-	// Stop the transport source, which halts the playback of the audio.
-	transportSource.stop();
+	// Queue a pause for the audio thread, where the transport fades out and halts the playback of the audio.
+	pushCommand(TransportCommand::pause);
 }
 
 // Define the isPlaying() method for the DJAudioPlayer class, which checks if the audio is currently playing.
 bool DJAudioPlayer::isPlaying() {
-	// Return whether the transport source is currently playing.
+	// Return whether the transport is currently playing.
 	// This indicates the playback status of the audio.
-	return transportSource.isPlaying();
+	return transport.isPlaying();
 }
 
 // Define the isLoaded() method for the DJAudioPlayer class, which checks if an audio file is loaded.
@@ -114,81 +244,157 @@ juce::URL DJAudioPlayer::returnURL() {
 
 
 
-// Define the loadURL() method for the DJAudioPlayer class, which loads an audio file from a given URL.
-void DJAudioPlayer::loadURL(juce::URL audioURL) {
-	// Create an AudioFormatReader for the audio URL by opening an input stream to the file.
-	auto* reader = formatManager.createReaderFor(audioURL.createInputStream(false));
+// Define the loadURL() method for the DJAudioPlayer class, which hands an audio file to the background loader.
+void DJAudioPlayer::loadURL(juce::URL audioURL, int numThumbnailReaders) {
+	TrackLoader::Request request;
+	request.url = audioURL;
+	request.storage = trackStorage;
+	request.readAheadSeconds = readAheadSeconds;
+	request.blockSize = transport.getBlockSize();
+	request.sampleRate = transport.getSampleRate();
+	request.numThumbnailReaders = numThumbnailReaders;
+	trackLoader.load(request);
+}
 
-	// Check if the reader was successfully created.
-	if (reader != nullptr) {
-		// Create a new AudioFormatReaderSource using the reader and enable playback.
-		std::unique_ptr<juce::AudioFormatReaderSource> newSource(new juce::AudioFormatReaderSource(reader, true));
+// Define the isLoading() method for the DJAudioPlayer class.
+bool DJAudioPlayer::isLoading() const {
+	return trackLoader.isLoading();
+}
 
-		// Set the new source to the transport source, specifying the sample rate from the reader.
-		transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
+// Define the loadProgress() method for the DJAudioPlayer class, which passes the progress of a load on to the listeners.
+void DJAudioPlayer::loadProgress(float progress) {
+	listeners.call([this, progress](Listener& l) { l.loadProgress(this, progress); });
+}
 
-		// Release ownership of the newSource to readerSource, managing its lifetime.
-		readerSource.reset(newSource.release());
+// Define the loadFinished() method for the DJAudioPlayer class, which hands a loaded file to the transport.
+// The audio thread swaps it in at the start of a block, after fading out the file it replaces.
+void DJAudioPlayer::loadFinished(TrackLoader::Result& result) {
+	const bool succeeded = result.track != nullptr;
 
-		// Log the size of the metadata associated with the loaded file.
-		DBG("real metadata size: " << reader->metadataValues.size());
+	if (succeeded) {
+		transport.setTrack(std::move(result.track));
 
 		// Update the loaded file name and URL.
-		loadedFileName = audioURL.getFileName();
+		loadedFileName = result.url.getFileName();
 		loaded = true;
-		currentAudioURL = audioURL;
+		loopInPosition = -1;
+		tempo = 0;
+		gridBpm.store(0.0);
+		currentAudioURL = result.url;
 	}
 	else {
-		// Log a debug message if the file could not be loaded.
+		// Log a debug message if the file could not be loaded. The previous file, if any, stays loaded.
 		DBG("Something went wrong loading the file ");
-		loaded = false;
+	}
+
+	listeners.call([this, succeeded, &result](Listener& l) { l.loadFinished(this, succeeded, result.thumbnailReaders); });
+}
+
+// Define the addListener() method for the DJAudioPlayer class.
+void DJAudioPlayer::addListener(Listener* listener) {
+	listeners.add(listener);
+}
+
+// Define the removeListener() method for the DJAudioPlayer class.
+void DJAudioPlayer::removeListener(Listener* listener) {
+	listeners.remove(listener);
+}
+
+
+
+
+// Define the setReadAheadTime() method for the DJAudioPlayer class, which sets the read-ahead buffer length for the next load.
+void DJAudioPlayer::setReadAheadTime(double seconds) {
+	if (seconds <= 0) {
+		DBG("DJAudioPlayer::setReadAheadTime seconds should be above 0");
+	}
+	else {
+		readAheadSeconds = seconds;
 	}
 }
 
+// Define the setHotCues() method for the DJAudioPlayer class, which passes the cue positions in samples to the track source.
+void DJAudioPlayer::setHotCues(const std::vector<double>& relativePositions) {
+	auto* track = transport.getTrack();
+	if (track == nullptr) {
+		return;
+	}
 
+	std::vector<juce::int64> positions;
+	for (auto position : relativePositions) {
+		positions.push_back(static_cast<juce::int64>(position * track->getTotalLength()));
+	}
+	track->setHotSpots(positions);
+}
 
+// Define the setTrackStorage() method for the DJAudioPlayer class, which chooses how the next loaded file is kept.
+void DJAudioPlayer::setTrackStorage(TrackSource::Storage storage) {
+	trackStorage = storage;
+}
+
+// Define the setOfflineRendering() method for the DJAudioPlayer class.
+void DJAudioPlayer::setOfflineRendering(bool offline) {
+	commandClock.setRealtime(!offline);
+	offlineRendering = offline;
+}
+
+// Define the waitUntilReady() method for the DJAudioPlayer class, which waits for the read-ahead of the latest track.
+bool DJAudioPlayer::waitUntilReady(int numSamples, int timeoutMs) {
+	auto* track = transport.getTrack();
+	return track == nullptr || track->waitUntilReady(numSamples, timeoutMs);
+}
 
 // Define the getRMSLevel() method for the DJAudioPlayer class, which returns the current RMS level.
 float DJAudioPlayer::getRMSLevel() {
 	// Return the current RMS (Root Mean Square) level, which represents the average power of the audio signal.
-	return level;
+	const auto snapshot = meter.getSnapshot();
+	return (snapshot.rmsDb[0] + snapshot.rmsDb[1]) / 2;
+}
+
+// Define the getMeter() method for the DJAudioPlayer class, which gives the GUI access to the full set of meter readings.
+LevelMeter& DJAudioPlayer::getMeter() {
+	return meter;
 }
 
 // Define the getPositionRelative() method for the DJAudioPlayer class, which returns the current playback position as a fraction of the total length.
 double DJAudioPlayer::getPositionRelative() {
 	// Calculate and return the relative position of the playback.
-	// If the length of the transport source is zero (which could indicate no audio is loaded), return 0.
+	// If the length of the transport is zero (which could indicate no audio is loaded), return 0.
 	// Otherwise, return the current position divided by the total length, giving a value between 0 and 1.
-	return (transportSource.getLengthInSeconds() == 0 ? 0 : transportSource.getCurrentPosition() / transportSource.getLengthInSeconds());
+	return (transport.getTotalLength() == 0 ? 0 : static_cast<double>(transport.getNextReadPosition()) / transport.getTotalLength());
 }
 
 
 
 
-// Define the setGain() method for the DJAudioPlayer class, which sets the gain for either volume or crossfade.
-void DJAudioPlayer::setGain(double gain, bool isVol) {
-	// Check if the gain should be applied to the volume (isVol is true) or crossfade (isVol is false).
-	if (isVol) {
-		// Update the playerVol variable with the new gain value.
-		playerVol = gain;
-	}
-	else {
-		// Update the crossFadeVol variable with the new gain value.
-		crossFadeVol = gain;
-	}
-
+// Define the setGain() method for the DJAudioPlayer class, which sets the volume of the deck.
+void DJAudioPlayer::setGain(double gain) {
 	// Validate that the gain value is within the range of 0 to 1.
 	if (gain < 0 || gain > 1.0) {
 		// Log a debug message if the gain value is out of the valid range.
 		DBG("DJAudioPlayer::setGain Gain should be between 0 and 1");
 	}
 	else {
-		// Set the gain of the transport source based on the product of playerVol and crossFadeVol.
-		// This allows for combined volume and crossfade adjustments.
-		transportSource.setGain(playerVol * crossFadeVol);
+		// Hand the new value to the audio engine, which reads it at the start of each block and ramps towards it.
+		parameters.set(DeckParameters::volume, static_cast<float>(gain));
 	}
 }
 
+// Define the getVolume() method for the DJAudioPlayer class.
+float DJAudioPlayer::getVolume() const {
+	return parameters.get(DeckParameters::volume);
+}
+
+// Define the setCue() method for the DJAudioPlayer class.
+void DJAudioPlayer::setCue(bool shouldCue) {
+	parameters.set(DeckParameters::cue, shouldCue ? 1.0f : 0.0f);
+}
+
+// Define the isCueOn() method for the DJAudioPlayer class.
+bool DJAudioPlayer::isCueOn() const {
+	return parameters.get(DeckParameters::cue) > 0.5f;
+}
+
 // Define the setSpeed() method for the DJAudioPlayer class, which sets the speed of the resample source.
 void DJAudioPlayer::setSpeed(double ratio) {
 	// Validate that the speed ratio is within the range of 0 to 100.
@@ -197,18 +403,132 @@ void DJAudioPlayer::setSpeed(double ratio) {
 		DBG("DJAudioPlayer::setSpeed Ratio should be between 0 and 100");
 	}
 	else {
-		// Set the resampling ratio of the resample source to the specified value.
-		// This adjusts the playback speed or pitch of the audio.
-		resampleSource.setResamplingRatio(ratio);
+		// Hand the new ratio to the audio thread, which applies it to the resample source at the matching sample of the next block.
+		pushCommand(TransportCommand::rateChange, 0, ratio);
+	}
+}
+
+// Define the setTrackGain() method for the DJAudioPlayer class, which hands the loudness trim of the track to the audio thread.
+// The trim is queued as a command stamped with the latest track, so that it only applies once that track is heard.
+void DJAudioPlayer::setTrackGain(double gainDb) {
+	pushCommand(TransportCommand::trimChange, 0, juce::Decibels::decibelsToGain(gainDb));
+}
+
+// Define the setResamplerQuality() method for the DJAudioPlayer class, which hands the quality tier to the audio thread.
+void DJAudioPlayer::setResamplerQuality(PolyphaseResampler::Quality quality) {
+	parameters.set(DeckParameters::resamplerQuality, static_cast<float>(quality));
+}
+
+// Define the setKeyLock() method for the DJAudioPlayer class, which hands the key lock setting to the audio thread.
+void DJAudioPlayer::setKeyLock(bool shouldLock) {
+	parameters.set(DeckParameters::keyLock, shouldLock ? 1.0f : 0.0f);
+}
+
+
+
+// Define the prepareJump() method for the DJAudioPlayer class, which finds the sample a jump goes to.
+juce::int64 DJAudioPlayer::prepareJump(double posInSecs) {
+	auto* track = transport.getTrack();
+	if (track == nullptr) {
+		return -1;
+	}
+
+	// Convert the position to a sample of the file, since the transport runs at the file's own rate.
+	return static_cast<juce::int64>(posInSecs * track->getSampleRate());
+}
+
+// Define the queueJump() method for the DJAudioPlayer class.
+void DJAudioPlayer::queueJump(TransportCommand::Type type, juce::int64 position) {
+	if (prefetchJump(pendingJump, type, position)) {
+		pushJump(type, position);
+	}
+}
+
+// Define the prefetchJump() method for the DJAudioPlayer class.
+// The pages of a memory-mapped file are faulted in, or the landing of a streamed one is read, on the read-ahead
+// thread; the message thread only checks on it, on a timer. An offline render has no timer to wait for, and waits here.
+bool DJAudioPlayer::prefetchJump(PendingJump& jump, TransportCommand::Type type, juce::int64 position) {
+	auto* track = transport.getTrack();
+	jump.position = -1;
+	if (track->prefetch(position, seekPrefetchSamples)) {
+		return true;
+	}
+
+	if (offlineRendering) {
+		const juce::uint32 startTime = juce::Time::getMillisecondCounter();
+		while (!track->isPrefetched(position, seekPrefetchSamples) && juce::Time::getMillisecondCounter() - startTime < static_cast<juce::uint32>(jumpTimeoutMs)) {
+			juce::Thread::sleep(1);
+		}
+		return true;
+	}
+
+	jump.type = type;
+	jump.position = position;
+	jump.trackSerial = transport.getLatestSerial();
+	jump.startTime = juce::Time::getMillisecondCounter();
+	startTimer(jumpPollIntervalMs);
+	return false;
+}
+
+// Define the pushJump() method for the DJAudioPlayer class.
+void DJAudioPlayer::pushJump(TransportCommand::Type type, juce::int64 position) {
+	if (pushCommand(type, position)) {
+		transport.getTrack()->jumpQueued(position);
 	}
 }
 
+// Define the timerCallback() method for the DJAudioPlayer class, which runs while a jump or a roll release waits for its audio.
+void DJAudioPlayer::timerCallback() {
+	if (isJumpReady(pendingJump)) {
+		pushJump(pendingJump.type, pendingJump.position);
+		pendingJump.position = -1;
+	}
+
+	if (isJumpReady(pendingRollRelease)) {
+		pendingRollRelease.position = -1;
+		if (transport.getLoopEngine().isRolling()) {
+			transport.getLoopEngine().exitLoop();
+		}
+	}
+
+	if (pendingJump.position < 0 && pendingRollRelease.position < 0) {
+		stopTimer();
+	}
+}
+
+// Define the isJumpReady() method for the DJAudioPlayer class.
+// A landing that could not be read is not waited for forever: after jumpTimeoutMs the jump is made without it.
+bool DJAudioPlayer::isJumpReady(PendingJump& jump) {
+	if (jump.position < 0) {
+		return false;
+	}
+
+	auto* track = transport.getTrack();
+	if (track == nullptr || transport.getLatestSerial() != jump.trackSerial) {
+		jump.position = -1;
+		return false;
+	}
+
+	const bool ready = track->isPrefetched(jump.position, seekPrefetchSamples);
+	if (!ready && juce::Time::getMillisecondCounter() - jump.startTime < static_cast<juce::uint32>(jumpTimeoutMs)) {
+		return false;
+	}
 
+	if (!ready) {
+		DBG("DJAudioPlayer::isJumpReady the audio of a jump was not ready in time");
+	}
+	return true;
+}
 
-// Define the setPosition() method for the DJAudioPlayer class, which sets the position of the transport source.
+// Define the setPosition() method for the DJAudioPlayer class, which sets the position of the transport.
 void DJAudioPlayer::setPosition(double posInSecs) {
-	// Set the position of the transport source to the specified value in seconds.
-	transportSource.setPosition(posInSecs);
+	const auto position = prepareJump(posInSecs);
+	if (position < 0) {
+		return;
+	}
+
+	// Queued even for a track the audio thread has not picked up yet, which then starts from the position.
+	queueJump(TransportCommand::seek, position);
 }
 
 // Define the setPositionRelative() method for the DJAudioPlayer class, which sets the position as a fraction of the total length.
@@ -219,61 +539,216 @@ void DJAudioPlayer::setPositionRelative(double pos) {
 		DBG("DJAudioPlayer::setPositionRelative pos should be between 0 and 1");
 	}
 	else {
-		// Calculate the position in seconds based on the total length of the transport source and the relative position.
-		double posInSecs = transportSource.getLengthInSeconds() * pos;
+		// Calculate the position in seconds based on the length of the file in samples and the relative position.
+		auto* track = transport.getTrack();
+		double posInSecs = track != nullptr && track->getSampleRate() > 0 ? track->getTotalLength() / track->getSampleRate() * pos : 0;
 
 		// Call the setPosition() method with the calculated position in seconds to update the transport source.
 		setPosition(posInSecs);
 	}
 }
 
+// Define the jumpToCue() method for the DJAudioPlayer class, which jumps to a cue and plays from it.
+void DJAudioPlayer::jumpToCue(double pos) {
+	auto* track = transport.getTrack();
+	if (track == nullptr || track->getSampleRate() <= 0) {
+		return;
+	}
+
+	const auto position = prepareJump(track->getTotalLength() / track->getSampleRate() * juce::jlimit(0.0, 1.0, pos));
+	queueJump(TransportCommand::cueJump, position);
+}
+
 
 
-// Define the setFilter() method for the DJAudioPlayer class, which sets the filter based on the given frequency.
-void DJAudioPlayer::setFilter(double freq) {
-	// Check if the frequency is within the valid range for a high-pass filter (greater than 0 and less than 20000 Hz).
-	if (freq > 0 && freq < 20000) {
-		// Make the high-pass filter inactive, as we are setting up a low-pass filter.
-		audioHPFilter.makeInactive();
+// Define the setBeatGrid() method for the DJAudioPlayer class.
+void DJAudioPlayer::setBeatGrid(double bpm, double downbeatSeconds) {
+	tempo = juce::jmax(0.0, bpm);
+	gridDownbeat.store(juce::jmax(0.0, downbeatSeconds));
+	gridBpm.store(tempo);
+}
 
-		// Configure the low-pass filter with the specified cutoff frequency.
-		// Parameters:
-		// - thisSampleRate: The sample rate of the audio.
-		// - freq: The cutoff frequency in Hz for the low-pass filter.
-		audioLPFilter.setCoefficients(juce::IIRCoefficients::makeLowPass(thisSampleRate, freq));
+// Define the setBeatGridAtPosition() method for the DJAudioPlayer class.
+void DJAudioPlayer::setBeatGridAtPosition(double bpm) {
+	auto* track = transport.getTrack();
+	if (track == nullptr || track->getSampleRate() <= 0) {
+		return;
 	}
-	// Check if the frequency is within the valid range for a low-pass filter (less than 0 and greater than -20000 Hz).
-	else if (freq < 0 && freq > -20000) {
-		// Make the low-pass filter inactive, as we are setting up a high-pass filter.
-		audioLPFilter.makeInactive();
+	setBeatGrid(bpm, transport.getNextReadPosition() / track->getSampleRate());
+}
+
+// Define the setSync() method for the DJAudioPlayer class, which hands the sync setting to the audio thread.
+void DJAudioPlayer::setSync(bool shouldSync) {
+	parameters.set(DeckParameters::sync, shouldSync ? 1.0f : 0.0f);
+}
 
-		// Configure the high-pass filter with the absolute value of the frequency.
-		// Parameters:
-		// - thisSampleRate: The sample rate of the audio.
-		// - freq: The cutoff frequency in Hz for the high-pass filter (adjusted to be positive).
-		audioHPFilter.setCoefficients(juce::IIRCoefficients::makeHighPass(thisSampleRate, -freq));
+// Define the getBeatState() method for the DJAudioPlayer class.
+// The phase is that of the next sample heard. The transport is read ahead of it by the stretcher, in file samples,
+// and by the resampler, in samples of the stretcher's output; both amounts change with the ratios, the kernel and
+// every block, so they are taken away rather than assumed to be the same on every deck.
+DJAudioPlayer::BeatState DJAudioPlayer::getBeatState() const {
+	BeatState state;
+	const double fileRate = transport.getCurrentSampleRate();
+	state.playing = transport.isPlaying() && fileRate > 0;
+	state.steady = samplesSinceJump >= static_cast<juce::int64>(settleSeconds * thisSampleRate);
+	state.syncOn = parameters.get(DeckParameters::sync) > 0.5f;
+	state.bpm = gridBpm.load();
+	state.speed = currentSpeed;
+	if (fileRate > 0) {
+		const double stretchRatio = timeStretcher.isEnabled() ? timeStretcher.getStretchRatio() : 1.0;
+		const double heardPosition = transport.getCurrentPosition() - timeStretcher.getLatency() - resampleSource.getLatency() * stretchRatio;
+		state.beats = (heardPosition / fileRate - gridDownbeat.load()) * state.bpm / 60.0;
 	}
-	// Check if the frequency is zero.
-	else if (freq == 0) {
-		// Make both filters inactive, effectively removing any filtering from the signal.
-		audioHPFilter.makeInactive();
-		audioLPFilter.makeInactive();
+	return state;
+}
+
+// Define the setSyncRatio() method for the DJAudioPlayer class.
+void DJAudioPlayer::setSyncRatio(double ratio) {
+	if (ratio != syncRatio) {
+		syncRatio = ratio;
+		updateRates();
 	}
 }
 
+// Define the getBeatSeconds() method for the DJAudioPlayer class. Loops are measured in seconds until the tempo is known.
+double DJAudioPlayer::getBeatSeconds() const {
+	return tempo > 0 ? 60.0 / tempo : 1.0;
+}
 
+// Define the setLoopIn() method for the DJAudioPlayer class.
+void DJAudioPlayer::setLoopIn() {
+	loopInPosition = transport.getTrack() != nullptr ? transport.getNextReadPosition() : -1;
+}
+
+// Define the setLoopOut() method for the DJAudioPlayer class.
+bool DJAudioPlayer::setLoopOut() {
+	const juce::int64 loopOutPosition = transport.getNextReadPosition();
+	if (loopInPosition < 0 || loopOutPosition <= loopInPosition) {
+		DBG("DJAudioPlayer::setLoopOut loop out should be after loop in");
+		return false;
+	}
+	return setLoopSamples(loopInPosition, loopOutPosition, false);
+}
+
+// Define the setBeatLoop() method for the DJAudioPlayer class.
+bool DJAudioPlayer::setBeatLoop(double beats) {
+	auto* track = transport.getTrack();
+	if (track == nullptr || beats < minLoopBeats || beats > maxLoopBeats) {
+		return false;
+	}
 
-// Define the setLBFilter() method for the DJAudioPlayer class, which sets the coefficients for the low-band filter.
+	const juce::int64 start = transport.getNextReadPosition();
+	loopInPosition = start;
+	return setLoopSamples(start, start + static_cast<juce::int64>(beats * getBeatSeconds() * track->getSampleRate()), false);
+}
+
+// Define the halveLoop() method for the DJAudioPlayer class.
+void DJAudioPlayer::halveLoop() {
+	auto& loop = transport.getLoopEngine();
+	auto* track = transport.getTrack();
+	if (!loop.isLooping() || track == nullptr) {
+		return;
+	}
+
+	const juce::int64 length = (loop.getLoopEnd() - loop.getLoopStart()) / 2;
+	if (length >= static_cast<juce::int64>(minLoopBeats * getBeatSeconds() * track->getSampleRate())) {
+		setLoopSamples(loop.getLoopStart(), loop.getLoopStart() + length, loop.isRolling());
+	}
+}
+
+// Define the doubleLoop() method for the DJAudioPlayer class.
+void DJAudioPlayer::doubleLoop() {
+	auto& loop = transport.getLoopEngine();
+	auto* track = transport.getTrack();
+	if (!loop.isLooping() || track == nullptr) {
+		return;
+	}
+
+	const juce::int64 length = (loop.getLoopEnd() - loop.getLoopStart()) * 2;
+	if (length <= static_cast<juce::int64>(maxLoopBeats * getBeatSeconds() * track->getSampleRate())) {
+		setLoopSamples(loop.getLoopStart(), loop.getLoopStart() + length, loop.isRolling());
+	}
+}
+
+// Define the exitLoop() method for the DJAudioPlayer class.
+void DJAudioPlayer::exitLoop() {
+	pendingRollRelease.position = -1;
+	transport.getLoopEngine().exitLoop();
+}
+
+// Define the startLoopRoll() method for the DJAudioPlayer class.
+void DJAudioPlayer::startLoopRoll(double beats) {
+	auto* track = transport.getTrack();
+	if (track == nullptr || beats < minLoopBeats || beats > maxLoopBeats) {
+		return;
+	}
+
+	const juce::int64 start = transport.getNextReadPosition();
+	setLoopSamples(start, start + static_cast<juce::int64>(beats * getBeatSeconds() * track->getSampleRate()), true);
+}
+
+// Define the endLoopRoll() method for the DJAudioPlayer class.
+// The roll jumps back to where the track has got to, so it is only released once the audio there has been prefetched.
+// The landing covers the time the release waits, since the position it returns to moves on meanwhile.
+void DJAudioPlayer::endLoopRoll() {
+	auto& loop = transport.getLoopEngine();
+	if (!loop.isRolling()) {
+		return;
+	}
+
+	const juce::int64 rollReturn = loop.getRollReturn();
+	if (rollReturn < 0 || prefetchJump(pendingRollRelease, TransportCommand::seek, rollReturn)) {
+		loop.exitLoop();
+	}
+}
+
+// Define the isLooping() method for the DJAudioPlayer class.
+bool DJAudioPlayer::isLooping() const {
+	return transport.isLooping();
+}
+
+// Define the isLoopCached() method for the DJAudioPlayer class.
+bool DJAudioPlayer::isLoopCached() {
+	return !transport.getLoopEngine().isReadingCache();
+}
+
+// Define the getLoopRelative() method for the DJAudioPlayer class.
+bool DJAudioPlayer::getLoopRelative(double& start, double& end) {
+	const juce::int64 totalLength = transport.getTotalLength();
+	if (!transport.isLooping() || totalLength <= 0) {
+		return false;
+	}
+
+	start = static_cast<double>(transport.getLoopEngine().getLoopStart()) / totalLength;
+	end = static_cast<double>(transport.getLoopEngine().getLoopEnd()) / totalLength;
+	return true;
+}
+
+// Define the setLoopSamples() method for the DJAudioPlayer class, which hands a loop of the latest track to the transport.
+bool DJAudioPlayer::setLoopSamples(juce::int64 start, juce::int64 end, bool roll) {
+	pendingRollRelease.position = -1;
+	return transport.getLoopEngine().setLoop(transport.getTrack(), start, end, roll);
+}
+
+
+
+// Define the setFilter() method for the DJAudioPlayer class, which sets the filter based on the given frequency.
+void DJAudioPlayer::setFilter(double freq) {
+	// A positive frequency selects the low-pass filter, a negative one the high-pass filter, and zero bypasses both.
+	// Values at or beyond +/-20000 Hz are ignored.
+	if (freq > -20000 && freq < 20000) {
+		// Hand the new setting to the audio thread, which glides the cutoff and recomputes the coefficients itself.
+		parameters.set(DeckParameters::filter, static_cast<float>(freq));
+	}
+}
+
+
+
+// Define the setLBFilter() method for the DJAudioPlayer class, which sets the gain of the low-band (500 Hz low-shelf) filter.
 void DJAudioPlayer::setLBFilter(double gain) {
-	// Configure the low-band filter with a low-shelf filter type.
-	// Parameters:
-	// - thisSampleRate: The sample rate of the audio.
-	// - 500: The cutoff frequency in Hz.
-	// - 1.0 / juce::MathConstants<double>::sqrt2: The filter's quality factor (Q), which determines the filter's sharpness.
-	// - gain: The gain value to be applied to the filter.
-	audioLBFilter.setCoefficients(juce::IIRCoefficients::makeLowShelf(thisSampleRate, 500, 1.0 / juce::MathConstants<double>::sqrt2, gain));
-}
-void applyFadeIn(juce::AudioBuffer<float>& buffer, int fadeInDuration) {
+	parameters.set(DeckParameters::lowBand, static_cast<float>(gain));
+}
+void DJAudioPlayer::applyFadeIn(juce::AudioBuffer<float>& buffer, int fadeInDuration) {
 	int numSamples = buffer.getNumSamples();
 	for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
 		float* channelData = buffer.getWritePointer(channel);
@@ -284,7 +759,7 @@ void applyFadeIn(juce::AudioBuffer<float>& buffer, int fadeInDuration) {
 	}
 }
 
-void applyFadeOut(juce::AudioBuffer<float>& buffer, int fadeOutDuration) {
+void DJAudioPlayer::applyFadeOut(juce::AudioBuffer<float>& buffer, int fadeOutDuration) {
 	int numSamples = buffer.getNumSamples();
 	for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
 		float* channelData = buffer.getWritePointer(channel);
@@ -295,7 +770,7 @@ void applyFadeOut(juce::AudioBuffer<float>& buffer, int fadeOutDuration) {
 	}
 }
 
-void reverseAudio(juce::AudioBuffer<float>& buffer) {
+void DJAudioPlayer::reverseAudio(juce::AudioBuffer<float>& buffer) {
 	int numSamples = buffer.getNumSamples();
 	for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
 		float* channelData = buffer.getWritePointer(channel);
@@ -303,7 +778,7 @@ void reverseAudio(juce::AudioBuffer<float>& buffer) {
 	}
 }
 
-void applyLowPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate) {
+void DJAudioPlayer::applyLowPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate) {
 	juce::IIRFilter lowPassFilter;
 	lowPassFilter.setCoefficients(juce::IIRCoefficients::makeLowPass(sampleRate, cutoffFrequency));
 	for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
@@ -311,7 +786,7 @@ void applyLowPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency,
 	}
 }
 
-void applyHighPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate) {
+void DJAudioPlayer::applyHighPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate) {
 	juce::IIRFilter highPassFilter;
 	highPassFilter.setCoefficients(juce::IIRCoefficients::makeHighPass(sampleRate, cutoffFrequency));
 	for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
@@ -319,8 +794,9 @@ void applyHighPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency
 	}
 }
 
-void applyDelayEffect(juce::AudioBuffer<float>& buffer, int delaySamples, float feedback) {
+void DJAudioPlayer::applyDelayEffect(juce::AudioBuffer<float>& buffer, int delaySamples, float feedback) {
 	juce::AudioBuffer<float> delayBuffer(buffer.getNumChannels(), buffer.getNumSamples() + delaySamples);
+	delayBuffer.clear();
 	for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
 		float* channelData = buffer.getWritePointer(channel);
 		float* delayData = delayBuffer.getWritePointer(channel);
@@ -333,7 +809,7 @@ void applyDelayEffect(juce::AudioBuffer<float>& buffer, int delaySamples, float
 	}
 }
 
-void normalizeAudio(juce::AudioBuffer<float>& buffer) {
+void DJAudioPlayer::normalizeAudio(juce::AudioBuffer<float>& buffer) {
 	for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
 		float* channelData = buffer.getWritePointer(channel);
 		float maxSample = *std::max_element(channelData, channelData + buffer.getNumSamples());
@@ -347,137 +823,28 @@ void normalizeAudio(juce::AudioBuffer<float>& buffer) {
 }
 
 
-// Define the setMBFilter() method for the DJAudioPlayer class, which sets the coefficients for the mid-band filter.
+// Define the setMBFilter() method for the DJAudioPlayer class, which sets the gain of the mid-band (3250 Hz peak) filter.
 void DJAudioPlayer::setMBFilter(double gain) {
-	// Configure the mid-band filter with a peak filter type.
-	// Parameters:
-	// - thisSampleRate: The sample rate of the audio.
-	// - 3250: The center frequency of the peak filter in Hz.
-	// - 1.0 / juce::MathConstants<double>::sqrt2: The filter's quality factor (Q), which determines the filter's bandwidth.
-	// - gain: The gain value to be applied to the filter.
-	audioMBFilter.setCoefficients(juce::IIRCoefficients::makePeakFilter(thisSampleRate, 3250, 1.0 / juce::MathConstants<double>::sqrt2, gain));
+	parameters.set(DeckParameters::midBand, static_cast<float>(gain));
 }
 
-// Define the setHBFilter() method for the DJAudioPlayer class, which sets the coefficients for the high-band filter.
+// Define the setHBFilter() method for the DJAudioPlayer class, which sets the gain of the high-band (5000 Hz high-shelf) filter.
 void DJAudioPlayer::setHBFilter(double gain) {
-	// Configure the high-band filter with a high-shelf filter type.
-	// Parameters:
-	// - thisSampleRate: The sample rate of the audio.
-	// - 5000: The cutoff frequency in Hz.
-	// - 1.0 / juce::MathConstants<double>::sqrt2: The filter's quality factor (Q), which determines the filter's sharpness.
-	// - gain: The gain value to be applied to the filter.
-	audioHBFilter.setCoefficients(juce::IIRCoefficients::makeHighShelf(thisSampleRate, 5000, 1.0 / juce::MathConstants<double>::sqrt2, gain));
+	parameters.set(DeckParameters::highBand, static_cast<float>(gain));
 }
 
 
-void DJAudioPlayer::playDrumSample(const juce::String& drumSamplePath)
-{
-	auto* reader = formatManager.createReaderFor(juce::File(drumSamplePath));
-	if (reader == nullptr)
-	{
-		juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
-			"Error",
-			"Drum sample file not found or could not be loaded.",
-			"OK");
-		return;
-	}
-
-	try
-	{
-				if (drumReaderSource != nullptr)
-		{
-			mixerSource.removeInputSource(drumReaderSource.get());
-			drumReaderSource.reset();
-		}
-
-				drumReaderSource.reset(new juce::AudioFormatReaderSource(reader, true));
-		mixerSource.addInputSource(drumReaderSource.get(), false);
-
-				drumReaderSource->setNextReadPosition(0);
-	}
-	catch (const std::exception& e)
-	{
-		juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
-			"Error",
-			"An error occurred while playing the drum sample: " + juce::String(e.what()),
-			"OK");
-	}
+// Define the loadPadSample() method for the DJAudioPlayer class, which loads a sample into one of the pads.
+bool DJAudioPlayer::loadPadSample(int pad, const juce::File& file) {
+	return padEngine.loadSample(pad, file);
 }
 
-// Define the loadDrumSample() method for the DJAudioPlayer class, which loads a drum sample from a given path.
-void DJAudioPlayer::loadDrumSample(const juce::String& drumSamplePath) {
-	// Create a juce::File object from the provided drumSamplePath.
-	juce::File drumFile(drumSamplePath);
-
-	// Check if the file exists.
-	if (drumFile.existsAsFile()) {
-		// Create an AudioFormatReader for the drum file using the format manager.
-		auto* reader = formatManager.createReaderFor(drumFile);
-
-		// Check if the reader was successfully created.
-		if (reader != nullptr) {
-			// If there is a previously loaded drum sample source, clean it up.
-			if (drumReaderSource != nullptr) {
-				// Remove the previous source from the drumTransportSource and reset the drumReaderSource.
-				drumTransportSource.setSource(nullptr);
-				drumReaderSource.reset();
-			}
-
-			// Create a new AudioFormatReaderSource with the reader, and enable playback.
-			drumReaderSource.reset(new juce::AudioFormatReaderSource(reader, true));
-
-			// Set the new source to the drumTransportSource, specifying the sample rate of the reader.
-			drumTransportSource.setSource(drumReaderSource.get(), 0, nullptr, reader->sampleRate);
-
-			// Log a debug message indicating successful loading of the drum sample.
-			DBG("Drum sample loaded successfully.");
-
-			// Show a message box to the user indicating success.
-			juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::InfoIcon,
-				"Success",
-				"Drum Sample Loaded successfully.",
-				"OK");
-		}
-		else {
-			// Log a debug message if the reader could not be created.
-			DBG("Failed to create reader for drum sample.");
-
-			// Show a message box indicating an error with file existence.
-			/*juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
-				"Error",
-				"Drum Sound File Not Found.",
-				"OK");*/
-		}
-	}
-	else {
-		// Log a debug message if the drum file does not exist.
-		DBG("Drum file does not exist.");
-
-		// Show a message box indicating an error with file existence.
-		/*juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
-			"Error",
-			"Drum Sound File Not Found.",
-			"OK");*/
-	}
+// Define the loadPadPack() method for the DJAudioPlayer class, which loads a folder of samples into the pads.
+int DJAudioPlayer::loadPadPack(const juce::File& folder) {
+	return padEngine.loadPack(folder);
 }
 
-
-
-
-// Define the playDrum() method for the DJAudioPlayer class.
-void DJAudioPlayer::playDrum() {
-	// Check if the drumTransportSource is currently playing.
-	if (drumTransportSource.isPlaying()) {
-		// If the drumTransportSource is playing, reset its position to the start (0.0).
-		// This effectively restarts the drum sample from the beginning.
-		drumTransportSource.setPosition(0.0);
-	}
-	else {
-		// If the drumTransportSource is not playing, start playback of the drum sample.
-		// This begins playing the drum sample from its current position.
-		drumTransportSource.start();
-	}
+// Define the triggerPad() method for the DJAudioPlayer class, which queues a pad hit for the audio thread.
+void DJAudioPlayer::triggerPad(int pad) {
+	padEngine.trigger(pad);
 }
-
-
-
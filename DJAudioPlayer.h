@@ -1,19 +1,69 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "DeckFilter.h"
+#include "DeckParameters.h"
+#include "LevelMeter.h"
+#include "TimeStretcher.h"
+#include "PolyphaseResampler.h"
+#include "ReadAheadThread.h"
+#include "TrackSource.h"
+#include "DeckTransport.h"
+#include "TrackLoader.h"
+#include "SamplePadEngine.h"
+#include "BlockClock.h"
+
+
+class DJAudioPlayer : public juce::AudioSource,
+	private TrackLoader::Listener,
+	private juce::Timer {
+public:
 
+	// Interface of the objects told when a file that was asked for with loadURL() has been opened, called on the message thread.
+	class Listener {
+	public:
+		virtual ~Listener() = default;
 
-class DJAudioPlayer : public juce::AudioSource {
-public:
+		// Method called while a file is being opened.
+		// Parameters:
+		// - player: The player loading the file.
+		// - progress: How far the load has got, from 0 to 1.
+		virtual void loadProgress(DJAudioPlayer* player, float progress) {}
+
+		// Method called when a file is ready to play, or could not be opened, in which case the previous file stays loaded.
+		// Parameters:
+		// - player: The player that loaded the file.
+		// - succeeded: Whether the file was opened.
+		// - thumbnailReaders: Readers of the file opened in the background for the waveform displays, which the listener may take.
+		virtual void loadFinished(DJAudioPlayer* player, bool succeeded, juce::OwnedArray<juce::AudioFormatReader>& thumbnailReaders) = 0;
+	};
+
+	// Methods to register and unregister a Listener.
+	void addListener(Listener* listener);
+	void removeListener(Listener* listener);
 
 
 	// Declaration of the DJAudioPlayer class methods and constructor.
 
-// Method to load a drum sample from a given file path.
-	void loadDrumSample(const juce::String& drumSamplePath);
+	// Method to load an audio file into one of the deck's sample pads. The file is read and resampled here, once.
+	// Parameters:
+	// - pad: One of the SamplePadEngine::Pad values.
+	// - file: The audio file to load.
+	// Returns:
+	// - true if the file could be read.
+	bool loadPadSample(int pad, const juce::File& file);
 
-	// Method to start playback of the drum sample.
-	void playDrum();
+	// Method to load the audio files in a folder into the sample pads, in alphabetical order.
+	// Parameters:
+	// - folder: The folder of the sample pack.
+	// Returns:
+	// - The number of pads that were loaded.
+	int loadPadPack(const juce::File& folder);
+
+	// Method to play a sample pad, which starts in the next audio block at the point matching when it was pressed.
+	// Parameters:
+	// - pad: One of the SamplePadEngine::Pad values.
+	void triggerPad(int pad);
 
 	// Constructor for the DJAudioPlayer class, which initializes with a reference to an AudioFormatManager.
 	DJAudioPlayer(juce::AudioFormatManager& formatManager);
@@ -35,10 +85,10 @@ public:
 	// Method to release any resources held by the audio player.
 	void releaseResources() override;
 
-	// Method to start playback of the audio.
+	// Method to start playback of the audio, at the point of the next audio block matching when it was called.
 	void start();
 
-	// Method to stop playback of the audio.
+	// Method to stop playback of the audio, at the point of the next audio block matching when it was called.
 	void stop();
 
 	// Method to check if the audio is currently playing.
@@ -56,16 +106,58 @@ public:
 	// - The URL of the currently loaded audio file.
 	juce::URL returnURL();
 
-	// Method to load an audio file from a given URL.
+	// Method to start loading an audio file from a given URL on a background thread. The listeners are told when it is
+	// ready, and the current file keeps playing until then.
 	// Parameters:
 	// - audioURL: The URL of the audio file to be loaded.
-	void loadURL(juce::URL audioURL);
+	// - numThumbnailReaders: The number of extra readers of the file to open for waveform displays.
+	void loadURL(juce::URL audioURL, int numThumbnailReaders = 0);
+
+	// Method to check whether a file is being loaded.
+	bool isLoading() const;
+
+	// Method to set how much audio is read from disk ahead of the playhead, which takes effect from the next loaded file.
+	// Parameters:
+	// - seconds: The length of the read-ahead buffer in seconds of the file.
+	void setReadAheadTime(double seconds);
+
+	// Method to choose whether files are streamed from disk or decoded to RAM, which takes effect from the next loaded file.
+	// A decoded file keeps streaming until the decoder has reached the playhead.
+	// Parameters:
+	// - storage: One of the TrackSource::Storage options.
+	void setTrackStorage(TrackSource::Storage storage);
+
+	// Method to prepare the deck to be rendered offline, faster or slower than real time. Transport commands then take
+	// effect at the start of the next block rendered instead of at the point matching when they were sent.
+	// Called before prepareToPlay().
+	// Parameters:
+	// - offline: true when the deck is not rendered by an audio device.
+	void setOfflineRendering(bool offline);
+
+	// Method to wait, for at most a given time, until the audio after the playhead of the latest track can be read
+	// without going to disk. An offline render calls it before each block, from the thread that renders the deck.
+	// Parameters:
+	// - numSamples: The number of samples of the file after the playhead that should be ready.
+	// - timeoutMs: The longest time to wait in milliseconds.
+	// Returns:
+	// - false if the audio was not ready in time.
+	bool waitUntilReady(int numSamples, int timeoutMs);
+
+	// Method to tell the player where the cue points are, so that a memory-mapped file keeps the audio after them in memory.
+	// Parameters:
+	// - relativePositions: The cue positions as fractions of the total length.
+	void setHotCues(const std::vector<double>& relativePositions);
 
 	// Method to get the RMS (Root Mean Square) level of the audio signal.
 	// Returns:
-	// - The current RMS level of the audio signal.
+	// - The current RMS level of the audio signal in dBFS, averaged over both channels.
 	float getRMSLevel();
 
+	// Method to access the meter of the deck output, which can be read from any thread.
+	// Returns:
+	// - The deck's LevelMeter.
+	LevelMeter& getMeter();
+
 	// Method to get the current playback position as a fraction of the total length.
 	// Returns:
 	// - The current position relative to the total length of the audio, ranging from 0 to 1.
@@ -86,17 +178,44 @@ public:
 	// - gain: The gain value for the mid-band filter.
 	void setMBFilter(double gain);
 
-	// Method to set the gain for either volume or crossfade.
+	// Method to set the volume of the deck. The volume and the crossfader are applied after the deck, in the mix stage,
+	// so the deck's output, its meter and its cue send are all pre-fader.
 	// Parameters:
 	// - gain: The gain value to be set.
-	// - isVol: Flag indicating whether the gain applies to volume (true) or crossfade (false). Defaults to true.
-	void setGain(double gain, bool isVol = true);
+	void setGain(double gain);
+
+	// Method to return the latest volume set. Safe from any thread.
+	float getVolume() const;
+
+	// Method to send the deck to the headphone cue bus or take it off. The send is pre-fader.
+	// Parameters:
+	// - shouldCue: true to hear the deck in the headphones.
+	void setCue(bool shouldCue);
+
+	// Method to return whether the deck is sent to the cue bus. Safe from any thread.
+	bool isCueOn() const;
+
+	// Method to set the trim that brings the loaded track to the common loudness, applied at the end of the deck.
+	// It belongs to the latest track loaded, and takes effect when the transport swaps that track in.
+	// Parameters:
+	// - gainDb: The trim in dB found by the library's loudness analysis, 0 for none.
+	void setTrackGain(double gainDb);
 
 	// Method to set the speed of the audio playback.
 	// Parameters:
 	// - ratio: The resampling ratio for speed adjustment.
 	void setSpeed(double ratio);
 
+	// Method to switch key lock on or off. With key lock on, the speed changes the tempo but keeps the pitch.
+	// Parameters:
+	// - shouldLock: true to keep the original pitch at any speed.
+	void setKeyLock(bool shouldLock);
+
+	// Method to choose the quality of the resampler that applies the speed and converts the file to the device rate.
+	// Parameters:
+	// - quality: One of the PolyphaseResampler::Quality tiers.
+	void setResamplerQuality(PolyphaseResampler::Quality quality);
+
 	// Method to set the playback position in seconds.
 	// Parameters:
 	// - posInSecs: The position in seconds to set.
@@ -107,106 +226,300 @@ public:
 	// - pos: The relative position, ranging from 0 to 1.
 	void setPositionRelative(double pos);
 
+	// Method to jump to a cue point and play from it, as a single command applied at one sample.
+	// Parameters:
+	// - pos: The position of the cue, ranging from 0 to 1.
+	void jumpToCue(double pos);
+
+	// Method to set the beat grid of the loaded track, which sets the length of a beat for loops and is what sync locks to.
+	// Parameters:
+	// - bpm: The tempo in beats per minute, or 0 when it is not known, in which case a beat lasts one second.
+	// - downbeatSeconds: The time of a downbeat in the file, which anchors the grid, or -1 to use the start of the file.
+	void setBeatGrid(double bpm, double downbeatSeconds = -1);
+
+	// Method to set the beat grid from tapped beats, with a beat at the current position.
+	// Parameters:
+	// - bpm: The tempo of the track at normal speed.
+	void setBeatGridAtPosition(double bpm);
+
+	// Method to switch sync on or off. A synced deck follows the tempo and beat phase of the master deck.
+	// Parameters:
+	// - shouldSync: true to follow the master deck.
+	void setSync(bool shouldSync);
+
+	// Where the deck is on its beat grid at the start of a block, as read by BeatSync on the audio thread.
+	struct BeatState {
+		bool playing = false;
+		// Whether the deck has played on without a jump or scratch for at least settleSeconds.
+		bool steady = false;
+		bool syncOn = false;
+		// Tempo of the track at normal speed, 0 when not known, and the speed set on the deck.
+		double bpm = 0;
+		double speed = 1.0;
+		// Number of beats from the downbeat to the read position.
+		double beats = 0;
+	};
+
+	// Method to return where the deck is on its beat grid. Called on the audio thread, between blocks.
+	BeatState getBeatState() const;
+
+	// Method to set the rate by which sync multiplies the speed of the deck. Called on the audio thread, between blocks.
+	// Parameters:
+	// - ratio: The ratio, 1 when the deck is not following another.
+	void setSyncRatio(double ratio);
+
+	// Time a deck must play without a jump before its beat phase counts for sync, in seconds.
+	static constexpr double settleSeconds = 0.25;
+
+	// Method to return the length of one beat of the loaded track in seconds.
+	double getBeatSeconds() const;
+
+	// Method to mark the current position as the start of a manual loop.
+	void setLoopIn();
+
+	// Method to loop from the position marked with setLoopIn() to the current position.
+	// Returns:
+	// - true if a loop was set.
+	bool setLoopOut();
+
+	// Method to loop a number of beats from the current position.
+	// Parameters:
+	// - beats: The length of the loop, from minLoopBeats to maxLoopBeats.
+	// Returns:
+	// - true if a loop was set.
+	bool setBeatLoop(double beats);
+
+	// Methods to halve or double the length of the current loop, keeping its start.
+	void halveLoop();
+	void doubleLoop();
+
+	// Method to leave the current loop, so that playback carries on past its end.
+	void exitLoop();
+
+	// Method to start a loop roll: a beat loop that, once released with endLoopRoll(), jumps to where the track
+	// would have been had it not looped.
+	// Parameters:
+	// - beats: The length of the loop.
+	void startLoopRoll(double beats);
+	void endLoopRoll();
+
+	// Method to check whether the deck is looping.
+	bool isLooping() const;
+
+	// Method to check whether the latest loop plays from RAM, rather than from the track while its cache is read.
+	bool isLoopCached();
+
+	// Method to get the current loop as fractions of the total length.
+	// Parameters:
+	// - start: Set to the start of the loop, from 0 to 1.
+	// - end: Set to the end of the loop, from 0 to 1.
+	// Returns:
+	// - false if there is no loop, in which case start and end are left unchanged.
+	bool getLoopRelative(double& start, double& end);
+
+	// Shortest and longest beat loops.
+	static constexpr double minLoopBeats = 0.125;
+	static constexpr double maxLoopBeats = 32.0;
+
 	// Method to set the gain for the high-band filter.
 	// Parameters:
 	// - gain: The gain value for the high-band filter.
 	void setHBFilter(double gain);
 
-	// Method to play a drum sample from a given file path.
-	// Parameters:
-	// 
-	void applyFadeIn(juce::AudioBuffer<float>& buffer, int fadeInDuration);
-	void applyFadeOut(juce::AudioBuffer<float>& buffer, int fadeOutDuration);
-	void reverseAudio(juce::AudioBuffer<float>& buffer);
-	void applyLowPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate);
-	void applyHighPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate);
-	void applyDelayEffect(juce::AudioBuffer<float>& buffer, int delaySamples, float feedback);
-	void normalizeAudio(juce::AudioBuffer<float>& buffer);
-
-	// - drumSamplePath: The file path of the drum sample to be played.
-	void playDrumSample(const juce::String& drumSamplePath);
+	// Offline helpers that process a whole buffer of samples. They use no state of the deck.
+	static void applyFadeIn(juce::AudioBuffer<float>& buffer, int fadeInDuration);
+	static void applyFadeOut(juce::AudioBuffer<float>& buffer, int fadeOutDuration);
+	static void reverseAudio(juce::AudioBuffer<float>& buffer);
+	static void applyLowPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate);
+	static void applyHighPassFilter(juce::AudioBuffer<float>& buffer, float cutoffFrequency, double sampleRate);
+	static void applyDelayEffect(juce::AudioBuffer<float>& buffer, int delaySamples, float feedback);
+	static void normalizeAudio(juce::AudioBuffer<float>& buffer);
 
 
 	
 private:
 
+	// A transport change sent by the message thread, stamped with the BlockClock time at which it was made and with
+	// the serial of the latest track at that time, which a seek or a trim applies to.
+	struct TransportCommand {
+		enum Type {
+			play = 0,
+			pause,
+			seek,
+			cueJump,
+			rateChange,
+			trimChange
+		};
+
+		Type type = play;
+		juce::int64 position = 0;
+		double rate = 1.0;
+		double time = 0;
+		juce::uint32 trackSerial = 0;
+	};
+
+	// Method called by the audio thread at the start of each block to pick up the latest control values.
+	void pullParameters();
+
+	// Method to queue a transport command for the audio thread. Called from the message thread.
+	// Returns:
+	// - false if the queue was full and the command was dropped.
+	bool pushCommand(TransportCommand::Type type, juce::int64 position = 0, double rate = 1.0);
+
+	// Method called on the audio thread to apply a transport command between two samples of a block.
+	void applyCommand(const TransportCommand& command);
+
+	// Method to apply the current speed, key lock setting and rate ratio to the stretcher and resample source.
+	void updateRates();
+
+	// Method to convert a position in seconds into a sample of the latest track.
+	// Returns:
+	// - The position in samples, or -1 when no track is loaded.
+	juce::int64 prepareJump(double posInSecs);
+
+	// Method to prefetch the audio at a position of the latest track and to queue a seek or cue jump there once it is
+	// ready, so that the audio thread never waits for the disk or plays silence after the jump. A later jump replaces
+	// one that is still waiting.
+	// Parameters:
+	// - type: TransportCommand::seek or TransportCommand::cueJump.
+	// - position: The position in samples of the latest track.
+	void queueJump(TransportCommand::Type type, juce::int64 position);
+
+	// Method to queue a jump whose audio is ready, and to keep its landing until the audio thread has applied it.
+	void pushJump(TransportCommand::Type type, juce::int64 position);
+
+	// Method called on the message thread while a jump or a roll release waits for its audio, which makes it once the
+	// audio is ready.
+	void timerCallback() override;
+
+	// Methods of TrackLoader::Listener, which hand a loaded file to the transport and tell the listeners.
+	void loadProgress(float progress) override;
+	void loadFinished(TrackLoader::Result& result) override;
+
+	// Time taken by the gain to reach a new trim, in seconds.
+	static constexpr double gainSmoothingTimeSeconds = 0.02;
+
 
 	// Define member variables for the DJAudioPlayer class that are used for audio processing and playback.
 
 	// Reference to the AudioFormatManager used for creating audio format readers.
 	juce::AudioFormatManager& formatManager;
 
-	// Unique pointer to an AudioFormatReaderSource, which is used to read audio data from a file.
-	std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
+	// Background thread shared by all decks that keeps their read-ahead buffers filled.
+	juce::SharedResourcePointer<ReadAheadThread> readAheadThread;
 
-	// Transport source used for controlling playback of the audio.
-	juce::AudioTransportSource transportSource;
+	// Length of the read-ahead buffer in seconds and how the file is kept, both used for the next file that is loaded.
+	double readAheadSeconds = 4.0;
+	TrackSource::Storage trackStorage = TrackSource::streamFromDisk;
 
-	// Resampling audio source, which resamples audio from the transport source.
-	// Parameters:
-	// - &transportSource: The source from which audio is resampled.
-	// - false: Whether the source should be owned by this object.
-	// - 2: Number of channels.
-	juce::ResamplingAudioSource resampleSource{ &transportSource, false, 2 };
+	// Number of samples after a new position that are prefetched before a seek is queued.
+	static constexpr int seekPrefetchSamples = 4096;
 
-	// Low-band IIR filter audio source for filtering audio with a low-band filter.
-	// Parameters:
-	// - &resampleSource: The source to which the filter is applied.
-	// - false: Whether the source should be owned by this object.
-	juce::IIRFilterAudioSource audioLBFilter{ &resampleSource , false };
+	// How often a jump waiting for its audio checks whether it is ready, and how long it waits at most before it is
+	// queued anyway, in milliseconds.
+	static constexpr int jumpPollIntervalMs = 2;
+	static constexpr int jumpTimeoutMs = 250;
+
+	// A jump waiting for its audio to be prefetched, owned by the message thread; its position is -1 when there is
+	// none. It is dropped if another track is loaded before it is made.
+	struct PendingJump {
+		TransportCommand::Type type = TransportCommand::seek;
+		juce::int64 position = -1;
+		juce::uint32 trackSerial = 0;
+		juce::uint32 startTime = 0;
+	};
+
+	// The seek or cue jump waiting to be queued, and the release of a loop roll waiting for the audio where it returns to.
+	PendingJump pendingJump;
+	PendingJump pendingRollRelease;
+
+	// Method to prefetch the audio of a jump and either return true when it is ready now, wait for it when rendering
+	// offline, or make it pending and start the timer.
+	bool prefetchJump(PendingJump& jump, TransportCommand::Type type, juce::int64 position);
+
+	// Method to check whether a pending jump can be made, because its audio is ready or it has waited long enough.
+	// A jump for a track that has since been replaced is dropped.
+	bool isJumpReady(PendingJump& jump);
+
+	// Whether the deck is rendered offline, where a jump waits for its audio on the calling thread instead.
+	bool offlineRendering = false;
+
+	// Method to loop a section of the latest track, in samples of the file.
+	bool setLoopSamples(juce::int64 start, juce::int64 end, bool roll);
+
+	// Tempo of the loaded track in beats per minute, 0 when unknown, and the start of a manual loop, or -1.
+	double tempo = 0;
+	juce::int64 loopInPosition = -1;
+
+	// Beat grid of the loaded track for the audio thread: its tempo, and the time of its downbeat in seconds.
+	std::atomic<double> gridBpm{ 0.0 };
+	std::atomic<double> gridDownbeat{ 0.0 };
+
+	// Number of transport commands that can wait between two blocks.
+	static constexpr int commandCapacity = 256;
+
+	// Transport that plays the loaded file and swaps in newly loaded ones without locking the audio thread.
+	DeckTransport transport;
+
+	// Time-stretching stage between the transport and the resampler, used while key lock is on.
+	TimeStretcher timeStretcher{ &transport };
+
+	// Windowed-sinc resampler reading from the time-stretching stage. It applies the speed and, since the transport
+	// runs at the file's own rate, also converts the file to the device sample rate.
+	PolyphaseResampler resampleSource{ &timeStretcher };
+
+	// Fused EQ/filter cascade applied to the output of the resample source.
+	// It holds the low-band, mid-band, high-band, high-pass and low-pass stages and runs them in a single pass.
+	DeckFilter deckFilter;
 
 	// The name of the currently loaded audio file.
 	juce::String loadedFileName;
 
 	// Sample rate of the audio, used for various audio processing tasks.
-	double thisSampleRate;
+	double thisSampleRate = 44100.0;
 
 	// Flag indicating whether an audio file has been successfully loaded.
 	bool loaded = false;
 
-	// Volume of the player, used to control the overall volume of the audio.
-	double playerVol = 1;
+	// Target values of the deck controls, written by the GUI and read by the audio thread at the start of each block.
+	DeckParameters parameters;
 
-	// Volume of the crossfade, used to control the crossfade volume.
-	double crossFadeVol = 1;
+	// Trim of the current track, ramped per sample on the audio thread. It jumps to the trim of a new track when the
+	// transport swaps it in, on silence, and ramps when the trim of the current track changes.
+	juce::SmoothedValue<float> smoothedGain{ 1.0f };
 
-	// URL of the currently loaded audio file.
-	juce::URL currentAudioURL;
+	// Serial of a track still waiting to be picked up whose trim has arrived, or 0, and the trim, owned by the audio thread.
+	juce::uint32 deferredTrimSerial = 0;
+	float deferredTrim = 1.0f;
 
-	// Mid-band IIR filter audio source for filtering audio with a mid-band filter.
-	// Parameters:
-	// - &audioLBFilter: The source to which the filter is applied.
-	// - false: Whether the source should be owned by this object.
-	juce::IIRFilterAudioSource audioMBFilter{ &audioLBFilter , false };
+	// Transport commands sent by the message thread to the audio thread, and the clock placing them inside the block.
+	juce::AbstractFifo commandFifo{ commandCapacity };
+	TransportCommand commands[commandCapacity];
+	BlockClock commandClock;
 
-	// High-band IIR filter audio source for filtering audio with a high-band filter.
-	// Parameters:
-	// - &audioMBFilter: The source to which the filter is applied.
-	// - false: Whether the source should be owned by this object.
-	juce::IIRFilterAudioSource audioHBFilter{ &audioMBFilter , false };
+	// Speed, key lock setting and file-to-device rate ratio currently applied to the stretcher and resample source, owned by the audio thread.
+	double currentSpeed = 1.0;
+	bool currentKeyLock = false;
+	double currentRateRatio = 1.0;
 
-	// High-pass IIR filter audio source for filtering audio with a high-pass filter.
-	// Parameters:
-	// - &audioHBFilter: The source to which the filter is applied.
-	// - false: Whether the source should be owned by this object.
-	juce::IIRFilterAudioSource audioHPFilter{ &audioHBFilter , false };
+	// Ratio set by BeatSync to lock the deck to the master, and the number of samples played since the last jump,
+	// both owned by the audio thread.
+	double syncRatio = 1.0;
+	juce::int64 samplesSinceJump = 0;
 
-	// Low-pass IIR filter audio source for filtering audio with a low-pass filter.
-	// Parameters:
-	// - &audioHPFilter: The source to which the filter is applied.
-	// - false: Whether the source should be owned by this object.
-	juce::IIRFilterAudioSource audioLPFilter{ &audioHPFilter , false };
+	// URL of the currently loaded audio file.
+	juce::URL currentAudioURL;
 
-	// The RMS level of the audio signal, representing its average power.
-	float level;
+	// Meter measuring peak, RMS and short-term loudness of the deck output.
+	LevelMeter meter;
 
-	// Mixer audio source used for mixing multiple audio sources together.
-	juce::MixerAudioSource mixerSource;
+	// Objects told about loads.
+	juce::ListenerList<Listener> listeners;
 
-	// Unique pointer to an AudioFormatReaderSource for reading drum sample data.
-	std::unique_ptr<juce::AudioFormatReaderSource> drumReaderSource;
+	// Sample pads of the deck, played from RAM and mixed into the deck before its EQ and fader.
+	SamplePadEngine padEngine{ formatManager };
 
-	// Transport source for controlling playback of the drum audio.
-	juce::AudioTransportSource drumTransportSource;
+	// Thread that opens files for this deck. Declared after everything it delivers to, so that it is stopped before they are destroyed.
+	TrackLoader trackLoader{ formatManager, *readAheadThread, *this };
 
 };
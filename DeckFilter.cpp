@@ -0,0 +1,284 @@
+#include "DeckFilter.h"
+#include "StereoVec.h"
+
+namespace {
+
+	// Quality factor shared by the three EQ bands and the sweep filters.
+	const double bandQ = 1.0 / juce::MathConstants<double>::sqrt2;
+
+	// Corner and centre frequencies of the low, mid and high bands in Hz.
+	const double lowBandFrequency = 500;
+	const double midBandFrequency = 3250;
+	const double highBandFrequency = 5000;
+
+	// Lowest cutoff accepted by the filter sweep, which keeps the coefficients well conditioned.
+	const float minimumSweepFrequency = 10.0f;
+
+}
+
+
+DeckFilter::DeckFilter()
+{
+	for (auto& gain : bandGains) {
+		gain.setCurrentAndTargetValue(1.0f);
+	}
+	sweepFrequency.setCurrentAndTargetValue(20000.0f);
+}
+
+
+// Define the prepare() method for the DeckFilter class, which stores the sample rate and clears the filter state.
+void DeckFilter::prepare(double sampleRate) {
+	thisSampleRate = sampleRate;
+
+	// Let the smoothers land on their targets straight away, since there is no audio to glide over yet.
+	for (auto& gain : bandGains) {
+		gain.reset(sampleRate, smoothingTimeSeconds);
+		gain.setCurrentAndTargetValue(gain.getTargetValue());
+	}
+	sweepFrequency.reset(sampleRate, smoothingTimeSeconds);
+	sweepFrequency.setCurrentAndTargetValue(sweepFrequency.getTargetValue());
+
+	for (auto i = 0; i < numStages; ++i) {
+		refreshStage(static_cast<Stage>(i));
+	}
+	reset();
+}
+
+
+// Define the reset() method for the DeckFilter class, which clears the state of every stage.
+void DeckFilter::reset() {
+	for (auto& s : state) {
+		s = StageState();
+	}
+}
+
+
+// Define the setBandGain() method for the DeckFilter class, which sets the target gain of one EQ band.
+void DeckFilter::setBandGain(Stage stage, float gain) {
+	jassert(stage <= highBand);
+
+	auto& smoothed = bandGains[stage];
+	if (gain == smoothed.getTargetValue()) {
+		return;
+	}
+
+	// A band that was flat starts from silence, like IIRFilter::reset() would.
+	if (!stages[stage].active) {
+		state[stage] = StageState();
+	}
+
+	smoothed.setTargetValue(gain);
+	refreshStage(stage);
+}
+
+
+// Define the setSweep() method for the DeckFilter class, which sets the target of the high-pass/low-pass sweep.
+void DeckFilter::setSweep(float value) {
+	const Stage newStage = value > 0 ? lowPass : (value < 0 ? highPass : numStages);
+	const float frequency = juce::jlimit(minimumSweepFrequency, static_cast<float>(thisSampleRate * 0.49), std::abs(value));
+
+	if (newStage != sweepStage) {
+		// Switching between low-pass and high-pass cannot be glided, so the new stage jumps straight to its cutoff.
+		sweepStage = newStage;
+		stages[lowPass].active = false;
+		stages[highPass].active = false;
+
+		if (sweepStage != numStages) {
+			state[sweepStage] = StageState();
+			sweepFrequency.setCurrentAndTargetValue(frequency);
+			refreshStage(sweepStage);
+		}
+	}
+	else if (sweepStage != numStages) {
+		sweepFrequency.setTargetValue(frequency);
+	}
+}
+
+
+// Define the isActive() method for the DeckFilter class.
+bool DeckFilter::isActive(Stage stage) const {
+	return stages[stage].active;
+}
+
+
+// Define the isSmoothing() method for the DeckFilter class.
+bool DeckFilter::isSmoothing() const {
+	for (const auto& gain : bandGains) {
+		if (gain.isSmoothing()) {
+			return true;
+		}
+	}
+	return sweepStage != numStages && sweepFrequency.isSmoothing();
+}
+
+
+// Define the advanceSmoothing() method for the DeckFilter class.
+void DeckFilter::advanceSmoothing(int numSamples) {
+	for (auto i = 0; i <= highBand; ++i) {
+		if (bandGains[i].isSmoothing()) {
+			bandGains[i].skip(numSamples);
+			refreshStage(static_cast<Stage>(i));
+		}
+	}
+
+	if (sweepStage != numStages && sweepFrequency.isSmoothing()) {
+		sweepFrequency.skip(numSamples);
+		refreshStage(sweepStage);
+	}
+}
+
+
+// Define the refreshStage() method for the DeckFilter class, which recomputes one stage from its current smoothed value.
+void DeckFilter::refreshStage(Stage stage) {
+	switch (stage) {
+	case lowBand:
+	case midBand:
+	case highBand: {
+		const auto& smoothed = bandGains[stage];
+		const float gain = smoothed.getCurrentValue();
+
+		// A band sitting at unity gain is left out of the cascade entirely.
+		if (gain == 1.0f && !smoothed.isSmoothing()) {
+			stages[stage].active = false;
+			return;
+		}
+
+		if (stage == lowBand) {
+			setStageCoefficients(stage, juce::IIRCoefficients::makeLowShelf(thisSampleRate, lowBandFrequency, bandQ, gain));
+		}
+		else if (stage == midBand) {
+			setStageCoefficients(stage, juce::IIRCoefficients::makePeakFilter(thisSampleRate, midBandFrequency, bandQ, gain));
+		}
+		else {
+			setStageCoefficients(stage, juce::IIRCoefficients::makeHighShelf(thisSampleRate, highBandFrequency, bandQ, gain));
+		}
+		break;
+	}
+	case highPass:
+	case lowPass:
+		// Only the stage selected by the sweep is ever switched on.
+		if (stage != sweepStage) {
+			stages[stage].active = false;
+		}
+		else if (stage == highPass) {
+			setStageCoefficients(stage, juce::IIRCoefficients::makeHighPass(thisSampleRate, sweepFrequency.getCurrentValue()));
+		}
+		else {
+			setStageCoefficients(stage, juce::IIRCoefficients::makeLowPass(thisSampleRate, sweepFrequency.getCurrentValue()));
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+
+// Define the setStageCoefficients() method for the DeckFilter class, which copies coefficients into a stage and activates it.
+void DeckFilter::setStageCoefficients(Stage stage, const juce::IIRCoefficients& coefficients) {
+	// IIRCoefficients are already normalised by a0 and stored as b0, b1, b2, a1, a2.
+	auto& target = stages[stage];
+	target.b0 = coefficients.coefficients[0];
+	target.b1 = coefficients.coefficients[1];
+	target.b2 = coefficients.coefficients[2];
+	target.a1 = coefficients.coefficients[3];
+	target.a2 = coefficients.coefficients[4];
+	target.active = true;
+}
+
+
+// Define the process() method for the DeckFilter class, which filters a section of the buffer in place.
+// While a control is moving the block is cut into short steps so that the coefficients follow the knob smoothly.
+void DeckFilter::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+	juce::ScopedNoDenormals noDenormals;
+
+	auto done = 0;
+	while (done < numSamples) {
+		const bool smoothing = isSmoothing();
+		const int stepSize = smoothing ? juce::jmin(smoothingStepSize, numSamples - done) : numSamples - done;
+
+		if (smoothing) {
+			advanceSmoothing(stepSize);
+		}
+
+		// Collect the stages that actually do something, so that flat stages cost nothing per sample.
+		int order[numStages];
+		int numActive = 0;
+		for (auto i = 0; i < numStages; ++i) {
+			if (stages[i].active) {
+				order[numActive++] = i;
+			}
+		}
+
+		if (numActive > 0) {
+			if (buffer.getNumChannels() >= 2) {
+				processStereo(buffer.getWritePointer(0, startSample + done), buffer.getWritePointer(1, startSample + done), stepSize, order, numActive);
+			}
+			else if (buffer.getNumChannels() == 1) {
+				processMono(buffer.getWritePointer(0, startSample + done), stepSize, order, numActive);
+			}
+		}
+
+		done += stepSize;
+	}
+}
+
+
+// Define the processStereo() method for the DeckFilter class.
+// Each stage is evaluated for both channels with the same vector instructions, and the state stays in registers for the whole block.
+void DeckFilter::processStereo(float* left, float* right, int numSamples, const int* order, int numActive) {
+	using namespace StereoVec;
+
+	Type b0[numStages], b1[numStages], b2[numStages], a1[numStages], a2[numStages];
+	Type s1[numStages], s2[numStages];
+
+	for (auto k = 0; k < numActive; ++k) {
+		const auto& c = stages[order[k]];
+		b0[k] = splat(c.b0);
+		b1[k] = splat(c.b1);
+		b2[k] = splat(c.b2);
+		a1[k] = splat(c.a1);
+		a2[k] = splat(c.a2);
+		s1[k] = loadPair(state[order[k]].s1);
+		s2[k] = loadPair(state[order[k]].s2);
+	}
+
+	float frame[2];
+	for (auto i = 0; i < numSamples; ++i) {
+		Type x = loadPair(left[i], right[i]);
+
+		for (auto k = 0; k < numActive; ++k) {
+			const Type y = add(mul(b0[k], x), s1[k]);
+			s1[k] = add(sub(mul(b1[k], x), mul(a1[k], y)), s2[k]);
+			s2[k] = sub(mul(b2[k], x), mul(a2[k], y));
+			x = y;
+		}
+
+		storePair(x, frame);
+		left[i] = frame[0];
+		right[i] = frame[1];
+	}
+
+	for (auto k = 0; k < numActive; ++k) {
+		storePair(s1[k], state[order[k]].s1);
+		storePair(s2[k], state[order[k]].s2);
+	}
+}
+
+
+// Define the processMono() method for the DeckFilter class, which runs the cascade over the left-channel state only.
+void DeckFilter::processMono(float* data, int numSamples, const int* order, int numActive) {
+	for (auto i = 0; i < numSamples; ++i) {
+		float x = data[i];
+
+		for (auto k = 0; k < numActive; ++k) {
+			const auto& c = stages[order[k]];
+			auto& s = state[order[k]];
+			const float y = c.b0 * x + s.s1[0];
+			s.s1[0] = c.b1 * x - c.a1 * y + s.s2[0];
+			s.s2[0] = c.b2 * x - c.a2 * y;
+			x = y;
+		}
+
+		data[i] = x;
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// DeckFilter runs the whole EQ/filter section of a deck (low shelf, mid peak, high shelf,
+// high-pass and low-pass) as one fused biquad cascade.
+// Every sample frame is pushed through all active stages in a single pass, with the left and
+// right channels held side by side in one SIMD register, and flat stages are skipped entirely.
+// All methods are meant to be called from the audio thread; knob changes are smoothed by
+// recomputing the coefficients every few samples while a control is moving.
+class DeckFilter {
+public:
+
+	// Indices of the individual stages, in the order the signal passes through them.
+	enum Stage {
+		lowBand = 0,
+		midBand,
+		highBand,
+		highPass,
+		lowPass,
+		numStages
+	};
+
+	// Constructor for the DeckFilter class. All stages start out flat.
+	DeckFilter();
+
+	// Method to prepare the filter for playback and clear its state.
+	// Parameters:
+	// - sampleRate: The sample rate the filter will run at.
+	void prepare(double sampleRate);
+
+	// Method to clear the internal state of every stage without touching the settings.
+	void reset();
+
+	// Method to set the target gain of one of the three EQ bands.
+	// Parameters:
+	// - stage: lowBand, midBand or highBand.
+	// - gain: The linear gain of the band, where 1 is flat.
+	void setBandGain(Stage stage, float gain);
+
+	// Method to set the target of the filter sweep.
+	// Parameters:
+	// - value: A positive value is a low-pass cutoff in Hz, a negative value a high-pass cutoff in Hz, and 0 bypasses both.
+	void setSweep(float value);
+
+	// Method to check whether a stage currently takes part in processing.
+	// Parameters:
+	// - stage: The stage to query.
+	bool isActive(Stage stage) const;
+
+	// Method to filter a section of a buffer in place.
+	// The first two channels are processed together; a mono buffer falls back to the scalar path.
+	// Parameters:
+	// - buffer: The buffer holding the audio to filter.
+	// - startSample: The first sample to process.
+	// - numSamples: The number of samples to process.
+	void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+private:
+
+	// Coefficients of one biquad stage in transposed direct form II, normalised so that a0 == 1.
+	struct Biquad {
+		float b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+		bool active = false;
+	};
+
+	// Filter state of one stage for the left and right channel.
+	struct StageState {
+		float s1[2] = { 0, 0 };
+		float s2[2] = { 0, 0 };
+	};
+
+	// Method to check whether any control is still moving towards its target.
+	bool isSmoothing() const;
+
+	// Method to move every smoothed control forward by a number of samples and refresh the affected stages.
+	void advanceSmoothing(int numSamples);
+
+	// Method to recompute the coefficients of one stage from the current smoothed values.
+	void refreshStage(Stage stage);
+
+	// Method to copy a set of IIRCoefficients into a stage.
+	void setStageCoefficients(Stage stage, const juce::IIRCoefficients& coefficients);
+
+	// Method to run the cascade over two channels at once.
+	void processStereo(float* left, float* right, int numSamples, const int* order, int numActive);
+
+	// Method to run the cascade over a single channel.
+	void processMono(float* data, int numSamples, const int* order, int numActive);
+
+	// Number of samples between coefficient updates while a control is moving.
+	static constexpr int smoothingStepSize = 16;
+
+	// Time taken by a control to reach a new target, in seconds.
+	static constexpr double smoothingTimeSeconds = 0.05;
+
+	// Coefficients of every stage.
+	Biquad stages[numStages];
+
+	// Per-stage filter state.
+	StageState state[numStages];
+
+	// Smoothed gains of the low, mid and high bands, indexed by Stage.
+	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> bandGains[3];
+
+	// Smoothed cutoff of the filter sweep in Hz.
+	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> sweepFrequency;
+
+	// Stage used by the filter sweep: lowPass, highPass, or numStages when the sweep is bypassed.
+	Stage sweepStage = numStages;
+
+	// Sample rate the filter was prepared with.
+	double thisSampleRate = 44100.0;
+};
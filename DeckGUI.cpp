@@ -12,7 +12,7 @@
  * with a focus on providing a rich, interactive experience for controlling audio playback and effects.
  */
 
-DeckGUI::DeckGUI(DJAudioPlayer* _player, juce::AudioFormatManager& formatManagerToUse, juce::AudioThumbnailCache& cacheToUse, ZoomedWaveform* _zoomedDisplay, Library& _library, juce::Colour _colour) : player(_player), waveformDisplay(formatManagerToUse, cacheToUse, _colour), zoomedDisplay(_zoomedDisplay), jogWheel(formatManagerToUse, cacheToUse, _colour), library(&_library), theme(_colour)
+DeckGUI::DeckGUI(DJAudioPlayer* _player, juce::AudioFormatManager& formatManagerToUse, juce::AudioThumbnailCache& cacheToUse, ZoomedWaveform* _zoomedDisplay, Library& _library, juce::Colour _colour, bool _mirrored) : player(_player), waveformDisplay(formatManagerToUse, cacheToUse, _colour), zoomedDisplay(_zoomedDisplay), jogWheel(formatManagerToUse, cacheToUse, _colour), library(&_library), theme(_colour), mirrored(_mirrored)
 {
 	std::vector<juce::Label*> labels{ &volLabel, &speedLabel, &filterLabel, &lbLabel, &mbLabel, &hbLabel };
 	for (auto& label : labels) {
@@ -31,18 +31,35 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player, juce::AudioFormatManager& formatManager
 	addAndMakeVisible(lowBandFilter);
 	addAndMakeVisible(midBandFilter);
 	addAndMakeVisible(highBandFilter);
-	player->loadDrumSample(hiHatSamplePath);
-
-	addAndMakeVisible(kickButton);
-	kickButton.addListener(this);
-	addAndMakeVisible(snareButton);
-	snareButton.addListener(this);
-
-	addAndMakeVisible(hiHatButton);
-	hiHatButton.addListener(this);
-
-	addAndMakeVisible(clapButton);
-	clapButton.addListener(this);
+	addAndMakeVisible(keyLockButton);
+	addAndMakeVisible(qualityBox);
+	addAndMakeVisible(storageBox);
+	addAndMakeVisible(syncButton);
+	addAndMakeVisible(tapButton);
+	addAndMakeVisible(pflButton);
+	addAndMakeVisible(loopInButton);
+	addAndMakeVisible(loopOutButton);
+	addAndMakeVisible(loopButton);
+	addAndMakeVisible(halveLoopButton);
+	addAndMakeVisible(doubleLoopButton);
+	addAndMakeVisible(rollButton);
+	addAndMakeVisible(loopLengthBox);
+	addChildComponent(loadingBar);
+	loadingBar.setPercentageDisplay(false);
+	player->addListener(this);
+	library->addListener(this);
+	// Load the pad samples into RAM once, so that pressing a pad never touches the disk.
+	player->loadPadSample(SamplePadEngine::kick, juce::File(kickSamplePath));
+	player->loadPadSample(SamplePadEngine::snare, juce::File(snareSamplePath));
+	player->loadPadSample(SamplePadEngine::hiHat, juce::File(hiHatSamplePath));
+	player->loadPadSample(SamplePadEngine::clap, juce::File(clapSamplePath));
+
+	// The pads fire when pressed rather than when released, which is what makes finger drumming feel immediate.
+	for (auto* pad : { &kickButton, &snareButton, &hiHatButton, &clapButton }) {
+		addAndMakeVisible(*pad);
+		pad->setTriggeredOnMouseDown(true);
+		pad->addListener(this);
+	}
 
 	volSlider.setRange(0, 1);
 	speedSlider.setRange(0.8, 1.2);
@@ -63,6 +80,46 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player, juce::AudioFormatManager& formatManager
 
 	playButton.addListener(this);
 	loadButton.addListener(this);
+	keyLockButton.setClickingTogglesState(true);
+	keyLockButton.setColour(juce::TextButton::ColourIds::buttonColourId, juce::Colour::fromRGBA(25, 25, 25, 255));
+	keyLockButton.setColour(juce::TextButton::ColourIds::buttonOnColourId, theme);
+	keyLockButton.addListener(this);
+	syncButton.setClickingTogglesState(true);
+	pflButton.setClickingTogglesState(true);
+	for (auto* beatControl : { &syncButton, &tapButton, &pflButton }) {
+		beatControl->setColour(juce::TextButton::ColourIds::buttonColourId, juce::Colour::fromRGBA(25, 25, 25, 255));
+		beatControl->setColour(juce::TextButton::ColourIds::buttonOnColourId, theme);
+		beatControl->addListener(this);
+	}
+
+	// The item IDs are the resampler quality tiers plus one, since a ComboBox reserves 0 for "nothing selected".
+	qualityBox.addItem("DRAFT", PolyphaseResampler::draft + 1);
+	qualityBox.addItem("STANDARD", PolyphaseResampler::standard + 1);
+	qualityBox.addItem("HIGH", PolyphaseResampler::high + 1);
+	qualityBox.addItem("BEST", PolyphaseResampler::best + 1);
+	qualityBox.setSelectedId(PolyphaseResampler::high + 1, juce::NotificationType::dontSendNotification);
+	qualityBox.addListener(this);
+
+	// Track storage options, with the same offset of one for the item IDs.
+	storageBox.addItem("DISK", TrackSource::streamFromDisk + 1);
+	storageBox.addItem("RAM", TrackSource::decodeToFloat + 1);
+	storageBox.addItem("RAM 16-BIT", TrackSource::decodeToInt16 + 1);
+	storageBox.setSelectedId(TrackSource::streamFromDisk + 1, juce::NotificationType::dontSendNotification);
+	storageBox.addListener(this);
+
+	// Set up the loop controls. The loop button lights up while the deck is looping.
+	for (auto* loopControl : { &loopInButton, &loopOutButton, &loopButton, &halveLoopButton, &doubleLoopButton, &rollButton }) {
+		loopControl->setColour(juce::TextButton::ColourIds::buttonColourId, juce::Colour::fromRGBA(25, 25, 25, 255));
+		loopControl->setColour(juce::TextButton::ColourIds::buttonOnColourId, theme);
+		loopControl->addListener(this);
+	}
+
+	// Set up the loop length selector, from 1/8 to 32 beats. A beat lasts a second until the tempo of the track is known.
+	const juce::StringArray loopLengths{ "1/8", "1/4", "1/2", "1", "2", "4", "8", "16", "32" };
+	for (auto i = 0; i < loopLengths.size(); ++i) {
+		loopLengthBox.addItem(loopLengths[i], i + 1);
+	}
+	loopLengthBox.setSelectedId(6, juce::NotificationType::dontSendNotification);
 	volSlider.addListener(this);
 	speedSlider.addListener(this);
 
@@ -159,6 +216,8 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player, juce::AudioFormatManager& formatManager
 DeckGUI::~DeckGUI()
 {
 	stopTimer();
+	player->removeListener(this);
+	library->removeListener(this);
 	for (auto& cue : cues) {
 		delete cue;
 	}
@@ -173,7 +232,7 @@ void DeckGUI::paint(juce::Graphics& g)
 	double rowH = getHeight() / 9;
 	float offset = rowH * 2.23;
 	float volMeterHeight = rowH * 2.5;
-	float volCurrentHeight = juce::jmap(player->getRMSLevel(), -60.0f, 0.0f, offset + volMeterHeight - 5, offset);
+	float volCurrentHeight = juce::jmap(juce::jlimit(-60.0f, 0.0f, volRMS), -60.0f, 0.0f, offset + volMeterHeight - 5, offset);
 
 	for (auto i = offset + volMeterHeight - 5; i > offset; i -= volMeterHeight / 10) {
 		float pos = i;
@@ -195,12 +254,20 @@ void DeckGUI::paint(juce::Graphics& g)
 		}
 
 
-		double volXOffset = theme == juce::Colours::hotpink ? 62.5 : getWidth() - (double)75;
+		double volXOffset = mirrored ? 62.5 : getWidth() - (double)75;
 
 		juce::Rectangle<float> rect(volXOffset, pos, 12.5, (volMeterHeight / 10) - 2);
 		g.fillRect(rect);
 	}
 
+	// Draw the peak-hold marker of the deck meter as a thin white line across the segments.
+	if (volPeakHold > -60.0f) {
+		double volXOffset = mirrored ? 62.5 : getWidth() - (double)75;
+		float peakHoldHeight = juce::jmap(juce::jmin(volPeakHold, 0.0f), -60.0f, 0.0f, offset + volMeterHeight - 5, offset);
+		g.setColour(juce::Colours::white);
+		g.fillRect(juce::Rectangle<float>(volXOffset, peakHoldHeight, 12.5, 2));
+	}
+
 	for (auto& cue : cues) {
 		juce::TextButton* thisButton = cue;
 		if (cueTargets.find(thisButton) != cueTargets.end() && flash) {
@@ -211,9 +278,9 @@ void DeckGUI::paint(juce::Graphics& g)
 		}
 	}
 
-	// Calculate the main X offset based on the theme color, using a conditional (ternary) operator.
-// If the theme color is hot pink, set the offset to 7/32 of the total width; otherwise, set it to 25/32 of the width.
-	double mainXOffset = theme == juce::Colours::hotpink ? getWidth() * 7 / 32 : getWidth() * 25 / 32;
+	// Calculate the main X offset based on the side of the deck, using a conditional (ternary) operator.
+// If the deck is mirrored, set the offset to 7/32 of the total width; otherwise, set it to 25/32 of the width.
+	double mainXOffset = mirrored ? getWidth() * 7 / 32 : getWidth() * 25 / 32;
 
 	// Set the drawing color to a custom RGBA color (25, 25, 25, 255), which corresponds to a dark gray color at full opacity.
 	g.setColour(juce::Colour::fromRGBA(25, 25, 25, 255));
@@ -227,19 +294,26 @@ void DeckGUI::paint(juce::Graphics& g)
 void DeckGUI::resized()
 {
 	double rowH = getHeight() / 9;
-	double volXOffset = theme == juce::Colours::hotpink ? 5.5 : getWidth() - (double)55;
+	double volXOffset = mirrored ? 5.5 : getWidth() - (double)55;
 	volSlider.setBounds(volXOffset, rowH * 2, 50, rowH * 3);
 	volLabel.setBounds(volXOffset, rowH * 5 + 5, 50, rowH * 0.5);
 	filter.setBounds(volXOffset, rowH * 5.8, 50, 50);
 	filterLabel.setBounds(volXOffset, rowH * 6.9, 50, 50);
-	double mainXOffset = theme == juce::Colours::hotpink ? getWidth() * 7 / 32 : 0;
+	pflButton.setBounds(volXOffset + 5, rowH * 8.2, 40, rowH * 0.6);
+	double mainXOffset = mirrored ? getWidth() * 7 / 32 : 0;
 	speedSlider.setBounds(mainXOffset, rowH * 2, getWidth() / 8, rowH * 3);
 	speedLabel.setBounds(mainXOffset, rowH * 5 + 5, getWidth() / 2.5, rowH * 0.5);
+	keyLockButton.setBounds(mainXOffset + 5, rowH * 5.8, getWidth() / 8 - 10, rowH * 0.6);
+	qualityBox.setBounds(mainXOffset + 5, rowH * 6.6, getWidth() / 8 - 10, rowH * 0.6);
+	storageBox.setBounds(mainXOffset + 5, rowH * 7.4, getWidth() / 8 - 10, rowH * 0.6);
+	syncButton.setBounds(mainXOffset + 5, rowH * 8.2, getWidth() / 16 - 6, rowH * 0.6);
+	tapButton.setBounds(mainXOffset + getWidth() / 16 + 1, rowH * 8.2, getWidth() / 16 - 6, rowH * 0.6);
 	jogWheel.setBounds(mainXOffset + getWidth() * 22.5 / 32 - 98.9, 5 + rowH * 2, (rowH * 3.3) - 10, (rowH * 3.3) - 10);
 	loadButton.setBounds(mainXOffset + getWidth() * 22.5 / 32, rowH * 2 + 5, rowH * 0.7, rowH * 0.7);
 	playButton.setBounds(mainXOffset + getWidth() * 22.5 / 32, rowH * 5 - 10, rowH * 0.7, rowH * 0.7);
 
 	waveformDisplay.setBounds(0, 0, getWidth(), rowH * 2);
+	loadingBar.setBounds(0, rowH * 1.8, getWidth(), rowH * 0.2);
 	// Calculate the X offset by adding a fraction (4/32) of the total width to the main X offset.
 	// This determines the starting horizontal position for a certain element or cell in the layout.
 	double xOffset = mainXOffset + getWidth() * 4 / 32;
@@ -283,6 +357,13 @@ void DeckGUI::resized()
 	hiHatButton.setBounds(xOffset + 110, rowH * 7.92, 40, 40);
 	clapButton.setBounds(xOffset + 160, rowH * 7.92, 40, 40);
 
+	// Place the loop controls in a row to the right of the pads.
+	juce::TextButton* loopControls[] = { &loopInButton, &loopOutButton, &loopButton, &halveLoopButton, &doubleLoopButton, &rollButton };
+	for (auto i = 0; i < 6; ++i) {
+		loopControls[i]->setBounds(xOffset + 215 + i * 40, rowH * 7.92 + 5, 38, 30);
+	}
+	loopLengthBox.setBounds(xOffset + 455, rowH * 7.92 + 5, 60, 30);
+
 }
 
 
@@ -306,34 +387,88 @@ void DeckGUI::buttonClicked(juce::Button* button) {
 
 
 
+	if (button == &keyLockButton) {
+		DBG("DeckGUI::buttonClicked: They toggled key lock " << (int)keyLockButton.getToggleState());
+		player->setKeyLock(keyLockButton.getToggleState());
+	}
+
+	if (button == &syncButton) {
+		player->setSync(syncButton.getToggleState());
+	}
+
+	if (button == &pflButton) {
+		player->setCue(pflButton.getToggleState());
+	}
+
+	// The tempo is the average gap between the taps, divided by the speed of the deck to get that of the track.
+	if (button == &tapButton) {
+		const double now = juce::Time::getMillisecondCounterHiRes();
+		if (tapTimes.size() > 0 && now - tapTimes.getLast() > maxTapGapMs) {
+			tapTimes.clear();
+		}
+		tapTimes.add(now);
+		if (tapTimes.size() > maxTaps) {
+			tapTimes.remove(0);
+		}
+
+		if (tapTimes.size() >= 2 && speedSlider.getValue() > 0) {
+			const double beatMs = (tapTimes.getLast() - tapTimes.getFirst()) / (tapTimes.size() - 1);
+			player->setBeatGridAtPosition(60000.0 / beatMs / speedSlider.getValue());
+		}
+	}
+
+	if (button == &loopInButton) {
+		player->setLoopIn();
+	}
+
+	if (button == &loopOutButton) {
+		player->setLoopOut();
+	}
+
+	if (button == &loopButton) {
+		// The loop button sets a beat loop at the playhead, or leaves the current loop.
+		if (player->isLooping()) {
+			player->exitLoop();
+		}
+		else {
+			player->setBeatLoop(getSelectedLoopBeats());
+		}
+	}
+
+	if (button == &halveLoopButton) {
+		player->halveLoop();
+	}
+
+	if (button == &doubleLoopButton) {
+		player->doubleLoop();
+	}
+
 	if (button == &loadButton && library->selectionIsValid()) {
 		loadDeck(library->getSelectedTrack());
 	}
 	if (button == &kickButton)
 	{
-		player->playDrumSample(kickSamplePath);
+		player->triggerPad(SamplePadEngine::kick);
 	}
 	// Check if the button that was clicked is the snareButton. If true, execute the following block.
 	if (button == &snareButton)
 	{
-		// Call the playDrum() method on the player object to play the snare drum sound.
-		player->playDrum();
+		// Queue a hit of the snare pad, which the audio thread plays from RAM.
+		player->triggerPad(SamplePadEngine::snare);
 	}
 
 	// Check if the button that was clicked is the hiHatButton. If true, execute the following block.
 	if (button == &hiHatButton)
 	{
-		// Call the playDrumSample() method on the player object, passing the hi-hat sample file path.
-		// This plays the hi-hat sound using the sample located at hiHatSamplePath.
-		player->playDrumSample(hiHatSamplePath);
+		// Queue a hit of the hi-hat pad, which the audio thread plays from RAM.
+		player->triggerPad(SamplePadEngine::hiHat);
 	}
 
 	// Check if the button that was clicked is the clapButton. If true, execute the following block.
 	if (button == &clapButton)
 	{
-		// Call the playDrumSample() method on the player object, passing the clap sample file path.
-		// This plays the clap sound using the sample located at clapSamplePath.
-		player->playDrumSample(clapSamplePath);
+		// Queue a hit of the clap pad, which the audio thread plays from RAM.
+		player->triggerPad(SamplePadEngine::clap);
 	}
 
 
@@ -342,7 +477,7 @@ void DeckGUI::buttonClicked(juce::Button* button) {
 			juce::TextButton* thisButton = cue;
 			if (button == thisButton) {
 				if (cueTargets.find(thisButton) != cueTargets.end()) {
-					player->setPositionRelative(cueTargets[thisButton].first);
+					player->jumpToCue(cueTargets[thisButton].first);
 					if (!modeIsPlaying) {
 						modeIsPlaying = true;
 						playButton.setToggleState(true, juce::NotificationType::dontSendNotification);
@@ -363,6 +498,13 @@ void DeckGUI::buttonClicked(juce::Button* button) {
 					// This ensures that both the normal and zoomed-in displays are synchronized in terms of cue point visualization.
 					zoomedDisplay->setCuePoints(cueTargets);
 
+					// Let the player keep the audio after every cue in memory, so that jumping to it never waits for the disk.
+					std::vector<double> cuePositions;
+					for (auto& cueTarget : cueTargets) {
+						cuePositions.push_back(cueTarget.second.first);
+					}
+					player->setHotCues(cuePositions);
+
 				}
 			}
 		}
@@ -423,6 +565,37 @@ void DeckGUI::sliderValueChanged(juce::Slider* slider) {
 };
 
 
+void DeckGUI::buttonStateChanged(juce::Button* button) {
+	if (button == &rollButton) {
+		if (rollButton.isDown()) {
+			player->startLoopRoll(getSelectedLoopBeats());
+		}
+		else {
+			player->endLoopRoll();
+		}
+	}
+}
+
+
+double DeckGUI::getSelectedLoopBeats() {
+	// The selector lists powers of two from 1/8 (id 1) to 32 (id 9) beats.
+	return std::pow(2.0, loopLengthBox.getSelectedId() - 4);
+}
+
+
+void DeckGUI::comboBoxChanged(juce::ComboBox* comboBox) {
+	if (comboBox == &qualityBox) {
+		DBG("DeckGUI::comboBoxChanged: They changed the resampler quality " << qualityBox.getSelectedId());
+		player->setResamplerQuality(static_cast<PolyphaseResampler::Quality>(qualityBox.getSelectedId() - 1));
+	}
+
+	if (comboBox == &storageBox) {
+		DBG("DeckGUI::comboBoxChanged: They changed the track storage " << storageBox.getSelectedId());
+		player->setTrackStorage(static_cast<TrackSource::Storage>(storageBox.getSelectedId() - 1));
+	}
+}
+
+
 bool DeckGUI::isInterestedInFileDrag(const juce::StringArray& files) {
 	return true;
 };
@@ -474,6 +647,12 @@ void DeckGUI::filesDropped(const juce::StringArray& files, int x, int y) {
 	// Output a debug message to the console, indicating that files have been dropped onto the component.
 	DBG("DeckGUI::filesDropped");
 
+	// A dropped folder is a sample pack, whose files are loaded into the pads.
+	if (files.size() == 1 && juce::File{ files[0] }.isDirectory()) {
+		player->loadPadPack(juce::File{ files[0] });
+		return;
+	}
+
 	// Check if exactly one file was dropped and the drop coordinates (x, y) are within the bounds of the component.
 	if (files.size() == 1 && x < getWidth() && y < getHeight()) {
 
@@ -506,6 +685,14 @@ void DeckGUI::timerCallback() {
 		repaint();
 	}
 
+	// Show the current loop on the waveforms and light the loop button while the deck is looping.
+	double loopStart = -1;
+	double loopEnd = -1;
+	player->getLoopRelative(loopStart, loopEnd);
+	waveformDisplay.setLoop(loopStart, loopEnd);
+	zoomedDisplay->setLoop(loopStart, loopEnd);
+	loopButton.setToggleState(player->isLooping(), juce::NotificationType::dontSendNotification);
+
 	for (auto i = 0; i < displays.size(); ++i) {
 		if (displays[i]->isFileLoaded()) {
 			double pos = displays[i]->getValue();
@@ -552,8 +739,12 @@ void DeckGUI::timerCallback() {
 		}
 	}
 
-	if (volRMS != player->getRMSLevel()) {
-		volRMS = player->getRMSLevel();
+	// Read the deck meter once per tick and repaint only when the RMS level or the peak hold moved.
+	const auto meterSnapshot = player->getMeter().getSnapshot();
+	const float newRMS = (meterSnapshot.rmsDb[0] + meterSnapshot.rmsDb[1]) / 2;
+	if (volRMS != newRMS || volPeakHold != meterSnapshot.peakHoldDb) {
+		volRMS = newRMS;
+		volPeakHold = meterSnapshot.peakHoldDb;
 		repaint();
 	}
 }
@@ -561,24 +752,62 @@ void DeckGUI::timerCallback() {
 
 
 void DeckGUI::loadDeck(track track) {
-	// Load the track's URL into the player object. This prepares the player to access and play the track specified by the URL.
-	player->loadURL(track.url);
+	// Hand the track's URL to the player, which opens it on a background thread so that the GUI and the other deck
+	// carry on while it loads. One extra reader is opened for each display, so that they do not parse the file here either.
+	loadingTrack = track;
+	loadingProgress = 0;
+	loadingBar.setVisible(true);
+	player->loadURL(track.url, static_cast<int>(displays.size()));
+}
 
-	// Check if the player has successfully loaded the track.
-	if (player->isLoaded()) {
-		// Iterate over all display objects in the 'displays' container.
-		for (auto& display : displays) {
-			// Load the track into each display object. This ensures that each display is updated to reflect the new track.
-			display->loadTrack(track);
-
-			// Add the current object (likely the main component or controller) as a listener to each display.
-			// This enables the object to respond to events or changes from the display components.
-			display->addListener(this);
+void DeckGUI::trackAnalysed(const track& song) {
+	// A track still loading takes the result when it is handed to the player.
+	if (song.identity == loadingTrack.identity) {
+		loadingTrack = song;
+	}
+
+	// The track on the deck takes it now. A tempo tapped in by hand is kept.
+	if (song.identity == loadedTrack.identity) {
+		if (tapTimes.size() < 2 && song.bpm > 0) {
+			player->setBeatGrid(song.bpm, song.downbeatSeconds);
 		}
+		if (song.lufs < 0) {
+			player->setTrackGain(song.gainDb);
+		}
+		loadedTrack = song;
+	}
+}
+
+void DeckGUI::loadProgress(DJAudioPlayer*, float progress) {
+	loadingProgress = progress;
+}
+
+void DeckGUI::loadFinished(DJAudioPlayer*, bool succeeded, juce::OwnedArray<juce::AudioFormatReader>& thumbnailReaders) {
+	loadingBar.setVisible(false);
+
+	// If the track could not be opened, the previous one stays on the deck untouched.
+	if (!succeeded) {
+		return;
+	}
+
+	// Iterate over all display objects in the 'displays' container.
+	for (auto& display : displays) {
+		// Load the track into each display object, from a reader opened by the loader when there is one.
+		// This ensures that each display is updated to reflect the new track.
+		display->loadTrack(loadingTrack, thumbnailReaders.size() > 0 ? thumbnailReaders.removeAndReturn(0) : nullptr);
+
+		// Add the current object (likely the main component or controller) as a listener to each display.
+		// This enables the object to respond to events or changes from the display components.
+		display->addListener(this);
 	}
 
 
-	player->setGain(volSlider.getValue(), true);
+	// The trim is queued for the new track, so the old one keeps its own while it fades out.
+	loadedTrack = loadingTrack;
+	player->setGain(volSlider.getValue());
+	player->setBeatGrid(loadedTrack.bpm, loadedTrack.downbeatSeconds);
+	player->setTrackGain(loadedTrack.gainDb);
+	tapTimes.clear();
 	cueTargets.clear();
 
 	// Check if the mode is currently playing (modeIsPlaying is true).
@@ -19,16 +19,20 @@
 class DeckGUI : public juce::Component,
 	public juce::Button::Listener,               // Inherits from Button::Listener to handle button click events.
 	public juce::Slider::Listener,               // Inherits from Slider::Listener to handle slider value changes.
+	public juce::ComboBox::Listener,             // Inherits from ComboBox::Listener to handle the resampler quality selector.
+	public DJAudioPlayer::Listener,              // Inherits from DJAudioPlayer::Listener to be told when a track has been loaded in the background.
+	public Library::Listener,                    // Inherits from Library::Listener to be told when the analysis of a track has finished.
 	public juce::FileDragAndDropTarget,          // Inherits from FileDragAndDropTarget to handle drag-and-drop events for files.
 	public juce::Timer                          // Inherits from Timer to allow periodic updates through timer callbacks.
 {
 public:
 	// Constructor: Initializes the DeckGUI with the required dependencies.
 	// Takes a pointer to a DJAudioPlayer, references to AudioFormatManager and AudioThumbnailCache, 
-	// a pointer to a ZoomedWaveform, a reference to the Library, and a Colour for theming.
+	// a pointer to a ZoomedWaveform, a reference to the Library, a Colour for theming, and whether the deck sits in the
+	// right-hand column, with its controls mirrored.
 	DeckGUI(DJAudioPlayer* player, juce::AudioFormatManager& formatManagerToUse,
 		juce::AudioThumbnailCache& cacheToUse, ZoomedWaveform* _zoomedDisplay,
-		Library& _library, juce::Colour _colour);
+		Library& _library, juce::Colour _colour, bool _mirrored);
 
 	// Destructor: Ensures that resources allocated during the lifetime of the DeckGUI are released properly.
 	~DeckGUI() override;
@@ -71,6 +75,12 @@ private:
 	// loading samples, or adjusting settings based on button presses.
 	void buttonClicked(juce::Button* button) override;
 
+	// Starts a loop roll when the roll button is pressed and ends it when the button is released.
+	void buttonStateChanged(juce::Button* button) override;
+
+	// Returns the length in beats chosen in the loop length selector.
+	double getSelectedLoopBeats();
+
 	// CustomLookAndFeel is a class that defines the visual style of the GUI components. 
 	// The customLookAndFeel instance here is used to apply a specific look and feel to the buttons and possibly other components within the DeckGUI.
 	// This allows for a consistent and unique visual theme that differentiates the DeckGUI from standard JUCE components.
@@ -96,6 +106,9 @@ private:
 	// Implementing this method is essential for making the sliders functional, 
 	// allowing the DeckGUI to react dynamically to user input and adjust the audio playback or processing accordingly.
 	void sliderValueChanged(juce::Slider* slider) override;
+
+	// Handles a change of the resampler quality or track storage selector by passing the choice to the player.
+	void comboBoxChanged(juce::ComboBox* comboBox) override;
 	void highlightSection(juce::Graphics& g, juce::Rectangle<int> section, juce::Colour highlightColour);
 	void applyBlurEffect(juce::Graphics& g, juce::Component& component);
 	void rotateElement(juce::Graphics& g, juce::Rectangle<float> area, float angleDegrees);
@@ -128,6 +141,16 @@ private:
 	// This function is crucial for initializing the playback of new audio content and ensuring the deck is ready for user interaction.
 	void loadDeck(track track);
 
+	// Shows the progress of a track that is being loaded in the background.
+	void loadProgress(DJAudioPlayer* player, float progress) override;
+
+	// Finishes loading a track once the player has opened it: loads the waveform displays and resumes playback if the deck was playing.
+	void loadFinished(DJAudioPlayer* player, bool succeeded, juce::OwnedArray<juce::AudioFormatReader>& thumbnailReaders) override;
+
+	// Takes the tempo, beat grid and trim of a track whose analysis finished after it was picked for the deck, both
+	// for a track still loading and for the one on the deck.
+	void trackAnalysed(const track& song) override;
+
 	// Pointers to the Library and DJAudioPlayer instances. 
 	// The library pointer is used for managing the collection of audio tracks available to the DeckGUI, 
 	// while the player pointer is used to control the playback of audio within the deck. 
@@ -148,6 +171,9 @@ private:
 	// The use of a single color theme ensures consistency and helps in creating a recognizable user experience.
 	juce::Colour theme;
 
+	// Whether the deck is laid out mirrored, with the volume on the left, as the right-hand deck of a pair.
+	bool mirrored;
+
 	// Labels and sliders for controlling various audio parameters like volume, speed, and filters.
 	// These GUI components allow users to adjust the audio output to their preference, 
 	// such as changing the playback speed, adjusting the volume, or applying filters to the audio signal. 
@@ -165,6 +191,47 @@ private:
 	juce::Label lbLabel{ "LOW", "LOW" };
 	juce::Label filterLabel{ "FILTER", "FILTER" };
 
+	// Toggle button under the speed slider that switches key lock on the deck, so the speed changes tempo without changing pitch.
+	juce::TextButton keyLockButton{ "KEY LOCK" };
+
+	// Selector for the quality tier of the deck's resampler, trading CPU for less aliasing at high speeds.
+	juce::ComboBox qualityBox;
+
+	// Selector for how the next loaded track is kept: streamed from disk, or decoded to RAM for instant cue jumps.
+	juce::ComboBox storageBox;
+
+	// Toggle button that locks the deck to the tempo and beat phase of the master deck, and a button to tap in the
+	// beats of a track whose tempo has not been found, which sets the beat grid with a beat on the last tap.
+	juce::TextButton syncButton{ "SYNC" };
+	juce::TextButton tapButton{ "TAP" };
+
+	// Times of the recent taps in milliseconds.
+	juce::Array<double> tapTimes;
+
+	// Toggle button that sends the deck, before its volume and the crossfader, to the headphone cue bus.
+	juce::TextButton pflButton{ "PFL" };
+
+	// Longest gap between two taps of the same tempo, in milliseconds, and the number of taps averaged.
+	static constexpr double maxTapGapMs = 2000.0;
+	static constexpr int maxTaps = 8;
+
+	// Loop controls: manual loop in and out, a beat loop of the selected length that is also used to exit the loop,
+	// halving and doubling of the current loop, and a loop roll that lasts as long as its button is held down.
+	juce::TextButton loopInButton{ "IN" };
+	juce::TextButton loopOutButton{ "OUT" };
+	juce::TextButton loopButton{ "LOOP" };
+	juce::TextButton halveLoopButton{ "/2" };
+	juce::TextButton doubleLoopButton{ "x2" };
+	juce::TextButton rollButton{ "ROLL" };
+	juce::ComboBox loopLengthBox;
+
+	// Track being loaded by the player, the track on the deck, and a bar along the bottom of the waveform showing how
+	// far the load has got.
+	track loadingTrack;
+	track loadedTrack;
+	double loadingProgress = 0;
+	juce::ProgressBar loadingBar{ loadingProgress };
+
 	// GUI components for waveform visualization and user interaction. 
 	// WaveformDisplay, JogWheel, and ZoomedWaveform are custom components that provide visual feedback on the audio's waveform, 
 	// allowing users to see and interact with the audio in a more detailed and intuitive way. 
@@ -190,7 +257,7 @@ private:
 
 	// Variables for keeping track of the playback position and state of the DeckGUI. 
 	// prevPlayerPos stores the last known position of the audio playback, 
-	// while canContinue, modeIsPlaying, draggedIndex, flash, counter, and volRMS 
+	// while canContinue, modeIsPlaying, draggedIndex, flash, counter, volRMS and volPeakHold 
 	// are used to manage various states and conditions during playback, such as whether playback can continue, 
 	// whether the deck is currently playing, or the RMS volume level. 
 	// These variables are critical for maintaining the functionality and responsiveness of the DeckGUI.
@@ -200,7 +267,8 @@ private:
 	int draggedIndex;
 	bool flash;
 	int counter;
-	float volRMS;
+	float volRMS = -100.0f;
+	float volPeakHold = -100.0f;
 
 	// JUCE's built-in macro to prevent the copying and assigning of instances of this class.
 	// The JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR macro defines private copy constructor and assignment operator 
@@ -0,0 +1,59 @@
+#pragma once
+#include <JuceHeader.h>
+#include "PolyphaseResampler.h"
+
+
+// DeckParameters is the hand-off point between the deck controls on the message thread and
+// DJAudioPlayer on the audio thread.
+// The GUI only ever stores target values here; the audio thread reads them once at the start of
+// each block and smooths towards them, so no coefficients are computed and no locks are taken
+// while a control is being moved.
+struct DeckParameters {
+
+	// Identifiers of the controls handed over to the audio thread.
+	enum ID {
+		volume = 0,
+		filter,
+		lowBand,
+		midBand,
+		highBand,
+		keyLock,
+		resamplerQuality,
+		sync,
+		cue,
+		numParameters
+	};
+
+	// Constructor that starts every control at its neutral value.
+	DeckParameters() {
+		set(volume, 1.0f);
+		set(filter, 0.0f);
+		set(lowBand, 1.0f);
+		set(midBand, 1.0f);
+		set(highBand, 1.0f);
+		set(keyLock, 0.0f);
+		set(resamplerQuality, static_cast<float>(PolyphaseResampler::high));
+		set(sync, 0.0f);
+		set(cue, 0.0f);
+	}
+
+	// Method to store a new target value. Safe to call from any thread.
+	// Parameters:
+	// - id: The control to update.
+	// - value: The new target value.
+	void set(ID id, float value) {
+		values[id].store(value, std::memory_order_relaxed);
+	}
+
+	// Method to read the latest target value. Safe to call from any thread.
+	// Parameters:
+	// - id: The control to read.
+	float get(ID id) const {
+		return values[id].load(std::memory_order_relaxed);
+	}
+
+private:
+
+	// Latest target value of every control.
+	std::atomic<float> values[numParameters];
+};
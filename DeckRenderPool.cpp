@@ -0,0 +1,137 @@
+#include "DeckRenderPool.h"
+#include <thread>
+
+
+// A worker thread, which renders decks of every block it sees published.
+class DeckRenderPool::Worker : public juce::Thread {
+public:
+
+	Worker(DeckRenderPool& _pool, int index) : juce::Thread("Deck render " + juce::String(index + 1)), pool(_pool)
+	{
+	}
+
+	// Method called by the audio thread to wake the worker for a new block. A worker that is still spinning sees the
+	// block by itself, so the event, which takes a lock, is only signalled for one that has gone to sleep.
+	void wake() {
+		if (sleeping.load()) {
+			wakeUp.signal();
+		}
+	}
+
+	// Method to ask the worker to exit, waking it if it sleeps.
+	void stop() {
+		signalThreadShouldExit();
+		wakeUp.signal();
+	}
+
+	void run() override {
+		juce::ScopedNoDenormals noDenormals;
+		juce::uint32 seen = pool.generation.load(std::memory_order_acquire);
+		int spins = 0;
+
+		while (!threadShouldExit()) {
+			const juce::uint32 current = pool.generation.load(std::memory_order_acquire);
+			if (current == seen) {
+				if (++spins < idleSpins) {
+					std::this_thread::yield();
+				}
+				else {
+					// The generation is checked again after the flag is raised, so a block published in between is
+					// either seen here or woken for.
+					sleeping.store(true);
+					if (pool.generation.load() == seen) {
+						wakeUp.wait(idleWaitMs);
+					}
+					sleeping.store(false);
+					spins = 0;
+				}
+				continue;
+			}
+
+			seen = current;
+			spins = 0;
+			pool.renderClaimedDecks();
+		}
+	}
+
+private:
+	DeckRenderPool& pool;
+	juce::WaitableEvent wakeUp;
+	std::atomic<bool> sleeping{ false };
+};
+
+
+// Constructor for the DeckRenderPool class. There is no point in more workers than decks besides the one the audio
+// thread renders, or than cores besides the one the audio thread runs on.
+DeckRenderPool::DeckRenderPool(Client& _client, int _numDecks, int numThreads)
+	: client(_client), numDecks(_numDecks)
+{
+	numThreads = juce::jmin(numThreads, numDecks - 1, juce::SystemStats::getNumCpus() - 1);
+	for (auto index = 0; index < numThreads; ++index) {
+		auto* worker = new Worker(*this, index);
+		workers.add(worker);
+		worker->startRealtimeThread(juce::Thread::RealtimeOptions{});
+	}
+
+	// Nothing is left to claim until the first block is published.
+	nextDeck.store(numDecks);
+}
+
+
+DeckRenderPool::~DeckRenderPool()
+{
+	for (auto* worker : workers) {
+		worker->stop();
+	}
+	for (auto* worker : workers) {
+		worker->stopThread(1000);
+	}
+}
+
+
+// Define the render() method for the DeckRenderPool class.
+// The counters are reset before the generation is bumped, so a worker that sees the new block sees them too. A worker
+// still leaving the last block can only claim decks of this one, since claims never move the counter past numDecks.
+void DeckRenderPool::render() {
+	if (workers.isEmpty()) {
+		for (auto index = 0; index < numDecks; ++index) {
+			client.renderDeck(index);
+		}
+		return;
+	}
+
+	decksLeft.store(numDecks, std::memory_order_relaxed);
+	nextDeck.store(0, std::memory_order_release);
+	generation.fetch_add(1);
+	for (auto* worker : workers) {
+		worker->wake();
+	}
+
+	renderClaimedDecks();
+
+	// The barrier: wait for the decks the workers are still rendering. This is a pure spin, which never gives the
+	// audio thread's core away, and only lasts as long as the rendering of one deck.
+	while (decksLeft.load(std::memory_order_acquire) > 0) {
+	}
+}
+
+
+// Define the getNumThreads() method for the DeckRenderPool class.
+int DeckRenderPool::getNumThreads() const {
+	return workers.size();
+}
+
+
+// Define the renderClaimedDecks() method for the DeckRenderPool class.
+void DeckRenderPool::renderClaimedDecks() {
+	int index = nextDeck.load(std::memory_order_acquire);
+	while (index < numDecks) {
+		if (!nextDeck.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel)) {
+			continue;
+		}
+
+		client.renderDeck(index);
+		decksLeft.fetch_sub(1, std::memory_order_release);
+		index = nextDeck.load(std::memory_order_acquire);
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// DeckRenderPool renders the decks of one audio callback in parallel, on a few real-time worker threads.
+// The audio thread publishes a block by bumping a generation counter and waking the workers, then renders decks
+// itself alongside them. Decks are claimed one at a time from a shared counter, so a worker that wakes late only
+// finds less to do, and the audio thread never waits for a deck that nobody has started. The call returns once the
+// last deck claimed is finished, which is the barrier before the mix.
+// Between blocks a worker spins for a moment, to catch back-to-back blocks, and then sleeps on its event, which the
+// audio thread only signals for a worker that has gone to sleep.
+class DeckRenderPool {
+public:
+
+	// Interface of the object whose decks are rendered.
+	class Client {
+	public:
+		virtual ~Client() = default;
+
+		// Method called on the audio thread or on a worker to render one deck of the current block.
+		// Parameters:
+		// - index: The deck to render.
+		virtual void renderDeck(int index) = 0;
+	};
+
+	// Constructor for the DeckRenderPool class, which starts the workers.
+	// Parameters:
+	// - client: The object whose decks are rendered.
+	// - numDecks: The number of decks rendered in every block.
+	// - numThreads: The number of workers besides the audio thread; 0 renders every deck on the audio thread.
+	DeckRenderPool(Client& client, int numDecks, int numThreads);
+
+	// Destructor that stops the workers. The audio callback must have stopped.
+	~DeckRenderPool();
+
+	// Method to render every deck once and return when all are done. Called on the audio thread.
+	void render();
+
+	// Method to return the number of workers besides the audio thread.
+	int getNumThreads() const;
+
+	// Number of times a worker checks for a new block before going to sleep.
+	static constexpr int idleSpins = 2000;
+
+	// Longest a sleeping worker waits before checking whether it should exit, in milliseconds.
+	static constexpr int idleWaitMs = 100;
+
+private:
+
+	class Worker;
+
+	// Method to claim and render decks until none are left unclaimed. Called on the audio thread and on the workers.
+	void renderClaimedDecks();
+
+	Client& client;
+	const int numDecks;
+	juce::OwnedArray<Worker> workers;
+
+	// Number of the current block, next deck to claim, and decks claimed or not that are still to finish.
+	std::atomic<juce::uint32> generation{ 0 };
+	std::atomic<int> nextDeck{ 0 };
+	std::atomic<int> decksLeft{ 0 };
+};
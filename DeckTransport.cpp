@@ -0,0 +1,319 @@
+#include "DeckTransport.h"
+
+
+DeckTransport::DeckTransport()
+{
+}
+
+
+DeckTransport::~DeckTransport()
+{
+	stopTimer();
+	loopEngine.cancelCacheFill();
+	deleteRetiredTracks();
+
+	// The latest track is one of these two.
+	delete pendingTrack.exchange(nullptr);
+	delete currentTrack;
+}
+
+
+// Define the prepareToPlay() method for the DeckTransport class.
+void DeckTransport::prepareToPlay(int samplesPerBlockExpected, double newSampleRate) {
+	blockSize.store(samplesPerBlockExpected);
+	sampleRate.store(newSampleRate);
+	seekFadeBuffer.setSize(2, seekFadeSamples);
+	seekFadePosition = seekFadeSamples;
+
+	// A pending track was prepared by the loader and is picked up as it is.
+	if (currentTrack != nullptr) {
+		currentTrack->prepareToPlay(samplesPerBlockExpected, newSampleRate);
+	}
+	lastGain = 0.0f;
+}
+
+
+// Define the releaseResources() method for the DeckTransport class.
+void DeckTransport::releaseResources() {
+	if (currentTrack != nullptr) {
+		currentTrack->releaseResources();
+	}
+}
+
+
+// Define the swapPendingTrack() method for the DeckTransport class.
+// The old track is pushed into the retired FIFO before the pending pointer is cleared, so that the timer cannot
+// find both empty, and stop, while the swap is half done.
+// A loop roll that ends jumps back to where the track would have been, crossfading like any other seek.
+void DeckTransport::swapPendingTrack() {
+	if (pendingTrack.load() != nullptr && lastGain == 0.0f && retiredFifo.getFreeSpace() > 0) {
+		if (currentTrack != nullptr) {
+			int start1, size1, start2, size2;
+			retiredFifo.prepareToWrite(1, start1, size1, start2, size2);
+			retiredTracks[size1 > 0 ? start1 : start2] = currentTrack;
+			retiredFifo.finishedWrite(1);
+		}
+
+		// The message thread may have replaced the pending track since it was checked, in which case the newer one is taken.
+		currentTrack = pendingTrack.exchange(nullptr);
+		loopEngine.trackChanged();
+
+		// A seek queued for the new track before it was picked up is applied before it is heard.
+		currentSerial = currentTrack->getSerial();
+		if (deferredSeekSerial == currentSerial) {
+			loopEngine.setPosition(*currentTrack, deferredSeekPosition);
+			currentTrack->jumpsApplied(deferredSeekCount);
+		}
+		deferredSeekSerial = 0;
+	}
+
+	if (currentTrack != nullptr) {
+		const juce::int64 rollReturn = loopEngine.swapPendingRegion(*currentTrack);
+		if (rollReturn >= 0) {
+			seek(rollReturn);
+		}
+	}
+}
+
+
+// Define the getNextAudioBlock() method for the DeckTransport class.
+// Starting and stopping ramp the gain over startStopFadeSamples, carrying on into the next segments when this one is
+// shorter, since the player splits blocks at its commands. A track waiting to be swapped in also fades the current
+// one out, so that the swap happens on silence.
+void DeckTransport::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
+	const bool swapWaiting = pendingTrack.load() != nullptr;
+	const float gain = (playing.load() && currentTrack != nullptr && !swapWaiting) ? 1.0f : 0.0f;
+
+	if (currentTrack == nullptr || (gain == 0.0f && lastGain == 0.0f)) {
+		bufferToFill.clearActiveBufferRegion();
+		lastGain = 0.0f;
+		seekFadePosition = seekFadeSamples;
+		return;
+	}
+
+	loopEngine.read(*currentTrack, bufferToFill);
+
+	// Crossfade from the audio before the last seek to the audio after it.
+	if (seekFadePosition < seekFadeSamples) {
+		const int numToFade = juce::jmin(bufferToFill.numSamples, seekFadeSamples - seekFadePosition);
+		const int numChannels = juce::jmin(2, bufferToFill.buffer->getNumChannels());
+		for (auto channel = 0; channel < numChannels; ++channel) {
+			float* out = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
+			const float* old = seekFadeBuffer.getReadPointer(channel, seekFadePosition);
+			for (auto i = 0; i < numToFade; ++i) {
+				const float oldGain = 1.0f - static_cast<float>(seekFadePosition + i + 1) / seekFadeSamples;
+				out[i] = out[i] * (1.0f - oldGain) + old[i] * oldGain;
+			}
+		}
+		seekFadePosition += numToFade;
+	}
+
+	if (gain != lastGain) {
+		const float step = 1.0f / startStopFadeSamples;
+		const int numToFade = juce::jmin(bufferToFill.numSamples, static_cast<int>(std::ceil(std::abs(gain - lastGain) / step)));
+		const float fadeEnd = numToFade < bufferToFill.numSamples ? gain
+			: juce::jlimit(0.0f, 1.0f, lastGain + (gain > lastGain ? step : -step) * numToFade);
+		bufferToFill.buffer->applyGainRamp(bufferToFill.startSample, numToFade, lastGain, fadeEnd);
+
+		// Once faded out, the rest of the segment is silent.
+		if (fadeEnd == 0.0f && numToFade < bufferToFill.numSamples) {
+			bufferToFill.buffer->clear(bufferToFill.startSample + numToFade, bufferToFill.numSamples - numToFade);
+		}
+		lastGain = fadeEnd;
+	}
+
+	if (currentTrack->getNextReadPosition() > currentTrack->getTotalLength() + 1) {
+		playing.store(false);
+	}
+}
+
+
+// Define the setNextReadPosition() method for the DeckTransport class.
+void DeckTransport::setNextReadPosition(juce::int64 newPosition) {
+	seek(newPosition);
+}
+
+
+// Define the getNextReadPosition() method for the DeckTransport class.
+// While a loop plays from RAM the track waits at the loop end, so the position is taken from the loop instead.
+juce::int64 DeckTransport::getNextReadPosition() const {
+	const juce::int64 loopPosition = loopEngine.getPlayhead();
+	if (loopPosition >= 0 && !hasPendingTrack()) {
+		return loopPosition;
+	}
+	return latestTrack != nullptr ? latestTrack->getNextReadPosition() : 0;
+}
+
+
+// Define the getTotalLength() method for the DeckTransport class.
+juce::int64 DeckTransport::getTotalLength() const {
+	return latestTrack != nullptr ? latestTrack->getTotalLength() : 0;
+}
+
+
+// Define the isLooping() method for the DeckTransport class.
+bool DeckTransport::isLooping() const {
+	return loopEngine.isLooping();
+}
+
+
+// Define the setTrack() method for the DeckTransport class.
+void DeckTransport::setTrack(std::unique_ptr<TrackSource> newTrack) {
+	jassert(newTrack != nullptr);
+
+	playing.store(false);
+	newTrack->setSerial(++latestSerial);
+	latestTrack = newTrack.get();
+	loopEngine.clear();
+
+	// A track that was handed over but never picked up was not seen by the audio thread, so it can go straight away.
+	delete pendingTrack.exchange(newTrack.release());
+
+	deleteRetiredTracks();
+	startTimer(deleteIntervalMs);
+}
+
+
+// Define the seek() method for the DeckTransport class.
+// Nothing is faded while the transport is silent. A second seek within the crossfade restarts it from the latest position.
+void DeckTransport::seek(juce::int64 newPosition) {
+	if (currentTrack == nullptr) {
+		return;
+	}
+
+	if (lastGain > 0.0f && seekFadeBuffer.getNumSamples() == seekFadeSamples) {
+		juce::AudioSourceChannelInfo info(&seekFadeBuffer, 0, seekFadeSamples);
+		loopEngine.read(*currentTrack, info);
+		seekFadePosition = 0;
+	}
+	loopEngine.setPosition(*currentTrack, newPosition);
+}
+
+
+// Define the seekTrack() method for the DeckTransport class.
+// Serials only grow, so a seek for a newer serial than the current one is for a track that has not been picked up yet.
+// Only the latest such seek is kept, but all of them are counted as applied when the track is picked up, so that
+// the track knows their landings are no longer needed; if the track is replaced first, the serials no longer match.
+void DeckTransport::seekTrack(juce::uint32 serial, juce::int64 newPosition) {
+	if (serial == 0) {
+		return;
+	}
+
+	if (serial == currentSerial && currentTrack != nullptr) {
+		seek(newPosition);
+		currentTrack->jumpsApplied(1);
+	}
+	else if (serial > currentSerial) {
+		deferredSeekCount = serial == deferredSeekSerial ? deferredSeekCount + 1 : 1;
+		deferredSeekSerial = serial;
+		deferredSeekPosition = newPosition;
+	}
+}
+
+
+// Define the getLatestSerial() method for the DeckTransport class.
+juce::uint32 DeckTransport::getLatestSerial() const {
+	return latestSerial;
+}
+
+
+// Define the getCurrentSerial() method for the DeckTransport class.
+juce::uint32 DeckTransport::getCurrentSerial() const {
+	return currentSerial;
+}
+
+
+// Define the getLoopEngine() method for the DeckTransport class.
+LoopEngine& DeckTransport::getLoopEngine() {
+	return loopEngine;
+}
+
+
+// Define the getTrack() method for the DeckTransport class.
+TrackSource* DeckTransport::getTrack() const {
+	return latestTrack;
+}
+
+
+// Define the hasPendingTrack() method for the DeckTransport class.
+bool DeckTransport::hasPendingTrack() const {
+	return pendingTrack.load() != nullptr;
+}
+
+
+// Define the getCurrentSampleRate() method for the DeckTransport class.
+double DeckTransport::getCurrentSampleRate() const {
+	return currentTrack != nullptr ? currentTrack->getSampleRate() : 0.0;
+}
+
+
+// Define the getCurrentPosition() method for the DeckTransport class.
+juce::int64 DeckTransport::getCurrentPosition() const {
+	const juce::int64 loopPosition = loopEngine.getPlayhead();
+	if (loopPosition >= 0) {
+		return loopPosition;
+	}
+	return currentTrack != nullptr ? currentTrack->getNextReadPosition() : 0;
+}
+
+
+// Define the start() method for the DeckTransport class.
+void DeckTransport::start() {
+	if (currentTrack != nullptr || pendingTrack.load() != nullptr) {
+		playing.store(true);
+	}
+}
+
+
+// Define the stop() method for the DeckTransport class.
+void DeckTransport::stop() {
+	playing.store(false);
+}
+
+
+// Define the isPlaying() method for the DeckTransport class.
+bool DeckTransport::isPlaying() const {
+	return playing.load();
+}
+
+
+// Define the getBlockSize() method for the DeckTransport class.
+int DeckTransport::getBlockSize() const {
+	return blockSize.load();
+}
+
+
+// Define the getSampleRate() method for the DeckTransport class.
+double DeckTransport::getSampleRate() const {
+	return sampleRate.load();
+}
+
+
+// Define the timerCallback() method for the DeckTransport class, which runs until the audio thread has picked up the latest track
+// and the track it replaced has been deleted.
+void DeckTransport::timerCallback() {
+	deleteRetiredTracks();
+
+	if (pendingTrack.load() == nullptr && retiredFifo.getNumReady() == 0) {
+		stopTimer();
+	}
+}
+
+
+// Define the deleteRetiredTracks() method for the DeckTransport class.
+void DeckTransport::deleteRetiredTracks() {
+	const int numReady = retiredFifo.getNumReady();
+	if (numReady == 0) {
+		return;
+	}
+
+	int start1, size1, start2, size2;
+	retiredFifo.prepareToRead(numReady, start1, size1, start2, size2);
+	for (auto i = 0; i < size1; ++i) {
+		delete retiredTracks[start1 + i];
+	}
+	for (auto i = 0; i < size2; ++i) {
+		delete retiredTracks[start2 + i];
+	}
+	retiredFifo.finishedRead(size1 + size2);
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TrackSource.h"
+#include "LoopEngine.h"
+
+
+// DeckTransport plays the loaded TrackSource of a deck and replaces juce::AudioTransportSource, which takes a
+// lock shared with the audio thread whenever its source is changed.
+// A new track is handed over by the message thread through an atomic pointer and picked up by the audio thread
+// at the start of a block, once the old track has faded out, so that loading never blocks or glitches the audio.
+// The audio thread never deletes anything: the track it replaces goes into a FIFO that the message thread
+// empties on a timer. Start and stop are atomic flags, faded in or out over startStopFadeSamples, and a seek made
+// on the audio thread crossfades from the old position to the new one. Loops are played by a LoopEngine between the
+// transport and the track.
+class DeckTransport : public juce::PositionableAudioSource,
+	private juce::Timer {
+public:
+
+	// Constructor for the DeckTransport class, which starts with no track.
+	DeckTransport();
+
+	// Destructor that deletes every track still owned by the transport. The audio callback must have stopped.
+	~DeckTransport() override;
+
+	// Method to prepare the current track for playback and to remember the block size and sample rate for new tracks.
+	// Parameters:
+	// - samplesPerBlockExpected: The number of audio samples expected per block.
+	// - sampleRate: The sample rate of the audio.
+	void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+	// Method to release the resources of the current track.
+	void releaseResources() override;
+
+	// Method to fill the buffer with the next block of the current track, or with silence when stopped.
+	// Parameters:
+	// - bufferToFill: Contains the buffer information to be filled with audio data.
+	void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+	// Methods of juce::PositionableAudioSource, in samples of the latest track. setNextReadPosition() moves the
+	// current track like seek() and is called on the audio thread; the others are called from the message thread.
+	void setNextReadPosition(juce::int64 newPosition) override;
+	juce::int64 getNextReadPosition() const override;
+	juce::int64 getTotalLength() const override;
+	bool isLooping() const override;
+
+	// Method to hand a new, already prepared track to the audio thread, which stops playback. Called from the message thread.
+	// Parameters:
+	// - newTrack: The track to play from now on.
+	void setTrack(std::unique_ptr<TrackSource> newTrack);
+
+	// Method to return the latest track handed over with setTrack(), or nullptr. Only for use on the message thread.
+	TrackSource* getTrack() const;
+
+	// Method to check whether the latest track is still waiting to be picked up by the audio thread.
+	bool hasPendingTrack() const;
+
+	// Method called by the audio thread at the start of each block to pick up a new track once the old one is silent,
+	// and the latest loop.
+	void swapPendingTrack();
+
+	// Method to access the loops of the transport, which are set from the message thread.
+	LoopEngine& getLoopEngine();
+
+	// Method to return the sample rate of the track the audio thread is playing, or 0. Only for use on the audio thread.
+	double getCurrentSampleRate() const;
+
+	// Method to return the position of the next sample the audio thread reads from the track it is playing, or from
+	// its loop, in samples of the file. Only for use on the audio thread, which unlike getNextReadPosition() never
+	// looks at a track that is still waiting to be picked up.
+	juce::int64 getCurrentPosition() const;
+
+	// Method to move the current track to a new position on the audio thread. While playing, the audio that would
+	// have followed the old position is faded out under the new one, so that the jump does not click.
+	// Parameters:
+	// - newPosition: The new position in samples of the file.
+	void seek(juce::int64 newPosition);
+
+	// Method to move a given track to a new position on the audio thread, for a seek queued by the message thread.
+	// The current track is moved by seek(); a track still waiting to be picked up starts from the position once it
+	// is; and a seek queued for a track that has since been replaced is dropped.
+	// Parameters:
+	// - serial: The serial of the track the seek was queued for, from getLatestSerial() when it was queued.
+	// - newPosition: The new position in samples of the file.
+	void seekTrack(juce::uint32 serial, juce::int64 newPosition);
+
+	// Method to return the serial of the latest track handed over with setTrack(), or 0. Only for use on the message thread.
+	juce::uint32 getLatestSerial() const;
+
+	// Method to return the serial of the track the audio thread is playing, or 0. Only for use on the audio thread.
+	juce::uint32 getCurrentSerial() const;
+
+	// Methods to start and stop playback, which take effect from the next block read. Called on the audio thread.
+	void start();
+	void stop();
+
+	// Method to check whether the transport is playing. Playback stops by itself at the end of the track.
+	bool isPlaying() const;
+
+	// Methods to return the block size and sample rate of the last call to prepareToPlay(), with which new tracks are prepared.
+	int getBlockSize() const;
+	double getSampleRate() const;
+
+private:
+
+	// Method called on the message thread to delete the tracks retired by the audio thread.
+	void timerCallback() override;
+
+	// Method to delete every track waiting in the retired FIFO.
+	void deleteRetiredTracks();
+
+	// Number of retired tracks that can wait to be deleted. A new track is not picked up while the FIFO is full.
+	static constexpr int retiredCapacity = 8;
+
+	// Interval at which retired tracks are deleted, in milliseconds.
+	static constexpr int deleteIntervalMs = 200;
+
+	// Length of the crossfade of a seek, in samples.
+	static constexpr int seekFadeSamples = 128;
+
+	// Length of the fade when playback starts or stops, in samples, whatever the length of the block or segment.
+	static constexpr int startStopFadeSamples = 128;
+
+	// Track handed over by the message thread and not yet picked up by the audio thread.
+	std::atomic<TrackSource*> pendingTrack{ nullptr };
+
+	// Track being played, owned by the audio thread.
+	TrackSource* currentTrack = nullptr;
+
+	// Latest track handed over, owned by the message thread. It is either the pending or the current track, so it
+	// is never retired until a newer one has been handed over.
+	TrackSource* latestTrack = nullptr;
+
+	// Serial of the latest track, owned by the message thread, and of the current track, owned by the audio thread.
+	juce::uint32 latestSerial = 0;
+	juce::uint32 currentSerial = 0;
+
+	// Tracks replaced by the audio thread and waiting for the message thread to delete them.
+	juce::AbstractFifo retiredFifo{ retiredCapacity };
+	TrackSource* retiredTracks[retiredCapacity] = {};
+
+	// Whether the transport should play, and the gain at the end of the last block, owned by the audio thread.
+	std::atomic<bool> playing{ false };
+	float lastGain = 0.0f;
+
+	// Serial of a track still waiting to be picked up whose seek has been applied, or 0, the position it starts from,
+	// and the number of seeks queued for it, owned by the audio thread.
+	juce::uint32 deferredSeekSerial = 0;
+	juce::int64 deferredSeekPosition = 0;
+	int deferredSeekCount = 0;
+
+	// Loops played between the transport and the current track.
+	LoopEngine loopEngine;
+
+	// Audio that followed the position before the last seek, and how much of it has been faded out.
+	juce::AudioBuffer<float> seekFadeBuffer;
+	int seekFadePosition = seekFadeSamples;
+
+	// Block size and sample rate of the last call to prepareToPlay().
+	std::atomic<int> blockSize{ 512 };
+	std::atomic<double> sampleRate{ 44100.0 };
+};
@@ -0,0 +1,475 @@
+#include "DspBenchmark.h"
+#include "DJAudioPlayer.h"
+#include "MixBus.h"
+#include "ReadAheadThread.h"
+#include "TrackLoader.h"
+
+
+namespace {
+	// Length of the noise every stage is fed, in samples.
+	constexpr int noiseLength = 1 << 14;
+
+	// Numbers of inputs the mixes are measured with.
+	constexpr int mixSizes[] = { 2, 4, 8 };
+
+	// Block size and sample rate the track is played at, how many samples after a seek are prefetched, as a deck does,
+	// and how long a seek may wait for the read-ahead.
+	constexpr int trackBlockSize = 512;
+	constexpr double trackSampleRate = 44100.0;
+	constexpr int trackPrefetchSamples = 4096;
+	constexpr int trackSeekTimeoutMs = 2000;
+
+	// Stereo white noise, the same on every run, read in a loop.
+	class NoiseTable {
+	public:
+		NoiseTable() : samples(2, noiseLength) {
+			juce::Random random(0x5eed);
+			for (auto channel = 0; channel < samples.getNumChannels(); ++channel) {
+				for (auto sample = 0; sample < noiseLength; ++sample) {
+					samples.setSample(channel, sample, random.nextFloat() - 0.5f);
+				}
+			}
+		}
+
+		// Copy the next samples of the noise into a buffer.
+		void read(juce::AudioBuffer<float>& dest, int startSample, int numSamples) {
+			while (numSamples > 0) {
+				const int chunk = juce::jmin(numSamples, noiseLength - position);
+				for (auto channel = 0; channel < dest.getNumChannels(); ++channel) {
+					dest.copyFrom(channel, startSample, samples, channel % 2, position, chunk);
+				}
+				position = (position + chunk) % noiseLength;
+				startSample += chunk;
+				numSamples -= chunk;
+			}
+		}
+
+	private:
+		juce::AudioBuffer<float> samples;
+		int position = 0;
+	};
+
+	// The noise as an AudioSource, for the stages that pull their input.
+	class NoiseSource : public juce::AudioSource {
+	public:
+		void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override {}
+		void releaseResources() override {}
+		void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override {
+			noise.read(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+		}
+
+	private:
+		NoiseTable noise;
+	};
+
+	// Names of the DeckFilter stages, in the order of DeckFilter::Stage.
+	const char* const filterStageNames[] = { "lowBand", "midBand", "highBand", "highPass", "lowPass" };
+
+	// Settings each filter stage is measured at: a boost on the bands, and a cutoff on the sweep.
+	constexpr float bandGain = 1.5f;
+	constexpr float highPassCutoff = 200.0f;
+	constexpr float lowPassCutoff = 2000.0f;
+
+	// Coefficients of a filter stage as the juce::IIRFilter chain used to set them.
+	juce::IIRCoefficients makeReferenceCoefficients(int stage, double sampleRate) {
+		const double q = 1.0 / juce::MathConstants<double>::sqrt2;
+		switch (stage) {
+		case DeckFilter::lowBand: return juce::IIRCoefficients::makeLowShelf(sampleRate, 500, q, bandGain);
+		case DeckFilter::midBand: return juce::IIRCoefficients::makePeakFilter(sampleRate, 3250, q, bandGain);
+		case DeckFilter::highBand: return juce::IIRCoefficients::makeHighShelf(sampleRate, 5000, q, bandGain);
+		case DeckFilter::highPass: return juce::IIRCoefficients::makeHighPass(sampleRate, highPassCutoff);
+		default: return juce::IIRCoefficients::makeLowPass(sampleRate, lowPassCutoff);
+		}
+	}
+
+	// Whether this is a debug build, whose timings say little about a release build.
+#if JUCE_DEBUG
+	constexpr bool isDebugBuild = true;
+#else
+	constexpr bool isDebugBuild = false;
+#endif
+
+	// Name of the vector instructions the build uses.
+	const char* getSimdName() {
+#if JUCE_USE_SSE_INTRINSICS
+		return "sse";
+#elif JUCE_USE_ARM_NEON
+		return "neon";
+#else
+		return "scalar";
+#endif
+	}
+}
+
+
+// Constructor for the DspBenchmark class.
+DspBenchmark::DspBenchmark(const Settings& _settings, std::function<void(bool)> _onFinished)
+	: juce::Thread("DSP benchmark"),
+	settings(_settings),
+	onFinished(std::move(_onFinished))
+{
+}
+
+
+DspBenchmark::~DspBenchmark()
+{
+	stopThread(10000);
+}
+
+
+// Define the run() method for the DspBenchmark class.
+// Every stage keeps its own objects, which are prepared again for each sample rate and block size.
+void DspBenchmark::run() {
+	NoiseTable noise;
+	std::vector<Stage> stages;
+
+	stages.push_back({ "copy",
+		[](double, int) {},
+		[&noise](juce::AudioBuffer<float>& buffer, int numSamples) { noise.read(buffer, 0, numSamples); } });
+
+	// Resamplers at the edge of the speed range.
+	NoiseSource resamplerInput;
+	PolyphaseResampler resampler(&resamplerInput);
+	const char* const qualityNames[] = { "draft", "standard", "high", "best" };
+	for (auto quality = 0; quality < PolyphaseResampler::numQualities; ++quality) {
+		stages.push_back({ juce::String("resampler.polyphase.") + qualityNames[quality],
+			[&resampler, quality](double sampleRate, int blockSize) {
+				resampler.setQuality(static_cast<PolyphaseResampler::Quality>(quality));
+				resampler.setResamplingRatio(speedRatio);
+				resampler.prepareToPlay(blockSize, sampleRate);
+			},
+			[&resampler](juce::AudioBuffer<float>& buffer, int numSamples) {
+				resampler.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, numSamples));
+			} });
+	}
+
+	juce::ResamplingAudioSource referenceResampler(&resamplerInput, false, 2);
+	stages.push_back({ "resampler.juce",
+		[&referenceResampler](double sampleRate, int blockSize) {
+			referenceResampler.setResamplingRatio(speedRatio);
+			referenceResampler.prepareToPlay(blockSize, sampleRate);
+		},
+		[&referenceResampler](juce::AudioBuffer<float>& buffer, int numSamples) {
+			referenceResampler.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, numSamples));
+		} });
+
+	// The key-lock stretcher, from half to double the tempo.
+	NoiseSource stretcherInput;
+	TimeStretcher stretcher(&stretcherInput);
+	for (const double ratio : stretchRatios) {
+		stages.push_back({ "timestretch." + juce::String(ratio, 2),
+			[&stretcher, ratio](double sampleRate, int blockSize) {
+				stretcher.setEnabled(true);
+				stretcher.setStretchRatio(ratio);
+				stretcher.prepareToPlay(blockSize, sampleRate);
+			},
+			[&stretcher](juce::AudioBuffer<float>& buffer, int numSamples) {
+				stretcher.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, numSamples));
+			} });
+	}
+
+	// Each biquad alone and the full chain, in the DeckFilter and in the juce::IIRFilter chain it replaced.
+	// The high-pass and low-pass share the sweep, so the full chain is the three bands and the low-pass.
+	DeckFilter deckFilter;
+	juce::IIRFilter referenceFilters[DeckFilter::numStages][2];
+	const std::vector<int> fullChain = { DeckFilter::lowBand, DeckFilter::midBand, DeckFilter::highBand, DeckFilter::lowPass };
+	for (auto stage = 0; stage <= DeckFilter::numStages; ++stage) {
+		const auto activeStages = stage < DeckFilter::numStages ? std::vector<int>{ stage } : fullChain;
+		const juce::String stageName = stage < DeckFilter::numStages ? filterStageNames[stage] : "full";
+
+		stages.push_back({ "eq.deckFilter." + stageName,
+			[&deckFilter, activeStages](double sampleRate, int blockSize) {
+				// Flatten every stage, set the ones measured, and let prepare() land them on their settings.
+				for (const int band : { DeckFilter::lowBand, DeckFilter::midBand, DeckFilter::highBand }) {
+					deckFilter.setBandGain(static_cast<DeckFilter::Stage>(band), 1.0f);
+				}
+				deckFilter.setSweep(0.0f);
+				for (const int active : activeStages) {
+					if (active == DeckFilter::highPass || active == DeckFilter::lowPass) {
+						deckFilter.setSweep(active == DeckFilter::highPass ? -highPassCutoff : lowPassCutoff);
+					}
+					else {
+						deckFilter.setBandGain(static_cast<DeckFilter::Stage>(active), bandGain);
+					}
+				}
+				deckFilter.prepare(sampleRate);
+			},
+			[&deckFilter, &noise](juce::AudioBuffer<float>& buffer, int numSamples) {
+				noise.read(buffer, 0, numSamples);
+				deckFilter.process(buffer, 0, numSamples);
+			} });
+
+		stages.push_back({ "eq.juceIIR." + stageName,
+			[&referenceFilters, activeStages](double sampleRate, int blockSize) {
+				for (const int active : activeStages) {
+					for (auto& filter : referenceFilters[active]) {
+						filter.setCoefficients(makeReferenceCoefficients(active, sampleRate));
+						filter.reset();
+					}
+				}
+			},
+			[&referenceFilters, &noise, activeStages](juce::AudioBuffer<float>& buffer, int numSamples) {
+				noise.read(buffer, 0, numSamples);
+				for (const int active : activeStages) {
+					for (auto channel = 0; channel < buffer.getNumChannels(); ++channel) {
+						referenceFilters[active][channel].processSamples(buffer.getWritePointer(channel), numSamples);
+					}
+				}
+			} });
+	}
+
+	// The meter, with its K-weighting and loudness bins.
+	LevelMeter meter;
+	stages.push_back({ "meter",
+		[&meter](double sampleRate, int blockSize) { meter.prepare(sampleRate); },
+		[&meter, &noise](juce::AudioBuffer<float>& buffer, int numSamples) {
+			noise.read(buffer, 0, numSamples);
+			meter.process(buffer, 0, numSamples);
+		} });
+
+	// The mix bus and juce::MixerAudioSource, each summing inputs that are filled with noise for every block.
+	MixBus mixBus;
+	juce::OwnedArray<NoiseTable> busInputs;
+	juce::Array<int> busIndices;
+	juce::OwnedArray<NoiseSource> mixerInputs;
+	juce::MixerAudioSource mixer;
+	for (const int numInputs : mixSizes) {
+		stages.push_back({ "mix.mixBus." + juce::String(numInputs),
+			[&mixBus, &busInputs, &busIndices, numInputs](double sampleRate, int blockSize) {
+				for (const int index : busIndices) {
+					mixBus.removeInput(index);
+				}
+				busIndices.clear();
+				while (busInputs.size() < numInputs) {
+					busInputs.add(new NoiseTable());
+				}
+				for (auto input = 0; input < numInputs; ++input) {
+					busIndices.add(mixBus.addInput());
+				}
+				mixBus.prepare(blockSize);
+			},
+			[&mixBus, &busInputs, &busIndices](juce::AudioBuffer<float>& buffer, int numSamples) {
+				for (auto input = 0; input < busIndices.size(); ++input) {
+					busInputs[input]->read(mixBus.getInputBuffer(busIndices[input]), 0, numSamples);
+				}
+				mixBus.mix(MixBus::master, buffer, 0, 0, numSamples);
+			} });
+
+		stages.push_back({ "mix.mixerAudioSource." + juce::String(numInputs),
+			[&mixer, &mixerInputs, numInputs](double sampleRate, int blockSize) {
+				mixer.removeAllInputs();
+				while (mixerInputs.size() < numInputs) {
+					mixerInputs.add(new NoiseSource());
+				}
+				for (auto input = 0; input < numInputs; ++input) {
+					mixer.addInputSource(mixerInputs[input], false);
+				}
+				mixer.prepareToPlay(blockSize, sampleRate);
+			},
+			[&mixer](juce::AudioBuffer<float>& buffer, int numSamples) {
+				mixer.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, numSamples));
+			} });
+	}
+
+	// The offline helpers, each given a whole block as its buffer.
+	double helperSampleRate = 44100.0;
+	const auto prepareHelper = [&helperSampleRate](double sampleRate, int blockSize) { helperSampleRate = sampleRate; };
+	stages.push_back({ "offline.fadeIn", prepareHelper,
+		[&noise](juce::AudioBuffer<float>& buffer, int numSamples) {
+			noise.read(buffer, 0, numSamples);
+			DJAudioPlayer::applyFadeIn(buffer, numSamples);
+		} });
+	stages.push_back({ "offline.lowPass", prepareHelper,
+		[&noise, &helperSampleRate](juce::AudioBuffer<float>& buffer, int numSamples) {
+			noise.read(buffer, 0, numSamples);
+			DJAudioPlayer::applyLowPassFilter(buffer, lowPassCutoff, helperSampleRate);
+		} });
+	stages.push_back({ "offline.delay", prepareHelper,
+		[&noise, &helperSampleRate](juce::AudioBuffer<float>& buffer, int numSamples) {
+			noise.read(buffer, 0, numSamples);
+			DJAudioPlayer::applyDelayEffect(buffer, juce::roundToInt(helperSampleRate * 0.25), 0.5f);
+		} });
+	stages.push_back({ "offline.normalize", prepareHelper,
+		[&noise](juce::AudioBuffer<float>& buffer, int numSamples) {
+			noise.read(buffer, 0, numSamples);
+			DJAudioPlayer::normalizeAudio(buffer);
+		} });
+
+	if (isDebugBuild) {
+		juce::Logger::writeToLog("Warning: this is a debug build, so the timings do not reflect a release build");
+	}
+
+	juce::Array<juce::var> results;
+	for (const auto& stage : stages) {
+		if (settings.stageFilter.isNotEmpty() && !stage.name.contains(settings.stageFilter)) {
+			continue;
+		}
+		for (const double sampleRate : sampleRates) {
+			for (const int blockSize : blockSizes) {
+				if (threadShouldExit()) {
+					onFinished(false);
+					return;
+				}
+
+				const double nsPerSample = measure(stage, sampleRate, blockSize);
+				juce::String line = stage.name.paddedRight(' ', 30) + juce::String(sampleRate, 0).paddedLeft(' ', 6) + " Hz"
+					+ juce::String(blockSize).paddedLeft(' ', 6) + juce::String(nsPerSample, 2).paddedLeft(' ', 10) + " ns/sample";
+
+				auto* result = new juce::DynamicObject();
+				result->setProperty("stage", stage.name);
+				result->setProperty("sampleRate", sampleRate);
+				result->setProperty("blockSize", blockSize);
+				result->setProperty("nsPerSample", nsPerSample);
+
+				// Each deck gets a budgetDecks-th of a callback lasting budgetBlockSize / sampleRate seconds, in which it
+				// stretches budgetBlockSize samples.
+				if (stage.name.startsWith("timestretch.")) {
+					const double budgetPercent = 100.0 * nsPerSample * 1.0e-9 * sampleRate * budgetDecks;
+					line += juce::String(budgetPercent, 1).paddedLeft(' ', 8) + "% of a deck's budget";
+					result->setProperty("deckBudgetPercent", budgetPercent);
+				}
+				juce::Logger::writeToLog(line);
+				results.add(juce::var(result));
+			}
+		}
+	}
+
+	// Loads and seeks of the track, through the memory map and through the stream.
+	juce::Array<juce::var> trackResults;
+	if (settings.track.existsAsFile()) {
+		for (const bool allowMemoryMap : { true, false }) {
+			const juce::String name = allowMemoryMap ? "track.mapped" : "track.stream";
+			if (threadShouldExit()) {
+				onFinished(false);
+				return;
+			}
+			if (settings.stageFilter.isEmpty() || name.contains(settings.stageFilter)) {
+				const auto result = measureTrack(name, allowMemoryMap);
+				if (!result.isVoid()) {
+					trackResults.add(result);
+				}
+			}
+		}
+	}
+
+	auto* root = new juce::DynamicObject();
+	root->setProperty("unit", "ns per stereo sample frame");
+	root->setProperty("simd", getSimdName());
+	root->setProperty("debugBuild", isDebugBuild);
+	root->setProperty("speedRatio", speedRatio);
+	root->setProperty("budgetDecks", budgetDecks);
+	root->setProperty("budgetBlockSize", budgetBlockSize);
+	root->setProperty("results", results);
+	if (settings.track.existsAsFile()) {
+		root->setProperty("track", settings.track.getFullPathName());
+		root->setProperty("trackResults", trackResults);
+	}
+
+	const bool written = settings.output.replaceWithText(juce::JSON::toString(juce::var(root)));
+	juce::Logger::writeToLog(written ? "Wrote " + settings.output.getFullPathName() : "Could not write " + settings.output.getFullPathName());
+	onFinished(written);
+}
+
+
+// Define the measure() method for the DspBenchmark class.
+// The clock is read every few blocks rather than around each one, since reading it costs about as much as a short
+// block of the cheaper stages.
+double DspBenchmark::measure(const Stage& stage, double sampleRate, int blockSize) {
+	constexpr int blocksPerCheck = 8;
+
+	juce::AudioBuffer<float> buffer(2, blockSize);
+	buffer.clear();
+	stage.prepare(sampleRate, blockSize);
+
+	const int warmupBlocks = juce::jmax(blocksPerCheck, juce::roundToInt(warmupSeconds * sampleRate / blockSize));
+	for (auto block = 0; block < warmupBlocks; ++block) {
+		stage.process(buffer, blockSize);
+	}
+
+	double best = std::numeric_limits<double>::max();
+	for (auto round = 0; round < numRounds; ++round) {
+		juce::int64 numBlocks = 0;
+		double seconds = 0;
+		const auto start = juce::Time::getHighResolutionTicks();
+		do {
+			for (auto block = 0; block < blocksPerCheck; ++block) {
+				stage.process(buffer, blockSize);
+			}
+			numBlocks += blocksPerCheck;
+			seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+		} while (seconds < roundSeconds);
+
+		best = juce::jmin(best, seconds * 1.0e9 / static_cast<double>(numBlocks * blockSize));
+	}
+	return best;
+}
+
+
+// Define the measureTrack() method for the DspBenchmark class.
+// A load is timed from opening the file until the start can be played, as the loader thread does it. A seek is timed
+// from the prefetch a deck asks for before it jumps, through the wait for the read-ahead thread to do it, until the
+// first block after the jump has been read.
+juce::var DspBenchmark::measureTrack(const juce::String& name, bool allowMemoryMap) {
+	juce::AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+	juce::SharedResourcePointer<ReadAheadThread> readAheadThread;
+
+	TrackLoader::Request request;
+	request.url = juce::URL(settings.track);
+	request.blockSize = trackBlockSize;
+	request.sampleRate = trackSampleRate;
+	request.allowMemoryMap = allowMemoryMap;
+
+	// Read the whole file once, so that every load finds it in the page cache.
+	juce::MemoryBlock contents;
+	settings.track.loadFileAsData(contents);
+
+	double totalLoadMs = 0, worstLoadMs = 0;
+	std::unique_ptr<TrackSource> track;
+	for (auto load = 0; load < numTrackLoads; ++load) {
+		track = nullptr;
+		const double start = juce::Time::getMillisecondCounterHiRes();
+		track = TrackLoader::createTrack(request, formatManager, *readAheadThread);
+		if (track == nullptr || track->isMemoryMapped() != allowMemoryMap) {
+			juce::Logger::writeToLog(name.paddedRight(' ', 30) + "cannot be loaded this way");
+			return {};
+		}
+		track->prepareToPlay(trackBlockSize, trackSampleRate);
+		track->waitUntilReady(TrackLoader::startPrefetchSamples, TrackLoader::startTimeoutMs);
+		const double elapsed = juce::Time::getMillisecondCounterHiRes() - start;
+		totalLoadMs += elapsed;
+		worstLoadMs = juce::jmax(worstLoadMs, elapsed);
+	}
+
+	// Seek to the same random positions along every path.
+	juce::Random random(0x5eed);
+	juce::AudioBuffer<float> block(2, trackBlockSize);
+	double totalSeekMs = 0, worstSeekMs = 0;
+	for (auto seek = 0; seek < numTrackSeeks; ++seek) {
+		const juce::int64 position = static_cast<juce::int64>(random.nextDouble() * static_cast<double>(juce::jmax<juce::int64>(0, track->getTotalLength() - trackBlockSize)));
+		const double start = juce::Time::getMillisecondCounterHiRes();
+		if (!track->prefetch(position, trackPrefetchSamples)) {
+			while (!track->isPrefetched(position, trackPrefetchSamples) && juce::Time::getMillisecondCounterHiRes() - start < trackSeekTimeoutMs) {
+				juce::Thread::sleep(1);
+			}
+		}
+		track->setNextReadPosition(position);
+		track->waitUntilReady(trackBlockSize, trackSeekTimeoutMs);
+		track->getNextAudioBlock(juce::AudioSourceChannelInfo(&block, 0, trackBlockSize));
+		const double elapsed = juce::Time::getMillisecondCounterHiRes() - start;
+		totalSeekMs += elapsed;
+		worstSeekMs = juce::jmax(worstSeekMs, elapsed);
+	}
+	track->releaseResources();
+
+	juce::Logger::writeToLog(name.paddedRight(' ', 30) + "load " + juce::String(totalLoadMs / numTrackLoads, 3) + " ms (worst "
+		+ juce::String(worstLoadMs, 3) + "), seek " + juce::String(totalSeekMs / numTrackSeeks, 3) + " ms (worst " + juce::String(worstSeekMs, 3) + ")");
+
+	auto* result = new juce::DynamicObject();
+	result->setProperty("path", name);
+	result->setProperty("loadMeanMs", totalLoadMs / numTrackLoads);
+	result->setProperty("loadWorstMs", worstLoadMs);
+	result->setProperty("seekMeanMs", totalSeekMs / numTrackSeeks);
+	result->setProperty("seekWorstMs", worstSeekMs);
+	return juce::var(result);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// DspBenchmark measures how long each stage of the deck signal chain takes, in nanoseconds per stereo sample frame,
+// at every block size from 32 to 4096 samples and at 44.1, 48 and 96 kHz, and writes the results to a JSON file so
+// that runs before and after a change can be compared.
+// The stages are the polyphase resampler at each quality with juce::ResamplingAudioSource for reference, the key-lock
+// stretcher across its range of tempo ratios, each biquad of the DeckFilter alone and all together with the juce::IIRFilter chain they replaced for
+// reference, the level meter, the MixBus with juce::MixerAudioSource for reference at 2, 4 and 8 inputs, and the
+// offline helpers of DJAudioPlayer. Every stage is fed the same white noise; the time of every stage includes copying
+// fresh noise into its buffer, which the "copy" stage measures alone.
+// Each result is the fastest of several rounds, after a warm-up long enough for the smoothed settings to settle.
+// The stretcher results also give the share of the audio callback one deck would take, for four decks sharing
+// callbacks of 128 samples.
+// Given a track, it also times loading it and seeking in it through a memory map and through the read-ahead stream.
+// The file is read once before that, so both paths are timed from the page cache and the disk itself is left out.
+class DspBenchmark : public juce::Thread {
+public:
+
+	// What to measure and where to write it.
+	struct Settings {
+		juce::File output;
+		// Only the stages whose names contain this are measured, or all of them when it is empty.
+		juce::String stageFilter;
+		// A local audio file whose load and seek times are measured, or none.
+		juce::File track;
+	};
+
+	// Constructor for the DspBenchmark class.
+	// Parameters:
+	// - settings: The output file and the stages to measure.
+	// - onFinished: Called on the benchmark thread when it is over, with whether the results were written.
+	DspBenchmark(const Settings& settings, std::function<void(bool)> onFinished);
+
+	// Destructor that stops the benchmark.
+	~DspBenchmark() override;
+
+	// Method that measures every stage and writes the results, on the benchmark thread.
+	void run() override;
+
+	// Block sizes and sample rates measured.
+	static constexpr int blockSizes[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+	static constexpr double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+
+	// Number of rounds of each measurement and the length of a round, in seconds.
+	static constexpr int numRounds = 5;
+	static constexpr double roundSeconds = 0.01;
+
+	// Length of audio processed before measuring, in seconds.
+	static constexpr double warmupSeconds = 0.2;
+
+	// Speed at which the resamplers are measured, the edge of the speed slider's range.
+	static constexpr double speedRatio = 1.08;
+
+	// Tempo ratios at which the stretcher is measured, across the range it accepts.
+	static constexpr double stretchRatios[] = { 0.5, 0.75, 1.0, 1.5, 2.0 };
+
+	// Number of decks and callback length, in samples, against which the share of the callback taken by a deck's
+	// stretcher is given.
+	static constexpr int budgetDecks = 4;
+	static constexpr int budgetBlockSize = 128;
+
+	// Number of times the track is loaded, and of seeks timed in it, for each path.
+	static constexpr int numTrackLoads = 5;
+	static constexpr int numTrackSeeks = 50;
+
+private:
+
+	// A stage of the chain: how to set it up for a sample rate and block size, and how to process a block with it.
+	struct Stage {
+		juce::String name;
+		std::function<void(double sampleRate, int blockSize)> prepare;
+		std::function<void(juce::AudioBuffer<float>& buffer, int numSamples)> process;
+	};
+
+	// Method to measure a stage.
+	// Parameters:
+	// - stage: The stage to measure.
+	// - sampleRate: The sample rate to prepare it for.
+	// - blockSize: The length of the blocks it processes.
+	// Returns:
+	// - The time taken per sample frame in nanoseconds.
+	double measure(const Stage& stage, double sampleRate, int blockSize);
+
+	// Method to time loading the track and seeking in it along one path, as a deck does.
+	// Parameters:
+	// - name: The name of the path in the results.
+	// - allowMemoryMap: true to load the track through a memory map, false through the read-ahead stream.
+	// Returns:
+	// - An object with the mean and worst load and seek times in milliseconds, or a void var if the track could not be
+	//   loaded along this path.
+	juce::var measureTrack(const juce::String& name, bool allowMemoryMap);
+
+	Settings settings;
+	std::function<void(bool)> onFinished;
+};
@@ -0,0 +1,67 @@
+#include "KWeighting.h"
+
+
+// Define the prepare() method for the KWeighting class.
+// The analogue prototypes from BS.1770 are re-derived with the bilinear transform so the filter is correct at any sample rate, not just 48 kHz.
+void KWeighting::prepare(double sampleRate) {
+	const double pi = juce::MathConstants<double>::pi;
+
+	// Stage 1: high shelf, +4 dB above roughly 1.7 kHz.
+	{
+		const double f0 = 1681.974450955533;
+		const double gainDb = 3.999843853973347;
+		const double q = 0.7071752369554196;
+
+		const double k = std::tan(pi * f0 / sampleRate);
+		const double vh = std::pow(10.0, gainDb / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+
+		shelf = makeStage((vh + vb * k / q + k * k) / a0,
+			2.0 * (k * k - vh) / a0,
+			(vh - vb * k / q + k * k) / a0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0);
+	}
+
+	// Stage 2: second-order high-pass at roughly 38 Hz.
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+
+		const double k = std::tan(pi * f0 / sampleRate);
+		const double a0 = 1.0 + k / q + k * k;
+
+		highPass = makeStage(1.0, -2.0, 1.0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0);
+	}
+
+	reset();
+}
+
+
+// Define the reset() method for the KWeighting class, which clears the filter state.
+void KWeighting::reset() {
+	shelfState1 = shelfState2 = StereoVec::splat(0);
+	highPassState1 = highPassState2 = StereoVec::splat(0);
+}
+
+
+// Define the toLufs() method for the KWeighting class, using the -0.691 dB offset from BS.1770.
+float KWeighting::toLufs(double meanSquare) {
+	if (meanSquare <= 0.0) {
+		return -100.0f;
+	}
+	return static_cast<float>(-0.691 + 10.0 * std::log10(meanSquare));
+}
+
+
+// Define the makeStage() method for the KWeighting class.
+KWeighting::Stage KWeighting::makeStage(double b0, double b1, double b2, double a1, double a2) {
+	return { StereoVec::splat(static_cast<float>(b0)),
+		StereoVec::splat(static_cast<float>(b1)),
+		StereoVec::splat(static_cast<float>(b2)),
+		StereoVec::splat(static_cast<float>(a1)),
+		StereoVec::splat(static_cast<float>(a2)) };
+}
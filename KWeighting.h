@@ -0,0 +1,64 @@
+#pragma once
+#include <JuceHeader.h>
+#include "StereoVec.h"
+
+
+// KWeighting is the two-stage pre-filter from ITU-R BS.1770 (a high shelf followed by a
+// high-pass) that turns a signal into the weighted signal loudness is measured on.
+// It filters a left/right pair per call so that it can sit inside the per-sample loops of the
+// meters and analysers without a separate pass over the audio.
+class KWeighting {
+public:
+
+	// Method to compute the filter coefficients for a sample rate and clear the state.
+	// Parameters:
+	// - sampleRate: The sample rate of the signal to be weighted.
+	void prepare(double sampleRate);
+
+	// Method to clear the filter state.
+	void reset();
+
+	// Method to weight one stereo frame.
+	// Parameters:
+	// - x: The left/right input pair.
+	// Returns:
+	// - The weighted left/right pair.
+	inline StereoVec::Type process(StereoVec::Type x) {
+		using namespace StereoVec;
+
+		const Type y1 = add(mul(shelf.b0, x), shelfState1);
+		shelfState1 = add(sub(mul(shelf.b1, x), mul(shelf.a1, y1)), shelfState2);
+		shelfState2 = sub(mul(shelf.b2, x), mul(shelf.a2, y1));
+
+		const Type y2 = add(mul(highPass.b0, y1), highPassState1);
+		highPassState1 = add(sub(mul(highPass.b1, y1), mul(highPass.a1, y2)), highPassState2);
+		highPassState2 = sub(mul(highPass.b2, y1), mul(highPass.a2, y2));
+
+		return y2;
+	}
+
+	// Method to convert a mean-square value of the weighted signal, summed over channels, into LUFS.
+	// Parameters:
+	// - meanSquare: The channel-summed mean square of the weighted signal.
+	static float toLufs(double meanSquare);
+
+private:
+
+	// Coefficients of one biquad stage, already broadcast into both lanes.
+	struct Stage {
+		StereoVec::Type b0, b1, b2, a1, a2;
+	};
+
+	// Method to broadcast a set of coefficients into a stage.
+	static Stage makeStage(double b0, double b1, double b2, double a1, double a2);
+
+	// The high-shelf stage modelling the acoustic effect of the head.
+	Stage shelf = makeStage(1, 0, 0, 0, 0);
+
+	// The high-pass stage (RLB weighting curve).
+	Stage highPass = makeStage(1, 0, 0, 0, 0);
+
+	// Transposed direct form II state of both stages, for both channels.
+	StereoVec::Type shelfState1 = StereoVec::splat(0), shelfState2 = StereoVec::splat(0);
+	StereoVec::Type highPassState1 = StereoVec::splat(0), highPassState2 = StereoVec::splat(0);
+};
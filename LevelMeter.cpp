@@ -0,0 +1,182 @@
+#include "LevelMeter.h"
+
+
+LevelMeter::LevelMeter()
+{
+	publish(Snapshot());
+}
+
+
+// Define the prepare() method for the LevelMeter class, which resets every reading for a new sample rate.
+void LevelMeter::prepare(double sampleRate) {
+	thisSampleRate = sampleRate;
+	kWeighting.prepare(sampleRate);
+
+	meanSquare[0] = meanSquare[1] = 0;
+	peak[0] = peak[1] = 0;
+	peakHold = 0;
+	peakHoldSamplesLeft = 0;
+
+	std::fill(std::begin(loudnessBins), std::end(loudnessBins), 0.0);
+	loudnessBinIndex = 0;
+	numFilledBins = 0;
+	currentBinEnergy = 0;
+	currentBinSamples = 0;
+	samplesPerBin = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+
+	publish(Snapshot());
+}
+
+
+// Define the process() method for the LevelMeter class.
+// Peak, plain energy and K-weighted energy of both channels are gathered in the same loop over the block,
+// with the two channels side by side in one SIMD register.
+void LevelMeter::process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+	if (numSamples <= 0 || buffer.getNumChannels() == 0) {
+		return;
+	}
+
+	if (resetRequested.exchange(false)) {
+		peakHold = 0;
+		peakHoldSamplesLeft = 0;
+		clipCount = 0;
+	}
+
+	using namespace StereoVec;
+
+	const bool isMono = buffer.getNumChannels() == 1;
+	const float* left = buffer.getReadPointer(0, startSample);
+	const float* right = isMono ? left : buffer.getReadPointer(1, startSample);
+
+	// A mono signal is run through both lanes, so its weighted energy is halved to count the channel only once.
+	const double weightedScale = isMono ? 0.5 : 1.0;
+
+	Type blockPeak = splat(0);
+	Type blockEnergy = splat(0);
+	float pair[2];
+
+	auto done = 0;
+	while (done < numSamples) {
+		// Stop at the end of the current 100 ms loudness bin so that every bin holds exactly its own samples.
+		const int sectionLength = juce::jmin(numSamples - done, samplesPerBin - currentBinSamples);
+		Type sectionWeighted = splat(0);
+
+		for (auto i = done; i < done + sectionLength; ++i) {
+			const Type x = loadPair(left[i], right[i]);
+			blockPeak = max(blockPeak, abs(x));
+			blockEnergy = add(blockEnergy, mul(x, x));
+
+			const Type z = kWeighting.process(x);
+			sectionWeighted = add(sectionWeighted, mul(z, z));
+		}
+
+		storePair(sectionWeighted, pair);
+		currentBinEnergy += (static_cast<double>(pair[0]) + pair[1]) * weightedScale;
+		currentBinSamples += sectionLength;
+		done += sectionLength;
+
+		if (currentBinSamples >= samplesPerBin) {
+			loudnessBins[loudnessBinIndex] = currentBinEnergy / currentBinSamples;
+			loudnessBinIndex = (loudnessBinIndex + 1) % numLoudnessBins;
+			numFilledBins = juce::jmin(numFilledBins + 1, numLoudnessBins);
+			currentBinEnergy = 0;
+			currentBinSamples = 0;
+		}
+	}
+
+	// Peak with a fixed fall-back rate, so short transients stay visible at GUI refresh rates.
+	const float fallback = static_cast<float>(std::pow(10.0, -peakFallbackDbPerSecond * numSamples / thisSampleRate / 20.0));
+	float peaks[2];
+	storePair(blockPeak, peaks);
+	peak[0] = juce::jmax(peaks[0], peak[0] * fallback);
+	peak[1] = juce::jmax(peaks[1], peak[1] * fallback);
+
+	// Exponentially averaged mean square, so the RMS reading does not depend on the block size.
+	const double alpha = 1.0 - std::exp(-numSamples / (rmsTimeSeconds * thisSampleRate));
+	float energies[2];
+	storePair(blockEnergy, energies);
+	meanSquare[0] += alpha * (energies[0] / numSamples - meanSquare[0]);
+	meanSquare[1] += alpha * (energies[1] / numSamples - meanSquare[1]);
+
+	// Peak hold and clip counter work on the louder channel.
+	const float blockMax = juce::jmax(peaks[0], peaks[1]);
+	if (blockMax >= peakHold || peakHoldSamplesLeft <= 0) {
+		peakHold = blockMax;
+		peakHoldSamplesLeft = juce::roundToInt(peakHoldTimeSeconds * thisSampleRate);
+	}
+	else {
+		peakHoldSamplesLeft -= numSamples;
+	}
+
+	if (blockMax >= clipLevel) {
+		++clipCount;
+	}
+
+	// Short-term loudness over the finished bins of the last 3 seconds.
+	double shortTermEnergy = 0;
+	for (auto i = 0; i < numFilledBins; ++i) {
+		shortTermEnergy += loudnessBins[i];
+	}
+
+	Snapshot snapshot;
+	for (auto channel = 0; channel < 2; ++channel) {
+		snapshot.peakDb[channel] = juce::Decibels::gainToDecibels(peak[channel], minusInfinityDb);
+		snapshot.rmsDb[channel] = juce::Decibels::gainToDecibels(static_cast<float>(std::sqrt(meanSquare[channel])), minusInfinityDb);
+	}
+	snapshot.peakHoldDb = juce::Decibels::gainToDecibels(peakHold, minusInfinityDb);
+	snapshot.shortTermLufs = numFilledBins > 0 ? juce::jmax(minusInfinityDb, KWeighting::toLufs(shortTermEnergy / numFilledBins)) : minusInfinityDb;
+	snapshot.clipCount = clipCount;
+
+	publish(snapshot);
+}
+
+
+// Define the getSnapshot() method for the LevelMeter class.
+// Retries if the audio thread published a new block while the values were being copied.
+LevelMeter::Snapshot LevelMeter::getSnapshot() const {
+	Snapshot snapshot;
+
+	for (;;) {
+		const auto before = sequence.load(std::memory_order_acquire);
+		if ((before & 1) != 0) {
+			continue;
+		}
+
+		for (auto channel = 0; channel < 2; ++channel) {
+			snapshot.peakDb[channel] = publishedPeakDb[channel].load(std::memory_order_relaxed);
+			snapshot.rmsDb[channel] = publishedRmsDb[channel].load(std::memory_order_relaxed);
+		}
+		snapshot.peakHoldDb = publishedPeakHoldDb.load(std::memory_order_relaxed);
+		snapshot.shortTermLufs = publishedShortTermLufs.load(std::memory_order_relaxed);
+		snapshot.clipCount = publishedClipCount.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) == before) {
+			return snapshot;
+		}
+	}
+}
+
+
+// Define the resetPeakHold() method for the LevelMeter class.
+void LevelMeter::resetPeakHold() {
+	resetRequested = true;
+}
+
+
+// Define the publish() method for the LevelMeter class, which writes a snapshot between two sequence increments.
+void LevelMeter::publish(const Snapshot& snapshot) {
+	const auto current = sequence.load(std::memory_order_relaxed);
+	sequence.store(current + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (auto channel = 0; channel < 2; ++channel) {
+		publishedPeakDb[channel].store(snapshot.peakDb[channel], std::memory_order_relaxed);
+		publishedRmsDb[channel].store(snapshot.rmsDb[channel], std::memory_order_relaxed);
+	}
+	publishedPeakHoldDb.store(snapshot.peakHoldDb, std::memory_order_relaxed);
+	publishedShortTermLufs.store(snapshot.shortTermLufs, std::memory_order_relaxed);
+	publishedClipCount.store(snapshot.clipCount, std::memory_order_relaxed);
+
+	sequence.store(current + 2, std::memory_order_release);
+}
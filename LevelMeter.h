@@ -0,0 +1,108 @@
+#pragma once
+#include <JuceHeader.h>
+#include "KWeighting.h"
+
+
+// LevelMeter measures peak, RMS and EBU short-term loudness of a stereo signal in a single pass
+// on the audio thread, and publishes the results as a snapshot that the GUI can read at any rate.
+// The snapshot is guarded by a sequence counter, so the audio thread never waits for a reader and
+// a reader never sees values from two different blocks.
+class LevelMeter {
+public:
+
+	// A consistent set of meter readings. Levels are in dBFS, loudness in LUFS.
+	struct Snapshot {
+		float peakDb[2] = { minusInfinityDb, minusInfinityDb };
+		float rmsDb[2] = { minusInfinityDb, minusInfinityDb };
+		float peakHoldDb = minusInfinityDb;
+		float shortTermLufs = minusInfinityDb;
+		int clipCount = 0;
+	};
+
+	// Level reported for silence.
+	static constexpr float minusInfinityDb = -100.0f;
+
+	// Constructor for the LevelMeter class.
+	LevelMeter();
+
+	// Method to prepare the meter for a sample rate and clear all readings.
+	// Parameters:
+	// - sampleRate: The sample rate of the metered signal.
+	void prepare(double sampleRate);
+
+	// Method to measure a section of a buffer and publish new readings. Call from the audio thread only.
+	// Mono buffers are metered on the left channel and mirrored to the right.
+	// Parameters:
+	// - buffer: The buffer holding the audio to measure.
+	// - startSample: The first sample to measure.
+	// - numSamples: The number of samples to measure.
+	void process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+	// Method to read the latest readings. Safe to call from any thread.
+	Snapshot getSnapshot() const;
+
+	// Method to ask the audio thread to clear the peak hold and the clip counter. Safe to call from any thread.
+	void resetPeakHold();
+
+private:
+
+	// Method to write a snapshot using the sequence counter.
+	void publish(const Snapshot& snapshot);
+
+	// Number of 100 ms loudness bins that make up the 3 s short-term window.
+	static constexpr int numLoudnessBins = 30;
+
+	// Integration time of the RMS reading, in seconds.
+	static constexpr double rmsTimeSeconds = 0.3;
+
+	// Time the peak hold stays put before falling back to the current peak, in seconds.
+	static constexpr double peakHoldTimeSeconds = 2.0;
+
+	// Rate at which the displayed peak falls back, in dB per second.
+	static constexpr double peakFallbackDbPerSecond = 20.0;
+
+	// Sample level at or above which a block counts as clipped.
+	static constexpr float clipLevel = 0.999f;
+
+	// K-weighting filter for the loudness measurement.
+	KWeighting kWeighting;
+
+	// Sample rate of the metered signal.
+	double thisSampleRate = 44100.0;
+
+	// Running mean square of both channels, smoothed over rmsTimeSeconds.
+	double meanSquare[2] = { 0, 0 };
+
+	// Displayed peak of both channels as linear gain, with fall-back applied.
+	float peak[2] = { 0, 0 };
+
+	// Held peak as linear gain and the number of samples it has left to hold.
+	float peakHold = 0;
+	int peakHoldSamplesLeft = 0;
+
+	// Number of blocks that contained a clipped sample.
+	int clipCount = 0;
+
+	// Weighted energy of the finished 100 ms bins, used as a ring buffer.
+	double loudnessBins[numLoudnessBins] = {};
+	int loudnessBinIndex = 0;
+	int numFilledBins = 0;
+
+	// Weighted energy and sample count of the bin currently being filled.
+	double currentBinEnergy = 0;
+	int currentBinSamples = 0;
+	int samplesPerBin = 4410;
+
+	// Readings published to the GUI, one atomic per value so that reads never tear.
+	std::atomic<float> publishedPeakDb[2];
+	std::atomic<float> publishedRmsDb[2];
+	std::atomic<float> publishedPeakHoldDb;
+	std::atomic<float> publishedShortTermLufs;
+	std::atomic<int> publishedClipCount;
+
+	// Sequence counter of the published readings: odd while the audio thread is writing.
+	std::atomic<juce::uint32> sequence{ 0 };
+
+	// Flag raised by resetPeakHold() and consumed by the audio thread.
+	std::atomic<bool> resetRequested{ false };
+};
@@ -0,0 +1,75 @@
+#include "LevelMeterDisplay.h"
+
+
+LevelMeterDisplay::LevelMeterDisplay(LevelMeter& meterToShow, juce::Colour _colour)
+	: meter(meterToShow), theme(_colour)
+{
+	// Refresh at roughly the same rate as the deck GUIs.
+	startTimerHz(30);
+}
+
+LevelMeterDisplay::~LevelMeterDisplay()
+{
+	stopTimer();
+}
+
+void LevelMeterDisplay::paint(juce::Graphics& g)
+{
+	// Dark background matching the rest of the decks.
+	g.fillAll(juce::Colour::fromRGBA(25, 25, 25, 255));
+
+	// Leave room on the right for the loudness readout and the clip indicator.
+	auto area = getLocalBounds().reduced(2);
+	auto textArea = area.removeFromRight(70);
+	auto clipArea = area.removeFromRight(10);
+	const float barWidth = (float)area.getWidth();
+	const float barHeight = area.getHeight() / 2.0f - 1;
+
+	// One bar per channel: RMS drawn solid, peak drawn as a lighter extension.
+	for (auto channel = 0; channel < 2; ++channel) {
+		const float y = area.getY() + channel * (barHeight + 2);
+
+		g.setColour(theme.withAlpha(0.4f));
+		g.fillRect((float)area.getX(), y, levelToWidth(shown.peakDb[channel], barWidth), barHeight);
+
+		g.setColour(theme);
+		g.fillRect((float)area.getX(), y, levelToWidth(shown.rmsDb[channel], barWidth), barHeight);
+	}
+
+	// Peak-hold marker across both bars.
+	if (shown.peakHoldDb > floorDb) {
+		g.setColour(juce::Colours::white);
+		g.fillRect(area.getX() + levelToWidth(shown.peakHoldDb, barWidth) - 1, (float)area.getY(), 2.0f, (float)area.getHeight());
+	}
+
+	// Clip indicator stays lit until the display is clicked.
+	g.setColour(shown.clipCount > 0 ? juce::Colours::red : juce::Colour::fromRGBA(60, 60, 60, 255));
+	g.fillRect(clipArea.reduced(2));
+
+	// Short-term loudness readout.
+	g.setColour(juce::Colours::white);
+	g.setFont(11.0f);
+	const juce::String lufs = shown.shortTermLufs > LevelMeter::minusInfinityDb ? juce::String(shown.shortTermLufs, 1) : juce::String("-inf");
+	g.drawText(lufs + " LUFS", textArea, juce::Justification::centredRight, false);
+}
+
+void LevelMeterDisplay::mouseDown(const juce::MouseEvent& e)
+{
+	// Clear the peak hold and clip counter on the audio thread's next block.
+	meter.resetPeakHold();
+}
+
+void LevelMeterDisplay::timerCallback()
+{
+	// Only repaint when one of the readings actually moved.
+	const auto snapshot = meter.getSnapshot();
+	if (std::memcmp(&snapshot, &shown, sizeof(snapshot)) != 0) {
+		shown = snapshot;
+		repaint();
+	}
+}
+
+float LevelMeterDisplay::levelToWidth(float levelDb, float width) const
+{
+	return juce::jmap(juce::jlimit(floorDb, 0.0f, levelDb), floorDb, 0.0f, 0.0f, width);
+}
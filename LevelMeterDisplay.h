@@ -0,0 +1,45 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LevelMeter.h"
+
+// The LevelMeterDisplay class draws the readings of a LevelMeter as two horizontal bars (left and right),
+// with a peak-hold marker, a clip indicator and the short-term loudness in LUFS.
+// It polls the meter's snapshot on its own timer, so it never touches the audio thread.
+class LevelMeterDisplay : public juce::Component,
+	public juce::Timer
+{
+public:
+	// Constructor takes the meter to display and the colour of the bars.
+	LevelMeterDisplay(LevelMeter& meterToShow, juce::Colour _colour);
+
+	// Destructor stops the refresh timer.
+	~LevelMeterDisplay() override;
+
+private:
+	// Paints the bars, the peak-hold marker, the clip indicator and the loudness readout.
+	void paint(juce::Graphics& g) override;
+
+	// Clicking the display clears the peak hold and the clip counter.
+	void mouseDown(const juce::MouseEvent& e) override;
+
+	// Fetches a new snapshot and repaints when it changed.
+	void timerCallback() override;
+
+	// Maps a level in dB onto a position along the bar.
+	float levelToWidth(float levelDb, float width) const;
+
+	// The meter whose readings are shown.
+	LevelMeter& meter;
+
+	// The readings currently on screen.
+	LevelMeter::Snapshot shown;
+
+	// Colour of the level bars.
+	juce::Colour theme;
+
+	// Lowest level shown on the bars, in dB.
+	static constexpr float floorDb = -60.0f;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LevelMeterDisplay)
+};
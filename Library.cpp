@@ -41,6 +41,11 @@ Library::Library(juce::AudioFormatManager& _formatManager) : formatManager(_form
 				for (auto j = 0; j < newValueTree.getChild(i).getNumChildren(); ++j) {
 					auto song = newValueTree.getChild(i).getChild(j);
 					track refSong{ song.getProperty("title"), song.getProperty("length") , song.getProperty("url") , song.getProperty("identity") };
+					refSong.bpm = song.getProperty("bpm", 0.0);
+					refSong.downbeatSeconds = song.getProperty("downbeat", -1.0);
+					refSong.key = song.getProperty("key", -1);
+					refSong.lufs = song.getProperty("lufs", 0.0);
+					refSong.gainDb = song.getProperty("gain", 0.0);
 					folder.second.push_back(refSong);
 				}
 				trackFolders.push_back(folder);
@@ -149,6 +154,7 @@ Library::Library(juce::AudioFormatManager& _formatManager) : formatManager(_form
 							// `trackFolders` is presumably a vector of pairs, where the first element is the folder name and the second element is a vector of `track` objects.
 							// Here, `selectedFolderIndex` is used to access the correct folder's tracks.
 							playlist.setTrackTitles(trackFolders[selectedFolderIndex].second);
+							analyseNewTracks();
 
 							// Update the content of the directory component. This might refresh the UI to reflect changes, such as displaying the contents of the selected folder.
 							// `directoryComponent` is likely a UI component responsible for showing directory or folder contents.
@@ -206,6 +212,11 @@ Library::~Library()
 			song.setProperty("length", trackFolders[i].second[j].lengthInSeconds, nullptr);
 			song.setProperty("url", trackFolders[i].second[j].url.toString(false), nullptr);
 			song.setProperty("identity", trackFolders[i].second[j].identity, nullptr);
+			song.setProperty("bpm", trackFolders[i].second[j].bpm, nullptr);
+			song.setProperty("downbeat", trackFolders[i].second[j].downbeatSeconds, nullptr);
+			song.setProperty("key", trackFolders[i].second[j].key, nullptr);
+			song.setProperty("lufs", trackFolders[i].second[j].lufs, nullptr);
+			song.setProperty("gain", trackFolders[i].second[j].gainDb, nullptr);
 
 			// Add the track (song) as a child of the folder (folder).
 			folder.addChild(song, j, nullptr);
@@ -249,6 +260,74 @@ bool Library::selectionIsValid() {
 	return selectedFolderIndex >= 0 && selectedFolderIndex < trackFolders.size() && playlist.trackIsSelected();
 }
 
+// Define the analyseNewTracks() method for the Library class.
+// Tracks are queued once per session; a track that could not be analysed is tried again the next time the library opens.
+// Tempo, key and loudness come from the same pass, so a track missing any of them is analysed in full.
+void Library::analyseNewTracks() {
+	for (const auto& folder : trackFolders) {
+		for (const auto& song : folder.second) {
+			if ((song.bpm <= 0 || song.key < 0 || song.lufs >= 0) && !queuedForAnalysis.contains(song.identity)) {
+				queuedForAnalysis.add(song.identity);
+				analyser.analyse(song);
+			}
+		}
+	}
+}
+
+
+// Define the analysisFinished() method for the Library class.
+// The same file can be in several folders under the same identity, so every copy is updated, and the listeners are
+// told once, so that a deck that loaded the track before its analysis finished can pick up the result.
+void Library::analysisFinished(const TrackAnalyser::Result& result) {
+	if (result.bpm <= 0 && result.key < 0 && result.lufs >= 0) {
+		DBG("Library could not analyse track " << result.identity);
+		return;
+	}
+
+	for (auto& folder : trackFolders) {
+		for (auto& song : folder.second) {
+			if (song.identity == result.identity) {
+				if (result.bpm > 0) {
+					song.bpm = result.bpm;
+					song.downbeatSeconds = result.downbeatSeconds;
+				}
+				if (result.key >= 0) {
+					song.key = result.key;
+				}
+				if (result.lufs < 0) {
+					song.lufs = result.lufs;
+					song.gainDb = result.gainDb;
+				}
+			}
+		}
+	}
+
+	if (selectedFolderIndex >= 0 && selectedFolderIndex < trackFolders.size()) {
+		playlist.refresh();
+	}
+
+	for (const auto& folder : trackFolders) {
+		for (const auto& song : folder.second) {
+			if (song.identity == result.identity) {
+				listeners.call([&song](Listener& l) { l.trackAnalysed(song); });
+				return;
+			}
+		}
+	}
+}
+
+
+// Define the addListener() method for the Library class.
+void Library::addListener(Listener* listener) {
+	listeners.add(listener);
+}
+
+
+// Define the removeListener() method for the Library class.
+void Library::removeListener(Listener* listener) {
+	listeners.remove(listener);
+}
+
 // Function to retrieve the currently selected track from the playlist.
 track Library::getSelectedTrack() {
 	// Calls the playlist's getSelectedTrack() method to get the currently selected track.
@@ -479,6 +558,7 @@ void Library::filesDropped(const juce::StringArray& files, int x, int y) {
 		// The second element of the pair contains the track titles for that folder.
 		playlist.setTrackTitles(trackFolders[selectedFolderIndex].second);
 	}
+	analyseNewTracks();
 
 	directoryComponent.updateContent();
 	directoryComponent.selectRow(selectedFolderIndex, true);
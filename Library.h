@@ -3,6 +3,7 @@
 #include <JuceHeader.h>
 #include "CustomLookAndFeel.h"
 #include "PlaylistComponent.h"
+#include "TrackAnalyser.h"
 #include <juce_gui_basics/juce_gui_basics.h>
 
 // The Library class provides functionality for managing a collection of audio tracks,
@@ -10,9 +11,23 @@
 
 class Library : public juce::Component,
     public juce::TableListBoxModel,
-    public juce::FileDragAndDropTarget
+    public juce::FileDragAndDropTarget,
+    private TrackAnalyser::Listener
 {
 public:
+    // Interface of the objects told when the analysis of a track has finished, called on the message thread.
+    class Listener {
+    public:
+        virtual ~Listener() = default;
+
+        // Method called with a track once its tempo, beat grid, key or loudness has been stored in the library.
+        virtual void trackAnalysed(const track& song) = 0;
+    };
+
+    // Methods to register and unregister a Listener.
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+
     // Constructor: Initializes the Library with a reference to an AudioFormatManager.
     // The AudioFormatManager is used to handle different audio formats when loading tracks.
     Library(juce::AudioFormatManager& _formatManager);
@@ -32,6 +47,11 @@ public:
     // This might involve removing a track or folder from the internal data structures.
     void deleteItem();
 
+    // Queues every track that has not been fully analysed yet for analysis in the background.
+    // The library does not start this itself when it opens, as the formats of the AudioFormatManager it was given may
+    // not be registered yet; its owner calls it once they are.
+    void analyseNewTracks();
+
 private:
     // File chooser to handle file selection dialogs.
     std::unique_ptr<juce::FileChooser> fChooser;
@@ -94,6 +114,18 @@ private:
     // Path to the file where library data is saved.
     juce::String filePath{ "C:/Otodecks/AppData/Library/Data/Resource.xml" };
 
+    // Stores the tempo, beat grid, key and loudness of an analysed track in every folder that holds it.
+    void analysisFinished(const TrackAnalyser::Result& result) override;
+
+    // Identities of the tracks queued for analysis since the library was opened.
+    juce::StringArray queuedForAnalysis;
+
+    // Objects told when a track has been analysed.
+    juce::ListenerList<Listener> listeners;
+
+    // Finds the tempo and beat grid of tracks on background threads. Declared last so that its jobs stop first.
+    TrackAnalyser analyser{ formatManager, *this };
+
     // Macro to ensure that the Library class is non-copyable and to detect memory leaks.
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Library)
 };
@@ -0,0 +1,418 @@
+#include "LoopEngine.h"
+
+
+LoopEngine::LoopEngine()
+{
+}
+
+
+LoopEngine::~LoopEngine()
+{
+	stopTimer();
+	cancelCacheFill();
+	deleteRetiredRegions();
+
+	// The latest region is one of these two.
+	delete pendingRegion.exchange(nullptr);
+	delete currentRegion;
+}
+
+
+// Define the setLoop() method for the LoopEngine class.
+// The section is read on the read-ahead thread: from RAM or the memory map when the track has them, and otherwise
+// through the track's own section reader, so the stream the audio thread reads is never touched.
+bool LoopEngine::setLoop(TrackSource* track, juce::int64 start, juce::int64 end, bool roll) {
+	if (track == nullptr || track->getSampleRate() <= 0) {
+		return false;
+	}
+
+	start = juce::jmax<juce::int64>(0, start);
+	end = juce::jmin(track->getTotalLength(), end);
+	const juce::int64 length = end - start;
+	if (length < 2 || length > static_cast<juce::int64>(maxLoopSeconds * track->getSampleRate())) {
+		DBG("LoopEngine::setLoop loop should be between 2 samples and " << maxLoopSeconds << " seconds long");
+		return false;
+	}
+
+	// The crossfade is shortened for loops at the very start of the file and for very short loops.
+	const juce::int64 fadeLength = juce::jmin<juce::int64>(juce::roundToInt(wrapFadeSeconds * track->getSampleRate()), start, length / 2);
+
+	std::unique_ptr<Region> region(new Region());
+	region->track = track;
+	region->start = start;
+	region->end = end;
+	region->cacheStart = start - fadeLength;
+	region->roll = roll;
+
+	// The audio where the loop is left is read ahead of time, in case the loop is exited before the stream is there,
+	// and so is the audio at its start, where the track jumps back to until the cache has been read.
+	track->prefetch(end, landingPrefetchSamples);
+	track->prefetch(start, landingPrefetchSamples);
+
+	cancelCacheFill();
+	cacheFill.reset(new CacheFill(*track, region->cacheStart, static_cast<int>(end - region->cacheStart)));
+	fillRegion = std::move(region);
+
+	// A loop already playing from RAM carries on until the new one is ready; otherwise the new one plays from the track.
+	if (latestRegion == nullptr || latestRegion->cache == nullptr || !latestRegion->wraps) {
+		publishRegion(new Region(*fillRegion));
+	}
+
+	readAheadThread->addTimeSliceClient(cacheFill.get());
+	startTimer(fillPollIntervalMs);
+	return true;
+}
+
+
+// Define the CacheFill constructor for the LoopEngine class.
+LoopEngine::CacheFill::CacheFill(TrackSource& _track, juce::int64 _start, int length)
+	: track(_track), start(_start), cache(std::make_shared<juce::AudioBuffer<float>>(2, length))
+{
+}
+
+
+// Define the useTimeSlice() method for the CacheFill class, which leaves the thread once the cache is read.
+int LoopEngine::CacheFill::useTimeSlice() {
+	const int numSamples = juce::jmin(fillChunkSamples, cache->getNumSamples() - numRead);
+	if (!track.readSection(*cache, numRead, start + numRead, numSamples)) {
+		state.store(failed);
+		return -1;
+	}
+
+	numRead += numSamples;
+	if (numRead == cache->getNumSamples()) {
+		state.store(finished);
+		return -1;
+	}
+	return 0;
+}
+
+
+// Define the cancelCacheFill() method for the LoopEngine class.
+// Removing the client waits for the chunk being read, so the track is no longer used once this returns.
+void LoopEngine::cancelCacheFill() {
+	if (cacheFill != nullptr) {
+		readAheadThread->removeTimeSliceClient(cacheFill.get());
+		cacheFill.reset();
+	}
+	fillRegion.reset();
+}
+
+
+// Define the isReadingCache() method for the LoopEngine class.
+bool LoopEngine::isReadingCache() const {
+	return cacheFill != nullptr;
+}
+
+
+// Define the finishCacheFill() method for the LoopEngine class.
+void LoopEngine::finishCacheFill() {
+	const bool read = cacheFill->state.load() == CacheFill::finished;
+	std::shared_ptr<const juce::AudioBuffer<float>> cache = cacheFill->cache;
+	std::unique_ptr<Region> region(std::move(fillRegion));
+	cancelCacheFill();
+
+	if (!read) {
+		DBG("LoopEngine::finishCacheFill could not read the loop");
+		publishRegion(new Region());
+		return;
+	}
+
+	region->cache = cache;
+	publishRegion(region.release());
+}
+
+
+// Define the exitLoop() method for the LoopEngine class.
+// The region is kept, without wrapping, so that a playhead inside it plays on from RAM up to the loop end.
+void LoopEngine::exitLoop() {
+	cancelCacheFill();
+	if (latestRegion == nullptr || latestRegion->track == nullptr || !latestRegion->wraps) {
+		return;
+	}
+
+	auto* region = new Region(*latestRegion);
+	region->wraps = false;
+	region->roll = false;
+	publishRegion(region);
+}
+
+
+// Define the clear() method for the LoopEngine class.
+void LoopEngine::clear() {
+	cancelCacheFill();
+	if (latestRegion != nullptr && latestRegion->track != nullptr) {
+		publishRegion(new Region());
+	}
+}
+
+
+// Define the isLooping() method for the LoopEngine class.
+bool LoopEngine::isLooping() const {
+	const Region* region = getLatestLoop();
+	return region != nullptr && region->track != nullptr && region->wraps;
+}
+
+
+// Define the isRolling() method for the LoopEngine class.
+bool LoopEngine::isRolling() const {
+	return isLooping() && getLatestLoop()->roll;
+}
+
+
+// Define the getLoopStart() method for the LoopEngine class.
+juce::int64 LoopEngine::getLoopStart() const {
+	return isLooping() ? getLatestLoop()->start : -1;
+}
+
+
+// Define the getLoopEnd() method for the LoopEngine class.
+juce::int64 LoopEngine::getLoopEnd() const {
+	return isLooping() ? getLatestLoop()->end : -1;
+}
+
+
+// Define the getLatestLoop() method for the LoopEngine class.
+const LoopEngine::Region* LoopEngine::getLatestLoop() const {
+	return fillRegion != nullptr ? fillRegion.get() : latestRegion;
+}
+
+
+// Define the getPlayhead() method for the LoopEngine class.
+juce::int64 LoopEngine::getPlayhead() const {
+	return playhead.load();
+}
+
+
+// Define the getRollReturn() method for the LoopEngine class.
+juce::int64 LoopEngine::getRollReturn() const {
+	return rollPosition.load();
+}
+
+
+// Define the swapPendingRegion() method for the LoopEngine class.
+// A playhead inside the old region stays in RAM when the new one covers it, and is folded back into a shortened
+// loop; otherwise the track is moved to it.
+juce::int64 LoopEngine::swapPendingRegion(TrackSource& track) {
+	if (pendingRegion.load() == nullptr || retiredFifo.getFreeSpace() == 0) {
+		return -1;
+	}
+
+	if (currentRegion != nullptr) {
+		int start1, size1, start2, size2;
+		retiredFifo.prepareToWrite(1, start1, size1, start2, size2);
+		retiredRegions[size1 > 0 ? start1 : start2] = currentRegion;
+		retiredFifo.finishedWrite(1);
+	}
+	currentRegion = pendingRegion.exchange(nullptr);
+
+	const Region& region = *currentRegion;
+	const bool usable = region.track == &track;
+	juce::int64 position = playhead.load();
+
+	// A roll remembers where the track was, and counts on from there until it is released.
+	juce::int64 rollReturn = -1;
+	if (rollOrigin >= 0 && !(usable && region.roll)) {
+		rollReturn = rollOrigin + rollElapsed;
+		rollOrigin = -1;
+		rollPosition.store(-1);
+	}
+	else if (rollOrigin < 0 && usable && region.roll) {
+		rollOrigin = position >= 0 ? position : track.getNextReadPosition();
+		rollElapsed = 0;
+		rollPosition.store(rollOrigin);
+	}
+
+	if (position >= 0) {
+		if (usable && region.wraps && position >= region.end && position >= region.start) {
+			position = region.start + (position - region.start) % (region.end - region.start);
+		}
+
+		if (usable && region.cache != nullptr && position >= region.cacheStart && position < region.end) {
+			track.setNextReadPosition(region.end);
+		}
+		else {
+			track.setNextReadPosition(position);
+			position = -1;
+		}
+		playhead.store(position);
+	}
+	return rollReturn;
+}
+
+
+// Define the read() method for the LoopEngine class.
+// The block is read in parts: from the track up to the cached section, then from the cache up to the loop end,
+// wrapping to the loop start, or carrying on from the track once the loop has been exited. Until its cache is read,
+// a loop is played from the track, which is moved back to the loop start at the end, without the crossfade.
+void LoopEngine::read(TrackSource& track, const juce::AudioSourceChannelInfo& bufferToFill) {
+	const Region* region = currentRegion;
+	if (region == nullptr || region->track != &track || (region->cache == nullptr && !region->wraps)) {
+		track.getNextAudioBlock(bufferToFill);
+		return;
+	}
+
+	int done = 0;
+	while (done < bufferToFill.numSamples) {
+		const int remaining = bufferToFill.numSamples - done;
+		juce::AudioSourceChannelInfo part(bufferToFill.buffer, bufferToFill.startSample + done, remaining);
+		juce::int64 position = playhead.load();
+
+		if (region->cache == nullptr) {
+			const juce::int64 trackPosition = track.getNextReadPosition();
+			if (trackPosition < region->end) {
+				const juce::int64 stop = trackPosition < region->start ? region->start : region->end;
+				part.numSamples = static_cast<int>(juce::jmin<juce::int64>(remaining, stop - trackPosition));
+			}
+			track.getNextAudioBlock(part);
+
+			if (trackPosition < region->end && trackPosition + part.numSamples >= region->end) {
+				track.setNextReadPosition(region->start);
+			}
+		}
+		else if (position < 0) {
+			const juce::int64 trackPosition = track.getNextReadPosition();
+			if (trackPosition >= region->cacheStart && trackPosition < region->end) {
+				// Play on from RAM and leave the track waiting at the loop end.
+				playhead.store(trackPosition);
+				track.setNextReadPosition(region->end);
+				continue;
+			}
+
+			if (trackPosition < region->cacheStart) {
+				part.numSamples = static_cast<int>(juce::jmin<juce::int64>(remaining, region->cacheStart - trackPosition));
+			}
+			track.getNextAudioBlock(part);
+		}
+		else {
+			part.numSamples = static_cast<int>(juce::jmin<juce::int64>(remaining, region->end - position));
+			readCache(*region, position, part);
+
+			position += part.numSamples;
+			if (position >= region->end) {
+				position = region->wraps ? region->start : -1;
+			}
+			playhead.store(position);
+		}
+		done += part.numSamples;
+	}
+
+	if (rollOrigin >= 0) {
+		rollElapsed += bufferToFill.numSamples;
+		rollPosition.store(rollOrigin + rollElapsed);
+	}
+}
+
+
+// Define the readCache() method for the LoopEngine class.
+// Over the last fadeLength samples of a wrapping loop, the end fades out while the fadeLength samples before the
+// start fade in, so the audio arrives at the start already playing the sample before it.
+void LoopEngine::readCache(const Region& region, juce::int64 position, const juce::AudioSourceChannelInfo& bufferToFill) {
+	const auto& cache = *region.cache;
+	auto& buffer = *bufferToFill.buffer;
+	const int offset = static_cast<int>(position - region.cacheStart);
+	const int numChannels = juce::jmin(2, buffer.getNumChannels());
+
+	for (auto channel = 0; channel < numChannels; ++channel) {
+		buffer.copyFrom(channel, bufferToFill.startSample, cache, channel, offset, bufferToFill.numSamples);
+	}
+	for (auto channel = 2; channel < buffer.getNumChannels(); ++channel) {
+		buffer.clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+	}
+
+	const juce::int64 fadeLength = region.start - region.cacheStart;
+	const juce::int64 fadeStart = region.end - fadeLength;
+	if (!region.wraps || fadeLength == 0 || position + bufferToFill.numSamples <= fadeStart) {
+		return;
+	}
+
+	const juce::int64 first = juce::jmax(position, fadeStart);
+	const juce::int64 last = position + bufferToFill.numSamples;
+	for (auto channel = 0; channel < numChannels; ++channel) {
+		float* out = buffer.getWritePointer(channel, bufferToFill.startSample);
+		const float* preRoll = cache.getReadPointer(channel);
+		for (auto sample = first; sample < last; ++sample) {
+			const float gain = static_cast<float>(sample - fadeStart + 1) / static_cast<float>(fadeLength + 1);
+			float& value = out[sample - position];
+			value = value * (1.0f - gain) + preRoll[sample - fadeStart] * gain;
+		}
+	}
+}
+
+
+// Define the setPosition() method for the LoopEngine class.
+// A jump inside the cached section is served from RAM without moving the track at all.
+void LoopEngine::setPosition(TrackSource& track, juce::int64 position) {
+	const Region* region = currentRegion;
+	if (region != nullptr && region->cache != nullptr && region->track == &track
+		&& position >= region->cacheStart && position < region->end) {
+		if (playhead.load() < 0) {
+			track.setNextReadPosition(region->end);
+		}
+		playhead.store(position);
+		return;
+	}
+
+	playhead.store(-1);
+	track.setNextReadPosition(position);
+}
+
+
+// Define the trackChanged() method for the LoopEngine class.
+void LoopEngine::trackChanged() {
+	playhead.store(-1);
+	rollOrigin = -1;
+	rollPosition.store(-1);
+}
+
+
+// Define the publishRegion() method for the LoopEngine class.
+void LoopEngine::publishRegion(Region* newRegion) {
+	latestRegion = newRegion;
+
+	// A region that was handed over but never picked up was not seen by the audio thread, so it can go straight away.
+	delete pendingRegion.exchange(newRegion);
+
+	deleteRetiredRegions();
+	startTimer(deleteIntervalMs);
+}
+
+
+// Define the timerCallback() method for the LoopEngine class, which runs until the cache being read has been handed
+// over, the audio thread has picked up the latest region and the region it replaced has been deleted.
+void LoopEngine::timerCallback() {
+	if (cacheFill != nullptr) {
+		if (cacheFill->state.load() != CacheFill::reading) {
+			finishCacheFill();
+		}
+		else if (latestRegion != nullptr && latestRegion->cache == nullptr && latestRegion->wraps) {
+			// The landing at the loop start is read again if a jump has taken it since.
+			cacheFill->track.prefetch(fillRegion->start, landingPrefetchSamples);
+		}
+	}
+
+	deleteRetiredRegions();
+
+	if (cacheFill == nullptr && pendingRegion.load() == nullptr && retiredFifo.getNumReady() == 0) {
+		stopTimer();
+	}
+}
+
+
+// Define the deleteRetiredRegions() method for the LoopEngine class.
+void LoopEngine::deleteRetiredRegions() {
+	const int numReady = retiredFifo.getNumReady();
+	if (numReady == 0) {
+		return;
+	}
+
+	int start1, size1, start2, size2;
+	retiredFifo.prepareToRead(numReady, start1, size1, start2, size2);
+	for (auto i = 0; i < size1; ++i) {
+		delete retiredRegions[start1 + i];
+	}
+	for (auto i = 0; i < size2; ++i) {
+		delete retiredRegions[start2 + i];
+	}
+	retiredFifo.finishedRead(size1 + size2);
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TrackSource.h"
+#include "ReadAheadThread.h"
+
+
+// LoopEngine makes a deck repeat a section of its track.
+// A loop is a region of the file that the read-ahead thread copies into RAM when it is set, together with a few
+// milliseconds before its start. The audio thread plays the region from that copy, so wrapping around never waits
+// for the disk, and wraps at the exact sample of the loop end. Over the last samples before the end, the audio is
+// crossfaded into the audio just before the start, so the wrap is continuous and does not click.
+// The loop is armed once the copy has been read. Until then, a loop that replaces another keeps the old one playing,
+// and a new loop plays from the track, which jumps back to a landing at the loop start at each wrap, without the
+// crossfade.
+// While a loop plays from RAM the track itself waits at the loop end, which is where playback carries on once the
+// loop is exited; a streamed track moves its stream there as soon as it is parked, and a landing there is prefetched
+// when the loop is set. A loop roll is a loop that, when released, jumps to where the track would have been without
+// it; the player prefetches the audio there before it releases the roll.
+// Regions are immutable and handed to the audio thread through an atomic pointer; replaced ones are deleted on the
+// message thread, like the tracks of DeckTransport.
+class LoopEngine : private juce::Timer {
+public:
+
+	// Constructor for the LoopEngine class, which starts with no loop.
+	LoopEngine();
+
+	// Destructor that deletes every region still owned by the engine. The audio callback must have stopped.
+	~LoopEngine() override;
+
+	// Method to loop a section of a track, which is copied into RAM on the read-ahead thread. Called from the message thread.
+	// Parameters:
+	// - track: The track the loop belongs to.
+	// - start: The first sample of the loop.
+	// - end: The sample after the last one of the loop.
+	// - roll: Whether leaving the loop jumps to where the track would have been without it.
+	// Returns:
+	// - false if the section is too short or too long. A section that cannot be read ends the loop once that is known.
+	bool setLoop(TrackSource* track, juce::int64 start, juce::int64 end, bool roll = false);
+
+	// Method to stop wrapping, so that playback carries on past the loop end. Called from the message thread.
+	void exitLoop();
+
+	// Method to forget the loop straight away, such as when another track is loaded. Called from the message thread.
+	void clear();
+
+	// Method to stop reading the cache of a loop, which must be done before the track it reads from is deleted.
+	// Called from the message thread.
+	void cancelCacheFill();
+
+	// Method to check whether the cache of the latest loop is still being read. Called from the message thread.
+	bool isReadingCache() const;
+
+	// Methods to read the latest loop set from the message thread, including one whose cache is still being read.
+	// The positions are -1 when there is no loop.
+	bool isLooping() const;
+	bool isRolling() const;
+	juce::int64 getLoopStart() const;
+	juce::int64 getLoopEnd() const;
+
+	// Method to return the position being played from the loop, or -1 while playing from the track. Safe from any thread.
+	juce::int64 getPlayhead() const;
+
+	// Method to return where the track would be had the current loop roll not looped, or -1 when the audio thread is
+	// not playing a roll. Safe from any thread.
+	juce::int64 getRollReturn() const;
+
+	// Method called by the audio thread at the start of each block to pick up the latest region.
+	// Parameters:
+	// - track: The track being played.
+	// Returns:
+	// - The position to jump to when the new region ends a loop roll, or -1.
+	juce::int64 swapPendingRegion(TrackSource& track);
+
+	// Method to fill a buffer from the track, wrapping around the loop. Called on the audio thread.
+	// Parameters:
+	// - track: The track being played.
+	// - bufferToFill: Contains the buffer information to be filled with audio data.
+	void read(TrackSource& track, const juce::AudioSourceChannelInfo& bufferToFill);
+
+	// Method to move the playhead on the audio thread, which plays from the loop if the position is inside it.
+	// Parameters:
+	// - track: The track being played.
+	// - position: The new position in samples of the file.
+	void setPosition(TrackSource& track, juce::int64 position);
+
+	// Method called by the audio thread when it starts playing another track.
+	void trackChanged();
+
+	// Longest loop that is copied into RAM, in seconds of the file.
+	static constexpr double maxLoopSeconds = 64.0;
+
+	// Length of the crossfade at the wrap, in seconds of the file.
+	static constexpr double wrapFadeSeconds = 0.003;
+
+	// Number of samples after the loop end that are prefetched when a loop is set.
+	static constexpr int landingPrefetchSamples = 4096;
+
+private:
+
+	// A loop: the section of the file from cacheStart to end, of which start to end is repeated.
+	// The samples from cacheStart to start are the audio faded in before the wrap. A region without a track means
+	// that there is no loop, and one without a cache is played from the track.
+	struct Region {
+		const TrackSource* track = nullptr;
+		juce::int64 start = 0;
+		juce::int64 end = 0;
+		juce::int64 cacheStart = 0;
+		std::shared_ptr<const juce::AudioBuffer<float>> cache;
+		bool wraps = true;
+		bool roll = false;
+	};
+
+	// Reads the cache of a loop on the read-ahead thread, a chunk at a time, so that a long loop does not hold up the
+	// read-ahead buffers of the decks sharing the thread.
+	class CacheFill : public juce::TimeSliceClient {
+	public:
+		CacheFill(TrackSource& _track, juce::int64 _start, int length);
+
+		// Method called on the read-ahead thread to read the next chunk.
+		int useTimeSlice() override;
+
+		enum State {
+			reading = 0,
+			finished,
+			failed
+		};
+
+		TrackSource& track;
+		const juce::int64 start;
+		std::shared_ptr<juce::AudioBuffer<float>> cache;
+		int numRead = 0;
+		std::atomic<int> state{ reading };
+	};
+
+	// Method called on the message thread to arm a loop whose cache has been read and to delete the regions retired
+	// by the audio thread.
+	void timerCallback() override;
+
+	// Method to hand the region being filled to the audio thread with its cache, or to end the loop if it could not be read.
+	void finishCacheFill();
+
+	// Method to return the latest loop set, which is the one being filled if there is one, or nullptr.
+	const Region* getLatestLoop() const;
+
+	// Method to hand a new region to the audio thread. A region without a track means that there is no loop.
+	void publishRegion(Region* newRegion);
+
+	// Method to delete every region waiting in the retired FIFO.
+	void deleteRetiredRegions();
+
+	// Method to copy part of the cache into a buffer, crossfading into the start over the end of a wrapping loop.
+	void readCache(const Region& region, juce::int64 position, const juce::AudioSourceChannelInfo& bufferToFill);
+
+	// Number of retired regions that can wait to be deleted. A new region is not picked up while the FIFO is full.
+	static constexpr int retiredCapacity = 8;
+
+	// Interval at which retired regions are deleted, and at which a cache being read is checked, in milliseconds.
+	static constexpr int deleteIntervalMs = 200;
+	static constexpr int fillPollIntervalMs = 5;
+
+	// Number of samples of a cache read on each time slice.
+	static constexpr int fillChunkSamples = 65536;
+
+	// Latest region handed over, owned by the message thread; the region waiting to be picked up; and the region
+	// being played, owned by the audio thread.
+	Region* latestRegion = nullptr;
+	std::atomic<Region*> pendingRegion{ nullptr };
+	Region* currentRegion = nullptr;
+
+	// Regions replaced by the audio thread and waiting for the message thread to delete them.
+	juce::AbstractFifo retiredFifo{ retiredCapacity };
+	Region* retiredRegions[retiredCapacity] = {};
+
+	// Position being played from the cache, or -1 while playing from the track. Written by the audio thread.
+	std::atomic<juce::int64> playhead{ -1 };
+
+	// Position at which the current loop roll started and the number of samples played since, owned by the audio thread.
+	juce::int64 rollOrigin = -1;
+	juce::int64 rollElapsed = 0;
+
+	// Sum of the two while a roll plays, or -1, written by the audio thread.
+	std::atomic<juce::int64> rollPosition{ -1 };
+
+	// Thread shared by the decks that reads the caches, the region waiting for its cache, and the read in progress,
+	// owned by the message thread.
+	juce::SharedResourcePointer<ReadAheadThread> readAheadThread;
+	std::unique_ptr<Region> fillRegion;
+	std::unique_ptr<CacheFill> cacheFill;
+};
@@ -1,5 +1,7 @@
 #include <JuceHeader.h>
 #include "MainComponent.h"
+#include "OfflineRenderer.h"
+#include "DspBenchmark.h"
 
 // The OtoDecksApplication class represents the main application for the OtoDecks project.
 // It manages the application's lifecycle, including initialization, shutdown, and handling multiple instances.
@@ -26,8 +28,91 @@ public:
     // It creates the main window of the application and sets it up.
     void initialise(const juce::String& commandLine) override
     {
+        // Read the number of decks and of deck render threads, as in "--decks=4 --render-threads=2".
+        juce::ArgumentList arguments(getApplicationName(), commandLine);
+        AudioEngine::Options engineOptions;
+        if (arguments.containsOption("--decks")) {
+            engineOptions.numDecks = arguments.getValueForOption("--decks").getIntValue();
+        }
+        if (arguments.containsOption("--render-threads")) {
+            engineOptions.numRenderThreads = arguments.getValueForOption("--render-threads").getIntValue();
+        }
+
+        // Render a scripted set to a file without a window or an audio device, as in
+        // "--render=set.txt --output=set.wav --sample-rate=48000 --block-size=256", and quit when it is done.
+        if (arguments.containsOption("--render")) {
+            OfflineRenderer::Settings settings;
+            const auto directory = juce::File::getCurrentWorkingDirectory();
+            settings.script = directory.getChildFile(arguments.getValueForOption("--render").unquoted());
+            settings.output = arguments.containsOption("--output") ? directory.getChildFile(arguments.getValueForOption("--output").unquoted())
+                : settings.script.withFileExtension(".wav");
+            if (arguments.containsOption("--sample-rate")) {
+                settings.sampleRate = arguments.getValueForOption("--sample-rate").getDoubleValue();
+            }
+            if (arguments.containsOption("--block-size")) {
+                settings.blockSize = arguments.getValueForOption("--block-size").getIntValue();
+            }
+            settings.engineOptions = engineOptions;
+
+            offlineRenderer.reset(new OfflineRenderer(settings, [this](bool succeeded)
+                {
+                    juce::MessageManager::callAsync([this, succeeded]()
+                        {
+                            setApplicationReturnValue(succeeded ? 0 : 1);
+                            quit();
+                        });
+                }));
+            offlineRenderer->startThread();
+            return;
+        }
+
+        // Measure the DSP stages of the decks and write the results to a JSON file, as in
+        // "--benchmark=results.json --benchmark-stages=eq.", and quit when it is done. With "--benchmark-track=set.wav"
+        // it also times loading and seeking in that file through a memory map and through the stream.
+        if (arguments.containsOption("--benchmark")) {
+            DspBenchmark::Settings settings;
+            const auto output = arguments.getValueForOption("--benchmark").unquoted();
+            settings.output = juce::File::getCurrentWorkingDirectory().getChildFile(output.isNotEmpty() ? output : juce::String("benchmark.json"));
+            settings.stageFilter = arguments.getValueForOption("--benchmark-stages");
+            if (arguments.containsOption("--benchmark-track")) {
+                settings.track = juce::File::getCurrentWorkingDirectory().getChildFile(arguments.getValueForOption("--benchmark-track").unquoted());
+            }
+
+            dspBenchmark.reset(new DspBenchmark(settings, [this](bool succeeded)
+                {
+                    juce::MessageManager::callAsync([this, succeeded]()
+                        {
+                            setApplicationReturnValue(succeeded ? 0 : 1);
+                            quit();
+                        });
+                }));
+            dspBenchmark->startThread();
+            return;
+        }
+
+        // Run the unit tests, as in "--run-tests" or "--run-tests=DSP" for one category, log the results and quit
+        // with the number of failures as the return value.
+        if (arguments.containsOption("--run-tests")) {
+            juce::UnitTestRunner runner;
+            const auto category = arguments.getValueForOption("--run-tests");
+            if (category.isNotEmpty()) {
+                runner.runTestsInCategory(category);
+            }
+            else {
+                runner.runAllTests();
+            }
+
+            int numFailures = 0;
+            for (auto i = 0; i < runner.getNumResults(); ++i) {
+                numFailures += runner.getResult(i)->failures;
+            }
+            setApplicationReturnValue(numFailures);
+            quit();
+            return;
+        }
+
         // Create and initialize the main application window.
-        mainWindow.reset(new MainWindow(getApplicationName()));
+        mainWindow.reset(new MainWindow(getApplicationName(), engineOptions));
     }
 
     // Cleans up resources when the application is shutting down.
@@ -36,6 +121,10 @@ public:
     {
         // Set the main window to nullptr, effectively releasing its resources.
         mainWindow = nullptr;
+
+        // Stop an offline render or a benchmark that is still going.
+        offlineRenderer = nullptr;
+        dspBenchmark = nullptr;
     }
 
     // Requests the application to quit. This method is called when the user requests to quit the application.
@@ -56,8 +145,8 @@ public:
     class MainWindow : public juce::DocumentWindow
     {
     public:
-        // Constructor for the MainWindow class. Initializes the window with a name and appearance.
-        MainWindow(juce::String name)
+        // Constructor for the MainWindow class. Initializes the window with a name and appearance, and a main component with the given audio engine.
+        MainWindow(juce::String name, const AudioEngine::Options& engineOptions)
             : DocumentWindow(name,
                 juce::Desktop::getInstance().getDefaultLookAndFeel()
                 .findColour(juce::ResizableWindow::backgroundColourId),
@@ -67,7 +156,7 @@ public:
             setUsingNativeTitleBar(true);
 
             // Set the content of the window to an instance of MainComponent.
-            setContentOwned(new MainComponent(), true);
+            setContentOwned(new MainComponent(engineOptions), true);
 
             // Configure the window's appearance and behavior based on the platform.
 #if JUCE_IOS || JUCE_ANDROID
@@ -100,6 +189,12 @@ public:
 private:
     // Unique pointer to the main application window.
     std::unique_ptr<MainWindow> mainWindow;
+
+    // Renderer of a scripted set, when the application was started with --render instead of a window.
+    std::unique_ptr<OfflineRenderer> offlineRenderer;
+
+    // Benchmark of the DSP stages, when the application was started with --benchmark instead of a window.
+    std::unique_ptr<DspBenchmark> dspBenchmark;
 };
 
 // Start the JUCE application with OtoDecksApplication as the main application class.
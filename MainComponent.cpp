@@ -1,10 +1,32 @@
 #include "MainComponent.h"
 
+namespace {
+    // Colours of the decks, in order; decks past the last colour start over from the first
+    const juce::Colour deckColours[] = { juce::Colours::aqua, juce::Colours::hotpink, juce::Colours::orange, juce::Colours::lawngreen };
+
+    // Height of a row of two decks
+    constexpr int deckRowHeight = 300;
+}
+
 // Constructor for MainComponent
-MainComponent::MainComponent()
+MainComponent::MainComponent(const AudioEngine::Options& engineOptions)
+    : engine(formatManager, engineOptions)
 {
-    // Set the initial size of the component
-    setSize(800, 600);
+    // Register basic audio formats with the format manager before anything loads a track
+    formatManager.registerBasicFormats();
+
+    // Queue the tracks of the library that have not been analysed yet, now that their formats can be read
+    library.analyseNewTracks();
+
+    // Make a waveform and a deck for each player; decks in the right column are laid out mirrored
+    for (auto index = 0; index < engine.getNumDecks(); ++index) {
+        const auto colour = deckColours[index % juce::numElementsInArray(deckColours)];
+        auto* zoomedDisplay = zoomedDisplays.add(new ZoomedWaveform(formatManager, thumbCache, colour));
+        deckGUIs.add(new DeckGUI(&engine.getDeck(index), formatManager, thumbCache, zoomedDisplay, library, colour, index % 2 == 1));
+    }
+
+    // Set the initial size of the component, with room for every row of decks
+    setSize(800, 600 + deckRowHeight * ((engine.getNumDecks() + 1) / 2 - 1));
 
     // Check if runtime permissions for recording audio are required and if they are granted
     if (juce::RuntimePermissions::isRequired(juce::RuntimePermissions::recordAudio)
@@ -12,35 +34,69 @@ MainComponent::MainComponent()
     {
         // Request runtime permissions if not already granted
         juce::RuntimePermissions::request(juce::RuntimePermissions::recordAudio,
-            [&](bool granted) { setAudioChannels(granted ? 2 : 0, 2); });
+            [&](bool granted) { setAudioChannels(granted ? 2 : 0, 4); });
     }
     else
     {
-        // Set up audio channels if permissions are already granted
-        setAudioChannels(2, 2);
+        // Set up audio channels if permissions are already granted: the master on outputs 1/2 and the headphones on 3/4
+        setAudioChannels(2, 4);
     }
 
     // Add and make visible various components in the UI
-    addAndMakeVisible(deckGUI1);
-    addAndMakeVisible(deckGUI2);
+    for (auto* deckGUI : deckGUIs) {
+        addAndMakeVisible(deckGUI);
+    }
     addAndMakeVisible(library);
-    addAndMakeVisible(zoomedDisplay1);
-    addAndMakeVisible(zoomedDisplay2);
+    for (auto* zoomedDisplay : zoomedDisplays) {
+        addAndMakeVisible(zoomedDisplay);
+    }
     addAndMakeVisible(crossFader);
+    addAndMakeVisible(masterMeterDisplay);
+    addAndMakeVisible(crossfaderCurveBox);
+    addAndMakeVisible(cueMixKnob);
+    addAndMakeVisible(recordButton);
+    addChildComponent(profilerDisplay);
 
     // Configure the crossfader slider properties
     crossFader.setRange(-1, 1);  // Set the range of the slider (-1 to 1)
     crossFader.setValue(0);      // Initialize the slider value to 0
     crossFader.addListener(this);  // Add this component as a listener for slider changes
 
-    // Register basic audio formats with the format manager
-    formatManager.registerBasicFormats();
+    // List the crossfader curves; the item IDs are the curves plus one, since a ComboBox reserves 0 for "nothing selected"
+    crossfaderCurveBox.addItem("LIN", Crossfader::linear + 1);
+    crossfaderCurveBox.addItem("POW", Crossfader::constantPower + 1);
+    crossfaderCurveBox.addItem("CUT", Crossfader::sharpCut + 1);
+    crossfaderCurveBox.setSelectedId(engine.getCrossfader().getCurve() + 1, juce::NotificationType::dontSendNotification);
+    crossfaderCurveBox.addListener(this);
+
+    // Configure the headphone blend knob, starting with the decks sent to cue alone
+    cueMixKnob.setRange(0, 1);
+    cueMixKnob.setValue(0);
+    cueMixKnob.addListener(this);
+
+    // Configure the record button: stop when recording, otherwise offer to record the master alone or with the decks
+    recordButton.setClickingTogglesState(false);
+    recordButton.setColour(juce::TextButton::buttonOnColourId, juce::Colours::red);
+    recordButton.onClick = [this]()
+        {
+            if (engine.getRecorder().isRecording()) {
+                engine.getRecorder().stop();
+                recordButton.setToggleState(false, juce::NotificationType::dontSendNotification);
+                return;
+            }
+
+            juce::PopupMenu menu;
+            menu.addItem("Record master...", [this]() { chooseRecordingFile(false); });
+            menu.addItem("Record master and decks...", [this]() { chooseRecordingFile(true); });
+            menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&recordButton));
+        };
 
     // Set the background colour of the window
     getLookAndFeel().setColour(juce::ResizableWindow::backgroundColourId, juce::Colour::fromRGBA(25, 25, 25, 255));
 
     // Apply a custom look-and-feel to the crossfader and library components
     crossFader.setLookAndFeel(&customLookAndFeel);
+    cueMixKnob.setLookAndFeel(&customLookAndFeel);
     library.setLookAndFeel(&customLookAndFeel);
 
     // Add this component as a key listener to handle key events
@@ -57,31 +113,26 @@ MainComponent::~MainComponent()
 // Prepare the audio playback system before starting playback
 void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
-    // Add input sources to the mixer
-    mixerSource.addInputSource(&player1, false);
-    mixerSource.addInputSource(&player2, false);
-
-    // Prepare individual players for playback
-    player1.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    player2.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    // Prepare the players, the mix and the meters for the device
+    engine.prepareToPlay(samplesPerBlockExpected, sampleRate);
 }
 
 // Process audio data for playback
 void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
-    // Pass the audio data through the mixer source
-    mixerSource.getNextAudioBlock(bufferToFill);
+    // Everything the audio thread does from here on is checked for realtime safety in debug builds, and timed
+    const RealtimeSafetyChecker::ScopedRealtimeSection realtimeSection;
+    const CallbackProfiler::ScopedTimer callbackTimer(engine.getProfiler(), CallbackProfiler::callbackSlot, bufferToFill.numSamples);
+
+    // Render the players and mix them into the output
+    engine.getNextAudioBlock(bufferToFill);
 }
 
 // Release audio resources and clean up
 void MainComponent::releaseResources()
 {
-    // Remove all input sources from the mixer
-    mixerSource.removeAllInputs();
-    // Release resources for the mixer and players
-    mixerSource.releaseResources();
-    player1.releaseResources();
-    player2.releaseResources();
+    // Release resources for the players and the mix
+    engine.releaseResources();
 }
 
 // Paint the component's background and UI elements
@@ -107,35 +158,63 @@ void MainComponent::resized()
     double rowH = getHeight() / 8;
 
     // Set bounds for each component in the layout
-    zoomedDisplay1.setBounds(0, 0, getWidth(), 75 + getHeight() / 32);
-    zoomedDisplay2.setBounds(0, 75 + getHeight() / 32, getWidth(), 75 + getHeight() / 32);
-    deckGUI1.setBounds(0, 150 + getHeight() / 16, getWidth() / 2, 300);
-    deckGUI2.setBounds(getWidth() / 2, 150 + getHeight() / 16, getWidth() / 2, 300);
-    crossFader.setBounds(getWidth() / 2 - 80, 412.5 + getHeight() / 16, 160, 37.5);
-    library.setBounds(0, 450 + getHeight() / 16, getWidth(), getHeight() - 450 - getHeight() / 16);
+    // The waveforms share the strip at the top, and the decks fill rows of two below it
+    const int numDecks = deckGUIs.size();
+    const double waveformsHeight = 150 + getHeight() / 16;
+    const double decksBottom = waveformsHeight + deckRowHeight * ((numDecks + 1) / 2);
+    for (auto index = 0; index < numDecks; ++index) {
+        zoomedDisplays[index]->setBounds(0, waveformsHeight * index / numDecks, getWidth(), waveformsHeight / numDecks);
+        deckGUIs[index]->setBounds(getWidth() / 2 * (index % 2), waveformsHeight + deckRowHeight * (index / 2), getWidth() / 2, deckRowHeight);
+    }
+    crossFader.setBounds(getWidth() / 2 - 80, decksBottom - 37.5, 160, 37.5);
+    masterMeterDisplay.setBounds(getWidth() / 2 - 80, decksBottom - 55.5, 110, 18);
+    crossfaderCurveBox.setBounds(getWidth() / 2 + 32, decksBottom - 55.5, 48, 18);
+    cueMixKnob.setBounds(getWidth() / 2 - 120, decksBottom - 37.5, 37.5, 37.5);
+    recordButton.setBounds(getWidth() / 2 + 88, decksBottom - 33, 37.5, 28);
+    library.setBounds(0, decksBottom, getWidth(), getHeight() - decksBottom);
+    profilerDisplay.setBounds(getWidth() - 234, 4, 230, profilerDisplay.getIdealHeight());
 }
 
 void MainComponent::sliderValueChanged(juce::Slider* slider) {
     // Check if the changed slider is the crossfader
     if (slider == &crossFader) {
-        double val;  // Variable to store the calculated gain value
-
-        // Determine the crossfader value and adjust gains accordingly
-        if (slider->getValue() > 0) {
-            // When the crossfader is positive, reduce the gain of player1 and keep player2 at full volume
-            val = 1 - slider->getValue();
-            player1.setGain(val, false);  // Set the gain for player1
-            player2.setGain(1, false);    // Set player2 to full volume (1.0)
-        }
-        else if (slider->getValue() < 0) {
-            // When the crossfader is negative, reduce the gain of player2 and keep player1 at full volume
-            val = 1 + slider->getValue();
-            player2.setGain(val, false);  // Set the gain for player2
-            player1.setGain(1, false);    // Set player1 to full volume (1.0)
-        }
+        // Map the slider range (-1 to 1) to the crossfader position (0 to 1); the gains are looked up on the audio thread
+        engine.getCrossfader().setPosition(static_cast<float>((slider->getValue() + 1) / 2));
+    }
+
+    // Check if the changed slider is the headphone blend knob
+    if (slider == &cueMixKnob) {
+        engine.setCueMix(static_cast<float>(slider->getValue()));
+    }
+}
+
+void MainComponent::comboBoxChanged(juce::ComboBox* comboBox) {
+    // Check if the changed box is the crossfader curve selector
+    if (comboBox == &crossfaderCurveBox) {
+        DBG("MainComponent::comboBoxChanged: They changed the crossfader curve " << crossfaderCurveBox.getSelectedId());
+        engine.getCrossfader().setCurve(static_cast<Crossfader::Curve>(crossfaderCurveBox.getSelectedId() - 1));
     }
 }
 
+// Ask for the file to record the set to, then start recording
+void MainComponent::chooseRecordingFile(bool includeDecks) {
+    auto chooserFlags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles | juce::FileBrowserComponent::warnAboutOverwriting;
+
+    recordChooser = std::make_unique<juce::FileChooser>("Record Set To", juce::File::getSpecialLocation(juce::File::userMusicDirectory).getChildFile("Set.wav"), "*.wav;*.flac");
+
+    recordChooser->launchAsync(chooserFlags, [this, includeDecks](const juce::FileChooser& chooser)
+        {
+            auto file = chooser.getResult();
+            if (file == juce::File{}) {
+                return;
+            }
+
+            const bool recording = engine.getRecorder().start(file, includeDecks ? engine.getNumDecks() : 0);
+            DBG("MainComponent::chooseRecordingFile: Recording to " << file.getFullPathName() << (recording ? "" : " failed"));
+            recordButton.setToggleState(recording, juce::NotificationType::dontSendNotification);
+        });
+}
+
 
 // Handle key press events
 bool MainComponent::keyPressed(const juce::KeyPress& key, juce::Component* originatingComponent) {
@@ -144,6 +223,9 @@ bool MainComponent::keyPressed(const juce::KeyPress& key, juce::Component* origi
         DBG("Delete Match");
         library.deleteItem();  // Call deleteItem on the library component
     }
+    if (key.getKeyCode() == 80) {  // The 'P' key (key code 80) shows or hides the audio timings
+        profilerDisplay.setVisible(!profilerDisplay.isVisible());
+    }
     return true;  // Return true to indicate that the key event was handled
 }
 void complexFunction()
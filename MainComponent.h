@@ -1,18 +1,22 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "DJAudioPlayer.h"
+#include "AudioEngine.h"
 #include "DeckGUI.h"
 #include "Library.h"
 #include "CustomLookAndFeel.h"
+#include "LevelMeterDisplay.h"
+#include "CallbackProfilerDisplay.h"
+#include "RealtimeSafetyChecker.h"
 
 // MainComponent is the central component of the application
 // It manages audio playback, user interface, and interactions between different components
-class MainComponent : public juce::AudioAppComponent, public juce::Slider::Listener, public juce::KeyListener
+class MainComponent : public juce::AudioAppComponent, public juce::Slider::Listener, public juce::ComboBox::Listener, public juce::KeyListener
 {
 public:
-    // Constructor initializes the main component and sets up the user interface
-    MainComponent();
+    // Constructor initializes the main component and sets up the user interface, with a deck and a waveform for each
+    // deck of the audio engine
+    MainComponent(const AudioEngine::Options& engineOptions = {});
 
     // Destructor cleans up resources when the component is destroyed
     ~MainComponent() override;
@@ -39,7 +43,17 @@ public:
     // Responds to changes in the slider's value
     void sliderValueChanged(juce::Slider* slider) override;
 
+    // Responds to a new crossfader curve being chosen
+    void comboBoxChanged(juce::ComboBox* comboBox) override;
+
 private:
+    // Reporter of the realtime safety violations of the audio threads, in debug builds
+    RealtimeSafetyChecker realtimeSafetyChecker;
+
+    // Audio format manager to handle different audio formats. Declared before the library and the engine, whose
+    // loaders and analysers read files through it, so that it outlives them
+    juce::AudioFormatManager formatManager;
+
     // Custom look-and-feel settings for the user interface
     CustomLookAndFeel customLookAndFeel;
 
@@ -49,27 +63,37 @@ private:
     // Caches for audio thumbnails
     juce::AudioThumbnailCache thumbCache{ 100 };
 
-    // Two audio players for simultaneous playback
-    DJAudioPlayer player1{ formatManager };
-    DJAudioPlayer player2{ formatManager };
+    // Audio engine with the players, the sync engine, the mix bus, the crossfader and the master meter
+    AudioEngine engine;
 
-    // Mixer source to combine audio from multiple players
-    juce::MixerAudioSource mixerSource;
+    // Display of the master meter, placed above the crossfader
+    LevelMeterDisplay masterMeterDisplay{ engine.getMasterMeter(), juce::Colours::white };
 
-    // Displays for zoomed waveforms of the audio tracks
-    ZoomedWaveform zoomedDisplay1{ formatManager, thumbCache, juce::Colours::aqua };
-    ZoomedWaveform zoomedDisplay2{ formatManager, thumbCache, juce::Colours::hotpink };
+    // Overlay of the audio callback timings in the top right corner of the waveforms, shown and hidden with the 'P' key
+    CallbackProfilerDisplay profilerDisplay{ engine.getProfiler(), deviceManager };
 
-    // Audio format manager to handle different audio formats
-    juce::AudioFormatManager formatManager;
+    // Displays for zoomed waveforms of the audio tracks, one per deck
+    juce::OwnedArray<ZoomedWaveform> zoomedDisplays;
 
-    // DeckGUI components for controlling the audio players
-    DeckGUI deckGUI1{ &player1, formatManager, thumbCache, &zoomedDisplay1, library, juce::Colours::aqua };
-    DeckGUI deckGUI2{ &player2, formatManager, thumbCache, &zoomedDisplay2, library, juce::Colours::hotpink };
+    // DeckGUI components for controlling the audio players, one per deck, in two columns
+    juce::OwnedArray<DeckGUI> deckGUIs;
 
     // Crossfader slider to blend audio between the two players
     juce::Slider crossFader{ juce::Slider::SliderStyle::LinearHorizontal, juce::Slider::TextEntryBoxPosition::NoTextBox };
 
+    // Selector of the crossfader curve, placed next to the master meter
+    juce::ComboBox crossfaderCurveBox;
+
+    // Knob blending the headphone output from the decks sent to cue (left) to the master (right), next to the crossfader
+    juce::Slider cueMixKnob{ juce::Slider::SliderStyle::RotaryVerticalDrag, juce::Slider::TextEntryBoxPosition::NoTextBox };
+
+    // Button starting and stopping the recording of the set, right of the crossfader, and the chooser of its file
+    juce::TextButton recordButton{ "REC" };
+    std::unique_ptr<juce::FileChooser> recordChooser;
+
+    // Asks where to record the set to and starts recording there, with each deck to a file of its own when includeDecks is set
+    void chooseRecordingFile(bool includeDecks);
+
     // Prevent copying and leaking of the MainComponent class
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
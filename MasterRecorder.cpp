@@ -0,0 +1,223 @@
+#include "MasterRecorder.h"
+
+
+MasterRecorder::MasterRecorder()
+{
+}
+
+
+MasterRecorder::~MasterRecorder()
+{
+	stop();
+	diskThread.stopThread(4000);
+}
+
+
+// Define the prepare() method for the MasterRecorder class.
+void MasterRecorder::prepare(double newSampleRate) {
+	sampleRate.store(newSampleRate);
+}
+
+
+// Define the start() method for the MasterRecorder class.
+// The files are opened here, on the message thread, and the recording is only handed to the audio thread once all
+// of them are ready.
+bool MasterRecorder::start(const juce::File& file, int numDecksToRecord) {
+	stop();
+
+	if (sampleRate.load() <= 0) {
+		DBG("MasterRecorder::start the audio has not been prepared");
+		return false;
+	}
+
+	std::unique_ptr<Session> session(new Session());
+	if (!addWriter(*session, file)) {
+		return false;
+	}
+	for (auto deck = 0; deck < numDecksToRecord; ++deck) {
+		const auto deckFile = file.getSiblingFile(file.getFileNameWithoutExtension() + " - Deck " + juce::String(deck + 1) + file.getFileExtension());
+		if (!addWriter(*session, deckFile)) {
+			return false;
+		}
+	}
+
+	for (auto* stream : session->streams) {
+		diskThread.addTimeSliceClient(stream);
+	}
+	if (!diskThread.isThreadRunning()) {
+		diskThread.startThread();
+	}
+
+	samplesRecorded.store(0);
+	samplesDropped.store(0);
+	activeSession.store(session.release());
+	return true;
+}
+
+
+// Define the stop() method for the MasterRecorder class.
+// The audio thread may still be writing a block to the recording just taken from it, so the streams are only
+// deleted once it has finished, and once the disk thread has let go of them. Deleting them writes what is left in
+// their FIFOs and finishes the files.
+void MasterRecorder::stop() {
+	std::unique_ptr<Session> session(activeSession.exchange(nullptr));
+	if (session == nullptr) {
+		return;
+	}
+
+	while (activeWrites.load() > 0) {
+		juce::Thread::sleep(1);
+	}
+	for (auto* stream : session->streams) {
+		diskThread.removeTimeSliceClient(stream);
+	}
+	session.reset();
+}
+
+
+// Define the isRecording() method for the MasterRecorder class.
+bool MasterRecorder::isRecording() const {
+	return activeSession.load() != nullptr;
+}
+
+
+// Define the getRecordedSeconds() method for the MasterRecorder class.
+double MasterRecorder::getRecordedSeconds() const {
+	const double rate = sampleRate.load();
+	return rate > 0 ? static_cast<double>(samplesRecorded.load()) / rate : 0.0;
+}
+
+
+// Define the getNumDroppedSamples() method for the MasterRecorder class.
+juce::int64 MasterRecorder::getNumDroppedSamples() const {
+	return samplesDropped.load();
+}
+
+
+// Define the write() method for the MasterRecorder class.
+// The count of writes in progress is raised before the recording is read, so stop either sees this write or this
+// write sees that there is no recording any more. The block goes to every file or to none of them.
+void MasterRecorder::write(const juce::AudioBuffer<float>& master, int startSample, int numSamples,
+	const juce::AudioBuffer<float>* const* decks, int numDecks) {
+	++activeWrites;
+	if (auto* session = activeSession.load()) {
+		bool fits = true;
+		for (auto* stream : session->streams) {
+			fits = fits && stream->getFreeSpace() >= numSamples;
+		}
+
+		if (fits) {
+			session->streams.getUnchecked(0)->write(&master, startSample, numSamples);
+			for (auto deck = 0; deck + 1 < session->streams.size(); ++deck) {
+				session->streams.getUnchecked(deck + 1)->write(deck < numDecks ? decks[deck] : nullptr, 0, numSamples);
+			}
+			samplesRecorded += numSamples;
+		}
+		else {
+			samplesDropped += numSamples;
+		}
+	}
+	--activeWrites;
+}
+
+
+// Define the addWriter() method for the MasterRecorder class.
+bool MasterRecorder::addWriter(Session& session, const juce::File& file) {
+	auto writer = createWriter(file, sampleRate.load());
+	if (writer == nullptr) {
+		return false;
+	}
+
+	const int bufferSamples = juce::roundToInt(bufferSeconds * sampleRate.load());
+	session.streams.add(new FileStream(std::move(writer), bufferSamples));
+	return true;
+}
+
+
+// Constructor for the FileStream class. The FIFO holds one sample fewer than its buffer, so the buffer has one more.
+MasterRecorder::FileStream::FileStream(std::unique_ptr<juce::AudioFormatWriter> _writer, int bufferSamples)
+	: writer(std::move(_writer)), fifo(bufferSamples + 1), buffer(2, bufferSamples + 1)
+{
+}
+
+
+// Destructor for the FileStream class.
+MasterRecorder::FileStream::~FileStream()
+{
+	while (fifo.getNumReady() > 0) {
+		useTimeSlice();
+	}
+}
+
+
+// Define the getFreeSpace() method for the FileStream class.
+int MasterRecorder::FileStream::getFreeSpace() const {
+	return fifo.getFreeSpace();
+}
+
+
+// Define the write() method for the FileStream class.
+void MasterRecorder::FileStream::write(const juce::AudioBuffer<float>* source, int startSample, int numSamples) {
+	const bool silent = source == nullptr || source->getNumChannels() == 0;
+	int start1, size1, start2, size2;
+	fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+	for (auto channel = 0; channel < 2; ++channel) {
+		if (silent) {
+			buffer.clear(channel, start1, size1);
+			buffer.clear(channel, start2, size2);
+		}
+		else {
+			const int sourceChannel = juce::jmin(channel, source->getNumChannels() - 1);
+			buffer.copyFrom(channel, start1, *source, sourceChannel, startSample, size1);
+			buffer.copyFrom(channel, start2, *source, sourceChannel, startSample + size1, size2);
+		}
+	}
+	fifo.finishedWrite(size1 + size2);
+}
+
+
+// Define the useTimeSlice() method for the FileStream class, which writes everything in the FIFO in one go and then
+// waits a little for more.
+int MasterRecorder::FileStream::useTimeSlice() {
+	int start1, size1, start2, size2;
+	fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+	if (size1 + size2 == 0) {
+		return 10;
+	}
+
+	if ((size1 > 0 && !writer->writeFromAudioSampleBuffer(buffer, start1, size1))
+		|| (size2 > 0 && !writer->writeFromAudioSampleBuffer(buffer, start2, size2))) {
+		DBG("MasterRecorder::FileStream::useTimeSlice could not write to the file");
+	}
+	fifo.finishedRead(size1 + size2);
+	return 0;
+}
+
+
+// Define the createWriter() method for the MasterRecorder class.
+std::unique_ptr<juce::AudioFormatWriter> MasterRecorder::createWriter(const juce::File& file, double sampleRate) {
+	file.deleteFile();
+	std::unique_ptr<juce::OutputStream> stream(file.createOutputStream(fileBufferBytes));
+	if (stream == nullptr) {
+		DBG("MasterRecorder::createWriter could not open " << file.getFullPathName());
+		return nullptr;
+	}
+
+	std::unique_ptr<juce::AudioFormat> format;
+	if (file.hasFileExtension(".flac")) {
+		format.reset(new juce::FlacAudioFormat());
+	}
+	else {
+		format.reset(new juce::WavAudioFormat());
+	}
+
+	std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), sampleRate, 2, bitsPerSample, {}, 0));
+	if (writer == nullptr) {
+		DBG("MasterRecorder::createWriter could not write " << format->getFormatName() << " to " << file.getFullPathName());
+		return nullptr;
+	}
+
+	// The writer owns the stream from here on.
+	stream.release();
+	return writer;
+}
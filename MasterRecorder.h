@@ -0,0 +1,130 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// MasterRecorder records the master output, and optionally the output of every deck, to WAV or FLAC files.
+// The audio thread only copies each block into a lock-free FIFO per file; a disk thread of the recorder's own drains
+// the FIFOs into the files, through output streams with large buffers, so the disk is written in big chunks. Nothing
+// in the callback allocates, locks or waits: if the disk falls more than bufferSeconds behind, the block is dropped
+// and counted rather than waited for, and memory stays bounded however long the set runs. A block is only written
+// when every file has room for it, so a dropped block is missing from all of them and the files stay aligned.
+// WAV files switch to RF64 on their own once they pass 4 GB.
+// Decks are recorded as they render, before their volume and the crossfader, so a set can be mixed again later.
+class MasterRecorder {
+public:
+
+	// Constructor for the MasterRecorder class, which starts not recording.
+	MasterRecorder();
+
+	// Destructor that stops the recording. The audio callback must have stopped.
+	~MasterRecorder();
+
+	// Method to tell the recorder the sample rate of the audio that will be written.
+	// Parameters:
+	// - sampleRate: The sample rate of the audio device.
+	void prepare(double sampleRate);
+
+	// Method to start recording, after stopping any recording in progress. Called from the message thread.
+	// The format is chosen by the extension of the file: FLAC for ".flac", WAV otherwise. Decks are recorded to
+	// files next to it, named after it with " - Deck n" added.
+	// Parameters:
+	// - file: The file the master is recorded to. It is replaced if it exists.
+	// - numDecksToRecord: The number of decks recorded besides the master, 0 for the master alone.
+	// Returns:
+	// - false if the audio has not been prepared or a file could not be opened.
+	bool start(const juce::File& file, int numDecksToRecord);
+
+	// Method to stop recording and finish the files. Called from the message thread.
+	void stop();
+
+	// Method to return whether a recording is in progress.
+	bool isRecording() const;
+
+	// Methods to return the length recorded so far, and the number of samples dropped because the disk fell behind.
+	double getRecordedSeconds() const;
+	juce::int64 getNumDroppedSamples() const;
+
+	// Method to record a block. Called on the audio thread; does nothing when not recording.
+	// Parameters:
+	// - master: The buffer holding the master output on its first two channels.
+	// - startSample: The first sample of the block in master.
+	// - numSamples: The number of samples in the block.
+	// - decks: The outputs of the decks, from sample 0.
+	// - numDecks: The number of buffers in decks. The files of decks past it are given silence.
+	void write(const juce::AudioBuffer<float>& master, int startSample, int numSamples,
+		const juce::AudioBuffer<float>* const* decks, int numDecks);
+
+	// Method to open a file for stereo audio at the bit depth of the recorder, replacing it if it exists. The format is
+	// chosen by the extension: FLAC for ".flac", WAV otherwise.
+	// Parameters:
+	// - file: The file to write.
+	// - sampleRate: The sample rate of the audio.
+	// Returns:
+	// - The writer, which owns a buffered stream to the file, or nullptr if the file could not be opened.
+	static std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& file, double sampleRate);
+
+	// Length of audio each file's FIFO holds while the disk catches up, in seconds.
+	static constexpr double bufferSeconds = 10.0;
+
+	// Bit depth of the files.
+	static constexpr int bitsPerSample = 24;
+
+	// Size of the buffer of each file's output stream, in bytes.
+	static constexpr int fileBufferBytes = 1 << 20;
+
+private:
+
+	// One file of a recording: a FIFO the audio thread copies blocks into, drained into the file by the disk thread.
+	class FileStream : public juce::TimeSliceClient {
+	public:
+		// Constructor that takes the writer of the file and the length of the FIFO in samples.
+		FileStream(std::unique_ptr<juce::AudioFormatWriter> _writer, int bufferSamples);
+
+		// Destructor that writes what is left in the FIFO and finishes the file. The stream must have been removed
+		// from the disk thread.
+		~FileStream() override;
+
+		// Method to return the number of samples that can be written without waiting for the disk.
+		int getFreeSpace() const;
+
+		// Method to copy a stereo block into the FIFO. Called on the audio thread, after checking getFreeSpace().
+		// A mono source is written to both channels, and a missing or empty one as silence.
+		// Parameters:
+		// - source: The buffer holding the block on its first two channels, or nullptr.
+		// - startSample: The first sample of the block in source.
+		// - numSamples: The number of samples in the block.
+		void write(const juce::AudioBuffer<float>* source, int startSample, int numSamples);
+
+		// Method called by the disk thread to write what is in the FIFO to the file.
+		int useTimeSlice() override;
+
+	private:
+		std::unique_ptr<juce::AudioFormatWriter> writer;
+		juce::AbstractFifo fifo;
+		juce::AudioBuffer<float> buffer;
+	};
+
+	// The files of one recording: the master first, then one per deck.
+	struct Session {
+		juce::OwnedArray<FileStream> streams;
+	};
+
+	// Method to open a file and the stream that feeds it.
+	// Parameters:
+	// - session: The recording the stream is added to.
+	// - file: The file to open.
+	// Returns:
+	// - false if the file could not be opened.
+	bool addWriter(Session& session, const juce::File& file);
+
+	// Thread that writes the FIFOs to disk.
+	juce::TimeSliceThread diskThread{ "Recorder disk writer" };
+
+	// Recording the audio thread writes to, or nullptr, and the number of writes in progress on the audio thread.
+	std::atomic<Session*> activeSession{ nullptr };
+	std::atomic<int> activeWrites{ 0 };
+
+	std::atomic<double> sampleRate{ 0 };
+	std::atomic<juce::int64> samplesRecorded{ 0 };
+	std::atomic<juce::int64> samplesDropped{ 0 };
+};
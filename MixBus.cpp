@@ -0,0 +1,163 @@
+#include "MixBus.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <xmmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+
+namespace {
+	// Sum one channel of several inputs, each scaled by gain = start + step * (sample + 1), so that the last sample of
+	// the block is scaled by the target exactly.
+	void sumRamped(float* out, const float* const* in, const float* start, const float* step, int numInputs, int numSamples) {
+		int sample = 0;
+#if JUCE_USE_SSE_INTRINSICS
+		const __m128 lanes = _mm_setr_ps(1.0f, 2.0f, 3.0f, 4.0f);
+		for (; sample + 4 <= numSamples; sample += 4) {
+			const __m128 position = _mm_add_ps(_mm_set1_ps(static_cast<float>(sample)), lanes);
+			__m128 acc = _mm_setzero_ps();
+			for (auto input = 0; input < numInputs; ++input) {
+				const __m128 gain = _mm_add_ps(_mm_set1_ps(start[input]), _mm_mul_ps(_mm_set1_ps(step[input]), position));
+				acc = _mm_add_ps(acc, _mm_mul_ps(gain, _mm_loadu_ps(in[input] + sample)));
+			}
+			_mm_storeu_ps(out + sample, acc);
+		}
+#elif JUCE_USE_ARM_NEON
+		const float lanesInit[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+		const float32x4_t lanes = vld1q_f32(lanesInit);
+		for (; sample + 4 <= numSamples; sample += 4) {
+			const float32x4_t position = vaddq_f32(vdupq_n_f32(static_cast<float>(sample)), lanes);
+			float32x4_t acc = vdupq_n_f32(0);
+			for (auto input = 0; input < numInputs; ++input) {
+				const float32x4_t gain = vmlaq_f32(vdupq_n_f32(start[input]), vdupq_n_f32(step[input]), position);
+				acc = vmlaq_f32(acc, gain, vld1q_f32(in[input] + sample));
+			}
+			vst1q_f32(out + sample, acc);
+		}
+#endif
+		for (; sample < numSamples; ++sample) {
+			const float position = static_cast<float>(sample + 1);
+			float acc = 0;
+			for (auto input = 0; input < numInputs; ++input) {
+				acc += (start[input] + step[input] * position) * in[input][sample];
+			}
+			out[sample] = acc;
+		}
+	}
+}
+
+
+MixBus::MixBus()
+{
+}
+
+
+// Define the prepare() method for the MixBus class.
+// Every slot is sized, in use or not, so that adding an input later never allocates.
+void MixBus::prepare(int samplesPerBlockExpected) {
+	blockCapacity = juce::jmax(samplesPerBlockExpected, minBlockCapacity);
+	for (auto& input : inputs) {
+		input.buffer.setSize(numChannels, blockCapacity, false, true, true);
+	}
+}
+
+
+// Define the releaseResources() method for the MixBus class.
+void MixBus::releaseResources() {
+	for (auto& input : inputs) {
+		input.buffer.setSize(0, 0);
+	}
+	blockCapacity = 0;
+}
+
+
+// Define the addInput() method for the MixBus class.
+int MixBus::addInput() {
+	for (auto index = 0; index < maxInputs; ++index) {
+		auto& input = inputs[index];
+		if (!input.active) {
+			input.active = true;
+			for (auto bus = 0; bus < numBuses; ++bus) {
+				for (auto channel = 0; channel < numChannels; ++channel) {
+					input.currentGain[bus][channel] = 0.0f;
+					input.targetGain[bus][channel] = bus == master ? 1.0f : 0.0f;
+				}
+			}
+			return index;
+		}
+	}
+
+	DBG("MixBus::addInput every input is in use");
+	return -1;
+}
+
+
+// Define the removeInput() method for the MixBus class.
+void MixBus::removeInput(int index) {
+	if (index >= 0 && index < maxInputs) {
+		inputs[index].active = false;
+	}
+}
+
+
+// Define the getNumInputs() method for the MixBus class.
+int MixBus::getNumInputs() const {
+	int numInputs = 0;
+	for (const auto& input : inputs) {
+		numInputs += input.active ? 1 : 0;
+	}
+	return numInputs;
+}
+
+
+// Define the setInputGain() method for the MixBus class.
+void MixBus::setInputGain(int index, Bus bus, float gainLeft, float gainRight) {
+	if (index < 0 || index >= maxInputs) {
+		DBG("MixBus::setInputGain no input " << index);
+		return;
+	}
+	inputs[index].targetGain[bus][0] = gainLeft;
+	inputs[index].targetGain[bus][1] = gainRight;
+}
+
+
+// Define the getBlockCapacity() method for the MixBus class.
+int MixBus::getBlockCapacity() const {
+	return blockCapacity;
+}
+
+
+// Define the getInputBuffer() method for the MixBus class.
+juce::AudioBuffer<float>& MixBus::getInputBuffer(int index) {
+	jassert(index >= 0 && index < maxInputs);
+	return inputs[index].buffer;
+}
+
+
+// Define the mix() method for the MixBus class.
+void MixBus::mix(Bus bus, juce::AudioBuffer<float>& output, int firstChannel, int startSample, int numSamples, int inputStart) {
+	const int numOutputChannels = juce::jlimit(0, numChannels, output.getNumChannels() - firstChannel);
+	inputStart = juce::jlimit(0, blockCapacity, inputStart);
+	numSamples = juce::jmin(numSamples, blockCapacity - inputStart);
+
+	const float* in[maxInputs];
+	float start[maxInputs];
+	float step[maxInputs];
+
+	for (auto channel = 0; channel < numOutputChannels; ++channel) {
+		int numActive = 0;
+		for (auto& input : inputs) {
+			if (!input.active) {
+				continue;
+			}
+			in[numActive] = input.buffer.getReadPointer(channel, inputStart);
+			start[numActive] = input.currentGain[bus][channel];
+			step[numActive] = numSamples > 0 ? (input.targetGain[bus][channel] - input.currentGain[bus][channel]) / static_cast<float>(numSamples) : 0.0f;
+			input.currentGain[bus][channel] = input.targetGain[bus][channel];
+			++numActive;
+		}
+
+		sumRamped(output.getWritePointer(firstChannel + channel, startSample), in, start, step, numActive, numSamples);
+	}
+}
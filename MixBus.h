@@ -0,0 +1,98 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// MixBus sums the stereo outputs of any number of decks into a master bus and a headphone cue bus.
+// Every input owns a buffer, allocated once in prepare, that its deck renders into, and which feeds both buses. Each
+// bus is mixed in a single pass over its output: each group of four samples is accumulated from every input in
+// vector registers and stored once, with each input scaled by a gain of that bus that ramps linearly, per channel,
+// from the value of the last mix to the latest target. Inputs are slots that are switched on and off, so adding or
+// removing one never allocates.
+// Everything here is called from the audio thread, or before the audio starts.
+class MixBus {
+public:
+
+	// Largest number of inputs, and number of channels of each input and of the mix.
+	static constexpr int maxInputs = 16;
+	static constexpr int numChannels = 2;
+
+	// Shortest length of the input buffers, in samples, so that a device giving blocks longer than it announced is
+	// usually still mixed in one go.
+	static constexpr int minBlockCapacity = 4096;
+
+	// Buses the inputs are summed into.
+	enum Bus {
+		master = 0,
+		cue,
+		numBuses
+	};
+
+	// Constructor for the MixBus class, which starts without inputs.
+	MixBus();
+
+	// Method to allocate the buffers of every input slot, long enough for the usual block and for minBlockCapacity
+	// samples. Called before the audio starts.
+	// Parameters:
+	// - samplesPerBlockExpected: The usual block size.
+	void prepare(int samplesPerBlockExpected);
+
+	// Method to free the buffers of every input slot. Inputs stay in use.
+	void releaseResources();
+
+	// Method to start using a free input slot. Its master gain fades in from silence to unity over the first block, and
+	// it is not sent to the cue bus.
+	// Returns:
+	// - The index of the input, or -1 if every slot is in use.
+	int addInput();
+
+	// Method to stop mixing an input straight away. Set its gain to 0 for one block first to avoid a click.
+	// Parameters:
+	// - index: The input to remove.
+	void removeInput(int index);
+
+	// Method to return the number of inputs in use.
+	int getNumInputs() const;
+
+	// Method to set the gain an input reaches on a bus at the end of the next mix of that bus.
+	// Parameters:
+	// - index: The input to change.
+	// - bus: The bus to change it on.
+	// - gainLeft: The gain of the left channel.
+	// - gainRight: The gain of the right channel.
+	void setInputGain(int index, Bus bus, float gainLeft, float gainRight);
+
+	// Method to return the number of samples each input buffer holds, which is the longest block that can be rendered
+	// and mixed in one go. A longer block is rendered and mixed in parts of this length.
+	int getBlockCapacity() const;
+
+	// Method to return the buffer an input is rendered into, from sample 0, before mix is called.
+	// Parameters:
+	// - index: The input.
+	juce::AudioBuffer<float>& getInputBuffer(int index);
+
+	// Method to sum every input into one bus, ramping each gain of the bus to its target.
+	// Parameters:
+	// - bus: The bus to mix.
+	// - output: The buffer the bus is written to. Only its two channels from firstChannel are written.
+	// - firstChannel: The channel the left side of the bus is written to.
+	// - startSample: The first sample of the output to write.
+	// - numSamples: The number of samples to mix, at most getBlockCapacity().
+	// - inputStart: The first sample of the input buffers to read, for a block mixed in several segments.
+	void mix(Bus bus, juce::AudioBuffer<float>& output, int firstChannel, int startSample, int numSamples, int inputStart = 0);
+
+private:
+
+	// An input slot: the buffer its deck renders into, and the gain of each channel on each bus at the end of the last
+	// mix and at the end of the next one.
+	struct Input {
+		juce::AudioBuffer<float> buffer;
+		bool active = false;
+		float currentGain[numBuses][numChannels] = {};
+		float targetGain[numBuses][numChannels] = {};
+	};
+
+	Input inputs[maxInputs];
+
+	// Number of samples each input buffer holds.
+	int blockCapacity = 0;
+};
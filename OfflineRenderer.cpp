@@ -0,0 +1,367 @@
+#include "OfflineRenderer.h"
+
+
+namespace {
+	// Commands of the decks, the ones among them that take no value, and commands of the mix.
+	const char* const deckCommands[] = { "load", "play", "stop", "seek", "cue", "volume", "trim", "speed", "low", "mid",
+		"high", "filter", "bpm", "sync", "keylock", "loop", "exitloop" };
+	const char* const deckCommandsWithoutValue[] = { "play", "stop", "exitloop" };
+	const char* const mixCommands[] = { "crossfader", "curve", "end" };
+
+	// Check whether a word is one of a list of commands.
+	template <size_t size>
+	bool isOneOf(const juce::String& word, const char* const (&commands)[size]) {
+		for (const auto* command : commands) {
+			if (word == command) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+
+// Constructor for the OfflineRenderer class.
+OfflineRenderer::OfflineRenderer(const Settings& _settings, std::function<void(bool)> _onFinished)
+	: juce::Thread("Offline renderer"),
+	settings(_settings),
+	onFinished(std::move(_onFinished)),
+	engine(formatManager, _settings.engineOptions)
+{
+	formatManager.registerBasicFormats();
+	for (auto index = 0; index < engine.getNumDecks(); ++index) {
+		engine.getDeck(index).addListener(this);
+		engine.getDeck(index).setOfflineRendering(true);
+	}
+}
+
+
+OfflineRenderer::~OfflineRenderer()
+{
+	stopThread(loadTimeoutMs);
+	for (auto index = 0; index < engine.getNumDecks(); ++index) {
+		engine.getDeck(index).removeListener(this);
+	}
+}
+
+
+// Define the getRenderedSeconds() method for the OfflineRenderer class.
+double OfflineRenderer::getRenderedSeconds() const {
+	return static_cast<double>(samplesRendered.load()) / settings.sampleRate;
+}
+
+
+// Define the getRealtimeFactor() method for the OfflineRenderer class.
+double OfflineRenderer::getRealtimeFactor() const {
+	const double seconds = engineSeconds.load();
+	return seconds > 0 ? getRenderedSeconds() / seconds : 0.0;
+}
+
+
+// Define the run() method for the OfflineRenderer class.
+// The blocks are cut at the times of the events, so each event is applied between two blocks and takes effect at
+// its own sample. Only the time spent in the engine counts towards the speed of the render; loading tracks and
+// writing the file do not.
+void OfflineRenderer::run() {
+	if (!readScript()) {
+		onFinished(false);
+		return;
+	}
+
+	auto writer = MasterRecorder::createWriter(settings.output, settings.sampleRate);
+	if (writer == nullptr) {
+		report("Could not write " + settings.output.getFullPathName());
+		onFinished(false);
+		return;
+	}
+
+	const int blockSize = juce::jmax(1, settings.blockSize);
+	engine.prepareToPlay(blockSize, settings.sampleRate);
+	juce::AudioBuffer<float> buffer(MixBus::numChannels, blockSize);
+
+	const double startTime = juce::Time::getMillisecondCounterHiRes();
+	double renderTime = 0;
+	int stalls = 0;
+	bool succeeded = true;
+	juce::int64 position = 0;
+	size_t nextEvent = 0;
+
+	while (position < endSample && succeeded && !threadShouldExit()) {
+		for (; nextEvent < events.size() && events[nextEvent].sample <= position; ++nextEvent) {
+			succeeded = applyEvent(events[nextEvent]) && succeeded;
+		}
+
+		// Render up to the next event, the end of the set or a full block, whichever comes first.
+		juce::int64 blockEnd = juce::jmin(position + blockSize, endSample);
+		if (nextEvent < events.size()) {
+			blockEnd = juce::jmin(blockEnd, events[nextEvent].sample);
+		}
+		const int numSamples = static_cast<int>(blockEnd - position);
+
+		for (auto index = 0; index < engine.getNumDecks(); ++index) {
+			if (!engine.getDeck(index).waitUntilReady(numSamples * readyBlocks, readAheadTimeoutMs)) {
+				++stalls;
+			}
+		}
+
+		const double blockStart = juce::Time::getMillisecondCounterHiRes();
+		engine.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, numSamples));
+		renderTime += juce::Time::getMillisecondCounterHiRes() - blockStart;
+
+		if (!writer->writeFromAudioSampleBuffer(buffer, 0, numSamples)) {
+			report("Could not write " + settings.output.getFullPathName());
+			succeeded = false;
+		}
+
+		position = blockEnd;
+		samplesRendered.store(position);
+		engineSeconds.store(renderTime * 0.001);
+	}
+
+	engine.releaseResources();
+	writer.reset();
+
+	const double totalSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+	report("Rendered " + juce::String(getRenderedSeconds(), 1) + " s to " + settings.output.getFullPathName()
+		+ " in " + juce::String(totalSeconds, 2) + " s");
+	report("Engine throughput: " + juce::String(getRealtimeFactor(), 1) + " s of audio per second, "
+		+ juce::String(engine.getNumDecks()) + " decks, " + juce::String(engine.getNumRenderThreads()) + " render threads, "
+		+ juce::String(blockSize) + "-sample blocks at " + juce::String(settings.sampleRate, 0) + " Hz");
+	if (stalls > 0) {
+		report(juce::String(stalls) + " blocks were rendered before a deck's read-ahead was ready");
+	}
+
+	onFinished(succeeded && !threadShouldExit());
+}
+
+
+// Define the readScript() method for the OfflineRenderer class.
+bool OfflineRenderer::readScript() {
+	if (!settings.script.existsAsFile()) {
+		report("No script at " + settings.script.getFullPathName());
+		return false;
+	}
+
+	const auto lines = juce::StringArray::fromLines(settings.script.loadFileAsString());
+	for (auto index = 0; index < lines.size(); ++index) {
+		const int line = index + 1;
+		juce::StringArray tokens;
+		tokens.addTokens(lines[index].upToFirstOccurrenceOf("#", false, false), " \t", "\"");
+		tokens.removeEmptyStrings();
+		if (tokens.isEmpty()) {
+			continue;
+		}
+		if (tokens.size() < 3) {
+			report("Expected \"<seconds> <target> <command> [value]\"", line);
+			return false;
+		}
+
+		// The time is checked before it is converted, since getDoubleValue() reads what it can and ignores the rest.
+		const auto& time = tokens[0];
+		if (!time.containsOnly("0123456789.") || !time.containsAnyOf("0123456789") || time.indexOfChar('.') != time.lastIndexOfChar('.')) {
+			report("Not a time in seconds: " + time, line);
+			return false;
+		}
+
+		Event event;
+		event.line = line;
+		event.sample = static_cast<juce::int64>(std::llround(time.getDoubleValue() * settings.sampleRate));
+		event.command = tokens[2].toLowerCase();
+		event.value = tokens[3].unquoted();
+		event.secondValue = tokens[4].unquoted();
+
+		if (tokens[1].equalsIgnoreCase("mix")) {
+			if (!isOneOf(event.command, mixCommands)) {
+				report("Unknown mix command: " + event.command, line);
+				return false;
+			}
+		}
+		else {
+			event.deck = tokens[1].getIntValue() - 1;
+			if (event.deck < 0 || event.deck >= engine.getNumDecks()) {
+				report("No deck " + tokens[1] + " with " + juce::String(engine.getNumDecks()) + " decks", line);
+				return false;
+			}
+			if (!isOneOf(event.command, deckCommands)) {
+				report("Unknown deck command: " + event.command, line);
+				return false;
+			}
+		}
+
+		if (event.value.isEmpty() && event.command != "end" && !isOneOf(event.command, deckCommandsWithoutValue)) {
+			report("The " + event.command + " command needs a value", line);
+			return false;
+		}
+
+		events.push_back(event);
+	}
+
+	// Apply events that share a time in the order they were written.
+	std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.sample < b.sample; });
+
+	for (const auto& event : events) {
+		if (event.command == "end") {
+			endSample = event.sample;
+			return true;
+		}
+	}
+
+	report("The script has no \"<seconds> mix end\" line");
+	return false;
+}
+
+
+// Define the applyEvent() method for the OfflineRenderer class.
+bool OfflineRenderer::applyEvent(const Event& event) {
+	const double value = event.value.getDoubleValue();
+	const bool on = event.value.equalsIgnoreCase("on");
+
+	if (event.deck < 0) {
+		if (event.command == "crossfader") {
+			// The same range as the crossfader slider, from -1 for the A side to 1 for the B side.
+			engine.getCrossfader().setPosition(static_cast<float>((juce::jlimit(-1.0, 1.0, value) + 1) / 2));
+		}
+		else if (event.command == "curve") {
+			const juce::StringArray curves{ "lin", "pow", "cut" };
+			const int curve = curves.indexOf(event.value.toLowerCase());
+			if (curve < 0) {
+				report("Unknown crossfader curve: " + event.value, event.line);
+				return false;
+			}
+			engine.getCrossfader().setCurve(static_cast<Crossfader::Curve>(curve));
+		}
+		return true;
+	}
+
+	auto& deck = engine.getDeck(event.deck);
+	if (event.command == "load") {
+		if (!loadTrack(deck, event.value)) {
+			report("Could not load " + event.value, event.line);
+			return false;
+		}
+	}
+	else if (event.command == "play") {
+		deck.start();
+	}
+	else if (event.command == "stop") {
+		deck.stop();
+	}
+	else if (event.command == "seek") {
+		deck.setPosition(value);
+	}
+	else if (event.command == "cue") {
+		deck.jumpToCue(juce::jlimit(0.0, 1.0, value));
+	}
+	else if (event.command == "volume") {
+		deck.setGain(juce::jlimit(0.0, 1.0, value));
+	}
+	else if (event.command == "trim") {
+		deck.setTrackGain(value);
+	}
+	else if (event.command == "speed") {
+		deck.setSpeed(value);
+	}
+	else if (event.command == "low") {
+		deck.setLBFilter(value);
+	}
+	else if (event.command == "mid") {
+		deck.setMBFilter(value);
+	}
+	else if (event.command == "high") {
+		deck.setHBFilter(value);
+	}
+	else if (event.command == "filter") {
+		deck.setFilter(value);
+	}
+	else if (event.command == "bpm") {
+		deck.setBeatGrid(value, event.secondValue.isEmpty() ? -1.0 : event.secondValue.getDoubleValue());
+	}
+	else if (event.command == "sync") {
+		deck.setSync(on);
+	}
+	else if (event.command == "keylock") {
+		deck.setKeyLock(on);
+	}
+	else if (event.command == "loop") {
+		// The loop engine publishes its regions and deletes the old ones on the message thread, so loops are set there.
+		bool looped = false;
+		callOnMessageThread([&deck, &looped, value]() { looped = deck.setBeatLoop(value); });
+		if (!looped) {
+			report("Could not loop " + event.value + " beats", event.line);
+		}
+
+		// A loop is armed once its cache has been read, which the render waits for so that it wraps as it would live.
+		bool cached = !looped;
+		while (!cached && callOnMessageThread([&deck, &cached]() { cached = deck.isLoopCached(); })) {
+			if (!cached) {
+				juce::Thread::sleep(messageWaitMs);
+			}
+		}
+	}
+	else if (event.command == "exitloop") {
+		callOnMessageThread([&deck]() { deck.exitLoop(); });
+	}
+	return true;
+}
+
+
+// Define the callOnMessageThread() method for the OfflineRenderer class.
+// The render waits in short steps so that it can still be stopped. If it is before the message thread has started the
+// call, the call is cancelled rather than left to run later against a renderer that may be gone; once started, it is
+// waited for, so it never runs alongside the rest of the render.
+bool OfflineRenderer::callOnMessageThread(std::function<void()> function) {
+	enum State { waiting = 0, running, cancelled };
+	struct Call {
+		std::function<void()> function;
+		juce::WaitableEvent done;
+		std::atomic<int> state{ waiting };
+	};
+	auto call = std::make_shared<Call>();
+	call->function = std::move(function);
+
+	juce::MessageManager::callAsync([call]()
+		{
+			int expected = waiting;
+			if (call->state.compare_exchange_strong(expected, running)) {
+				call->function();
+				call->done.signal();
+			}
+		});
+
+	while (!call->done.wait(messageWaitMs)) {
+		int expected = waiting;
+		if (threadShouldExit() && call->state.compare_exchange_strong(expected, cancelled)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Define the loadTrack() method for the OfflineRenderer class.
+// The load finishes on the message thread, which hands the track to the deck; the deck picks it up in the next block.
+bool OfflineRenderer::loadTrack(DJAudioPlayer& deck, const juce::String& path) {
+	// Relative paths are relative to the script, so a set and its tracks can be kept together.
+	const auto file = settings.script.getParentDirectory().getChildFile(path);
+	if (!file.existsAsFile()) {
+		return false;
+	}
+
+	loadDone.reset();
+	loadSucceeded.store(false);
+	deck.loadURL(juce::URL(file));
+	return loadDone.wait(loadTimeoutMs) && loadSucceeded.load();
+}
+
+
+// Define the loadFinished() method for the OfflineRenderer class.
+void OfflineRenderer::loadFinished(DJAudioPlayer* player, bool succeeded, juce::OwnedArray<juce::AudioFormatReader>& thumbnailReaders) {
+	loadSucceeded.store(succeeded);
+	loadDone.signal();
+}
+
+
+// Define the report() method for the OfflineRenderer class.
+void OfflineRenderer::report(const juce::String& message, int line) const {
+	juce::Logger::writeToLog(line > 0 ? settings.script.getFileName() + ":" + juce::String(line) + ": " + message : message);
+}
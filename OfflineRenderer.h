@@ -0,0 +1,123 @@
+#pragma once
+#include <JuceHeader.h>
+#include "AudioEngine.h"
+
+
+// OfflineRenderer plays a scripted set through an AudioEngine with no GUI and no audio device, and writes the master
+// output to a file as fast as the CPU allows. It is used to pre-render mixes, to check the engine's output on
+// machines without a sound card, and to measure how many seconds of audio the engine renders per second.
+//
+// The script is a text file with one event per line, "<seconds> <target> <command> [value]", where the target is a
+// deck number from 1 or "mix". Blank lines and anything after a '#' are ignored, and paths with spaces are quoted:
+//
+//     0      1    load      "/music/First Track.wav"
+//     0      1    cue       0.1
+//     0      mix  crossfader -1
+//     60     2    load      /music/second.flac
+//     60     2    play
+//     64     mix  crossfader 0
+//     96     1    low       0.2
+//     120    mix  end
+//
+// Deck commands are load <file>, play, stop, seek <seconds>, cue <0 to 1>, volume <0 to 1>, trim <dB>,
+// speed <ratio>, low/mid/high <gain>, filter <Hz>, bpm <bpm> [downbeat seconds], sync on/off, keylock on/off,
+// loop <beats> and exitloop; mix commands are crossfader <-1 to 1>, curve lin/pow/cut and end, which ends the set.
+// Every event takes effect at the sample of its time: the blocks are cut there and the decks apply their commands
+// at the start of a block. A load is waited for before rendering goes on, and every block waits until the decks'
+// read-ahead has the audio it needs, so the result does not depend on the speed of the disk.
+class OfflineRenderer : public juce::Thread,
+	private DJAudioPlayer::Listener {
+public:
+
+	// What to render and how.
+	struct Settings {
+		juce::File script;
+		juce::File output;
+		double sampleRate = 44100.0;
+		int blockSize = 512;
+		AudioEngine::Options engineOptions;
+	};
+
+	// Constructor for the OfflineRenderer class, which makes the engine. Called from the message thread, which must
+	// keep running while rendering, since that is where the decks finish loading their tracks.
+	// Parameters:
+	// - settings: The script, the output file and the format of the render.
+	// - onFinished: Called on the render thread when the render is over, with whether it succeeded.
+	OfflineRenderer(const Settings& settings, std::function<void(bool)> onFinished);
+
+	// Destructor that stops the render.
+	~OfflineRenderer() override;
+
+	// Method that reads the script and renders the set, on the render thread.
+	void run() override;
+
+	// Methods to return the length of audio rendered so far, in seconds, and the speed of the render, in seconds of
+	// audio per second of time spent in the engine.
+	double getRenderedSeconds() const;
+	double getRealtimeFactor() const;
+
+	// Longest time to wait for a track to load, and for a deck's read-ahead before each block, in milliseconds.
+	static constexpr int loadTimeoutMs = 60000;
+	static constexpr int readAheadTimeoutMs = 5000;
+
+	// Interval at which a wait for the message thread checks whether the render has been stopped, in milliseconds.
+	static constexpr int messageWaitMs = 10;
+
+	// Number of blocks of audio after the playhead that each deck must have ready before a block is rendered.
+	static constexpr int readyBlocks = 4;
+
+private:
+
+	// A line of the script.
+	struct Event {
+		juce::int64 sample = 0;
+		int deck = -1;
+		juce::String command;
+		juce::String value;
+		juce::String secondValue;
+		int line = 0;
+	};
+
+	// Method to read the script into events, sorted by time.
+	// Returns:
+	// - false if the script could not be read, with the reason logged.
+	bool readScript();
+
+	// Method to apply an event to the engine.
+	// Returns:
+	// - false if it failed, with the reason logged.
+	bool applyEvent(const Event& event);
+
+	// Method to load a track into a deck and wait until the deck has it.
+	bool loadTrack(DJAudioPlayer& deck, const juce::String& path);
+
+	// Method to run a function on the message thread and wait for it, for the deck calls that must be made there.
+	// Parameters:
+	// - function: The function to run.
+	// Returns:
+	// - false if the render was stopped first, in which case the function is never run.
+	bool callOnMessageThread(std::function<void()> function);
+
+	// Method of DJAudioPlayer::Listener called on the message thread when a deck has loaded a track.
+	void loadFinished(DJAudioPlayer* player, bool succeeded, juce::OwnedArray<juce::AudioFormatReader>& thumbnailReaders) override;
+
+	// Method to log a line of the report, or an error with the script line it comes from.
+	void report(const juce::String& message, int line = 0) const;
+
+	Settings settings;
+	std::function<void(bool)> onFinished;
+
+	juce::AudioFormatManager formatManager;
+	AudioEngine engine;
+
+	// The set, in order, and the sample it ends at.
+	std::vector<Event> events;
+	juce::int64 endSample = -1;
+
+	// Signalled when the deck loading a track has finished, and whether it succeeded.
+	juce::WaitableEvent loadDone;
+	std::atomic<bool> loadSucceeded{ false };
+
+	std::atomic<juce::int64> samplesRendered{ 0 };
+	std::atomic<double> engineSeconds{ 0 };
+};
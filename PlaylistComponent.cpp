@@ -11,8 +11,14 @@ PlaylistComponent::PlaylistComponent(juce::AudioFormatManager& _formatManager)
 	// Add a column for "Length" with an ID of 2 and a width of 150 pixels.
 	tableComponent.getHeader().addColumn("Length", 2, 150);
 
-	// Add a column for "Search" with an ID of 3 and a width of 150 pixels.
-	tableComponent.getHeader().addColumn("Search", 3, 150);
+	// Add a column for "BPM" with an ID of 4 and a width of 80 pixels.
+	tableComponent.getHeader().addColumn("BPM", 4, 80);
+
+	// Add a column for "Key" with an ID of 5 and a width of 60 pixels, showing the key in Camelot notation.
+	tableComponent.getHeader().addColumn("Key", 5, 60);
+
+	// Add a column for "Search" with an ID of 3 and a width of 150 pixels. It holds the search box, so it cannot be sorted by.
+	tableComponent.getHeader().addColumn("Search", 3, 150, 30, -1, juce::TableHeaderComponent::notSortable);
 
 	// Set the current instance of PlaylistComponent as the model for the table component.
 	// This allows PlaylistComponent to handle events and provide data for the table.
@@ -65,6 +71,9 @@ void PlaylistComponent::setTrackTitles(std::vector<track>& _trackTitles) {
 		displayTrackTitles.push_back(&trackTitles->at(i));
 	}
 
+	// Keep the order the user chose by clicking a column header.
+	sortDisplayedTracks();
+
 	// Deselect any currently selected rows in the table component.
 	// This ensures that no rows are highlighted after updating the track list.
 	tableComponent.deselectAllRows();
@@ -149,10 +158,80 @@ void PlaylistComponent::paintCell(juce::Graphics& g, int rowNumber, int columnId
 			std::string time = track::getLengthString(displayTrackTitles.at(rowNumber)->lengthInSeconds);
 			g.drawText(time, 2, 0, width - 4, height, juce::Justification::centredLeft, true);
 		}
+		else if (tableComponent.getHeader().getColumnName(columnId) == "BPM") {
+			// If the column is "BPM", draw the analysed tempo, or an ellipsis while the track is still being analysed
+			const double bpm = displayTrackTitles.at(rowNumber)->bpm;
+			g.drawText(bpm > 0 ? juce::String(bpm, 1) : juce::String("..."), 2, 0, width - 4, height, juce::Justification::centredLeft, true);
+		}
+		else if (tableComponent.getHeader().getColumnName(columnId) == "Key") {
+			// If the column is "Key", draw the analysed key in Camelot notation
+			g.drawText(track::getKeyString(displayTrackTitles.at(rowNumber)->key), 2, 0, width - 4, height, juce::Justification::centredLeft, true);
+		}
+	}
+}
+
+
+
+void PlaylistComponent::refresh() {
+	// A new BPM or key can move a track when the list is sorted by it, so the sort is applied again, keeping the
+	// selection on the same track.
+	const int selectedRow = tableComponent.getSelectedRow();
+	const track* selected = selectedRow >= 0 && selectedRow < static_cast<int>(displayTrackTitles.size()) ? displayTrackTitles[selectedRow] : nullptr;
+
+	sortDisplayedTracks();
+	tableComponent.updateContent();
+
+	if (selected != nullptr) {
+		const auto row = std::find(displayTrackTitles.begin(), displayTrackTitles.end(), selected) - displayTrackTitles.begin();
+		tableComponent.selectRow(static_cast<int>(row), false, true);
 	}
+	tableComponent.repaint();
+}
+
+
+void PlaylistComponent::sortOrderChanged(int newSortColumnId, bool isForwards) {
+	// The selected row would point at another track once the rows have moved, so the selection is cleared.
+	sortDisplayedTracks();
+	tableComponent.deselectAllRows();
+	tableComponent.updateContent();
+	tableComponent.repaint();
 }
 
 
+void PlaylistComponent::sortDisplayedTracks() {
+	const int columnId = tableComponent.getHeader().getSortColumnId();
+	const bool forwards = tableComponent.getHeader().isSortedForwards();
+
+	// Tracks that have not been analysed yet go after the others whichever way the column is sorted.
+	auto compare = [columnId](const track* a, const track* b) -> int {
+		switch (columnId) {
+		case 1:
+			return a->title.compareNatural(b->title);
+		case 2:
+			return a->lengthInSeconds < b->lengthInSeconds ? -1 : (a->lengthInSeconds > b->lengthInSeconds ? 1 : 0);
+		case 4:
+			return a->bpm < b->bpm ? -1 : (a->bpm > b->bpm ? 1 : 0);
+		case 5:
+			return track::getCamelotIndex(a->key) - track::getCamelotIndex(b->key);
+		default:
+			return 0;
+		}
+	};
+	auto isUnknown = [columnId](const track* t) {
+		return (columnId == 4 && t->bpm <= 0) || (columnId == 5 && t->key < 0);
+	};
+
+	if (columnId == 0 || columnId == 3) {
+		return;
+	}
+	std::stable_sort(displayTrackTitles.begin(), displayTrackTitles.end(), [&](const track* a, const track* b) {
+		if (isUnknown(a) != isUnknown(b)) {
+			return isUnknown(b);
+		}
+		return forwards ? compare(a, b) < 0 : compare(a, b) > 0;
+	});
+}
+
 
 void PlaylistComponent::textEditorTextChanged(juce::TextEditor& e) {
 	// Clear the list of track titles currently displayed in the UI
@@ -179,6 +258,7 @@ void PlaylistComponent::textEditorTextChanged(juce::TextEditor& e) {
 
 	// Log the size of the displayTrackTitles list after filtering
 	DBG("displayTrackTitles size" << displayTrackTitles.size());
+	sortDisplayedTracks();
 
 	// Update the table component to reflect the changes in the track titles
 	tableComponent.updateContent();
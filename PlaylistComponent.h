@@ -26,6 +26,10 @@ public:
     // It clears the current display list and repopulates it based on the provided list of tracks.
     void setTrackTitles(std::vector<track>& _trackTitles);
 
+    // Sorts the list again and repaints it after the tracks it shows have changed in place, such as when their
+    // analysis has finished.
+    void refresh();
+
     // Returns the currently selected track from the display list.
     track getSelectedTrack();
 
@@ -41,6 +45,12 @@ private:
     // It determines what text to display based on the column ID and the row number.
     void paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
 
+    // Sorts the displayed tracks when a column header is clicked.
+    void sortOrderChanged(int newSortColumnId, bool isForwards) override;
+
+    // Sorts the displayed tracks by the column the table is sorted by, if any.
+    void sortDisplayedTracks();
+
     // Handles changes in the search text editor.
     // It updates the list of displayed tracks based on the search query.
     void textEditorTextChanged(juce::TextEditor& e) override;
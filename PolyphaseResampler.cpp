@@ -0,0 +1,304 @@
+#include "PolyphaseResampler.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <xmmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace {
+
+	// Number of fractional positions stored per kernel. Positions in between are linearly interpolated.
+	const int numPhases = 256;
+
+	// Ratios for which a kernel is designed. A ratio above 1 uses the first kernel designed for at least that ratio,
+	// whose cutoff is lowered and whose length is stretched by the same factor. The last one is maximumRatio, so that
+	// every accepted ratio has a kernel whose cutoff is low enough.
+	constexpr double designRatios[] = { 1.0, 1.125, 1.25, 1.5, 2.0, 3.0, 4.0, 6.0, 8.0 };
+	constexpr int numDesignRatios = 9;
+	static_assert(designRatios[numDesignRatios - 1] >= PolyphaseResampler::maximumRatio, "ratios up to maximumRatio need a kernel");
+
+	// Kernel length, Kaiser window shape and cutoff (as a fraction of the input Nyquist frequency) of every quality tier.
+	struct TierDesign {
+		int numTaps;
+		double beta;
+		double cutoff;
+	};
+	const TierDesign tierDesigns[PolyphaseResampler::numQualities] = {
+		{ 8, 4.0, 0.80 },
+		{ 16, 6.0, 0.86 },
+		{ 32, 8.0, 0.92 },
+		{ 64, 10.0, 0.95 }
+	};
+
+	// Zeroth-order modified Bessel function of the first kind, used by the Kaiser window.
+	double besselI0(double x) {
+		double sum = 1, term = 1;
+		for (auto k = 1; k < 64 && term > 1.0e-12 * sum; ++k) {
+			const double half = x / (2 * k);
+			term *= half * half;
+			sum += term;
+		}
+		return sum;
+	}
+
+	// One designed kernel: numPhases + 1 rows of numTaps coefficients, so that the last row can be interpolated towards.
+	struct KernelTable {
+		int numTaps = 0;
+		std::vector<float> coefficients;
+	};
+
+	// Every kernel for every quality tier and design ratio. The tables do not depend on the sample rate, so they are
+	// built once, the first time a resampler is created, and shared by all decks.
+	struct KernelSet {
+		KernelTable tables[PolyphaseResampler::numQualities][numDesignRatios];
+
+		KernelSet() {
+			for (auto q = 0; q < PolyphaseResampler::numQualities; ++q) {
+				for (auto r = 0; r < numDesignRatios; ++r) {
+					design(tables[q][r], tierDesigns[q], designRatios[r]);
+				}
+			}
+		}
+
+		static void design(KernelTable& table, const TierDesign& tier, double ratio) {
+			// Lengths are kept a multiple of 4 for the vector loop.
+			const int numTaps = (static_cast<int>(std::ceil(tier.numTaps * ratio)) + 3) & ~3;
+			const int half = numTaps / 2;
+			const double cutoff = tier.cutoff / ratio;
+			const double windowNorm = besselI0(tier.beta);
+
+			table.numTaps = numTaps;
+			table.coefficients.resize(static_cast<size_t>((numPhases + 1) * numTaps));
+
+			for (auto p = 0; p <= numPhases; ++p) {
+				float* row = table.coefficients.data() + p * numTaps;
+				const double fraction = static_cast<double>(p) / numPhases;
+				double sum = 0;
+
+				for (auto k = 0; k < numTaps; ++k) {
+					// Distance of this tap from the output position, in input samples.
+					const double d = k - (half - 1) - fraction;
+					const double x = juce::MathConstants<double>::pi * cutoff * d;
+					const double sinc = std::abs(x) < 1.0e-9 ? 1.0 : std::sin(x) / x;
+					const double w = d / half;
+					const double window = std::abs(w) >= 1.0 ? 0.0 : besselI0(tier.beta * std::sqrt(1.0 - w * w)) / windowNorm;
+
+					row[k] = static_cast<float>(cutoff * sinc * window);
+					sum += row[k];
+				}
+
+				// Normalise every row to unity gain at DC, so that no fractional position is louder than another.
+				for (auto k = 0; k < numTaps; ++k) {
+					row[k] = static_cast<float>(row[k] / sum);
+				}
+			}
+		}
+	};
+
+	const KernelSet& getKernelSet() {
+		static const KernelSet kernelSet;
+		return kernelSet;
+	}
+
+	// Filter both channels at one output position. The coefficients are interpolated between two neighbouring
+	// kernel rows a and b by fraction, and applied to left and right with the same vector instructions.
+	void convolvePair(const float* left, const float* right, const float* a, const float* b, float fraction, int numTaps, float& outLeft, float& outRight) {
+#if JUCE_USE_SSE_INTRINSICS
+		const __m128 f = _mm_set1_ps(fraction);
+		__m128 accLeft = _mm_setzero_ps();
+		__m128 accRight = _mm_setzero_ps();
+		for (auto k = 0; k < numTaps; k += 4) {
+			const __m128 ca = _mm_loadu_ps(a + k);
+			const __m128 c = _mm_add_ps(ca, _mm_mul_ps(f, _mm_sub_ps(_mm_loadu_ps(b + k), ca)));
+			accLeft = _mm_add_ps(accLeft, _mm_mul_ps(c, _mm_loadu_ps(left + k)));
+			accRight = _mm_add_ps(accRight, _mm_mul_ps(c, _mm_loadu_ps(right + k)));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, accLeft);
+		outLeft = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		_mm_storeu_ps(lanes, accRight);
+		outRight = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif JUCE_USE_ARM_NEON
+		const float32x4_t f = vdupq_n_f32(fraction);
+		float32x4_t accLeft = vdupq_n_f32(0);
+		float32x4_t accRight = vdupq_n_f32(0);
+		for (auto k = 0; k < numTaps; k += 4) {
+			const float32x4_t ca = vld1q_f32(a + k);
+			const float32x4_t c = vmlaq_f32(ca, f, vsubq_f32(vld1q_f32(b + k), ca));
+			accLeft = vmlaq_f32(accLeft, c, vld1q_f32(left + k));
+			accRight = vmlaq_f32(accRight, c, vld1q_f32(right + k));
+		}
+		float32x2_t half = vadd_f32(vget_low_f32(accLeft), vget_high_f32(accLeft));
+		outLeft = vget_lane_f32(vpadd_f32(half, half), 0);
+		half = vadd_f32(vget_low_f32(accRight), vget_high_f32(accRight));
+		outRight = vget_lane_f32(vpadd_f32(half, half), 0);
+#else
+		float sumLeft = 0, sumRight = 0;
+		for (auto k = 0; k < numTaps; ++k) {
+			const float c = a[k] + fraction * (b[k] - a[k]);
+			sumLeft += c * left[k];
+			sumRight += c * right[k];
+		}
+		outLeft = sumLeft;
+		outRight = sumRight;
+#endif
+	}
+
+}
+
+
+PolyphaseResampler::PolyphaseResampler(juce::AudioSource* _input)
+	: input(_input)
+{
+	// Build the shared tables now, on the thread creating the deck, rather than in the first audio callback.
+	const auto& kernels = getKernelSet();
+
+	historyLength = kernels.tables[best][numDesignRatios - 1].numTaps / 2;
+	selectKernel();
+}
+
+
+// Define the prepareToPlay() method for the PolyphaseResampler class, which sizes the input buffer and clears it.
+void PolyphaseResampler::prepareToPlay(int samplesPerBlockExpected, double sampleRate) {
+	// The input is read in blocks of roughly the same length as the output.
+	input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+	// One chunk at the highest ratio, plus the history and the look-ahead of the longest kernel.
+	inputBuffer.setSize(2, static_cast<int>(std::ceil(maxChunkSize * maximumRatio)) + 2 * historyLength + 4);
+	flushBuffers();
+}
+
+
+// Define the releaseResources() method for the PolyphaseResampler class.
+void PolyphaseResampler::releaseResources() {
+	input->releaseResources();
+}
+
+
+// Define the flushBuffers() method for the PolyphaseResampler class.
+void PolyphaseResampler::flushBuffers() {
+	inputBuffer.clear();
+
+	// The first output lands on the first input sample, with silence as its history.
+	inputFill = historyLength - 1;
+	position = historyLength - 1;
+}
+
+
+// Define the setResamplingRatio() method for the PolyphaseResampler class.
+void PolyphaseResampler::setResamplingRatio(double ratio) {
+	resamplingRatio = juce::jlimit(minimumRatio, maximumRatio, ratio);
+	selectKernel();
+}
+
+
+// Define the getResamplingRatio() method for the PolyphaseResampler class.
+double PolyphaseResampler::getResamplingRatio() const {
+	return resamplingRatio;
+}
+
+
+// Define the getLatency() method for the PolyphaseResampler class.
+// Every sample of inputBuffer after the position has been read from the input and not yet been output.
+double PolyphaseResampler::getLatency() const {
+	return juce::jmax(0.0, inputFill - position);
+}
+
+
+// Define the setQuality() method for the PolyphaseResampler class.
+void PolyphaseResampler::setQuality(Quality newQuality) {
+	quality = juce::jlimit(draft, best, newQuality);
+	selectKernel();
+}
+
+
+// Define the selectKernel() method for the PolyphaseResampler class.
+void PolyphaseResampler::selectKernel() {
+	auto r = 0;
+	while (r < numDesignRatios - 1 && designRatios[r] < resamplingRatio) {
+		++r;
+	}
+
+	const auto& table = getKernelSet().tables[quality][r];
+	kernel = table.coefficients.data();
+	numTaps = table.numTaps;
+}
+
+
+// Define the getNextAudioBlock() method for the PolyphaseResampler class, which produces the output in chunks of at most maxChunkSize samples.
+void PolyphaseResampler::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
+	auto& buffer = *bufferToFill.buffer;
+	const int numChannels = buffer.getNumChannels();
+	const int half = numTaps / 2;
+
+	auto done = 0;
+	while (done < bufferToFill.numSamples) {
+		const int chunkSize = juce::jmin(maxChunkSize, bufferToFill.numSamples - done);
+
+		// Read up to the last input sample under the kernel of the last output in this chunk.
+		fillInput(static_cast<int>(position + (chunkSize - 1) * resamplingRatio) + half + 1);
+
+		const float* left = inputBuffer.getReadPointer(0);
+		const float* right = inputBuffer.getReadPointer(1);
+		float* outLeft = buffer.getWritePointer(0, bufferToFill.startSample + done);
+		float* outRight = numChannels > 1 ? buffer.getWritePointer(1, bufferToFill.startSample + done) : nullptr;
+
+		for (auto i = 0; i < chunkSize; ++i) {
+			const int index = static_cast<int>(position);
+			const float phase = static_cast<float>((position - index) * numPhases);
+			const int row = juce::jmin(static_cast<int>(phase), numPhases - 1);
+			const float* a = kernel + row * numTaps;
+			const int first = index - (half - 1);
+
+			float l, r;
+			convolvePair(left + first, right + first, a, a + numTaps, phase - row, numTaps, l, r);
+
+			outLeft[i] = l;
+			if (outRight != nullptr) {
+				outRight[i] = r;
+			}
+			position += resamplingRatio;
+		}
+
+		discardInput();
+		done += chunkSize;
+	}
+
+	for (auto channel = 2; channel < numChannels; ++channel) {
+		buffer.clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+	}
+}
+
+
+// Define the fillInput() method for the PolyphaseResampler class.
+void PolyphaseResampler::fillInput(int numSamplesNeeded) {
+	jassert(numSamplesNeeded <= inputBuffer.getNumSamples());
+
+	if (numSamplesNeeded > inputFill) {
+		juce::AudioSourceChannelInfo info(&inputBuffer, inputFill, numSamplesNeeded - inputFill);
+		input->getNextAudioBlock(info);
+		inputFill = numSamplesNeeded;
+	}
+}
+
+
+// Define the discardInput() method for the PolyphaseResampler class.
+// The history of the longest kernel is always kept, so that switching quality or ratio never runs out of past samples.
+void PolyphaseResampler::discardInput() {
+	const int firstNeeded = juce::jmin(static_cast<int>(position) - (historyLength - 1), inputFill);
+	if (firstNeeded <= 0) {
+		return;
+	}
+
+	const int numToKeep = inputFill - firstNeeded;
+	for (auto channel = 0; channel < 2; ++channel) {
+		float* data = inputBuffer.getWritePointer(channel);
+		if (numToKeep > 0) {
+			std::memmove(data, data + firstNeeded, sizeof(float) * static_cast<size_t>(numToKeep));
+		}
+	}
+
+	inputFill = numToKeep;
+	position -= firstNeeded;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// PolyphaseResampler is a drop-in replacement for juce::ResamplingAudioSource that reads its input
+// at any ratio through a windowed-sinc interpolator.
+// The kernels are precomputed once per process as polyphase tables (one row per fractional position,
+// with linear interpolation between neighbouring rows), for several quality tiers and for a set of
+// ratios above 1, where the cutoff is lowered with the ratio so that speeding up does not alias.
+// The inner loop filters both channels with the same SSE/NEON instructions. Processing never
+// allocates; all setters are meant to be called from the audio thread.
+class PolyphaseResampler : public juce::AudioSource {
+public:
+
+	// Quality tiers, from the cheapest to the cleanest. The numbers are the kernel lengths at a ratio of 1.
+	enum Quality {
+		draft = 0,     // 8 taps
+		standard,      // 16 taps
+		high,          // 32 taps
+		best,          // 64 taps
+		numQualities
+	};
+
+	// Constructor for the PolyphaseResampler class.
+	// Parameters:
+	// - input: The source to read from, which is not owned by the resampler.
+	PolyphaseResampler(juce::AudioSource* input);
+
+	// Method to prepare the resampler and its input for playback.
+	// Parameters:
+	// - samplesPerBlockExpected: The number of audio samples expected per block.
+	// - sampleRate: The sample rate of the audio.
+	void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+	// Method to release the resources of the input.
+	void releaseResources() override;
+
+	// Method to fill the buffer with the next block of resampled audio.
+	// Parameters:
+	// - bufferToFill: Contains the buffer information to be filled with audio data.
+	void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+	// Method to set how many input samples are read for every output sample, which takes effect from the next block.
+	// Parameters:
+	// - ratio: The resampling ratio, limited to the range [minimumRatio, maximumRatio].
+	void setResamplingRatio(double ratio);
+
+	// Method to return the current resampling ratio.
+	double getResamplingRatio() const;
+
+	// Method to return how far the resampler has read its input ahead of the centre of the next output sample's
+	// kernel, which depends on the kernel length and on where the last read left off.
+	// Returns:
+	// - The distance in input samples.
+	double getLatency() const;
+
+	// Method to choose the quality tier, which takes effect from the next block.
+	// Parameters:
+	// - quality: One of the Quality values.
+	void setQuality(Quality quality);
+
+	// Method to clear the buffered input, so that the next block starts from silence.
+	void flushBuffers();
+
+	// Range of ratios accepted by setResamplingRatio().
+	static constexpr double minimumRatio = 1.0 / 16.0;
+	static constexpr double maximumRatio = 8.0;
+
+private:
+
+	// Method to pick the kernel table for the current quality and ratio.
+	void selectKernel();
+
+	// Method to read more samples from the input until the buffer holds at least a given number of samples.
+	void fillInput(int numSamplesNeeded);
+
+	// Method to drop input samples that are no longer part of any kernel, moving the rest to the start of the buffer.
+	void discardInput();
+
+	// Largest number of output samples produced between two reads from the input.
+	static constexpr int maxChunkSize = 256;
+
+	// Source the resampler reads from.
+	juce::AudioSource* input;
+
+	// Input audio waiting to be filtered, always two channels.
+	juce::AudioBuffer<float> inputBuffer;
+
+	// Number of valid samples at the start of inputBuffer.
+	int inputFill = 0;
+
+	// Position of the next output sample within inputBuffer, in input samples.
+	double position = 0;
+
+	// Number of past input samples kept in front of the position, enough for the longest kernel.
+	int historyLength = 0;
+
+	// Current ratio and quality tier.
+	double resamplingRatio = 1.0;
+	Quality quality = high;
+
+	// Kernel used for the current quality and ratio: numPhases + 1 rows of numTaps coefficients each.
+	const float* kernel = nullptr;
+	int numTaps = 0;
+};
@@ -0,0 +1,135 @@
+#include <JuceHeader.h>
+#include "PolyphaseResampler.h"
+
+
+namespace {
+	// Sample rate the tests run at, and the lengths of audio skipped while the kernel fills and then measured.
+	constexpr double testSampleRate = 44100.0;
+	constexpr int settleSamples = 2048;
+	constexpr int measuredSamples = 16384;
+
+	// Highest THD+N allowed at each quality, in dB below the tone, with a few dB of margin over what the tiers reach.
+	constexpr double maxDistortionDb[PolyphaseResampler::numQualities] = { -40.0, -55.0, -75.0, -95.0 };
+
+	// Highest level allowed of a tone that lands above the output Nyquist frequency, in dB below the tone.
+	constexpr double maxAliasDb[PolyphaseResampler::numQualities] = { -40.0, -55.0, -70.0, -85.0 };
+
+	// A sine at full scale on both channels, computed from the sample index so that it carries no error of its own.
+	class SineSource : public juce::AudioSource {
+	public:
+		SineSource(double _frequency) : frequency(_frequency) {}
+
+		void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override {}
+		void releaseResources() override {}
+		void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override {
+			for (auto i = 0; i < bufferToFill.numSamples; ++i) {
+				const float sample = static_cast<float>(std::sin(juce::MathConstants<double>::twoPi * frequency * static_cast<double>(position++) / testSampleRate));
+				for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel) {
+					bufferToFill.buffer->setSample(channel, bufferToFill.startSample + i, sample);
+				}
+			}
+		}
+
+	private:
+		double frequency;
+		juce::int64 position = 0;
+	};
+
+	// Run a sine through a resampler, and return the left channel of the output after the kernel has filled.
+	std::vector<double> resampleSine(PolyphaseResampler::Quality quality, double frequency, double ratio) {
+		SineSource sine(frequency);
+		PolyphaseResampler resampler(&sine);
+		resampler.setQuality(quality);
+		resampler.setResamplingRatio(ratio);
+		resampler.prepareToPlay(512, testSampleRate);
+
+		juce::AudioBuffer<float> block(2, 512);
+		std::vector<double> output;
+		for (auto done = 0; done < settleSamples + measuredSamples; done += block.getNumSamples()) {
+			resampler.getNextAudioBlock(juce::AudioSourceChannelInfo(block));
+			if (done >= settleSamples) {
+				for (auto i = 0; i < block.getNumSamples(); ++i) {
+					output.push_back(block.getSample(0, i));
+				}
+			}
+		}
+		return output;
+	}
+
+	// Level of what is left of a signal once the best-fitting sine at a frequency is taken out, in dB below a
+	// full-scale sine. Fitting the sine rather than comparing with the input ignores the delay and the gentle roll-off
+	// of the kernel, so that only distortion and noise are counted.
+	double measureResidualDb(const std::vector<double>& signal, double frequency) {
+		const double step = juce::MathConstants<double>::twoPi * frequency / testSampleRate;
+		double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+		for (size_t n = 0; n < signal.size(); ++n) {
+			const double s = std::sin(step * static_cast<double>(n));
+			const double c = std::cos(step * static_cast<double>(n));
+			ss += s * s;
+			sc += s * c;
+			cc += c * c;
+			ys += signal[n] * s;
+			yc += signal[n] * c;
+		}
+		const double determinant = ss * cc - sc * sc;
+		const double a = (ys * cc - yc * sc) / determinant;
+		const double b = (yc * ss - ys * sc) / determinant;
+
+		double residual = 0;
+		for (size_t n = 0; n < signal.size(); ++n) {
+			const double e = signal[n] - a * std::sin(step * static_cast<double>(n)) - b * std::cos(step * static_cast<double>(n));
+			residual += e * e;
+		}
+		return 10.0 * std::log10(residual / static_cast<double>(signal.size()) / 0.5 + 1.0e-30);
+	}
+
+	// Level of a signal in dB below a full-scale sine.
+	double measureLevelDb(const std::vector<double>& signal) {
+		double sum = 0;
+		for (const double sample : signal) {
+			sum += sample * sample;
+		}
+		return 10.0 * std::log10(sum / static_cast<double>(signal.size()) / 0.5 + 1.0e-30);
+	}
+
+	const char* const qualityNames[] = { "draft", "standard", "high", "best" };
+}
+
+
+// PolyphaseResamplerTests checks the distortion of every quality tier on tones within the deck's speed range, and
+// that a tone pushed above the output Nyquist frequency is filtered out at every ratio up to maximumRatio rather than
+// folded back down. Run with "--run-tests".
+class PolyphaseResamplerTests : public juce::UnitTest {
+public:
+	PolyphaseResamplerTests() : juce::UnitTest("PolyphaseResampler", "DSP") {}
+
+	void runTest() override {
+		beginTest("THD+N of a sine within the speed range");
+		// A low tone sped up, and a high tone slowed down, at the edges of the speed slider.
+		const double distortionCases[][2] = { { 1000.0, 1.08 }, { 15000.0, 0.92 }, { 5000.0, 1.0 } };
+		for (auto quality = 0; quality < PolyphaseResampler::numQualities; ++quality) {
+			for (const auto& test : distortionCases) {
+				const double frequency = test[0], ratio = test[1];
+				const auto output = resampleSine(static_cast<PolyphaseResampler::Quality>(quality), frequency, ratio);
+				const double distortion = measureResidualDb(output, frequency * ratio);
+				expectLessThan(distortion, maxDistortionDb[quality],
+					juce::String(qualityNames[quality]) + " at " + juce::String(frequency, 0) + " Hz, ratio " + juce::String(ratio, 2));
+			}
+		}
+
+		beginTest("Aliasing of a tone raised above the output Nyquist frequency");
+		// The tone is read at the input frequency that the ratio raises to 0.7 of the sample rate, which would fold
+		// back to 0.3 of it. The ratios cover each design ratio and the ranges between them, up to maximumRatio.
+		const double aliasRatios[] = { 1.5, 2.5, 3.5, 4.0, 5.0, 6.0, 7.0, PolyphaseResampler::maximumRatio };
+		for (auto quality = 0; quality < PolyphaseResampler::numQualities; ++quality) {
+			for (const double ratio : aliasRatios) {
+				const double frequency = 0.7 * testSampleRate / ratio;
+				const auto output = resampleSine(static_cast<PolyphaseResampler::Quality>(quality), frequency, ratio);
+				expectLessThan(measureLevelDb(output), maxAliasDb[quality],
+					juce::String(qualityNames[quality]) + " at ratio " + juce::String(ratio, 2));
+			}
+		}
+	}
+};
+
+static PolyphaseResamplerTests polyphaseResamplerTests;
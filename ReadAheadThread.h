@@ -0,0 +1,21 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// ReadAheadThread is the background thread that reads audio from disk ahead of the playhead for every deck.
+// Decks hold it through a juce::SharedResourcePointer, so all of them share one thread, which is started
+// with the first deck and stopped when the last deck goes away. Each deck registers its own
+// BufferingAudioSource with it as a TimeSliceClient.
+class ReadAheadThread : public juce::TimeSliceThread {
+public:
+
+	// Constructor that starts the thread straight away.
+	ReadAheadThread() : juce::TimeSliceThread("Deck read-ahead") {
+		startThread();
+	}
+
+	// Destructor that waits for the thread to finish the chunk it is reading.
+	~ReadAheadThread() override {
+		stopThread(4000);
+	}
+};
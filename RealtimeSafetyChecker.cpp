@@ -0,0 +1,422 @@
+#include "RealtimeSafetyChecker.h"
+
+#if REALTIME_SAFETY_CHECKS
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <cstdarg>
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <unistd.h>
+ #define REALTIME_SAFETY_INTERPOSE_POSIX 1
+#endif
+
+#if JUCE_LINUX && defined(__GLIBC__)
+ #define REALTIME_SAFETY_INTERPOSE_MALLOC 1
+
+// The C library's own allocator, which the interposed malloc and free forward to.
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void __libc_free(void* pointer);
+#endif
+
+#if JUCE_WINDOWS
+extern "C" __declspec(dllimport) unsigned short __stdcall RtlCaptureStackBackTrace(unsigned long framesToSkip,
+	unsigned long framesToCapture, void** backTrace, unsigned long* backTraceHash);
+#endif
+
+
+namespace {
+	// A violation waiting to be reported.
+	struct Record {
+		RealtimeSafetyChecker::Violation violation = RealtimeSafetyChecker::allocation;
+		const char* function = "";
+		void* frames[RealtimeSafetyChecker::maxFrames];
+		int numFrames = 0;
+	};
+
+	// Violations waiting to be reported. Several realtime threads may record at once, so writers take the spin lock,
+	// which never waits in the kernel; the message thread is the only reader.
+	Record records[RealtimeSafetyChecker::recordCapacity];
+	juce::AbstractFifo recordFifo{ RealtimeSafetyChecker::recordCapacity };
+	juce::SpinLock recordLock;
+
+	std::atomic<int> numViolationsSeen{ 0 };
+	std::atomic<int> numDropped{ 0 };
+
+	// How deep the calling thread is in realtime sections, and whether it is recording a violation, so that the calls
+	// made while recording are not checked themselves.
+	thread_local int realtimeDepth = 0;
+	thread_local bool insideCheck = false;
+
+	// Capture the stack of the calling thread.
+	int captureStack(void** frames, int maxFrames) {
+#if JUCE_LINUX || JUCE_MAC
+		return backtrace(frames, maxFrames);
+#elif JUCE_WINDOWS
+		return RtlCaptureStackBackTrace(0, static_cast<unsigned long>(maxFrames), frames, nullptr);
+#else
+		return 0;
+#endif
+	}
+
+	// Hash the kind and the stack of a violation, so that one reached the same way is only reported once.
+	juce::uint64 hashRecord(const Record& record) {
+		juce::uint64 hash = 14695981039346656037ull;
+		hash = (hash ^ static_cast<juce::uint64>(record.violation)) * 1099511628211ull;
+		for (auto frame = 0; frame < record.numFrames; ++frame) {
+			hash = (hash ^ static_cast<juce::uint64>(reinterpret_cast<juce::pointer_sized_uint>(record.frames[frame]))) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	const char* getViolationName(RealtimeSafetyChecker::Violation violation) {
+		switch (violation) {
+		case RealtimeSafetyChecker::allocation: return "allocation";
+		case RealtimeSafetyChecker::deallocation: return "deallocation";
+		case RealtimeSafetyChecker::lock: return "lock";
+		default: return "blocking call";
+		}
+	}
+
+	// Write a violation and its stack to the debug log.
+	void reportRecord(const Record& record) {
+		juce::String message;
+		message << "Realtime safety violation: " << getViolationName(record.violation) << " in " << record.function
+			<< " on a realtime thread";
+#if REALTIME_SAFETY_INTERPOSE_POSIX
+		if (char** symbols = backtrace_symbols(record.frames, record.numFrames)) {
+			for (auto frame = 0; frame < record.numFrames; ++frame) {
+				message << "\n    " << symbols[frame];
+			}
+			free(symbols);
+		}
+#else
+		for (auto frame = 0; frame < record.numFrames; ++frame) {
+			message << "\n    0x" << juce::String::toHexString(static_cast<juce::pointer_sized_int>(reinterpret_cast<juce::pointer_sized_uint>(record.frames[frame])));
+		}
+#endif
+		DBG(message);
+	}
+
+#if REALTIME_SAFETY_INTERPOSE_POSIX
+	// Find the definition of a function that the interposed one hides, which is the C library's, and keep it.
+	// The cache is a plain atomic, since a function-local static with a guard could lock and call back in here.
+	template <typename Function>
+	Function findNext(std::atomic<void*>& cache, const char* name) {
+		void* function = cache.load(std::memory_order_acquire);
+		if (function == nullptr) {
+			function = dlsym(RTLD_NEXT, name);
+			cache.store(function, std::memory_order_release);
+		}
+		return reinterpret_cast<Function>(function);
+	}
+#endif
+}
+
+
+// Constructor for the RealtimeSafetyChecker class. The first stack capture can load the unwinder, so it is done here
+// rather than on a realtime thread.
+RealtimeSafetyChecker::RealtimeSafetyChecker()
+{
+	void* frames[1];
+	captureStack(frames, 1);
+	startTimer(reportIntervalMs);
+}
+
+
+RealtimeSafetyChecker::~RealtimeSafetyChecker()
+{
+	stopTimer();
+	timerCallback();
+
+	if (numViolationsSeen.load() > 0) {
+		DBG("Realtime safety: " << numViolationsSeen.load() << " violations from " << static_cast<int>(reportedStacks.size())
+			<< " places, " << numDropped.load() << " of them not recorded");
+	}
+}
+
+
+// Define the check() method for the RealtimeSafetyChecker class.
+void RealtimeSafetyChecker::check(Violation violation, const char* function) {
+	if (realtimeDepth == 0 || insideCheck) {
+		return;
+	}
+	insideCheck = true;
+	++numViolationsSeen;
+
+	Record record;
+	record.violation = violation;
+	record.function = function;
+	record.numFrames = captureStack(record.frames, maxFrames);
+
+	{
+		const juce::SpinLock::ScopedLockType sl(recordLock);
+		int start1, size1, start2, size2;
+		recordFifo.prepareToWrite(1, start1, size1, start2, size2);
+		if (size1 > 0) {
+			records[start1] = record;
+			recordFifo.finishedWrite(1);
+		}
+		else {
+			++numDropped;
+		}
+	}
+
+	insideCheck = false;
+}
+
+
+// Define the enterRealtimeSection() method for the RealtimeSafetyChecker class.
+void RealtimeSafetyChecker::enterRealtimeSection() {
+	++realtimeDepth;
+}
+
+
+// Define the exitRealtimeSection() method for the RealtimeSafetyChecker class.
+void RealtimeSafetyChecker::exitRealtimeSection() {
+	jassert(realtimeDepth > 0);
+	--realtimeDepth;
+}
+
+
+// Define the getNumViolations() method for the RealtimeSafetyChecker class.
+int RealtimeSafetyChecker::getNumViolations() {
+	return numViolationsSeen.load();
+}
+
+
+// Define the timerCallback() method for the RealtimeSafetyChecker class.
+void RealtimeSafetyChecker::timerCallback() {
+	int start1, size1, start2, size2;
+	recordFifo.prepareToRead(recordFifo.getNumReady(), start1, size1, start2, size2);
+	for (auto i = 0; i < size1 + size2; ++i) {
+		const Record& record = records[i < size1 ? start1 + i : start2 + i - size1];
+		if (++reportedStacks[hashRecord(record)] == 1) {
+			reportRecord(record);
+		}
+	}
+	recordFifo.finishedRead(size1 + size2);
+}
+
+
+#if REALTIME_SAFETY_INTERPOSE_MALLOC
+
+// The C allocator, interposed. operator new and delete call these, so they are caught too.
+extern "C" void* malloc(size_t size) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::allocation, "malloc");
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::allocation, "calloc");
+	return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::allocation, "realloc");
+	return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) {
+	if (pointer != nullptr) {
+		RealtimeSafetyChecker::check(RealtimeSafetyChecker::deallocation, "free");
+	}
+	__libc_free(pointer);
+}
+
+#else
+
+// The global operator new and delete, replaced.
+void* operator new(std::size_t size) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::allocation, "operator new");
+	if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::allocation, "operator new[]");
+	if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::allocation, "operator new");
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::allocation, "operator new[]");
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* pointer) noexcept {
+	if (pointer != nullptr) {
+		RealtimeSafetyChecker::check(RealtimeSafetyChecker::deallocation, "operator delete");
+	}
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	if (pointer != nullptr) {
+		RealtimeSafetyChecker::check(RealtimeSafetyChecker::deallocation, "operator delete[]");
+	}
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+	operator delete[](pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+	operator delete[](pointer);
+}
+
+#endif
+
+
+#if REALTIME_SAFETY_INTERPOSE_POSIX
+
+// Locks and waits of the pthread library, interposed.
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::lock, "pthread_mutex_lock");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(pthread_mutex_t*)>(next, "pthread_mutex_lock")(mutex);
+}
+
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::lock, "pthread_rwlock_rdlock");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(pthread_rwlock_t*)>(next, "pthread_rwlock_rdlock")(rwlock);
+}
+
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::lock, "pthread_rwlock_wrlock");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(pthread_rwlock_t*)>(next, "pthread_rwlock_wrlock")(rwlock);
+}
+
+extern "C" int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "pthread_cond_wait");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(pthread_cond_t*, pthread_mutex_t*)>(next, "pthread_cond_wait")(condition, mutex);
+}
+
+extern "C" int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "pthread_cond_timedwait");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(pthread_cond_t*, pthread_mutex_t*, const struct timespec*)>(next, "pthread_cond_timedwait")(condition, mutex, time);
+}
+
+extern "C" int pthread_join(pthread_t thread, void** result) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "pthread_join");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(pthread_t, void**)>(next, "pthread_join")(thread, result);
+}
+
+extern "C" int sem_wait(sem_t* semaphore) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "sem_wait");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(sem_t*)>(next, "sem_wait")(semaphore);
+}
+
+// File access, sleeping and polling of the C library, interposed.
+extern "C" int open(const char* path, int flags, ...) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "open");
+	mode_t mode = 0;
+	if ((flags & O_CREAT) != 0) {
+		va_list arguments;
+		va_start(arguments, flags);
+		mode = static_cast<mode_t>(va_arg(arguments, int));
+		va_end(arguments);
+	}
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(const char*, int, ...)>(next, "open")(path, flags, mode);
+}
+
+extern "C" ssize_t read(int file, void* buffer, size_t size) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "read");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<ssize_t (*)(int, void*, size_t)>(next, "read")(file, buffer, size);
+}
+
+extern "C" ssize_t write(int file, const void* buffer, size_t size) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "write");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<ssize_t (*)(int, const void*, size_t)>(next, "write")(file, buffer, size);
+}
+
+extern "C" ssize_t pread(int file, void* buffer, size_t size, off_t offset) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "pread");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<ssize_t (*)(int, void*, size_t, off_t)>(next, "pread")(file, buffer, size, offset);
+}
+
+extern "C" ssize_t pwrite(int file, const void* buffer, size_t size, off_t offset) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "pwrite");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<ssize_t (*)(int, const void*, size_t, off_t)>(next, "pwrite")(file, buffer, size, offset);
+}
+
+extern "C" int fsync(int file) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "fsync");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(int)>(next, "fsync")(file);
+}
+
+extern "C" int usleep(useconds_t microseconds) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "usleep");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(useconds_t)>(next, "usleep")(microseconds);
+}
+
+extern "C" int nanosleep(const struct timespec* requested, struct timespec* remaining) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "nanosleep");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(const struct timespec*, struct timespec*)>(next, "nanosleep")(requested, remaining);
+}
+
+extern "C" int poll(struct pollfd* files, nfds_t numFiles, int timeoutMs) {
+	RealtimeSafetyChecker::check(RealtimeSafetyChecker::blockingCall, "poll");
+	static std::atomic<void*> next{ nullptr };
+	return findNext<int (*)(struct pollfd*, nfds_t, int)>(next, "poll")(files, numFiles, timeoutMs);
+}
+
+#endif
+
+#else
+
+RealtimeSafetyChecker::RealtimeSafetyChecker()
+{
+}
+
+
+RealtimeSafetyChecker::~RealtimeSafetyChecker()
+{
+}
+
+
+// Without the checks, a realtime section marks nothing and nothing is checked.
+void RealtimeSafetyChecker::check(Violation violation, const char* function) {}
+void RealtimeSafetyChecker::enterRealtimeSection() {}
+void RealtimeSafetyChecker::exitRealtimeSection() {}
+int RealtimeSafetyChecker::getNumViolations() { return 0; }
+void RealtimeSafetyChecker::timerCallback() {}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+#include <JuceHeader.h>
+
+// The checks are built into debug builds only, unless the project sets REALTIME_SAFETY_CHECKS itself.
+#ifndef REALTIME_SAFETY_CHECKS
+ #define REALTIME_SAFETY_CHECKS JUCE_DEBUG
+#endif
+
+
+// RealtimeSafetyChecker catches the audio threads doing things that can make them miss their deadline: allocating or
+// freeing memory, locking a mutex, and making system calls that can block, such as reading or writing files,
+// sleeping and waiting on a condition.
+// Code is checked while a ScopedRealtimeSection lives on its thread, which the audio callback and the deck renders
+// open. Each violation is recorded with a stack trace from inside the call that caused it, into a fixed ring that
+// neither allocates nor blocks, and a RealtimeSafetyChecker on the message thread writes it to the debug log the
+// first time its stack is seen, and a count of them all when it is destroyed.
+// Allocations are caught by interposing malloc and free on Linux, which also catches C code, and by replacing the
+// global operator new and delete elsewhere. On Linux and macOS, mutex locks and blocking calls are caught by
+// interposing the pthread and libc functions, so JUCE, which is built into the app, is checked as well as this
+// code; on Windows only allocations are caught. None of it is built into a release build.
+class RealtimeSafetyChecker : private juce::Timer {
+public:
+
+	// The kinds of calls that are not realtime safe.
+	enum Violation {
+		allocation = 0,
+		deallocation,
+		lock,
+		blockingCall,
+		numViolations
+	};
+
+	// Marks the code run while it lives, on the thread that made it, as code that must be realtime safe. Sections
+	// may nest.
+	class ScopedRealtimeSection {
+	public:
+		ScopedRealtimeSection() {
+#if REALTIME_SAFETY_CHECKS
+			enterRealtimeSection();
+#endif
+		}
+
+		~ScopedRealtimeSection() {
+#if REALTIME_SAFETY_CHECKS
+			exitRealtimeSection();
+#endif
+		}
+
+		JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+	};
+
+	// Constructor for the RealtimeSafetyChecker class, which starts reporting violations.
+	RealtimeSafetyChecker();
+
+	// Destructor that reports the violations not reported yet.
+	~RealtimeSafetyChecker() override;
+
+	// Method called by the interposed functions before they do anything. Records a violation when the calling
+	// thread is in a realtime section; safe from any thread, at any time.
+	// Parameters:
+	// - violation: The kind of call.
+	// - function: The name of the function called.
+	static void check(Violation violation, const char* function);
+
+	// Methods to mark the start and the end of a realtime section on the calling thread.
+	static void enterRealtimeSection();
+	static void exitRealtimeSection();
+
+	// Method to return the number of violations seen so far, including repeats and the ones not reported yet.
+	static int getNumViolations();
+
+	// Number of violations that can wait to be reported, and number of stack frames kept for each.
+	static constexpr int recordCapacity = 64;
+	static constexpr int maxFrames = 32;
+
+	// Interval at which violations are reported, in milliseconds.
+	static constexpr int reportIntervalMs = 500;
+
+private:
+
+	// Method called on the message thread to report the violations recorded since the last call.
+	void timerCallback() override;
+
+	// Hashes of the stacks already reported, and how often each has been seen since.
+	std::map<juce::uint64, int> reportedStacks;
+};
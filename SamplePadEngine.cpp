@@ -0,0 +1,387 @@
+#include "SamplePadEngine.h"
+#include "PolyphaseResampler.h"
+
+namespace {
+
+	// Longest sample a pad accepts, in seconds, so that dropping a whole track on a pad does not fill the memory.
+	const double maxSampleSeconds = 30.0;
+
+	// Block size used when resampling a sample.
+	const int resampleBlockSize = 4096;
+
+	// Add a section of a stereo sample to a buffer, with a gain ramping linearly from startGain to endGain.
+	void addSegment(const juce::AudioBuffer<float>& source, int sourceStart, juce::AudioBuffer<float>& dest, int destStart, int numSamples, float startGain, float endGain) {
+		const int numChannels = juce::jmin(2, dest.getNumChannels());
+		for (auto channel = 0; channel < numChannels; ++channel) {
+			const float* in = source.getReadPointer(channel, sourceStart);
+			float* out = dest.getWritePointer(channel, destStart);
+
+			if (startGain == endGain) {
+				juce::FloatVectorOperations::addWithMultiply(out, in, startGain, numSamples);
+			}
+			else {
+				const float step = (endGain - startGain) / numSamples;
+				for (auto i = 0; i < numSamples; ++i) {
+					out[i] += in[i] * (startGain + step * i);
+				}
+			}
+		}
+	}
+
+}
+
+
+SamplePadEngine::SamplePadEngine(juce::AudioFormatManager& _formatManager)
+	: formatManager(_formatManager)
+{
+	startTimer(deleteIntervalMs);
+}
+
+
+SamplePadEngine::~SamplePadEngine()
+{
+	stopTimer();
+	cancelPendingUpdate();
+	deleteRetiredBanks();
+
+	// The latest bank is either the pending or the current one.
+	delete pendingBank.exchange(nullptr);
+	delete currentBank;
+	delete previousBank;
+}
+
+
+// Define the prepareToPlay() method for the SamplePadEngine class.
+// The bank is owned by the message thread, so the check for a new sample rate is left to handleAsyncUpdate().
+void SamplePadEngine::prepareToPlay(int samplesPerBlockExpected, double newSampleRate) {
+	sampleRate.store(newSampleRate);
+	clock.prepare(newSampleRate);
+
+	for (auto& voice : voices) {
+		voice = Voice();
+	}
+
+	triggerAsyncUpdate();
+}
+
+
+// Define the process() method for the SamplePadEngine class.
+void SamplePadEngine::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+	swapPendingBank();
+	clock.beginBlock();
+
+	// Start a voice for every hit that has arrived since the last block, at the matching point of this block.
+	const int numReady = eventFifo.getNumReady();
+	if (numReady > 0) {
+		int start1, size1, start2, size2;
+		eventFifo.prepareToRead(numReady, start1, size1, start2, size2);
+		for (auto i = 0; i < size1 + size2; ++i) {
+			const PadEvent& event = events[i < size1 ? start1 + i : start2 + i - size1];
+			startVoice(event.pad, event.gain, clock.getSampleOffset(event.time, numSamples));
+		}
+		eventFifo.finishedRead(size1 + size2);
+	}
+
+	for (auto& voice : voices) {
+		if (voice.tail.sample != nullptr) {
+			renderNote(voice.tail, buffer, startSample, numSamples);
+		}
+		if (voice.note.sample != nullptr) {
+			renderNote(voice.note, buffer, startSample, numSamples);
+		}
+	}
+}
+
+
+// Define the startVoice() method for the SamplePadEngine class.
+// A voice that is completely idle is preferred, then one whose stolen tail is still fading, and only then is the
+// oldest hit stolen. The stolen hit keeps playing until the new one starts and then fades out as its tail.
+void SamplePadEngine::startVoice(int pad, float gain, int offset) {
+	if (currentBank == nullptr || currentBank->pads[pad] == nullptr || currentBank->pads[pad]->audio.getNumSamples() == 0) {
+		return;
+	}
+
+	Voice* chosen = nullptr;
+	for (auto& voice : voices) {
+		if (voice.note.sample == nullptr && voice.tail.sample == nullptr) {
+			chosen = &voice;
+			break;
+		}
+	}
+	if (chosen == nullptr) {
+		for (auto& voice : voices) {
+			if (voice.note.sample == nullptr) {
+				chosen = &voice;
+				break;
+			}
+		}
+	}
+	if (chosen == nullptr) {
+		chosen = &voices[0];
+		for (auto& voice : voices) {
+			if (startCount - voice.note.startCount > startCount - chosen->note.startCount) {
+				chosen = &voice;
+			}
+		}
+		chosen->tail = chosen->note;
+		chosen->tail.fadeDelay = offset;
+		chosen->tail.fadeRemaining = stealFadeSamples;
+	}
+
+	Note& note = chosen->note;
+	note = Note();
+	note.sample = currentBank->pads[pad].get();
+	note.bank = currentBank;
+	note.gain = gain;
+	note.delay = offset;
+	note.startCount = ++startCount;
+}
+
+
+// Define the renderNote() method for the SamplePadEngine class.
+// The block is cut into segments at the start of the note and at the start of its fade, so that the gain is
+// constant or a single ramp within each segment. The delays are relative to the start of the block.
+void SamplePadEngine::renderNote(Note& note, juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+	const juce::AudioBuffer<float>& audio = note.sample->audio;
+	int i = note.delay;
+	note.delay = 0;
+
+	while (i < numSamples) {
+		int n = juce::jmin(numSamples - i, audio.getNumSamples() - note.position);
+		float startGain = note.gain;
+		float endGain = note.gain;
+
+		if (note.fadeDelay > i) {
+			n = juce::jmin(n, note.fadeDelay - i);
+		}
+		else if (note.fadeDelay >= 0) {
+			n = juce::jmin(n, note.fadeRemaining);
+			startGain = note.gain * note.fadeRemaining / stealFadeSamples;
+			endGain = note.gain * (note.fadeRemaining - n) / stealFadeSamples;
+			note.fadeRemaining -= n;
+		}
+
+		addSegment(audio, note.position, buffer, startSample + i, n, startGain, endGain);
+		note.position += n;
+		i += n;
+
+		if (note.position >= audio.getNumSamples() || (note.fadeDelay >= 0 && note.fadeDelay < i && note.fadeRemaining == 0)) {
+			note.sample = nullptr;
+			return;
+		}
+	}
+
+	// A fade that has started carries on from the start of the next block.
+	if (note.fadeDelay > 0) {
+		note.fadeDelay = 0;
+	}
+}
+
+
+// Define the trigger() method for the SamplePadEngine class.
+// A hit is dropped if the queue is full, which only happens when the audio thread is not running.
+void SamplePadEngine::trigger(int pad, float gain) {
+	if (pad < 0 || pad >= numPads) {
+		return;
+	}
+
+	int start1, size1, start2, size2;
+	eventFifo.prepareToWrite(1, start1, size1, start2, size2);
+	if (size1 + size2 == 0) {
+		return;
+	}
+
+	PadEvent& event = events[size1 > 0 ? start1 : start2];
+	event.pad = pad;
+	event.gain = gain;
+	event.time = BlockClock::now();
+	eventFifo.finishedWrite(1);
+}
+
+
+// Define the loadSample() method for the SamplePadEngine class.
+bool SamplePadEngine::loadSample(int pad, const juce::File& file) {
+	if (pad < 0 || pad >= numPads) {
+		return false;
+	}
+
+	auto sample = readSample(file, sampleRate.load());
+	if (sample == nullptr) {
+		DBG("SamplePadEngine::loadSample: could not read " << file.getFullPathName());
+		return false;
+	}
+
+	// The other pads keep sharing their samples with the bank being replaced.
+	std::unique_ptr<Bank> newBank(latestBank != nullptr ? new Bank(*latestBank) : new Bank());
+	newBank->pads[pad] = sample;
+	if (latestBank == nullptr) {
+		newBank->sampleRate = sampleRate.load();
+	}
+	publishBank(std::move(newBank));
+	return true;
+}
+
+
+// Define the loadPack() method for the SamplePadEngine class.
+int SamplePadEngine::loadPack(const juce::File& folder) {
+	juce::Array<juce::File> files;
+	for (const auto& file : folder.findChildFiles(juce::File::findFiles, false)) {
+		if (formatManager.findFormatForFileExtension(file.getFileExtension()) != nullptr) {
+			files.add(file);
+		}
+	}
+	files.sort();
+
+	int numLoaded = 0;
+	for (auto i = 0; i < files.size() && numLoaded < numPads; ++i) {
+		if (loadSample(numLoaded, files[i])) {
+			++numLoaded;
+		}
+	}
+
+	DBG("SamplePadEngine::loadPack: loaded " << numLoaded << " pads from " << folder.getFileName());
+	return numLoaded;
+}
+
+
+// Define the readSample() method for the SamplePadEngine class, which reads a file in full and makes it stereo.
+std::shared_ptr<const SamplePadEngine::PadSample> SamplePadEngine::readSample(const juce::File& file, double targetRate) const {
+	std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+	if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0) {
+		return nullptr;
+	}
+
+	const int length = static_cast<int>(juce::jmin<juce::int64>(reader->lengthInSamples, static_cast<juce::int64>(maxSampleSeconds * reader->sampleRate)));
+	juce::AudioBuffer<float> original(2, length);
+	reader->read(&original, 0, length, 0, true, true);
+	if (reader->numChannels == 1) {
+		original.copyFrom(1, 0, original, 0, 0, length);
+	}
+	return makeSample(original, reader->sampleRate, targetRate);
+}
+
+
+// Define the makeSample() method for the SamplePadEngine class.
+// The audio is converted to the device rate once, with the best resampler tier, so that voices only ever copy it.
+std::shared_ptr<const SamplePadEngine::PadSample> SamplePadEngine::makeSample(const juce::AudioBuffer<float>& original, double originalRate, double targetRate) {
+	auto sample = std::make_shared<PadSample>();
+	sample->original.makeCopyOf(original);
+	sample->originalRate = originalRate;
+
+	// Until the device rate is known the sample is kept at its own rate.
+	if (targetRate <= 0 || targetRate == originalRate) {
+		sample->audio.makeCopyOf(original);
+		return sample;
+	}
+
+	const double ratio = originalRate / targetRate;
+	juce::MemoryAudioSource input(sample->original, false);
+	PolyphaseResampler resampler(&input);
+	resampler.setQuality(PolyphaseResampler::best);
+	resampler.setResamplingRatio(ratio);
+	resampler.prepareToPlay(resampleBlockSize, targetRate);
+
+	const int length = static_cast<int>(std::ceil(original.getNumSamples() / ratio));
+	sample->audio.setSize(2, length);
+	for (auto position = 0; position < length; position += resampleBlockSize) {
+		resampler.getNextAudioBlock(juce::AudioSourceChannelInfo(&sample->audio, position, juce::jmin(resampleBlockSize, length - position)));
+	}
+	return sample;
+}
+
+
+// Define the handleAsyncUpdate() method for the SamplePadEngine class, which resamples every pad from its original audio.
+void SamplePadEngine::handleAsyncUpdate() {
+	const double targetRate = sampleRate.load();
+	if (latestBank == nullptr || latestBank->sampleRate == targetRate) {
+		return;
+	}
+
+	std::unique_ptr<Bank> newBank(new Bank());
+	for (auto pad = 0; pad < numPads; ++pad) {
+		if (const auto& old = latestBank->pads[pad]) {
+			newBank->pads[pad] = makeSample(old->original, old->originalRate, targetRate);
+		}
+	}
+	newBank->sampleRate = targetRate;
+	publishBank(std::move(newBank));
+}
+
+
+// Define the publishBank() method for the SamplePadEngine class.
+void SamplePadEngine::publishBank(std::unique_ptr<Bank> newBank) {
+	latestBank = newBank.get();
+
+	// A bank that was handed over but never picked up was not seen by the audio thread, so it can go straight away.
+	delete pendingBank.exchange(newBank.release());
+}
+
+
+// Define the swapPendingBank() method for the SamplePadEngine class.
+// Voices playing from the replaced bank carry on, so it is only retired once the last of them has finished. A newer
+// bank waits until then, which keeps at most two banks in use by the audio thread.
+void SamplePadEngine::swapPendingBank() {
+	if (previousBank != nullptr && !isBankInUse(previousBank) && retiredFifo.getFreeSpace() > 0) {
+		retireBank(previousBank);
+		previousBank = nullptr;
+	}
+
+	if (pendingBank.load() == nullptr || previousBank != nullptr || retiredFifo.getFreeSpace() == 0) {
+		return;
+	}
+
+	if (currentBank != nullptr) {
+		if (isBankInUse(currentBank)) {
+			previousBank = currentBank;
+		}
+		else {
+			retireBank(currentBank);
+		}
+	}
+	currentBank = pendingBank.exchange(nullptr);
+}
+
+
+// Define the retireBank() method for the SamplePadEngine class.
+void SamplePadEngine::retireBank(Bank* bank) {
+	int start1, size1, start2, size2;
+	retiredFifo.prepareToWrite(1, start1, size1, start2, size2);
+	retiredBanks[size1 > 0 ? start1 : start2] = bank;
+	retiredFifo.finishedWrite(1);
+}
+
+
+// Define the isBankInUse() method for the SamplePadEngine class.
+bool SamplePadEngine::isBankInUse(const Bank* bank) const {
+	for (const auto& voice : voices) {
+		if ((voice.note.sample != nullptr && voice.note.bank == bank) || (voice.tail.sample != nullptr && voice.tail.bank == bank)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Define the timerCallback() method for the SamplePadEngine class.
+void SamplePadEngine::timerCallback() {
+	deleteRetiredBanks();
+}
+
+
+// Define the deleteRetiredBanks() method for the SamplePadEngine class.
+void SamplePadEngine::deleteRetiredBanks() {
+	const int numReady = retiredFifo.getNumReady();
+	if (numReady == 0) {
+		return;
+	}
+
+	int start1, size1, start2, size2;
+	retiredFifo.prepareToRead(numReady, start1, size1, start2, size2);
+	for (auto i = 0; i < size1; ++i) {
+		delete retiredBanks[start1 + i];
+	}
+	for (auto i = 0; i < size2; ++i) {
+		delete retiredBanks[start2 + i];
+	}
+	retiredFifo.finishedRead(size1 + size2);
+}
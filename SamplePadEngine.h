@@ -0,0 +1,184 @@
+#pragma once
+#include <JuceHeader.h>
+#include "BlockClock.h"
+
+
+// SamplePadEngine plays the sample pads of a deck from RAM.
+// Every sample is read from disk once, when it is loaded, and resampled to the device rate with the deck's
+// polyphase resampler, so that triggering a pad costs nothing but starting a voice. Pads are triggered from the
+// message thread through a lock-free event queue and start at a sample-accurate offset inside the block (see
+// BlockClock). A fixed pool of voices plays them; when all are busy the oldest is stolen and faded out over a
+// few milliseconds instead of being cut.
+// The samples of all pads form an immutable bank. Loading a sample builds a new bank on the message thread and
+// hands it to the audio thread through an atomic pointer; the old bank is deleted on the message thread once no
+// voice is playing from it.
+class SamplePadEngine : private juce::AsyncUpdater,
+	private juce::Timer {
+public:
+
+	// The pads, in the order of the buttons of a deck.
+	enum Pad {
+		kick = 0,
+		snare,
+		hiHat,
+		clap,
+		numPads
+	};
+
+	// Constructor for the SamplePadEngine class.
+	// Parameters:
+	// - formatManager: The formats used to open samples.
+	SamplePadEngine(juce::AudioFormatManager& formatManager);
+
+	// Destructor that deletes every bank. The audio callback must have stopped.
+	~SamplePadEngine() override;
+
+	// Method to prepare the engine for playback. The samples are resampled again if the sample rate has changed.
+	// Parameters:
+	// - samplesPerBlockExpected: The number of audio samples expected per block.
+	// - sampleRate: The sample rate of the audio.
+	void prepareToPlay(int samplesPerBlockExpected, double sampleRate);
+
+	// Method to add the playing pads to a block of audio. Called on the audio thread once per block.
+	// Parameters:
+	// - buffer: The buffer to add to.
+	// - startSample: The first sample of the block.
+	// - numSamples: The length of the block.
+	void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+	// Method to load an audio file into a pad, replacing its sample. Called from the message thread.
+	// Parameters:
+	// - pad: The pad to load.
+	// - file: The audio file to read.
+	// Returns:
+	// - true if the file could be read.
+	bool loadSample(int pad, const juce::File& file);
+
+	// Method to load a sample pack: the audio files in a folder, in alphabetical order, go to the pads in order.
+	// Parameters:
+	// - folder: The folder to read.
+	// Returns:
+	// - The number of pads that were loaded.
+	int loadPack(const juce::File& folder);
+
+	// Method to trigger a pad, which starts playing at the matching point of the next block. Called from the message thread.
+	// Parameters:
+	// - pad: The pad to play.
+	// - gain: The gain of the hit.
+	void trigger(int pad, float gain = 1.0f);
+
+	// Number of pad hits that can play at the same time.
+	static constexpr int numVoices = 16;
+
+private:
+
+	// One sample: the audio as read from the file, always stereo, and the same audio at the device rate.
+	struct PadSample {
+		juce::AudioBuffer<float> original;
+		double originalRate = 0;
+		juce::AudioBuffer<float> audio;
+	};
+
+	// The samples of every pad, and the rate they have been resampled to (0 when not resampled yet).
+	// Unchanged samples are shared between consecutive banks.
+	struct Bank {
+		std::shared_ptr<const PadSample> pads[numPads];
+		double sampleRate = 0;
+	};
+
+	// A pad hit waiting in the queue.
+	struct PadEvent {
+		int pad = 0;
+		float gain = 1.0f;
+		double time = 0;
+	};
+
+	// One hit being played. It starts delay samples into the block; once fadeDelay reaches 0 it fades out over fadeRemaining samples.
+	struct Note {
+		const PadSample* sample = nullptr;
+		const Bank* bank = nullptr;
+		int position = 0;
+		float gain = 1.0f;
+		int delay = 0;
+		int fadeDelay = -1;
+		int fadeRemaining = 0;
+		juce::uint32 startCount = 0;
+	};
+
+	// A voice plays one hit, plus the fading tail of the hit it replaced when it was stolen.
+	struct Voice {
+		Note note;
+		Note tail;
+	};
+
+	// Method called on the message thread to resample the bank after the device rate has changed.
+	void handleAsyncUpdate() override;
+
+	// Method called regularly on the message thread to delete the banks retired by the audio thread.
+	void timerCallback() override;
+
+	// Method to read and resample a file, returning nullptr when it cannot be read.
+	std::shared_ptr<const PadSample> readSample(const juce::File& file, double sampleRate) const;
+
+	// Method to build a sample from its original audio, resampled to a given rate.
+	static std::shared_ptr<const PadSample> makeSample(const juce::AudioBuffer<float>& original, double originalRate, double sampleRate);
+
+	// Method to hand a new bank to the audio thread.
+	void publishBank(std::unique_ptr<Bank> newBank);
+
+	// Method to delete every bank waiting in the retired FIFO.
+	void deleteRetiredBanks();
+
+	// Method called on the audio thread to pick up a new bank, and to retire the previous one once no voice uses it.
+	void swapPendingBank();
+
+	// Method to push a bank into the retired FIFO on the audio thread.
+	void retireBank(Bank* bank);
+
+	// Method to start a hit on a free voice, stealing the oldest one if all are busy.
+	void startVoice(int pad, float gain, int offset);
+
+	// Method to add one note to a block, advancing it.
+	void renderNote(Note& note, juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+	// Method to check whether any voice is still playing from a bank.
+	bool isBankInUse(const Bank* bank) const;
+
+	// Number of pad hits that can wait between two blocks, and of retired banks that can wait to be deleted.
+	static constexpr int eventCapacity = 256;
+	static constexpr int retiredCapacity = 8;
+
+	// Length of the fade applied to a stolen voice, in samples.
+	static constexpr int stealFadeSamples = 64;
+
+	// Interval at which retired banks are deleted, in milliseconds.
+	static constexpr int deleteIntervalMs = 200;
+
+	juce::AudioFormatManager& formatManager;
+
+	// Latest bank built, owned by the message thread. Never retired until a newer one has been handed over.
+	Bank* latestBank = nullptr;
+
+	// Bank handed over and not yet picked up, the bank being played, and a replaced bank still used by some voices.
+	std::atomic<Bank*> pendingBank{ nullptr };
+	Bank* currentBank = nullptr;
+	Bank* previousBank = nullptr;
+
+	// Banks replaced by the audio thread and waiting for the message thread to delete them.
+	juce::AbstractFifo retiredFifo{ retiredCapacity };
+	Bank* retiredBanks[retiredCapacity] = {};
+
+	// Pad hits sent by the message thread to the audio thread.
+	juce::AbstractFifo eventFifo{ eventCapacity };
+	PadEvent events[eventCapacity];
+
+	// Voices and the number of hits started so far, used to find the oldest voice, owned by the audio thread.
+	Voice voices[numVoices];
+	juce::uint32 startCount = 0;
+
+	// Clock placing the hits inside the block.
+	BlockClock clock;
+
+	// Device sample rate, written when the engine is prepared.
+	std::atomic<double> sampleRate{ 0.0 };
+};
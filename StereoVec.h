@@ -0,0 +1,51 @@
+#pragma once
+#include <JuceHeader.h>
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <xmmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+
+// A pair of samples (left, right) that the per-sample DSP loops work on as one value.
+// On SSE the pair lives in the low half of an __m128, on NEON in a float32x2_t,
+// and anywhere else it is a plain pair of floats.
+namespace StereoVec {
+
+#if JUCE_USE_SSE_INTRINSICS
+	using Type = __m128;
+	inline Type loadPair(float l, float r) { return _mm_setr_ps(l, r, 0.0f, 0.0f); }
+	inline Type loadPair(const float* p) { return _mm_setr_ps(p[0], p[1], 0.0f, 0.0f); }
+	inline Type splat(float v) { return _mm_set1_ps(v); }
+	inline Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+	inline Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+	inline Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+	inline Type max(Type a, Type b) { return _mm_max_ps(a, b); }
+	inline Type abs(Type a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	inline void storePair(Type v, float* p) { _mm_storel_pi(reinterpret_cast<__m64*>(p), v); }
+#elif JUCE_USE_ARM_NEON
+	using Type = float32x2_t;
+	inline Type loadPair(float l, float r) { float tmp[2] = { l, r }; return vld1_f32(tmp); }
+	inline Type loadPair(const float* p) { return vld1_f32(p); }
+	inline Type splat(float v) { return vdup_n_f32(v); }
+	inline Type add(Type a, Type b) { return vadd_f32(a, b); }
+	inline Type sub(Type a, Type b) { return vsub_f32(a, b); }
+	inline Type mul(Type a, Type b) { return vmul_f32(a, b); }
+	inline Type max(Type a, Type b) { return vmax_f32(a, b); }
+	inline Type abs(Type a) { return vabs_f32(a); }
+	inline void storePair(Type v, float* p) { vst1_f32(p, v); }
+#else
+	struct Type { float l, r; };
+	inline Type loadPair(float l, float r) { return { l, r }; }
+	inline Type loadPair(const float* p) { return { p[0], p[1] }; }
+	inline Type splat(float v) { return { v, v }; }
+	inline Type add(Type a, Type b) { return { a.l + b.l, a.r + b.r }; }
+	inline Type sub(Type a, Type b) { return { a.l - b.l, a.r - b.r }; }
+	inline Type mul(Type a, Type b) { return { a.l * b.l, a.r * b.r }; }
+	inline Type max(Type a, Type b) { return { a.l > b.l ? a.l : b.l, a.r > b.r ? a.r : b.r }; }
+	inline Type abs(Type a) { return { std::abs(a.l), std::abs(a.r) }; }
+	inline void storePair(Type v, float* p) { p[0] = v.l; p[1] = v.r; }
+#endif
+
+}
@@ -0,0 +1,313 @@
+#include "TimeStretcher.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <xmmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace {
+
+	// Sum of a[i] * b[i], four products at a time. This is the inner loop of the similarity search.
+	float dotProduct(const float* a, const float* b, int numSamples) {
+		auto i = 0;
+		float sum = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+		__m128 acc = _mm_setzero_ps();
+		for (; i + 4 <= numSamples; i += 4) {
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, acc);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif JUCE_USE_ARM_NEON
+		float32x4_t acc = vdupq_n_f32(0);
+		for (; i + 4 <= numSamples; i += 4) {
+			acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+		}
+		const float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+		sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+
+		for (; i < numSamples; ++i) {
+			sum += a[i] * b[i];
+		}
+		return sum;
+	}
+
+	// Similarity of a candidate to the reference, normalised by the candidate's energy so that loud passages are not favoured.
+	float similarity(float correlation, float energy) {
+		return correlation / std::sqrt(energy + 1.0e-9f);
+	}
+
+}
+
+
+TimeStretcher::TimeStretcher(juce::AudioSource* _input)
+	: input(_input)
+{
+}
+
+
+// Define the prepareToPlay() method for the TimeStretcher class, which sizes every buffer for the new sample rate.
+void TimeStretcher::prepareToPlay(int samplesPerBlockExpected, double sampleRate) {
+	input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+	// The hop and the search radius are kept multiples of the decimation factor so that both search grids line up.
+	hopSize = juce::jmax(64, juce::roundToInt(sampleRate * frameLengthSeconds / (2 * searchDecimation)) * searchDecimation);
+	searchRadius = hopSize / 2;
+
+	window.allocate(2 * hopSize, true);
+	for (auto i = 0; i < 2 * hopSize; ++i) {
+		window[i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * i / (2 * hopSize));
+	}
+
+	// The buffer has to hold the previous frame's continuation, the whole search range of the next frame and one
+	// analysis hop at the fastest ratio, which four frame lengths cover with room to spare.
+	inputBuffer.setSize(2, 8 * hopSize);
+	overlapTail.setSize(2, hopSize);
+	outputFrame.setSize(2, hopSize);
+
+	reference.allocate(hopSize, true);
+	searchRegion.allocate(hopSize + 2 * searchRadius, true);
+	decimatedReference.allocate(hopSize / searchDecimation, true);
+	decimatedRegion.allocate((hopSize + 2 * searchRadius) / searchDecimation, true);
+
+	reset();
+}
+
+
+// Define the releaseResources() method for the TimeStretcher class.
+void TimeStretcher::releaseResources() {
+	input->releaseResources();
+}
+
+
+// Define the reset() method for the TimeStretcher class, which starts the stretcher again from silence.
+void TimeStretcher::reset() {
+	inputBuffer.clear();
+	overlapTail.clear();
+	outputFrame.clear();
+
+	// The first frame is centred after searchRadius samples of silence, so that the search never looks before the buffer.
+	inputFill = searchRadius;
+	analysisPosition = searchRadius;
+	previousFrameStart = 0;
+	hasPreviousFrame = false;
+
+	// Nothing is waiting to be handed out until the first frame has been built.
+	outputReadPosition = hopSize;
+}
+
+
+// Define the setEnabled() method for the TimeStretcher class.
+void TimeStretcher::setEnabled(bool shouldBeEnabled) {
+	if (shouldBeEnabled != enabled) {
+		enabled = shouldBeEnabled;
+		if (enabled) {
+			reset();
+		}
+	}
+}
+
+
+// Define the isEnabled() method for the TimeStretcher class.
+bool TimeStretcher::isEnabled() const {
+	return enabled;
+}
+
+
+// Define the setStretchRatio() method for the TimeStretcher class.
+void TimeStretcher::setStretchRatio(double ratio) {
+	stretchRatio = juce::jlimit(minimumRatio, maximumRatio, ratio);
+}
+
+
+// Define the getStretchRatio() method for the TimeStretcher class.
+double TimeStretcher::getStretchRatio() const {
+	return stretchRatio;
+}
+
+
+// Define the getLatency() method for the TimeStretcher class.
+// The next sample handed out comes from the frame placed at previousFrameStart, or once that frame is used up, from
+// the next one, which is placed around analysisPosition.
+double TimeStretcher::getLatency() const {
+	if (!enabled || hopSize == 0) {
+		return 0.0;
+	}
+
+	const double nextInputPosition = outputReadPosition < hopSize ? static_cast<double>(previousFrameStart + outputReadPosition) : analysisPosition;
+	return juce::jmax(0.0, inputFill - nextInputPosition);
+}
+
+
+// Define the getNextAudioBlock() method for the TimeStretcher class, which hands out finished frames and builds new ones as needed.
+void TimeStretcher::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
+	if (!enabled || hopSize == 0) {
+		input->getNextAudioBlock(bufferToFill);
+		return;
+	}
+
+	auto& buffer = *bufferToFill.buffer;
+	const int numChannels = juce::jmin(2, buffer.getNumChannels());
+
+	auto done = 0;
+	while (done < bufferToFill.numSamples) {
+		if (outputReadPosition >= hopSize) {
+			synthesiseFrame();
+		}
+
+		const int numToCopy = juce::jmin(bufferToFill.numSamples - done, hopSize - outputReadPosition);
+		for (auto channel = 0; channel < numChannels; ++channel) {
+			buffer.copyFrom(channel, bufferToFill.startSample + done, outputFrame, channel, outputReadPosition, numToCopy);
+		}
+
+		outputReadPosition += numToCopy;
+		done += numToCopy;
+	}
+
+	for (auto channel = numChannels; channel < buffer.getNumChannels(); ++channel) {
+		buffer.clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+	}
+}
+
+
+// Define the synthesiseFrame() method for the TimeStretcher class.
+// The new frame is placed at the best-matching position around analysisPosition; its first half completes the
+// previous frame's tail to give hopSize finished samples, and its second half becomes the new tail.
+void TimeStretcher::synthesiseFrame() {
+	const int nominalStart = static_cast<int>(analysisPosition);
+	fillInput(nominalStart + searchRadius + 2 * hopSize);
+
+	const int frameStart = nominalStart + (hasPreviousFrame ? findBestOffset(nominalStart) : 0);
+
+	for (auto channel = 0; channel < 2; ++channel) {
+		const float* frame = inputBuffer.getReadPointer(channel, frameStart);
+		float* output = outputFrame.getWritePointer(channel);
+		float* tail = overlapTail.getWritePointer(channel);
+
+		juce::FloatVectorOperations::copy(output, tail, hopSize);
+		juce::FloatVectorOperations::addWithMultiply(output, frame, window.get(), hopSize);
+		juce::FloatVectorOperations::multiply(tail, frame + hopSize, window.get() + hopSize, hopSize);
+	}
+	outputReadPosition = 0;
+
+	previousFrameStart = frameStart;
+	hasPreviousFrame = true;
+	analysisPosition += hopSize * stretchRatio;
+
+	discardInput();
+}
+
+
+// Define the fillInput() method for the TimeStretcher class, which pulls just enough audio from the input.
+void TimeStretcher::fillInput(int numSamplesNeeded) {
+	jassert(numSamplesNeeded <= inputBuffer.getNumSamples());
+
+	if (numSamplesNeeded > inputFill) {
+		juce::AudioSourceChannelInfo info(&inputBuffer, inputFill, numSamplesNeeded - inputFill);
+		input->getNextAudioBlock(info);
+		inputFill = numSamplesNeeded;
+	}
+}
+
+
+// Define the findBestOffset() method for the TimeStretcher class.
+// The candidates are compared on a mono mix: first every searchDecimation samples on a decimated copy,
+// then sample by sample around the best coarse match.
+int TimeStretcher::findBestOffset(int nominalStart) {
+	const int regionStart = nominalStart - searchRadius;
+	const int regionLength = hopSize + 2 * searchRadius;
+	const int continuationStart = previousFrameStart + hopSize;
+
+	// Build the mono reference and search region, plus their decimated versions (the mean of each group of samples).
+	const float* left = inputBuffer.getReadPointer(0);
+	const float* right = inputBuffer.getReadPointer(1);
+
+	for (auto i = 0; i < hopSize; ++i) {
+		reference[i] = left[continuationStart + i] + right[continuationStart + i];
+	}
+	for (auto i = 0; i < regionLength; ++i) {
+		searchRegion[i] = left[regionStart + i] + right[regionStart + i];
+	}
+	for (auto i = 0; i < hopSize / searchDecimation; ++i) {
+		float sum = 0;
+		for (auto k = 0; k < searchDecimation; ++k) {
+			sum += reference[i * searchDecimation + k];
+		}
+		decimatedReference[i] = sum;
+	}
+	for (auto i = 0; i < regionLength / searchDecimation; ++i) {
+		float sum = 0;
+		for (auto k = 0; k < searchDecimation; ++k) {
+			sum += searchRegion[i * searchDecimation + k];
+		}
+		decimatedRegion[i] = sum;
+	}
+
+	// Coarse search over every decimated lag, updating the candidate energy as the window slides.
+	const int decimatedLength = hopSize / searchDecimation;
+	const int numCoarseLags = 2 * searchRadius / searchDecimation + 1;
+
+	float energy = dotProduct(decimatedRegion.get(), decimatedRegion.get(), decimatedLength);
+	int bestLag = 0;
+	float bestScore = -std::numeric_limits<float>::max();
+
+	for (auto lag = 0; lag < numCoarseLags; ++lag) {
+		if (lag > 0) {
+			const float leaving = decimatedRegion[lag - 1];
+			const float entering = decimatedRegion[lag + decimatedLength - 1];
+			energy = juce::jmax(0.0f, energy - leaving * leaving + entering * entering);
+		}
+
+		const float score = similarity(dotProduct(decimatedReference.get(), decimatedRegion.get() + lag, decimatedLength), energy);
+		if (score > bestScore) {
+			bestScore = score;
+			bestLag = lag;
+		}
+	}
+
+	// Fine search at full rate around the coarse winner.
+	const int coarseOffset = bestLag * searchDecimation;
+	const int fineStart = juce::jmax(0, coarseOffset - searchDecimation + 1);
+	const int fineEnd = juce::jmin(2 * searchRadius, coarseOffset + searchDecimation - 1);
+
+	int bestOffset = coarseOffset;
+	bestScore = -std::numeric_limits<float>::max();
+
+	for (auto offset = fineStart; offset <= fineEnd; ++offset) {
+		const float* candidate = searchRegion.get() + offset;
+		const float score = similarity(dotProduct(reference.get(), candidate, hopSize), dotProduct(candidate, candidate, hopSize));
+		if (score > bestScore) {
+			bestScore = score;
+			bestOffset = offset;
+		}
+	}
+
+	return bestOffset - searchRadius;
+}
+
+
+// Define the discardInput() method for the TimeStretcher class.
+// The next frame needs the continuation of the frame just built and the search range around the next nominal position;
+// everything before the earlier of the two is dropped.
+void TimeStretcher::discardInput() {
+	const int firstNeeded = juce::jmin(previousFrameStart + hopSize, static_cast<int>(analysisPosition) - searchRadius);
+	if (firstNeeded <= 0) {
+		return;
+	}
+
+	const int numToKeep = inputFill - firstNeeded;
+	for (auto channel = 0; channel < 2; ++channel) {
+		float* data = inputBuffer.getWritePointer(channel);
+		if (numToKeep > 0) {
+			std::memmove(data, data + firstNeeded, sizeof(float) * static_cast<size_t>(numToKeep));
+		}
+	}
+
+	inputFill = juce::jmax(0, numToKeep);
+	analysisPosition -= firstNeeded;
+	previousFrameStart -= firstNeeded;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// TimeStretcher changes the tempo of its input without changing its pitch (key lock / master tempo).
+// It uses WSOLA: frames of the input are windowed and overlap-added at a fixed synthesis hop, while
+// the analysis hop follows the stretch ratio. Each new frame is shifted within a small tolerance so
+// that it lines up with the natural continuation of the previous one, which keeps the waveform
+// continuous and avoids the phasiness of a plain overlap-add.
+// All buffers are allocated in prepareToPlay(); processing never allocates, and the search and
+// overlap-add kernels run on SSE/NEON. All setters are meant to be called from the audio thread.
+class TimeStretcher : public juce::AudioSource {
+public:
+
+	// Constructor for the TimeStretcher class.
+	// Parameters:
+	// - input: The source to read from, which is not owned by the stretcher.
+	TimeStretcher(juce::AudioSource* input);
+
+	// Method to prepare the stretcher and its input for playback.
+	// Parameters:
+	// - samplesPerBlockExpected: The number of audio samples expected per block.
+	// - sampleRate: The sample rate of the audio.
+	void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+	// Method to release the resources of the input.
+	void releaseResources() override;
+
+	// Method to fill the buffer with the next block of stretched audio.
+	// While the stretcher is disabled the input is passed straight through.
+	// Parameters:
+	// - bufferToFill: Contains the buffer information to be filled with audio data.
+	void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+	// Method to switch time-stretching on or off. Switching it on restarts the stretcher from an empty state.
+	// Parameters:
+	// - shouldBeEnabled: true to stretch the input, false to pass it through.
+	void setEnabled(bool shouldBeEnabled);
+
+	// Method to check whether time-stretching is switched on.
+	bool isEnabled() const;
+
+	// Method to set the tempo ratio, where 1 is the original tempo and 2 is twice as fast.
+	// The new ratio takes effect from the next frame.
+	// Parameters:
+	// - ratio: The tempo ratio, limited to the range [minimumRatio, maximumRatio].
+	void setStretchRatio(double ratio);
+
+	// Method to return the current tempo ratio.
+	double getStretchRatio() const;
+
+	// Method to return how far the stretcher has read its input ahead of the next sample it hands out, which changes
+	// with every frame and every block. Called on the audio thread.
+	// Returns:
+	// - The distance in input samples, or 0 while the input is passed through.
+	double getLatency() const;
+
+	// Method to clear all buffered audio and start again from the current input position.
+	void reset();
+
+	// Range of tempo ratios supported by the stretcher.
+	static constexpr double minimumRatio = 0.5;
+	static constexpr double maximumRatio = 2.0;
+
+private:
+
+	// Method to build the next frame of output from the buffered input.
+	void synthesiseFrame();
+
+	// Method to read more samples from the input until the buffer holds at least a given number of samples.
+	void fillInput(int numSamplesNeeded);
+
+	// Method to find the offset from the nominal frame position that best continues the previous frame.
+	// Parameters:
+	// - nominalStart: Position in the input buffer where the frame would start without any search.
+	int findBestOffset(int nominalStart);
+
+	// Method to drop input samples that no later frame can use, moving the rest to the start of the buffer.
+	void discardInput();
+
+	// Source the stretcher reads from.
+	juce::AudioSource* input;
+
+	// Number of output samples produced by each frame (the synthesis hop). Frames are twice this long.
+	int hopSize = 0;
+
+	// Largest distance in samples by which a frame may be moved away from its nominal position.
+	int searchRadius = 0;
+
+	// Decimation factor used for the coarse search.
+	static constexpr int searchDecimation = 4;
+
+	// Length of a frame relative to the sample rate, in seconds.
+	static constexpr double frameLengthSeconds = 0.046;
+
+	// Periodic Hann window of two hops, whose two halves add up to exactly one.
+	juce::HeapBlock<float> window;
+
+	// Input audio waiting to be used by a frame, always two channels.
+	juce::AudioBuffer<float> inputBuffer;
+
+	// Number of valid samples at the start of inputBuffer.
+	int inputFill = 0;
+
+	// Mono mix of the previous frame's natural continuation, which the next frame is matched against.
+	juce::HeapBlock<float> reference;
+
+	// Mono mix of the input region covered by the search, at full and at decimated rate.
+	juce::HeapBlock<float> searchRegion;
+	juce::HeapBlock<float> decimatedRegion;
+	juce::HeapBlock<float> decimatedReference;
+
+	// Second half of the previous windowed frame, still waiting to be added to the next one.
+	juce::AudioBuffer<float> overlapTail;
+
+	// Finished output of the latest frame and the position of the next sample to hand out.
+	juce::AudioBuffer<float> outputFrame;
+	int outputReadPosition = 0;
+
+	// Nominal start of the next frame within inputBuffer, which advances by the analysis hop.
+	double analysisPosition = 0;
+
+	// Start of the previous frame within inputBuffer.
+	int previousFrameStart = 0;
+
+	// Whether a previous frame exists to match against.
+	bool hasPreviousFrame = false;
+
+	// Current tempo ratio.
+	double stretchRatio = 1.0;
+
+	// Whether the input is being stretched or passed through.
+	bool enabled = false;
+};
@@ -2,8 +2,8 @@
 #pragma once
 
 // The `track` struct represents an audio track with various attributes.
-// It includes the track's title, length, URL, and a unique identifier.
-// It also provides a static method for formatting the track's length into a string.
+// It includes the track's title, length, URL, a unique identifier, and the tempo, beat grid, key and loudness found by analysis.
+// It also provides static methods for formatting the track's length and key into strings.
 struct track {
 
     // The title of the track.
@@ -18,6 +18,49 @@ struct track {
     // A unique identifier for the track, useful for distinguishing tracks.
     juce::String identity;
 
+    // The tempo of the track in beats per minute, or 0 until it has been analysed.
+    double bpm = 0;
+
+    // The time of the first downbeat in seconds, which anchors the beat grid, or -1 until the track has been analysed.
+    double downbeatSeconds = -1;
+
+    // The musical key: the tonic from 0 for C to 11 for B, plus 12 for minor keys, or -1 until the track has been analysed.
+    int key = -1;
+
+    // The integrated loudness in LUFS, or 0 until the track has been analysed, and the trim in dB that the deck
+    // applies to bring the track to the common level.
+    double lufs = 0;
+    double gainDb = 0;
+
+    // Static method that returns the position of a key on the Camelot wheel, counting 1A, 1B, 2A and so on from 0,
+    // so that keys that mix well sort next to each other. Returns -1 for an unknown key.
+    static int getCamelotIndex(int key) {
+        if (key < 0 || key >= 24) {
+            return -1;
+        }
+
+        // Going round the wheel goes up by fifths; a minor key shares its number with its relative major.
+        const bool minor = key >= 12;
+        const int majorTonic = minor ? (key - 12 + 3) % 12 : key;
+        const int number = (majorTonic * 7 + 7) % 12;
+        return number * 2 + (minor ? 0 : 1);
+    }
+
+    // Static method that formats a key in Camelot notation, such as "8A" for A minor, or in Open Key notation, such as "1m".
+    static juce::String getKeyString(int key, bool openKey = false) {
+        const int index = getCamelotIndex(key);
+        if (index < 0) {
+            return "...";
+        }
+
+        const int camelotNumber = index / 2 + 1;
+        const bool minor = index % 2 == 0;
+        if (openKey) {
+            return juce::String((camelotNumber + 4) % 12 + 1) + (minor ? "m" : "d");
+        }
+        return juce::String(camelotNumber) + (minor ? "A" : "B");
+    }
+
     // Static method that formats the length of a track into a human-readable string.
     // The method converts the track length from seconds into hours, minutes, and seconds.
     // Optionally, it can include milliseconds for regular updates (e.g., during playback).
@@ -0,0 +1,795 @@
+#include "TrackAnalyser.h"
+#include "KWeighting.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <xmmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace {
+
+	// Rate the audio is reduced to before analysis, and the size and hop of the analysis frames at that rate.
+	// 1024 samples at about 11 kHz resolve the kick drum from the bass line, and the hop puts a frame every 11.6 ms.
+	constexpr double analysisRate = 11025.0;
+	constexpr int frameOrder = 10;
+	constexpr int frameSize = 1 << frameOrder;
+	constexpr int hopSize = 128;
+
+	// Highest frequency counted in the bass onsets used to find the downbeat, in Hz.
+	constexpr double bassCutoff = 150.0;
+
+	// Size and hop of the frames of the chromagram. 4096 samples at about 11 kHz are 2.7 Hz apart, fine enough to tell
+	// semitones apart from about 65 Hz.
+	constexpr int chromaOrder = 12;
+	constexpr int chromaFrameSize = 1 << chromaOrder;
+	constexpr int chromaHopSize = 2048;
+
+	// Range of the chromagram, from C2 to C7, in Hz.
+	constexpr double chromaLowest = 65.4;
+	constexpr double chromaHighest = 2093.0;
+
+	// Krumhansl-Kessler profiles of how much each pitch class, from the tonic up, is heard in major and minor keys.
+	constexpr double majorProfile[12] = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+	constexpr double minorProfile[12] = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+
+	// Number of samples of the file read at a time.
+	constexpr int readBlockSize = 65536;
+
+	// Steps at which the beat period and phase are tried, in envelope frames, before they are refined between them.
+	constexpr double periodStep = 0.05;
+	constexpr double phaseStep = 0.5;
+
+	// Sum of max(0, a[i] - b[i]), four differences at a time. This is the spectral flux of one frame.
+	float positiveDifferenceSum(const float* a, const float* b, int numBins) {
+		auto i = 0;
+		float sum = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+		const __m128 zero = _mm_setzero_ps();
+		__m128 acc = zero;
+		for (; i + 4 <= numBins; i += 4) {
+			acc = _mm_add_ps(acc, _mm_max_ps(zero, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i))));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, acc);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif JUCE_USE_ARM_NEON
+		const float32x4_t zero = vdupq_n_f32(0);
+		float32x4_t acc = zero;
+		for (; i + 4 <= numBins; i += 4) {
+			acc = vaddq_f32(acc, vmaxq_f32(zero, vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i))));
+		}
+		const float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+		sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+
+		for (; i < numBins; ++i) {
+			sum += juce::jmax(0.0f, a[i] - b[i]);
+		}
+		return sum;
+	}
+
+	// Sum of a[i] * b[i], four products at a time. This is one lag of the autocorrelation.
+	float dotProduct(const float* a, const float* b, int numSamples) {
+		auto i = 0;
+		float sum = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+		__m128 acc = _mm_setzero_ps();
+		for (; i + 4 <= numSamples; i += 4) {
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, acc);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif JUCE_USE_ARM_NEON
+		float32x4_t acc = vdupq_n_f32(0);
+		for (; i + 4 <= numSamples; i += 4) {
+			acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+		}
+		const float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+		sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+
+		for (; i < numSamples; ++i) {
+			sum += a[i] * b[i];
+		}
+		return sum;
+	}
+
+	// FFT of real frames of 2^order samples. The even and odd samples are packed into a complex FFT of half the size,
+	// run on separate real and imaginary arrays so that the butterflies of every stage past the second are done four
+	// at a time, and the spectrum of the real frame is unpacked from its result.
+	class RealFFT {
+	public:
+		explicit RealFFT(int order)
+			: size(1 << order),
+			half(size / 2),
+			real(static_cast<size_t>(half)),
+			imag(static_cast<size_t>(half)),
+			bitReversed(static_cast<size_t>(half))
+		{
+			for (auto i = 0; i < half; ++i) {
+				int reversed = 0;
+				for (auto bit = 0; bit < order - 1; ++bit) {
+					reversed |= ((i >> bit) & 1) << (order - 2 - bit);
+				}
+				bitReversed[static_cast<size_t>(i)] = reversed;
+			}
+
+			// The twiddles of each stage are stored one after the other, so that every stage reads them contiguously.
+			for (auto span = 1; span < half; span *= 2) {
+				for (auto k = 0; k < span; ++k) {
+					const double angle = -juce::MathConstants<double>::pi * k / span;
+					stageReal.push_back(static_cast<float>(std::cos(angle)));
+					stageImag.push_back(static_cast<float>(std::sin(angle)));
+				}
+			}
+			for (auto k = 0; k < half; ++k) {
+				const double angle = -juce::MathConstants<double>::twoPi * k / size;
+				unpackReal.push_back(static_cast<float>(std::cos(angle)));
+				unpackImag.push_back(static_cast<float>(std::sin(angle)));
+			}
+		}
+
+		// Method to compute the magnitudes of bins 0 to size / 2 - 1 of a frame of size samples.
+		void performMagnitudes(const float* input, float* magnitudes) {
+			for (auto i = 0; i < half; ++i) {
+				const auto index = static_cast<size_t>(bitReversed[static_cast<size_t>(i)]);
+				real[index] = input[2 * i];
+				imag[index] = input[2 * i + 1];
+			}
+			performComplex();
+
+			// X[k] = E[k] + W^k O[k], where E and O are the spectra of the even and odd samples.
+			for (auto k = 0; k < half; ++k) {
+				const auto mirror = static_cast<size_t>((half - k) & (half - 1));
+				const float zr = real[static_cast<size_t>(k)];
+				const float zi = imag[static_cast<size_t>(k)];
+				const float cr = real[mirror];
+				const float ci = -imag[mirror];
+				const float er = 0.5f * (zr + cr);
+				const float ei = 0.5f * (zi + ci);
+				const float or_ = 0.5f * (zi - ci);
+				const float oi = -0.5f * (zr - cr);
+				const float wr = unpackReal[static_cast<size_t>(k)];
+				const float wi = unpackImag[static_cast<size_t>(k)];
+				const float xr = er + wr * or_ - wi * oi;
+				const float xi = ei + wr * oi + wi * or_;
+				magnitudes[k] = std::sqrt(xr * xr + xi * xi);
+			}
+		}
+
+	private:
+		// Method to run the radix-2 stages on the bit-reversed packed frame.
+		void performComplex() {
+			const float* twiddleReal = stageReal.data();
+			const float* twiddleImag = stageImag.data();
+
+			for (auto span = 1; span < half; span *= 2) {
+				for (auto start = 0; start < half; start += 2 * span) {
+					float* ar = real.data() + start;
+					float* ai = imag.data() + start;
+					float* br = ar + span;
+					float* bi = ai + span;
+					auto k = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+					for (; k + 4 <= span; k += 4) {
+						const __m128 wr = _mm_loadu_ps(twiddleReal + k);
+						const __m128 wi = _mm_loadu_ps(twiddleImag + k);
+						const __m128 xr = _mm_loadu_ps(br + k);
+						const __m128 xi = _mm_loadu_ps(bi + k);
+						const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+						const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+						const __m128 yr = _mm_loadu_ps(ar + k);
+						const __m128 yi = _mm_loadu_ps(ai + k);
+						_mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+						_mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+						_mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+						_mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+					}
+#elif JUCE_USE_ARM_NEON
+					for (; k + 4 <= span; k += 4) {
+						const float32x4_t wr = vld1q_f32(twiddleReal + k);
+						const float32x4_t wi = vld1q_f32(twiddleImag + k);
+						const float32x4_t xr = vld1q_f32(br + k);
+						const float32x4_t xi = vld1q_f32(bi + k);
+						const float32x4_t tr = vmlsq_f32(vmulq_f32(xr, wr), xi, wi);
+						const float32x4_t ti = vmlaq_f32(vmulq_f32(xr, wi), xi, wr);
+						const float32x4_t yr = vld1q_f32(ar + k);
+						const float32x4_t yi = vld1q_f32(ai + k);
+						vst1q_f32(br + k, vsubq_f32(yr, tr));
+						vst1q_f32(bi + k, vsubq_f32(yi, ti));
+						vst1q_f32(ar + k, vaddq_f32(yr, tr));
+						vst1q_f32(ai + k, vaddq_f32(yi, ti));
+					}
+#endif
+
+					for (; k < span; ++k) {
+						const float tr = br[k] * twiddleReal[k] - bi[k] * twiddleImag[k];
+						const float ti = br[k] * twiddleImag[k] + bi[k] * twiddleReal[k];
+						br[k] = ar[k] - tr;
+						bi[k] = ai[k] - ti;
+						ar[k] += tr;
+						ai[k] += ti;
+					}
+				}
+				twiddleReal += span;
+				twiddleImag += span;
+			}
+		}
+
+		const int size;
+		const int half;
+		std::vector<float> real, imag;
+		std::vector<float> stageReal, stageImag;
+		std::vector<float> unpackReal, unpackImag;
+		std::vector<int> bitReversed;
+	};
+
+	// Integrated loudness of a whole track as in EBU R128: the mean energy of the 400 ms blocks, overlapping by 75%,
+	// that pass the absolute gate at -70 LUFS and the relative gate 10 LU below the mean of those blocks. The block
+	// energies are kept in a histogram of 0.1 LU bins rather than a list, so memory stays the same for any length of
+	// track, at the cost of placing the relative gate to within 0.1 LU.
+	class IntegratedLoudness {
+	public:
+		// Method to set up the measurement of a file.
+		// Parameters:
+		// - sampleRate: The sample rate of the file.
+		// - isMono: Whether the file has one channel, which the reader copies to both sides.
+		void prepare(double sampleRate, bool isMono) {
+			kWeighting.prepare(sampleRate);
+			samplesPerStep = juce::jmax(1, juce::roundToInt(sampleRate * stepSeconds));
+			weightedScale = isMono ? 0.5 : 1.0;
+		}
+
+		// Method to measure the next samples of the file.
+		void process(const float* left, const float* right, int numSamples) {
+			using namespace StereoVec;
+
+			Type blockPeak = splat(0);
+			float pair[2];
+
+			auto done = 0;
+			while (done < numSamples) {
+				// Stop at the end of the current 100 ms step so that every step holds exactly its own samples.
+				const int sectionLength = juce::jmin(numSamples - done, samplesPerStep - stepSamples);
+				Type sectionWeighted = splat(0);
+
+				for (auto i = done; i < done + sectionLength; ++i) {
+					const Type x = loadPair(left[i], right[i]);
+					blockPeak = max(blockPeak, abs(x));
+
+					const Type z = kWeighting.process(x);
+					sectionWeighted = add(sectionWeighted, mul(z, z));
+				}
+
+				storePair(sectionWeighted, pair);
+				stepEnergy += (static_cast<double>(pair[0]) + pair[1]) * weightedScale;
+				stepSamples += sectionLength;
+				done += sectionLength;
+
+				if (stepSamples >= samplesPerStep) {
+					finishStep();
+				}
+			}
+
+			storePair(blockPeak, pair);
+			peak = juce::jmax(peak, pair[0], pair[1]);
+		}
+
+		// Method to return the integrated loudness in LUFS, or 0 when no block passed the gates.
+		double getLufs() const {
+			double energy = 0;
+			juce::int64 count = 0;
+			for (auto i = 0; i < numHistogramBins; ++i) {
+				energy += energySums[i];
+				count += counts[i];
+			}
+			if (count == 0) {
+				return 0;
+			}
+
+			const double relativeGate = KWeighting::toLufs(energy / count) - 10.0;
+			energy = 0;
+			count = 0;
+			for (auto i = 0; i < numHistogramBins; ++i) {
+				if (histogramLowest + (i + 1) * histogramStep > relativeGate) {
+					energy += energySums[i];
+					count += counts[i];
+				}
+			}
+			return count > 0 ? KWeighting::toLufs(energy / count) : 0.0;
+		}
+
+		// Method to return the highest sample of the file, from 0 to 1 and above.
+		float getPeak() const {
+			return peak;
+		}
+
+	private:
+		// Method to close a 100 ms step, and the 400 ms block that ends with it once there are four steps.
+		void finishStep() {
+			steps[stepIndex] = stepEnergy / stepSamples;
+			stepIndex = (stepIndex + 1) % stepsPerBlock;
+			numSteps = juce::jmin(numSteps + 1, stepsPerBlock);
+			stepEnergy = 0;
+			stepSamples = 0;
+
+			if (numSteps == stepsPerBlock) {
+				const double blockEnergy = (steps[0] + steps[1] + steps[2] + steps[3]) / stepsPerBlock;
+				const double blockLufs = KWeighting::toLufs(blockEnergy);
+				if (blockLufs > histogramLowest) {
+					const int bin = juce::jlimit(0, numHistogramBins - 1, static_cast<int>((blockLufs - histogramLowest) / histogramStep));
+					energySums[bin] += blockEnergy;
+					++counts[bin];
+				}
+			}
+		}
+
+		static constexpr double stepSeconds = 0.1;
+		static constexpr int stepsPerBlock = 4;
+		static constexpr double histogramLowest = -70.0;
+		static constexpr double histogramStep = 0.1;
+		static constexpr int numHistogramBins = 800;
+
+		KWeighting kWeighting;
+		int samplesPerStep = 4410;
+		double weightedScale = 1.0;
+
+		// Energy of the last four steps, and of the step being measured.
+		double steps[stepsPerBlock] = {};
+		int stepIndex = 0;
+		int numSteps = 0;
+		double stepEnergy = 0;
+		int stepSamples = 0;
+
+		// Summed energy and number of the blocks in each bin of loudness.
+		double energySums[numHistogramBins] = {};
+		juce::int64 counts[numHistogramBins] = {};
+
+		float peak = 0;
+	};
+
+	// Hann window of a frame.
+	std::vector<float> makeWindow(int size) {
+		std::vector<float> window(static_cast<size_t>(size));
+		for (auto i = 0; i < size; ++i) {
+			window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * i / size);
+		}
+		return window;
+	}
+
+	// Key whose profile correlates best with a chromagram: the tonic from 0 for C, plus 12 for minor keys, or -1.
+	int findKey(const double* chroma) {
+		double mean = 0;
+		for (auto i = 0; i < 12; ++i) {
+			mean += chroma[i] / 12.0;
+		}
+		if (mean <= 0) {
+			return -1;
+		}
+
+		int bestKey = -1;
+		double bestCorrelation = -2.0;
+		for (auto mode = 0; mode < 2; ++mode) {
+			const double* profile = mode == 0 ? majorProfile : minorProfile;
+			double profileMean = 0;
+			for (auto i = 0; i < 12; ++i) {
+				profileMean += profile[i] / 12.0;
+			}
+
+			for (auto tonic = 0; tonic < 12; ++tonic) {
+				double product = 0, chromaSquares = 0, profileSquares = 0;
+				for (auto i = 0; i < 12; ++i) {
+					const double c = chroma[(tonic + i) % 12] - mean;
+					const double p = profile[i] - profileMean;
+					product += c * p;
+					chromaSquares += c * c;
+					profileSquares += p * p;
+				}
+				const double correlation = product / std::sqrt(chromaSquares * profileSquares + 1e-12);
+				if (correlation > bestCorrelation) {
+					bestCorrelation = correlation;
+					bestKey = tonic + 12 * mode;
+				}
+			}
+		}
+		return bestKey;
+	}
+
+	// Value of an envelope at a fractional frame, interpolated linearly, or 0 past its end.
+	float valueAt(const std::vector<float>& envelope, double frame) {
+		const auto index = static_cast<size_t>(frame);
+		if (frame < 0 || index + 1 >= envelope.size()) {
+			return 0.0f;
+		}
+		const float fraction = static_cast<float>(frame - static_cast<double>(index));
+		return envelope[index] + fraction * (envelope[index + 1] - envelope[index]);
+	}
+
+	// Sum of an envelope over a comb of beats.
+	float combSum(const std::vector<float>& envelope, double phase, double period) {
+		float sum = 0;
+		for (double frame = phase; frame < static_cast<double>(envelope.size()); frame += period) {
+			sum += valueAt(envelope, frame);
+		}
+		return sum;
+	}
+
+	// Mean of an envelope over a comb of beats, per beat.
+	float combMean(const std::vector<float>& envelope, double phase, double period) {
+		return combSum(envelope, phase, period) / static_cast<float>((static_cast<double>(envelope.size()) - phase) / period);
+	}
+
+	// Offset of the top of the parabola through three evenly spaced values, in steps from the middle one, which is
+	// the largest of them, or 0 when they do not curve down.
+	double parabolicPeak(double before, double at, double after) {
+		const double curvature = before - 2.0 * at + after;
+		return curvature < 0 ? juce::jlimit(-0.5, 0.5, 0.5 * (before - after) / curvature) : 0.0;
+	}
+
+	// Strongest comb of a period over an envelope, per beat, and the phase it lines up at, refined between the phases
+	// tried by a parabola through the best one and its neighbours, which wrap around the period.
+	float bestComb(const std::vector<float>& envelope, double period, double& phase) {
+		float best = -1.0f;
+		phase = 0;
+		for (double tried = 0; tried < period; tried += phaseStep) {
+			const float comb = combMean(envelope, tried, period);
+			if (comb > best) {
+				best = comb;
+				phase = tried;
+			}
+		}
+
+		const double before = phase >= phaseStep ? phase - phaseStep : phase - phaseStep + period;
+		const double after = phase + phaseStep < period ? phase + phaseStep : phase + phaseStep - period;
+		phase += phaseStep * parabolicPeak(combMean(envelope, before, period), best, combMean(envelope, after, period));
+		phase = phase < 0 ? phase + period : (phase >= period ? phase - period : phase);
+		return best;
+	}
+
+	// Refines the period and phase of a comb by fitting a line through the beats of the whole track: each beat is where
+	// the envelope is centred within a quarter period of where the comb puts it, weighted by the envelope there.
+	// Returns false, leaving both unchanged, if the fit moves the period by more than a step of the search.
+	bool fitBeats(const std::vector<float>& envelope, double& phase, double& period) {
+		const auto size = static_cast<int>(envelope.size());
+		double sumWeights = 0, sumBeats = 0, sumFrames = 0, sumBeatsSquared = 0, sumProducts = 0;
+		for (auto beat = 0; phase + beat * period < size; ++beat) {
+			const double predicted = phase + beat * period;
+			const int first = juce::jmax(0, static_cast<int>(std::ceil(predicted - period / 4)));
+			const int last = juce::jmin(size - 1, static_cast<int>(std::floor(predicted + period / 4)));
+			double weight = 0, moment = 0;
+			for (auto frame = first; frame <= last; ++frame) {
+				weight += envelope[static_cast<size_t>(frame)];
+				moment += envelope[static_cast<size_t>(frame)] * frame;
+			}
+			if (weight <= 0) {
+				continue;
+			}
+			const double centre = moment / weight;
+			sumWeights += weight;
+			sumBeats += weight * beat;
+			sumFrames += weight * centre;
+			sumBeatsSquared += weight * beat * beat;
+			sumProducts += weight * beat * centre;
+		}
+
+		const double determinant = sumWeights * sumBeatsSquared - sumBeats * sumBeats;
+		if (determinant <= 0) {
+			return false;
+		}
+		const double fittedPeriod = (sumWeights * sumProducts - sumBeats * sumFrames) / determinant;
+		if (std::abs(fittedPeriod - period) > periodStep) {
+			return false;
+		}
+
+		period = fittedPeriod;
+		phase = (sumFrames - fittedPeriod * sumBeats) / sumWeights;
+		phase -= std::floor(phase / period) * period;
+		return true;
+	}
+
+	// Removes the slowly changing part of an envelope, the local mean over about half a second, and keeps what rises above it.
+	std::vector<float> detrend(const std::vector<float>& envelope, int halfWindow) {
+		std::vector<double> prefix(envelope.size() + 1, 0.0);
+		for (size_t i = 0; i < envelope.size(); ++i) {
+			prefix[i + 1] = prefix[i] + envelope[i];
+		}
+
+		std::vector<float> result(envelope.size());
+		for (size_t i = 0; i < envelope.size(); ++i) {
+			const size_t first = i > static_cast<size_t>(halfWindow) ? i - static_cast<size_t>(halfWindow) : 0;
+			const size_t last = juce::jmin(envelope.size(), i + static_cast<size_t>(halfWindow) + 1);
+			const double mean = (prefix[last] - prefix[first]) / static_cast<double>(last - first);
+			result[i] = static_cast<float>(juce::jmax(0.0, envelope[i] - mean));
+		}
+		return result;
+	}
+}
+
+
+// A job that analyses one track on a worker thread.
+class TrackAnalyser::AnalysisJob : public juce::ThreadPoolJob {
+public:
+	AnalysisJob(TrackAnalyser& _owner, const track& _trackToAnalyse)
+		: juce::ThreadPoolJob("Track analysis"),
+		owner(_owner),
+		trackToAnalyse(_trackToAnalyse)
+	{
+	}
+
+	JobStatus runJob() override {
+		Result result;
+		if (trackToAnalyse.url.isLocalFile()) {
+			std::unique_ptr<juce::AudioFormatReader> reader(owner.formatManager.createReaderFor(trackToAnalyse.url.getLocalFile()));
+			if (reader != nullptr) {
+				result = analyseReader(*reader, [this] { return shouldExit(); });
+			}
+		}
+
+		if (!shouldExit()) {
+			result.identity = trackToAnalyse.identity;
+			owner.addResult(result);
+		}
+		return jobHasFinished;
+	}
+
+private:
+	TrackAnalyser& owner;
+	track trackToAnalyse;
+};
+
+
+TrackAnalyser::TrackAnalyser(juce::AudioFormatManager& _formatManager, Listener& _listener)
+	: formatManager(_formatManager),
+	listener(_listener),
+	pool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+{
+}
+
+
+TrackAnalyser::~TrackAnalyser()
+{
+	pool.removeAllJobs(true, 4000);
+	cancelPendingUpdate();
+}
+
+
+// Define the analyse() method for the TrackAnalyser class.
+void TrackAnalyser::analyse(const track& trackToAnalyse) {
+	pool.addJob(new AnalysisJob(*this, trackToAnalyse), true);
+}
+
+
+// Define the getNumPending() method for the TrackAnalyser class.
+int TrackAnalyser::getNumPending() const {
+	return pool.getNumJobs();
+}
+
+
+// Define the addResult() method for the TrackAnalyser class.
+void TrackAnalyser::addResult(const Result& result) {
+	{
+		const juce::ScopedLock sl(finishedLock);
+		finished.add(result);
+	}
+	triggerAsyncUpdate();
+}
+
+
+// Define the handleAsyncUpdate() method for the TrackAnalyser class.
+void TrackAnalyser::handleAsyncUpdate() {
+	juce::Array<Result> results;
+	{
+		const juce::ScopedLock sl(finishedLock);
+		results.swapWith(finished);
+	}
+
+	for (const auto& result : results) {
+		listener.analysisFinished(result);
+	}
+}
+
+
+// Define the analyseReader() method for the TrackAnalyser class.
+// The file is read in blocks and reduced to mono on the fly, so a job only ever holds a few frames of audio, the
+// onset envelopes and the chromagram, whatever the length of the track. Both analyses share the one decode.
+TrackAnalyser::Result TrackAnalyser::analyseReader(juce::AudioFormatReader& reader, const std::function<bool()>& shouldExit) {
+	Result result;
+	if (reader.sampleRate <= 0 || reader.lengthInSamples <= 0) {
+		return result;
+	}
+
+	// Whole groups of input samples are averaged down to roughly the analysis rate.
+	const int decimation = juce::jmax(1, juce::roundToInt(reader.sampleRate / analysisRate));
+	const double rate = reader.sampleRate / decimation;
+	const double envelopeRate = rate / hopSize;
+	const int numBins = frameSize / 2;
+	const int numBassBins = juce::jlimit(1, numBins, juce::roundToInt(bassCutoff * frameSize / rate));
+
+	RealFFT fft(frameOrder);
+	const std::vector<float> window = makeWindow(frameSize);
+	std::vector<float> frame(frameSize);
+	std::vector<float> magnitudes(numBins);
+	std::vector<float> previousMagnitudes(numBins, 0.0f);
+	std::vector<float> flux;
+	std::vector<float> bassFlux;
+	flux.reserve(static_cast<size_t>(reader.lengthInSamples / decimation / hopSize + 1));
+	bassFlux.reserve(flux.capacity());
+
+	// Pitch class of every chromagram bin in range, from 0 for C, and the chromagram summed over the track.
+	RealFFT chromaFFT(chromaOrder);
+	const std::vector<float> chromaWindow = makeWindow(chromaFrameSize);
+	std::vector<float> chromaFrame(chromaFrameSize);
+	std::vector<float> chromaMagnitudes(chromaFrameSize / 2);
+	const int firstChromaBin = juce::jmax(1, static_cast<int>(std::ceil(chromaLowest * chromaFrameSize / rate)));
+	const int lastChromaBin = juce::jmin(chromaFrameSize / 2, static_cast<int>(chromaHighest * chromaFrameSize / rate));
+	std::vector<int> pitchClasses;
+	for (auto bin = firstChromaBin; bin < lastChromaBin; ++bin) {
+		const double note = 69.0 + 12.0 * std::log2(bin * rate / chromaFrameSize / 440.0);
+		pitchClasses.push_back(juce::roundToInt(note) % 12);
+	}
+	double chroma[12] = {};
+
+	// The loudness is measured at the file's own rate, before anything is mixed down.
+	IntegratedLoudness loudness;
+	loudness.prepare(reader.sampleRate, reader.numChannels == 1);
+
+	juce::AudioBuffer<float> block(2, readBlockSize);
+	std::vector<float> mono;
+	size_t frameStart = 0;
+	size_t chromaFrameStart = 0;
+	float groupSum = 0;
+	int groupCount = 0;
+
+	for (juce::int64 position = 0; position < reader.lengthInSamples; position += readBlockSize) {
+		if (shouldExit()) {
+			return result;
+		}
+
+		const int numSamples = static_cast<int>(juce::jmin<juce::int64>(readBlockSize, reader.lengthInSamples - position));
+		reader.read(&block, 0, numSamples, position, true, true);
+
+		const float* left = block.getReadPointer(0);
+		const float* right = block.getReadPointer(1);
+		loudness.process(left, right, numSamples);
+		for (auto i = 0; i < numSamples; ++i) {
+			groupSum += left[i] + right[i];
+			if (++groupCount == decimation) {
+				mono.push_back(groupSum / (2.0f * decimation));
+				groupSum = 0;
+				groupCount = 0;
+			}
+		}
+
+		// Turn every complete frame into one value of each onset envelope.
+		while (frameStart + frameSize <= mono.size()) {
+			juce::FloatVectorOperations::multiply(frame.data(), mono.data() + frameStart, window.data(), frameSize);
+			fft.performMagnitudes(frame.data(), magnitudes.data());
+
+			// Log compression makes quiet onsets count next to loud ones.
+			for (auto& magnitude : magnitudes) {
+				magnitude = std::log1p(1000.0f * magnitude);
+			}
+
+			flux.push_back(positiveDifferenceSum(magnitudes.data(), previousMagnitudes.data(), numBins));
+			bassFlux.push_back(positiveDifferenceSum(magnitudes.data(), previousMagnitudes.data(), numBassBins));
+			std::swap(magnitudes, previousMagnitudes);
+			frameStart += hopSize;
+		}
+
+		// Add every complete chromagram frame to the chromagram, each frame normalised so that loud passages do not
+		// outweigh quiet ones.
+		while (chromaFrameStart + chromaFrameSize <= mono.size()) {
+			juce::FloatVectorOperations::multiply(chromaFrame.data(), mono.data() + chromaFrameStart, chromaWindow.data(), chromaFrameSize);
+			chromaFFT.performMagnitudes(chromaFrame.data(), chromaMagnitudes.data());
+
+			double frameChroma[12] = {};
+			double frameTotal = 0;
+			for (size_t i = 0; i < pitchClasses.size(); ++i) {
+				const double magnitude = chromaMagnitudes[static_cast<size_t>(firstChromaBin) + i];
+				frameChroma[pitchClasses[i]] += magnitude;
+				frameTotal += magnitude;
+			}
+			if (frameTotal > 1e-3) {
+				for (auto i = 0; i < 12; ++i) {
+					chroma[i] += frameChroma[i] / frameTotal;
+				}
+			}
+			chromaFrameStart += chromaHopSize;
+		}
+
+		// Drop the samples no frame needs any more.
+		const size_t consumed = juce::jmin(frameStart, chromaFrameStart);
+		mono.erase(mono.begin(), mono.begin() + static_cast<std::ptrdiff_t>(consumed));
+		frameStart -= consumed;
+		chromaFrameStart -= consumed;
+	}
+
+	result.key = findKey(chroma);
+
+	// The trim brings the track to the target loudness, but never boosts its peaks above full scale.
+	result.lufs = loudness.getLufs();
+	if (result.lufs < 0) {
+		const double peakDb = juce::Decibels::gainToDecibels(loudness.getPeak(), -100.0f);
+		result.gainDb = juce::jlimit(-maxTrimDb, maxTrimDb, targetLufs - result.lufs);
+		result.gainDb = juce::jmin(result.gainDb, juce::jmax(0.0, -peakDb));
+	}
+
+	const int halfWindow = juce::roundToInt(0.25 * envelopeRate);
+	const std::vector<float> onsets = detrend(flux, halfWindow);
+	const std::vector<float> bassOnsets = detrend(bassFlux, halfWindow);
+
+	const int minLag = juce::jmax(1, static_cast<int>(std::floor(60.0 * envelopeRate / maxBpm)));
+	const int maxLag = static_cast<int>(std::ceil(60.0 * envelopeRate / minBpm));
+	const int numOnsets = static_cast<int>(onsets.size());
+	if (numOnsets < maxLag * 8) {
+		DBG("TrackAnalyser: track too short to find a tempo");
+		return result;
+	}
+
+	// Coarse tempo: the strongest autocorrelation lag, weighted towards 120 BPM so that half and double tempos lose.
+	int bestLag = minLag;
+	float bestScore = -1.0f;
+	for (auto lag = minLag; lag <= maxLag; ++lag) {
+		const float correlation = dotProduct(onsets.data(), onsets.data() + lag, numOnsets - lag) / (numOnsets - lag);
+		const double octaves = std::log2(60.0 * envelopeRate / lag / 120.0);
+		const float score = correlation * static_cast<float>(std::exp(-0.5 * octaves * octaves));
+		if (score > bestScore) {
+			bestScore = score;
+			bestLag = lag;
+		}
+	}
+	if (bestScore <= 0) {
+		return result;
+	}
+
+	// Fine tempo: the comb that lines up best with the onsets over the whole track, tried at periods around the coarse
+	// lag and refined between them by a parabola through the best one and its neighbours, so the tempo is not
+	// rounded to the step.
+	const int numPeriods = static_cast<int>(std::lround(2.0 / periodStep)) + 1;
+	std::vector<float> combs(static_cast<size_t>(numPeriods));
+	int bestIndex = 0;
+	for (auto index = 0; index < numPeriods; ++index) {
+		if (shouldExit()) {
+			return result;
+		}
+		double phase = 0;
+		combs[static_cast<size_t>(index)] = bestComb(onsets, bestLag - 1.0 + index * periodStep, phase);
+		if (combs[static_cast<size_t>(index)] > combs[static_cast<size_t>(bestIndex)]) {
+			bestIndex = index;
+		}
+	}
+
+	double bestPeriod = bestLag - 1.0 + bestIndex * periodStep;
+	if (bestIndex > 0 && bestIndex + 1 < numPeriods) {
+		const auto best = static_cast<size_t>(bestIndex);
+		bestPeriod += periodStep * parabolicPeak(combs[best - 1], combs[best], combs[best + 1]);
+	}
+
+	// Beat phase: where the comb of that period lines up best. A period that is slightly off shifts the best phase to
+	// suit the middle of the track, so both are then fitted to the beats of the whole track.
+	double bestPhase = 0;
+	bestComb(onsets, bestPeriod, bestPhase);
+	fitBeats(onsets, bestPhase, bestPeriod);
+
+	// The downbeat is the beat of the bar on which the bass onsets are strongest.
+	int bestBeat = 0;
+	float bestBass = -1.0f;
+	for (auto beat = 0; beat < 4; ++beat) {
+		const float bass = combSum(bassOnsets, bestPhase + beat * bestPeriod, bestPeriod * 4);
+		if (bass > bestBass) {
+			bestBass = bass;
+			bestBeat = beat;
+		}
+	}
+
+	// A frame's flux belongs to the centre of the frame, and each envelope value is one frame later than its lag index.
+	const double downbeatFrame = bestPhase + bestBeat * bestPeriod;
+	result.bpm = 60.0 * envelopeRate / bestPeriod;
+	result.downbeatSeconds = (downbeatFrame * hopSize + frameSize / 2) / rate;
+	return result;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <JuceHeader.h>
+#include "Track.h"
+
+
+// TrackAnalyser finds the tempo, the beat grid and the musical key of library tracks on a pool of background threads.
+// Each track is decoded once, by a job of its own, and downmixed to mono at a quarter of the usual rate. From there it
+// is turned into an onset envelope: the spectral flux of the log-magnitude spectrum, frame by frame. The tempo is the
+// lag with the strongest autocorrelation of that envelope; the beats are the comb of that period that lines up best
+// with the onsets, and the downbeat is the beat of the bar on which the bass onsets are strongest. The same audio is
+// also summed into a chromagram, whose best match among the 24 major and minor key profiles is the key. Before it is
+// downmixed, the audio is measured for integrated loudness as in EBU R128, which gives the trim that brings the
+// track to a common level.
+// Jobs share nothing but the queue of finished results, so a crate of tracks is analysed about as many times faster
+// as there are worker threads. Results are handed to the listener on the message thread; nothing here ever runs on
+// the message or audio threads.
+class TrackAnalyser : private juce::AsyncUpdater {
+public:
+
+	// The tempo and beat grid found for one track.
+	struct Result {
+		juce::String identity;
+		double bpm = 0;
+		double downbeatSeconds = -1;
+		int key = -1;
+		double lufs = 0;
+		double gainDb = 0;
+	};
+
+	// Interface of the object told about finished analyses, called on the message thread.
+	class Listener {
+	public:
+		virtual ~Listener() = default;
+
+		// Method called when a track has been analysed. A track that could not be read has a bpm of 0 and a key of -1.
+		// Parameters:
+		// - result: The identity of the track and what was found.
+		virtual void analysisFinished(const Result& result) = 0;
+	};
+
+	// Constructor for the TrackAnalyser class, which starts one worker thread per core, less one for the audio.
+	// Parameters:
+	// - formatManager: The formats used to open tracks.
+	// - listener: The object told about finished analyses.
+	TrackAnalyser(juce::AudioFormatManager& formatManager, Listener& listener);
+
+	// Destructor that cancels the analyses that have not finished.
+	~TrackAnalyser() override;
+
+	// Method to queue a track for analysis. Called from the message thread.
+	// Parameters:
+	// - trackToAnalyse: The track to analyse; its identity is passed back with the result.
+	void analyse(const track& trackToAnalyse);
+
+	// Method to return the number of tracks queued or being analysed.
+	int getNumPending() const;
+
+	// Method to analyse a whole file on the calling thread. The key is given as in track::key.
+	// Parameters:
+	// - reader: A reader of the file.
+	// - shouldExit: Polled between blocks; the analysis gives up and returns nothing found when it returns true.
+	// Returns:
+	// - The tempo, beat grid, key, loudness and trim, with an empty identity.
+	static Result analyseReader(juce::AudioFormatReader& reader, const std::function<bool()>& shouldExit);
+
+	// Slowest and fastest tempo that can be found, in beats per minute.
+	static constexpr double minBpm = 60.0;
+	static constexpr double maxBpm = 200.0;
+
+	// Loudness that tracks are trimmed to, in LUFS, leaving headroom for two decks playing together, and the largest
+	// trim in either direction, in dB.
+	static constexpr double targetLufs = -12.0;
+	static constexpr double maxTrimDb = 12.0;
+
+private:
+
+	class AnalysisJob;
+
+	// Method called on the message thread to hand the finished results to the listener.
+	void handleAsyncUpdate() override;
+
+	// Method called by a job when it has finished.
+	void addResult(const Result& result);
+
+	juce::AudioFormatManager& formatManager;
+	Listener& listener;
+
+	// Results waiting to be delivered, and the lock shared by the jobs that add them.
+	juce::Array<Result> finished;
+	juce::CriticalSection finishedLock;
+
+	// Worker threads running the jobs.
+	juce::ThreadPool pool;
+};
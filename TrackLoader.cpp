@@ -0,0 +1,192 @@
+#include "TrackLoader.h"
+
+
+TrackLoader::TrackLoader(juce::AudioFormatManager& _formatManager, juce::TimeSliceThread& _readAheadThread, Listener& _listener)
+	: juce::Thread("Track loader"),
+	formatManager(_formatManager),
+	readAheadThread(_readAheadThread),
+	listener(_listener)
+{
+	startThread();
+}
+
+
+TrackLoader::~TrackLoader()
+{
+	signalThreadShouldExit();
+	notify();
+	stopThread(4000);
+	cancelPendingUpdate();
+}
+
+
+// Define the load() method for the TrackLoader class.
+void TrackLoader::load(const Request& newRequest) {
+	{
+		const juce::ScopedLock sl(lock);
+		request = newRequest;
+		requestWaiting = true;
+		++requestCount;
+
+		// A load that finished but was not delivered yet is out of date now.
+		finished.reset();
+	}
+
+	loading = true;
+	progress.store(0.0f);
+	notify();
+}
+
+
+// Define the isLoading() method for the TrackLoader class.
+bool TrackLoader::isLoading() const {
+	return loading;
+}
+
+
+// Define the run() method for the TrackLoader class.
+void TrackLoader::run() {
+	while (!threadShouldExit()) {
+		Request next;
+		int requestNumber = 0;
+		bool hasRequest = false;
+		{
+			const juce::ScopedLock sl(lock);
+			if (requestWaiting) {
+				next = request;
+				requestNumber = requestCount.load();
+				requestWaiting = false;
+				hasRequest = true;
+			}
+		}
+
+		if (!hasRequest) {
+			wait(-1);
+			continue;
+		}
+
+		std::unique_ptr<Result> result(new Result());
+		result->url = next.url;
+		result->track = createTrack(next, formatManager, readAheadThread);
+
+		if (result->track != nullptr && !isSuperseded(requestNumber)) {
+			setProgress(requestNumber, 0.4f);
+
+			// Fill the start of the read-ahead buffer here, so that the track can play as soon as it is delivered.
+			result->track->prepareToPlay(next.blockSize, next.sampleRate);
+			result->track->waitUntilReady(startPrefetchSamples, startTimeoutMs);
+			setProgress(requestNumber, 0.6f);
+
+			// The waveform displays get readers of their own, since opening one can take as long as opening the track.
+			for (auto i = 0; i < next.numThumbnailReaders && !isSuperseded(requestNumber); ++i) {
+				auto* reader = formatManager.createReaderFor(next.url.createInputStream(false));
+				if (reader == nullptr) {
+					break;
+				}
+				result->thumbnailReaders.add(reader);
+				setProgress(requestNumber, 0.6f + 0.4f * (i + 1) / next.numThumbnailReaders);
+			}
+		}
+
+		{
+			const juce::ScopedLock sl(lock);
+			if (requestNumber == requestCount.load()) {
+				finished = std::move(result);
+			}
+		}
+
+		// A replaced result is deleted here, on this thread, rather than on the message thread.
+		result.reset();
+		triggerAsyncUpdate();
+	}
+}
+
+
+// Define the handleAsyncUpdate() method for the TrackLoader class.
+void TrackLoader::handleAsyncUpdate() {
+	std::unique_ptr<Result> result;
+	{
+		const juce::ScopedLock sl(lock);
+		result = std::move(finished);
+	}
+
+	if (result != nullptr) {
+		loading = false;
+		listener.loadFinished(*result);
+	}
+	else if (loading) {
+		listener.loadProgress(progress.load());
+	}
+}
+
+
+// Define the createTrack() method for the TrackLoader class.
+std::unique_ptr<TrackSource> TrackLoader::createTrack(const Request& newRequest, juce::AudioFormatManager& formatManager, juce::TimeSliceThread& readAheadThread) {
+	// Uncompressed local files are mapped into memory when streaming, which avoids copying through stream buffers and makes loading near-instant.
+	if (newRequest.storage == TrackSource::streamFromDisk && newRequest.allowMemoryMap) {
+		if (auto* mappedReader = createMappedReader(newRequest.url, formatManager)) {
+			DBG("TrackLoader: memory-mapped " << newRequest.url.getFileName());
+			return std::unique_ptr<TrackSource>(new TrackSource(mappedReader, readAheadThread));
+		}
+	}
+
+	// Create an AudioFormatReader for the audio URL by opening an input stream to the file.
+	auto* reader = formatManager.createReaderFor(newRequest.url.createInputStream(false));
+	if (reader == nullptr) {
+		DBG("TrackLoader: could not open " << newRequest.url.getFileName());
+		return nullptr;
+	}
+
+	// Log the size of the metadata associated with the loaded file.
+	DBG("real metadata size: " << reader->metadataValues.size());
+
+	// Open a second reader for the RAM decoder, so that it never makes the stream seek.
+	juce::AudioFormatReader* decodeReader = nullptr;
+	if (newRequest.storage != TrackSource::streamFromDisk) {
+		decodeReader = formatManager.createReaderFor(newRequest.url.createInputStream(false));
+	}
+
+	// The read-ahead buffer and decoder of the track are run by the shared background thread.
+	const int readAheadSamples = juce::jmax(startPrefetchSamples * 2, juce::roundToInt(newRequest.readAheadSeconds * reader->sampleRate));
+	std::unique_ptr<TrackSource> track(new TrackSource(reader, decodeReader, readAheadThread, readAheadSamples, newRequest.storage));
+
+	// A third reader lets loops be copied into RAM without touching the stream or the decoder.
+	track->setSectionReader(formatManager.createReaderFor(newRequest.url.createInputStream(false)));
+	return track;
+}
+
+
+// Define the createMappedReader() method for the TrackLoader class.
+// Only formats with a memory-mapped reader (WAV and AIFF) return one; the whole file is mapped once, up front.
+juce::MemoryMappedAudioFormatReader* TrackLoader::createMappedReader(const juce::URL& audioURL, juce::AudioFormatManager& formatManager) {
+	if (!audioURL.isLocalFile()) {
+		return nullptr;
+	}
+
+	const juce::File file = audioURL.getLocalFile();
+	auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+	if (format == nullptr) {
+		return nullptr;
+	}
+
+	std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader(format->createMemoryMappedReader(file));
+	if (mappedReader == nullptr || mappedReader->lengthInSamples <= 0 || !mappedReader->mapEntireFile()) {
+		return nullptr;
+	}
+	return mappedReader.release();
+}
+
+
+// Define the isSuperseded() method for the TrackLoader class.
+bool TrackLoader::isSuperseded(int requestNumber) const {
+	return requestNumber != requestCount.load();
+}
+
+
+// Define the setProgress() method for the TrackLoader class.
+void TrackLoader::setProgress(int requestNumber, float newProgress) {
+	if (!isSuperseded(requestNumber)) {
+		progress.store(newProgress);
+		triggerAsyncUpdate();
+	}
+}
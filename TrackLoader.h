@@ -0,0 +1,119 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TrackSource.h"
+
+
+// TrackLoader opens files for a deck on its own background thread, so that parsing a large file never blocks
+// the message thread or the audio thread.
+// For every request it opens the reader (through a memory map when it can), builds and prepares the TrackSource,
+// waits until the start of the file has been read, and optionally opens extra readers for the waveform displays.
+// Progress and the finished track are delivered to the listener on the message thread. Only the latest request
+// counts: a request made while another is loading makes the loader drop the older one as soon as it can.
+class TrackLoader : private juce::Thread,
+	private juce::AsyncUpdater {
+public:
+
+	// Everything the loader needs to know to open a file.
+	struct Request {
+		juce::URL url;
+		TrackSource::Storage storage = TrackSource::streamFromDisk;
+		double readAheadSeconds = 4.0;
+		int blockSize = 512;
+		double sampleRate = 44100.0;
+		int numThumbnailReaders = 0;
+		// Whether an uncompressed local file may be memory-mapped when it is streamed.
+		bool allowMemoryMap = true;
+	};
+
+	// A finished load. The track is nullptr when the file could not be opened.
+	struct Result {
+		juce::URL url;
+		std::unique_ptr<TrackSource> track;
+		juce::OwnedArray<juce::AudioFormatReader> thumbnailReaders;
+	};
+
+	// Interface of the object told about progress, called on the message thread.
+	class Listener {
+	public:
+		virtual ~Listener() = default;
+
+		// Method called while a file is being opened.
+		// Parameters:
+		// - progress: How far the load has got, from 0 to 1.
+		virtual void loadProgress(float progress) = 0;
+
+		// Method called when a file has been opened, or could not be. The listener may take the track and the readers.
+		// Parameters:
+		// - result: The opened track and readers.
+		virtual void loadFinished(Result& result) = 0;
+	};
+
+	// Constructor for the TrackLoader class, which starts its thread.
+	// Parameters:
+	// - formatManager: The formats used to open files.
+	// - readAheadThread: The thread that the loaded tracks use for read-ahead and decoding.
+	// - listener: The object told about progress and finished loads.
+	TrackLoader(juce::AudioFormatManager& formatManager, juce::TimeSliceThread& readAheadThread, Listener& listener);
+
+	// Destructor that stops the thread, waiting for a file that is being opened.
+	~TrackLoader() override;
+
+	// Method to start loading a file, replacing any load that has not finished yet. Called from the message thread.
+	// Parameters:
+	// - request: The file to open and how to keep it.
+	void load(const Request& request);
+
+	// Method to check whether a load has been requested and not delivered yet.
+	bool isLoading() const;
+
+	// Method to open the file of a request and build its TrackSource on the calling thread, as the loader thread does.
+	// Parameters:
+	// - request: The file to open and how to keep it.
+	// - formatManager: The formats used to open files.
+	// - readAheadThread: The thread that the track uses for read-ahead and decoding.
+	// Returns:
+	// - The track, or nullptr if the file could not be opened.
+	static std::unique_ptr<TrackSource> createTrack(const Request& request, juce::AudioFormatManager& formatManager, juce::TimeSliceThread& readAheadThread);
+
+	// Number of samples at the start of a file that are read before the track is delivered, and how long that waits at most.
+	static constexpr int startPrefetchSamples = 4096;
+	static constexpr int startTimeoutMs = 500;
+
+private:
+
+	// Method run on the loader thread, which waits for requests and opens them one at a time.
+	void run() override;
+
+	// Method called on the message thread to deliver progress or a finished load to the listener.
+	void handleAsyncUpdate() override;
+
+	// Method to open a local uncompressed file through a memory map, returning nullptr when the format or file does not allow it.
+	static juce::MemoryMappedAudioFormatReader* createMappedReader(const juce::URL& audioURL, juce::AudioFormatManager& formatManager);
+
+	// Method to check whether a newer request has replaced the one with the given number.
+	bool isSuperseded(int requestNumber) const;
+
+	// Method to publish the progress of a request, unless it has been replaced.
+	void setProgress(int requestNumber, float newProgress);
+
+	juce::AudioFormatManager& formatManager;
+	juce::TimeSliceThread& readAheadThread;
+	Listener& listener;
+
+	// Guards the request and the finished result, which are shared by the message thread and the loader thread.
+	juce::CriticalSection lock;
+
+	// Latest request, whether the loader thread has taken it yet, and its number.
+	Request request;
+	bool requestWaiting = false;
+	std::atomic<int> requestCount{ 0 };
+
+	// Finished load waiting to be delivered to the listener.
+	std::unique_ptr<Result> finished;
+
+	// Progress of the latest request, written by the loader thread.
+	std::atomic<float> progress{ 0.0f };
+
+	// Whether a load has been requested and not delivered yet, owned by the message thread.
+	bool loading = false;
+};
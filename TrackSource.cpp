@@ -0,0 +1,613 @@
+#include "TrackSource.h"
+
+
+TrackSource::TrackSource(juce::AudioFormatReader* streamReader, juce::AudioFormatReader* _decodeReader,
+	juce::TimeSliceThread& _thread, int readAheadSamples, Storage _storage)
+	: streamSource(new juce::AudioFormatReaderSource(streamReader, true)),
+	decodeReader(_decodeReader),
+	thread(_thread),
+	storage(_storage)
+{
+	bufferedStream.reset(new juce::BufferingAudioSource(streamSource.get(), thread, false, readAheadSamples, 2));
+
+	for (auto& hotSpot : hotSpots) {
+		hotSpot.store(-1);
+	}
+
+	numChannels = juce::jlimit(1, 2, static_cast<int>(streamReader->numChannels));
+	totalLength = streamReader->lengthInSamples;
+	sampleRate = streamReader->sampleRate;
+
+	landingLength = juce::jmax(1, static_cast<int>(landingSeconds * sampleRate));
+	for (auto& landing : landings) {
+		landing.audio.setSize(2, landingLength);
+	}
+
+	if (decodeReader == nullptr || totalLength <= 0) {
+		storage = streamFromDisk;
+	}
+
+	if (storage != streamFromDisk) {
+		// The whole file is allocated up front, so the decoder never allocates and the audio thread never sees memory move.
+		const size_t numValues = static_cast<size_t>(numChannels) * static_cast<size_t>(totalLength);
+		if (storage == decodeToFloat) {
+			floatData.allocate(numValues, false);
+		}
+		else {
+			int16Data.allocate(numValues, false);
+			decodeScratch.setSize(numChannels, decodeChunkSize);
+		}
+
+		if (floatData == nullptr && int16Data == nullptr) {
+			// Not enough memory for the whole file, so it is streamed like any other.
+			DBG("TrackSource: not enough memory to decode the file, streaming it instead");
+			storage = streamFromDisk;
+		}
+	}
+
+	// The thread moves the stream when the audio thread asks, and runs the decoder if there is one.
+	thread.addTimeSliceClient(this);
+}
+
+
+TrackSource::TrackSource(juce::MemoryMappedAudioFormatReader* _mappedReader, juce::TimeSliceThread& _thread)
+	: mappedReader(_mappedReader),
+	thread(_thread),
+	storage(streamFromDisk)
+{
+	numChannels = juce::jlimit(1, 2, static_cast<int>(mappedReader->numChannels));
+	totalLength = mappedReader->lengthInSamples;
+	sampleRate = mappedReader->sampleRate;
+
+	const int bytesPerFrame = juce::jmax(1, static_cast<int>(mappedReader->numChannels * mappedReader->bitsPerSample / 8));
+	samplesPerPage = juce::jmax(1, juce::SystemStats::getPageSize() / bytesPerFrame);
+
+	for (auto& hotSpot : hotSpots) {
+		hotSpot.store(-1);
+	}
+
+	// Fault in the start of the file before the first block is played; the rest follows the playhead.
+	prefault(0, static_cast<juce::int64>(prefaultSeconds * mappedReader->sampleRate));
+	thread.addTimeSliceClient(this);
+}
+
+
+TrackSource::~TrackSource()
+{
+	// Waits for a chunk that is being decoded right now to finish.
+	thread.removeTimeSliceClient(this);
+}
+
+
+// Define the prepareToPlay() method for the TrackSource class.
+void TrackSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate) {
+	if (bufferedStream != nullptr) {
+		bufferedStream->prepareToPlay(samplesPerBlockExpected, sampleRate);
+	}
+}
+
+
+// Define the releaseResources() method for the TrackSource class.
+void TrackSource::releaseResources() {
+	if (bufferedStream != nullptr) {
+		bufferedStream->releaseResources();
+	}
+}
+
+
+// Define the getNextAudioBlock() method for the TrackSource class.
+// A block is read from RAM when all of it has been decoded (or when the whole file has, so that the end is padded with
+// silence); otherwise it comes from the stream.
+void TrackSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {
+	juce::int64 position = nextReadPosition.load();
+	const juce::int64 decoded = decodedLength.load(std::memory_order_acquire);
+
+	if (mappedReader != nullptr) {
+		// Converted straight from the mapped file; a mono file is played on both channels.
+		const bool hasRight = bufferToFill.buffer->getNumChannels() > 1;
+		mappedReader->read(bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, position, true, hasRight);
+		for (auto channel = 2; channel < bufferToFill.buffer->getNumChannels(); ++channel) {
+			bufferToFill.buffer->clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+		}
+	}
+	else if (storage != streamFromDisk && position >= 0 && (position + bufferToFill.numSamples <= decoded || decoded == totalLength)) {
+		readFromRam(bufferToFill, position);
+	}
+	else {
+		// The stream may have been left behind by a seek, or while blocks came from RAM, so the block starts from the
+		// landing of the last jump where there is one, and can be silent in part while the read-ahead thread moves it.
+		for (auto done = 0; done < bufferToFill.numSamples;) {
+			const juce::AudioSourceChannelInfo part(bufferToFill.buffer, bufferToFill.startSample + done, bufferToFill.numSamples - done);
+			const int numFromLanding = readFromLanding(part, position + done);
+			done += numFromLanding > 0 ? numFromLanding : readFromStream(part, position + done);
+		}
+	}
+
+	// A seek made while this block was being read takes precedence over moving on.
+	nextReadPosition.compare_exchange_strong(position, position + bufferToFill.numSamples);
+}
+
+
+// Define the readFromRam() method for the TrackSource class, which copies decoded audio and pads past the end with silence.
+void TrackSource::readFromRam(const juce::AudioSourceChannelInfo& bufferToFill, juce::int64 position) {
+	auto& buffer = *bufferToFill.buffer;
+	const int numAvailable = static_cast<int>(juce::jlimit<juce::int64>(0, bufferToFill.numSamples, totalLength - position));
+
+	for (auto channel = 0; channel < buffer.getNumChannels(); ++channel) {
+		if (channel >= 2) {
+			buffer.clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+			continue;
+		}
+
+		// A mono file is played on both channels.
+		const size_t sourceOffset = static_cast<size_t>(juce::jmin(channel, numChannels - 1)) * static_cast<size_t>(totalLength) + static_cast<size_t>(position);
+
+		if (storage == decodeToFloat) {
+			buffer.copyFrom(channel, bufferToFill.startSample, floatData + sourceOffset, numAvailable);
+		}
+		else {
+			const juce::int16* source = int16Data + sourceOffset;
+			float* dest = buffer.getWritePointer(channel, bufferToFill.startSample);
+			for (auto i = 0; i < numAvailable; ++i) {
+				dest[i] = source[i] * (1.0f / 32767.0f);
+			}
+		}
+
+		if (numAvailable < bufferToFill.numSamples) {
+			buffer.clear(channel, bufferToFill.startSample + numAvailable, bufferToFill.numSamples - numAvailable);
+		}
+	}
+}
+
+
+// Define the readFromStream() method for the TrackSource class.
+// The audio thread never moves the stream itself. When the stream is not at the playhead, which only happens when a
+// jump had no landing or the disk was too slow to fill the stream behind one, it asks the read-ahead thread to move
+// the stream a little after the playhead, plays silence up to there, and carries on from the stream once it is there.
+// Jumps within the decoded part never reach this, so they cause no disk reads at all.
+int TrackSource::readFromStream(const juce::AudioSourceChannelInfo& bufferToFill, juce::int64 position) {
+	if (streamRequest.load() < 0 && bufferedStream->getNextReadPosition() == position) {
+		requestedStreamPosition = -1;
+		bufferedStream->getNextAudioBlock(bufferToFill);
+		return bufferToFill.numSamples;
+	}
+
+	// Ask again when the playhead has reached the position asked for without the stream being there, or when a seek
+	// has taken it somewhere else.
+	const juce::int64 leadSamples = static_cast<juce::int64>(streamLeadSeconds * sampleRate);
+	if (requestedStreamPosition <= position || requestedStreamPosition > position + leadSamples) {
+		requestStreamPosition(juce::jmax<juce::int64>(0, position + leadSamples));
+	}
+
+	const int numSilent = static_cast<int>(juce::jmin<juce::int64>(bufferToFill.numSamples, requestedStreamPosition - position));
+	for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel) {
+		bufferToFill.buffer->clear(channel, bufferToFill.startSample, numSilent);
+	}
+	return numSilent;
+}
+
+
+// Define the requestStreamPosition() method for the TrackSource class.
+void TrackSource::requestStreamPosition(juce::int64 position) {
+	requestedStreamPosition = position;
+	streamRequest.store(position);
+}
+
+
+// Define the readFromLanding() method for the TrackSource class.
+// When the stream is not at the playhead, a landing that became ready after the jump to it is still taken here. The
+// landing is handed back once it has been played to the end, or as soon as the playhead is somewhere else.
+int TrackSource::readFromLanding(const juce::AudioSourceChannelInfo& bufferToFill, juce::int64 position) {
+	if (activeLanding >= 0 && (position < landings[activeLanding].start || position >= landings[activeLanding].start + landingLength)) {
+		releaseLanding();
+	}
+	if (activeLanding < 0) {
+		const bool streamThere = streamRequest.load() < 0 && bufferedStream->getNextReadPosition() == position;
+		if (streamThere || !takeLanding(position)) {
+			return 0;
+		}
+	}
+
+	const auto& landing = landings[activeLanding];
+	const juce::int64 end = landing.start + landingLength;
+
+	const int numToCopy = static_cast<int>(juce::jmin<juce::int64>(bufferToFill.numSamples, end - position));
+	const int offset = static_cast<int>(position - landing.start);
+	for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel) {
+		if (channel < 2) {
+			bufferToFill.buffer->copyFrom(channel, bufferToFill.startSample, landing.audio, channel, offset, numToCopy);
+		}
+		else {
+			bufferToFill.buffer->clear(channel, bufferToFill.startSample, numToCopy);
+		}
+	}
+
+	if (position + numToCopy >= end) {
+		releaseLanding();
+	}
+	return numToCopy;
+}
+
+
+// Define the releaseLanding() method for the TrackSource class.
+void TrackSource::releaseLanding() {
+	if (activeLanding >= 0) {
+		landings[activeLanding].state.store(landingFree);
+		activeLanding = -1;
+	}
+}
+
+
+// Define the setNextReadPosition() method for the TrackSource class.
+// Only the playhead moves here; the stream follows when a block needs it. A jump into a landing read by prefetch()
+// plays from the landing, and one that stays inside the landing being played carries on from it.
+void TrackSource::setNextReadPosition(juce::int64 newPosition) {
+	nextReadPosition.store(newPosition);
+
+	if (bufferedStream == nullptr) {
+		return;
+	}
+
+	if (activeLanding >= 0 && newPosition >= landings[activeLanding].start && newPosition < landings[activeLanding].start + landingLength) {
+		return;
+	}
+
+	releaseLanding();
+	if (takeLanding(newPosition)) {
+		return;
+	}
+
+	// Without a landing, the stream is moved to the new position straight away, so that it is ready there by the time
+	// the playhead reads from it, unless the position is in RAM already.
+	const juce::int64 decoded = decodedLength.load(std::memory_order_acquire);
+	const bool inRam = storage != streamFromDisk && newPosition >= 0 && (newPosition < decoded || decoded == totalLength);
+	if (!inRam && newPosition >= 0 && newPosition < totalLength && requestedStreamPosition != newPosition
+		&& (streamRequest.load() >= 0 || bufferedStream->getNextReadPosition() != newPosition)) {
+		requestStreamPosition(newPosition);
+	}
+}
+
+
+// Define the takeLanding() method for the TrackSource class.
+// A landing is claimed before its start is looked at, since the thread that queues seeks may otherwise be reusing it.
+bool TrackSource::takeLanding(juce::int64 position) {
+	for (auto i = 0; i < numLandings; ++i) {
+		auto& landing = landings[i];
+		int expected = landingReady;
+		if (landing.state.compare_exchange_strong(expected, landingPlaying)) {
+			if (position >= landing.start && position < landing.start + landingLength) {
+				activeLanding = i;
+				if (landing.start + landingLength < totalLength) {
+					requestStreamPosition(landing.start + landingLength);
+				}
+				return true;
+			}
+			landing.state.store(landingReady);
+		}
+	}
+	return false;
+}
+
+
+// Define the getNextReadPosition() method for the TrackSource class.
+juce::int64 TrackSource::getNextReadPosition() const {
+	return nextReadPosition.load();
+}
+
+
+// Define the getTotalLength() method for the TrackSource class.
+juce::int64 TrackSource::getTotalLength() const {
+	return totalLength;
+}
+
+
+// Define the isLooping() method for the TrackSource class.
+bool TrackSource::isLooping() const {
+	return false;
+}
+
+
+// Define the waitUntilReady() method for the TrackSource class.
+bool TrackSource::waitUntilReady(int numSamples, int timeoutMs) {
+	const juce::int64 position = nextReadPosition.load();
+	const juce::int64 decoded = decodedLength.load(std::memory_order_acquire);
+
+	// A mapped file is ready as soon as its pages are resident, which is done here on the calling thread.
+	if (mappedReader != nullptr) {
+		prefault(position, numSamples);
+		return true;
+	}
+
+	if (storage != streamFromDisk && (position + numSamples <= decoded || decoded == totalLength)) {
+		return true;
+	}
+
+	// The stream is asked to start right at the playhead rather than ahead of it, or where the landing being played
+	// ends, and waited for, so that nothing is played as silence.
+	juce::int64 streamPosition = juce::jmax<juce::int64>(0, position);
+	if (activeLanding >= 0) {
+		const juce::int64 landingEnd = landings[activeLanding].start + landingLength;
+		if (position >= landings[activeLanding].start && position < landingEnd) {
+			if (position + numSamples <= landingEnd) {
+				return true;
+			}
+			streamPosition = landingEnd;
+		}
+	}
+
+	const juce::uint32 startTime = juce::Time::getMillisecondCounter();
+	if (streamRequest.load() >= 0 || bufferedStream->getNextReadPosition() != streamPosition) {
+		requestStreamPosition(streamPosition);
+		while (streamRequest.load() >= 0) {
+			if (juce::Time::getMillisecondCounter() - startTime >= static_cast<juce::uint32>(timeoutMs)) {
+				return false;
+			}
+			juce::Thread::sleep(1);
+		}
+	}
+
+	const int remainingMs = juce::jmax(0, timeoutMs - static_cast<int>(juce::Time::getMillisecondCounter() - startTime));
+	return bufferedStream->waitForNextAudioBlockReady(juce::AudioSourceChannelInfo(nullptr, 0, numSamples), static_cast<juce::uint32>(remainingMs));
+}
+
+
+// Define the prefetch() method for the TrackSource class.
+// Every landing is searched for a free one first. Failing that, a ready landing is taken back if every jump queued
+// to it has been applied; one that is being read, or played by the audio thread, is left alone.
+bool TrackSource::prefetch(juce::int64 position, int numSamples) {
+	if (isPrefetched(position, numSamples)) {
+		return true;
+	}
+
+	if (mappedReader != nullptr) {
+		prefaultRequest.store(position);
+		thread.moveToFrontOfQueue(this);
+		return false;
+	}
+
+	// A landing already asked for at the same position is waited for rather than read twice.
+	for (const auto& landing : landings) {
+		if (landing.state.load() == landingRequested && landing.start == position) {
+			return false;
+		}
+	}
+
+	Landing* claimed = nullptr;
+	for (auto& landing : landings) {
+		int expected = landingFree;
+		if (landing.state.compare_exchange_strong(expected, landingClaimed)) {
+			claimed = &landing;
+			break;
+		}
+	}
+	const juce::uint32 applied = appliedJumps.load();
+	for (auto i = 0; claimed == nullptr && i < numLandings; ++i) {
+		int expected = landingReady;
+		if (landings[i].heldUntil <= applied && landings[i].state.compare_exchange_strong(expected, landingClaimed)) {
+			claimed = &landings[i];
+		}
+	}
+
+	if (claimed == nullptr) {
+		DBG("TrackSource::prefetch no landing is free");
+		return false;
+	}
+
+	// The read-ahead thread only reads the landing once it is requested, after its start has been set.
+	claimed->start = position;
+	claimed->heldUntil = 0;
+	claimed->state.store(landingRequested);
+	thread.moveToFrontOfQueue(this);
+	return false;
+}
+
+
+// Define the isPrefetched() method for the TrackSource class.
+// Only the thread that queues seeks sets the start of a landing, so it can be read here whatever the state.
+bool TrackSource::isPrefetched(juce::int64 position, int numSamples) const {
+	if (mappedReader != nullptr) {
+		return prefaultedPosition.load() == position;
+	}
+
+	const juce::int64 decoded = decodedLength.load(std::memory_order_acquire);
+	if (position < 0 || position >= totalLength || (storage != streamFromDisk && (position + numSamples <= decoded || decoded == totalLength))) {
+		return true;
+	}
+
+	for (const auto& landing : landings) {
+		const int state = landing.state.load();
+		if ((state == landingReady || state == landingPlaying)
+			&& position >= landing.start && position + numSamples <= landing.start + landingLength) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Define the jumpQueued() method for the TrackSource class.
+void TrackSource::jumpQueued(juce::int64 position) {
+	++queuedJumps;
+	for (auto& landing : landings) {
+		if (landing.state.load() != landingFree && position >= landing.start && position < landing.start + landingLength) {
+			landing.heldUntil = queuedJumps;
+		}
+	}
+}
+
+
+// Define the jumpsApplied() method for the TrackSource class.
+void TrackSource::jumpsApplied(int numJumps) {
+	appliedJumps.fetch_add(static_cast<juce::uint32>(numJumps));
+}
+
+
+// Define the readLandings() method for the TrackSource class.
+// A landing that cannot be read is freed, and the jump waiting for it is queued anyway once it has waited long enough.
+void TrackSource::readLandings() {
+	for (auto& landing : landings) {
+		if (landing.state.load() == landingRequested) {
+			const bool read = readSection(landing.audio, 0, landing.start, landingLength);
+			landing.state.store(read ? landingReady : landingFree);
+		}
+	}
+}
+
+
+// Define the setSectionReader() method for the TrackSource class.
+void TrackSource::setSectionReader(juce::AudioFormatReader* reader) {
+	const juce::ScopedLock sl(sectionLock);
+	sectionReader.reset(reader);
+}
+
+
+// Define the readSection() method for the TrackSource class.
+bool TrackSource::readSection(juce::AudioBuffer<float>& dest, int destStart, juce::int64 start, int numSamples) {
+	jassert(dest.getNumChannels() >= 2 && destStart + numSamples <= dest.getNumSamples());
+	dest.clear(destStart, numSamples);
+
+	// Only the part inside the file is read; the rest stays silent.
+	const juce::int64 first = juce::jmax<juce::int64>(0, start);
+	const juce::int64 end = juce::jmin(totalLength, start + numSamples);
+	if (first >= end) {
+		return true;
+	}
+	const int offset = destStart + static_cast<int>(first - start);
+	const int length = static_cast<int>(end - first);
+
+	if (mappedReader != nullptr) {
+		return mappedReader->read(&dest, offset, length, first, true, true);
+	}
+
+	const juce::int64 decoded = decodedLength.load(std::memory_order_acquire);
+	if (storage != streamFromDisk && end <= decoded) {
+		readFromRam(juce::AudioSourceChannelInfo(&dest, offset, length), first);
+		return true;
+	}
+
+	const juce::ScopedLock sl(sectionLock);
+	if (sectionReader == nullptr) {
+		return false;
+	}
+	return sectionReader->read(&dest, offset, length, first, true, true);
+}
+
+
+// Define the getDecodedFraction() method for the TrackSource class.
+float TrackSource::getDecodedFraction() const {
+	if (storage == streamFromDisk || totalLength <= 0) {
+		return 0.0f;
+	}
+	return static_cast<float>(static_cast<double>(decodedLength.load()) / totalLength);
+}
+
+
+// Define the isMemoryMapped() method for the TrackSource class.
+bool TrackSource::isMemoryMapped() const {
+	return mappedReader != nullptr;
+}
+
+
+// Define the getSampleRate() method for the TrackSource class.
+double TrackSource::getSampleRate() const {
+	return sampleRate;
+}
+
+
+// Define the setHotSpots() method for the TrackSource class.
+void TrackSource::setHotSpots(const std::vector<juce::int64>& positions) {
+	for (auto i = 0; i < maxHotSpots; ++i) {
+		hotSpots[i].store(i < static_cast<int>(positions.size()) ? positions[static_cast<size_t>(i)] : -1);
+	}
+}
+
+
+// Define the setSerial() method for the TrackSource class.
+void TrackSource::setSerial(juce::uint32 newSerial) {
+	serial = newSerial;
+}
+
+
+// Define the getSerial() method for the TrackSource class.
+juce::uint32 TrackSource::getSerial() const {
+	return serial;
+}
+
+
+// Define the prefault() method for the TrackSource class, which reads one sample from every page in the range.
+void TrackSource::prefault(juce::int64 start, juce::int64 numSamples) {
+	const juce::int64 first = juce::jmax<juce::int64>(0, start);
+	const juce::int64 end = juce::jmin(totalLength, start + numSamples);
+
+	for (auto sample = first; sample < end; sample += samplesPerPage) {
+		mappedReader->touchSample(sample);
+	}
+}
+
+
+// Define the useTimeSlice() method for the TrackSource class, which does the background work for the file.
+// For a mapped file it keeps the pages after the playhead, after every hot spot and after the position of a jump
+// resident. Otherwise it moves the stream if the audio thread has asked, reads the landings asked for, then decodes
+// one chunk into RAM; the thread is shared with the read-ahead buffers of every deck, so the decode is cut into
+// chunks to let them in between.
+int TrackSource::useTimeSlice() {
+	if (mappedReader != nullptr) {
+		const juce::int64 prefaultLength = static_cast<juce::int64>(prefaultSeconds * mappedReader->sampleRate);
+
+		const juce::int64 jump = prefaultRequest.exchange(-1);
+		if (jump >= 0) {
+			prefault(jump, prefaultLength);
+			prefaultedPosition.store(jump);
+		}
+
+		prefault(nextReadPosition.load(), prefaultLength);
+		for (const auto& hotSpot : hotSpots) {
+			const juce::int64 position = hotSpot.load();
+			if (position >= 0) {
+				prefault(position, prefaultLength);
+			}
+		}
+		return prefaultIntervalMs;
+	}
+
+	// The request is only cleared once the stream has moved, and not if a newer one has come in meanwhile.
+	juce::int64 target = streamRequest.load();
+	if (target >= 0) {
+		bufferedStream->setNextReadPosition(target);
+		streamRequest.compare_exchange_strong(target, -1);
+	}
+
+	readLandings();
+
+	const juce::int64 start = decodedLength.load();
+	if (storage == streamFromDisk || start >= totalLength) {
+		return streamPollIntervalMs;
+	}
+
+	const int numSamples = static_cast<int>(juce::jmin<juce::int64>(decodeChunkSize, totalLength - start));
+
+	if (storage == decodeToFloat) {
+		float* dest[2] = { floatData + start, numChannels > 1 ? floatData + totalLength + start : nullptr };
+		decodeReader->read(dest, numChannels, start, numSamples);
+	}
+	else {
+		float* scratch[2] = { decodeScratch.getWritePointer(0), numChannels > 1 ? decodeScratch.getWritePointer(1) : nullptr };
+		decodeReader->read(scratch, numChannels, start, numSamples);
+
+		for (auto channel = 0; channel < numChannels; ++channel) {
+			const float* source = scratch[channel];
+			juce::int16* dest = int16Data + static_cast<size_t>(channel) * static_cast<size_t>(totalLength) + static_cast<size_t>(start);
+			for (auto i = 0; i < numSamples; ++i) {
+				dest[i] = static_cast<juce::int16>(juce::jlimit(-32767, 32767, juce::roundToInt(source[i] * 32767.0f)));
+			}
+		}
+	}
+
+	// Publish the new samples only after they have been written.
+	decodedLength.store(start + numSamples, std::memory_order_release);
+
+	if (start + numSamples >= totalLength) {
+		DBG("TrackSource: decoded " << totalLength << " samples to RAM");
+	}
+	return 0;
+}
@@ -0,0 +1,304 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+// TrackSource is what a deck plays a loaded file from.
+// The file is always streamed through a read-ahead buffer. Optionally it is also decoded in full, in the
+// background, into one contiguous block of RAM, stored either as float or as compact 16-bit integers that
+// are converted on the fly. Every block that lies entirely inside the decoded part is copied straight from
+// RAM, so seeks, cue jumps and scrubbing there are sample-instant; anything beyond it falls back to the
+// stream until the decode has caught up.
+// Uncompressed files can instead be memory-mapped, in which case blocks are converted straight from the
+// page cache with no read-ahead buffer in between, and the pages around the playhead and the cue points
+// are faulted in ahead of time so that the audio thread does not wait for the disk.
+// The read-ahead buffer, the decoder and the prefaulting are all served by the same TimeSliceThread. Moving a
+// juce::BufferingAudioSource takes the thread's list lock, so the audio thread never does it: it asks the thread to.
+// Reading from the buffer does take the buffer's callback lock, which the thread also holds while it reads each chunk
+// of at most 2048 samples into the buffer, so a block can wait for one such chunk, but never for a move or a seek
+// of the file.
+// Every jump made on the audio thread starts from RAM: a jump to a streamed position lands on a short section that
+// prefetch() has the read-ahead thread read before the jump is queued, which is played while the stream is moved to
+// where the section ends, and a position the playhead is parked at, such as the end of a loop played from a cache,
+// has the stream moved there as soon as it is parked. Silence is only played when the disk cannot keep up.
+class TrackSource : public juce::PositionableAudioSource,
+	private juce::TimeSliceClient {
+public:
+
+	// How a loaded file is kept.
+	enum Storage {
+		streamFromDisk = 0,    // Read-ahead buffer only.
+		decodeToFloat,         // Decoded to RAM as 32-bit float.
+		decodeToInt16,         // Decoded to RAM as 16-bit integers, half the memory of float.
+		numStorages
+	};
+
+	// Constructor for the TrackSource class, which takes ownership of both readers.
+	// Parameters:
+	// - streamReader: The reader used for streaming.
+	// - decodeReader: A second reader of the same file used by the decoder, or nullptr to stream only.
+	// - thread: The thread that fills the read-ahead buffer and runs the decoder.
+	// - readAheadSamples: The size of the read-ahead buffer in samples.
+	// - storage: How the file is kept; streamFromDisk ignores decodeReader.
+	TrackSource(juce::AudioFormatReader* streamReader, juce::AudioFormatReader* decodeReader,
+		juce::TimeSliceThread& thread, int readAheadSamples, Storage storage);
+
+	// Constructor for a memory-mapped file, which takes ownership of the reader.
+	// Parameters:
+	// - mappedReader: A reader whose whole file has already been mapped.
+	// - thread: The thread that prefaults the pages around the playhead and the cue points.
+	TrackSource(juce::MemoryMappedAudioFormatReader* mappedReader, juce::TimeSliceThread& thread);
+
+	// Destructor that stops the decoder before the RAM copy is freed.
+	~TrackSource() override;
+
+	// Method to prepare the read-ahead buffer, if there is one, for playback.
+	// Parameters:
+	// - samplesPerBlockExpected: The number of audio samples expected per block.
+	// - sampleRate: The sample rate of the audio.
+	void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+	// Method to release the read-ahead buffer.
+	void releaseResources() override;
+
+	// Method to fill the buffer with the next block of the file, from RAM where possible.
+	// Parameters:
+	// - bufferToFill: Contains the buffer information to be filled with audio data.
+	void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+	// Methods of juce::PositionableAudioSource, in samples of the file. Once the track is playing, the position is
+	// only set on the audio thread.
+	void setNextReadPosition(juce::int64 newPosition) override;
+	juce::int64 getNextReadPosition() const override;
+	juce::int64 getTotalLength() const override;
+	bool isLooping() const override;
+
+	// Method to wait, for at most a given time, until the audio following the current position can be read
+	// without going to disk. Returns straight away when that audio is already in RAM. Called before the track is
+	// handed to the audio thread, or between blocks on the thread that renders it offline.
+	// Parameters:
+	// - numSamples: The number of samples after the position that should be ready.
+	// - timeoutMs: The longest time to wait in milliseconds.
+	bool waitUntilReady(int numSamples, int timeoutMs);
+
+	// Method to ask for a position that is about to be jumped to to be made ready, without moving the playhead. The
+	// pages of a memory-mapped file are faulted in, and for a streamed position a landing section is read, both on the
+	// read-ahead thread; a decoded position is already ready. Called by the thread that queues seeks, which queues the
+	// jump once isPrefetched() returns true.
+	// Parameters:
+	// - position: The position in samples that will be jumped to.
+	// - numSamples: The number of samples after it that should be ready.
+	// Returns:
+	// - true if the position is ready already.
+	bool prefetch(juce::int64 position, int numSamples);
+
+	// Method to check whether a position asked for with prefetch() is ready. Called by the thread that queues seeks.
+	// Parameters:
+	// - position: The position in samples that will be jumped to.
+	// - numSamples: The number of samples after it that should be ready.
+	bool isPrefetched(juce::int64 position, int numSamples) const;
+
+	// Method to keep the landing of a position from being reused until the jump to it has been applied. Called by the
+	// thread that queues seeks, once for every jump it queues to the track, after it has been queued.
+	// Parameters:
+	// - position: The position in samples of the jump.
+	void jumpQueued(juce::int64 position);
+
+	// Method to tell the track that jumps queued to it have been applied, so that their landings can be reused.
+	// Called on the audio thread.
+	// Parameters:
+	// - numJumps: The number of jumps applied.
+	void jumpsApplied(int numJumps);
+
+	// Method to give the track a reader of its own file that is only used by readSection(), taking ownership of it.
+	// Not needed for a memory-mapped file, which can be read from any thread.
+	// Parameters:
+	// - reader: A reader of the same file, or nullptr.
+	void setSectionReader(juce::AudioFormatReader* reader);
+
+	// Method to copy a section of the file into a buffer without moving the playhead, for use off the audio thread.
+	// The section comes from RAM or the memory map where possible, and otherwise from the section reader.
+	// Samples outside the file are silent, and a mono file is copied to both channels.
+	// Parameters:
+	// - dest: The stereo buffer to fill.
+	// - destStart: The first sample of dest to write.
+	// - start: The first sample of the file to read, which may be negative.
+	// - numSamples: The number of samples to read.
+	// Returns:
+	// - false if the section could not be read, in which case it is left silent.
+	bool readSection(juce::AudioBuffer<float>& dest, int destStart, juce::int64 start, int numSamples);
+
+	// Method to return the fraction of the file that has been decoded to RAM, from 0 to 1.
+	float getDecodedFraction() const;
+
+	// Method to check whether the file is played from a memory map.
+	bool isMemoryMapped() const;
+
+	// Method to return the sample rate of the file.
+	double getSampleRate() const;
+
+	// Method to set the positions, in samples, whose surroundings should be kept in memory, such as cue points.
+	// Only used for memory-mapped files. Safe to call from any thread.
+	// Parameters:
+	// - positions: The positions to keep ready; any beyond maxHotSpots are ignored.
+	void setHotSpots(const std::vector<juce::int64>& positions);
+
+	// Largest number of positions passed to setHotSpots() that are kept ready.
+	static constexpr int maxHotSpots = 8;
+
+	// Methods to set and return the number given to the track when it was handed to a transport. Numbers only grow,
+	// so that a command queued for the track is never mistaken for one for a later track that reuses its memory.
+	void setSerial(juce::uint32 newSerial);
+	juce::uint32 getSerial() const;
+
+private:
+
+	// Method called on the background thread to move the stream, decode the next chunk into RAM, or prefault a
+	// memory-mapped file.
+	int useTimeSlice() override;
+
+	// Method to fill the start of a block from the stream, or with silence while the stream is being moved to it.
+	// Called on the audio thread.
+	// Parameters:
+	// - bufferToFill: The part of the block to fill.
+	// - position: The position in samples of its first sample.
+	// Returns:
+	// - The number of samples filled, at least one.
+	int readFromStream(const juce::AudioSourceChannelInfo& bufferToFill, juce::int64 position);
+
+	// Method to ask the read-ahead thread to move the stream to a position.
+	// Parameters:
+	// - position: The position in samples, which must not be negative.
+	void requestStreamPosition(juce::int64 position);
+
+	// Method to read the landings asked for by prefetch(). Called on the read-ahead thread.
+	void readLandings();
+
+	// Method to fill the start of a block from the landing being played, if it holds the position. Called on the
+	// audio thread.
+	// Parameters:
+	// - bufferToFill: The part of the block to fill.
+	// - position: The position in samples of its first sample.
+	// Returns:
+	// - The number of samples filled, or 0 when the landing does not hold the position.
+	int readFromLanding(const juce::AudioSourceChannelInfo& bufferToFill, juce::int64 position);
+
+	// Method to start playing a ready landing that holds a position, and to ask for the stream to be moved to where
+	// it ends. Called on the audio thread.
+	// Returns:
+	// - false if no ready landing holds the position.
+	bool takeLanding(juce::int64 position);
+
+	// Method to hand the landing being played back to prefetch(). Called on the audio thread.
+	void releaseLanding();
+
+	// Method to touch every page of a memory-mapped file in a range of samples, so that later reads do not fault.
+	void prefault(juce::int64 start, juce::int64 numSamples);
+
+	// Method to copy a section of the decoded audio into a buffer.
+	void readFromRam(const juce::AudioSourceChannelInfo& bufferToFill, juce::int64 position);
+
+	// Number of samples decoded on every time slice.
+	static constexpr int decodeChunkSize = 32768;
+
+	// Length of audio kept in memory after the playhead and after every hot spot of a memory-mapped file, in seconds,
+	// and how often it is refreshed in milliseconds.
+	static constexpr double prefaultSeconds = 2.0;
+	static constexpr int prefaultIntervalMs = 20;
+
+	// Length of a landing in seconds, enough for the read-ahead thread to move the stream and start filling it.
+	static constexpr double landingSeconds = 0.25;
+
+	// How far after the playhead the stream is asked to move, in seconds, so that its read-ahead buffer has started
+	// to fill by the time playback gets there, and how often the read-ahead thread looks for a request in milliseconds.
+	static constexpr double streamLeadSeconds = 0.1;
+	static constexpr int streamPollIntervalMs = 5;
+
+	// Reader and source used for streaming, and the read-ahead buffer in front of them.
+	std::unique_ptr<juce::AudioFormatReaderSource> streamSource;
+	std::unique_ptr<juce::BufferingAudioSource> bufferedStream;
+
+	// Reader used by the decoder, kept separate so that streaming and decoding do not make each other seek.
+	std::unique_ptr<juce::AudioFormatReader> decodeReader;
+
+	// Reader of a memory-mapped file, used instead of the stream when set.
+	std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader;
+
+	// Reader used by readSection() for parts of the file that are not in memory, and the lock serialising its callers.
+	std::unique_ptr<juce::AudioFormatReader> sectionReader;
+	juce::CriticalSection sectionLock;
+
+	// Number of samples that share one page of a memory-mapped file.
+	int samplesPerPage = 1024;
+
+	// Positions around which a memory-mapped file is kept in memory, or -1 for unused entries.
+	std::atomic<juce::int64> hotSpots[maxHotSpots];
+
+	// Thread running the decoder and the prefaulting.
+	juce::TimeSliceThread& thread;
+
+	// How the file is kept.
+	Storage storage;
+
+	// Decoded audio, channel after channel, in the format chosen by storage.
+	juce::HeapBlock<float> floatData;
+	juce::HeapBlock<juce::int16> int16Data;
+
+	// Scratch buffer used by the decoder when converting to 16-bit.
+	juce::AudioBuffer<float> decodeScratch;
+
+	// Number of channels, number of samples and sample rate of the file.
+	int numChannels = 0;
+	juce::int64 totalLength = 0;
+	double sampleRate = 0;
+
+	// Number of samples from the start of the file that are already in RAM. Written by the decoder, read by the audio thread.
+	std::atomic<juce::int64> decodedLength{ 0 };
+
+	// Position of the next sample to play.
+	std::atomic<juce::int64> nextReadPosition{ 0 };
+
+	// Number given by the transport, set before the track is handed to the audio thread.
+	juce::uint32 serial = 0;
+
+	// Position the stream should be moved to, or -1 once the read-ahead thread has moved it.
+	std::atomic<juce::int64> streamRequest{ -1 };
+
+	// Position last asked for, which stays set until the stream has been read from there, or -1. Audio thread only.
+	juce::int64 requestedStreamPosition = -1;
+
+	// A section of a streamed file read for a jump. Its state hands it from the thread that queues seeks, which asks
+	// for it and is the only one to set its start, to the read-ahead thread, which reads it, and on to the audio
+	// thread, which plays it. A ready landing is only taken back for another jump once no queued jump still needs it:
+	// heldUntil is the number of jumps to the track that must have been applied first, and is owned by the thread
+	// that queues seeks.
+	enum LandingState {
+		landingFree = 0,
+		landingClaimed,
+		landingRequested,
+		landingReady,
+		landingPlaying
+	};
+	struct Landing {
+		juce::AudioBuffer<float> audio;
+		juce::int64 start = -1;
+		std::atomic<int> state{ landingFree };
+		juce::uint32 heldUntil = 0;
+	};
+
+	// Four landings, so that jumps can be prefetched while the audio thread still plays the last one and others are
+	// still waiting to be applied.
+	static constexpr int numLandings = 4;
+	Landing landings[numLandings];
+	int landingLength = 0;
+
+	// Number of jumps queued to the track, owned by the thread that queues seeks, and applied, written by the audio thread.
+	juce::uint32 queuedJumps = 0;
+	std::atomic<juce::uint32> appliedJumps{ 0 };
+
+	// Position whose pages a memory-mapped file should fault in for a jump, or -1, and the last position done.
+	std::atomic<juce::int64> prefaultRequest{ -1 };
+	std::atomic<juce::int64> prefaultedPosition{ -1 };
+
+	// Index of the landing the audio thread is playing, or -1. Audio thread only.
+	int activeLanding = -1;
+};
@@ -40,6 +40,19 @@ void WaveformDisplay::loadTrack(track track) {
 	}
 }
 
+void WaveformDisplay::loadTrack(track track, juce::AudioFormatReader* reader) {
+	// Loads the waveform data from the given reader, or from the URL when there is none.
+	// If loading is successful, updates the loaded song name.
+	if (reader == nullptr) {
+		loadTrack(track);
+		return;
+	}
+	loadReader(reader, track.url);
+	if (isLoaded) {
+		songNameLoaded = track.title;
+	}
+}
+
 void WaveformDisplay::setPositionRelative(double pos) {
 	// Updates the current position of the playback marker if it has changed.
 	// Triggers a repaint of the component to reflect the new position.
@@ -61,6 +74,19 @@ void WaveformDisplay::setCuePoints(std::map<juce::TextButton*, std::pair<double,
 	DBG("cueTargets size" << cueTargets.size());
 }
 
+void WaveformDisplay::setLoop(double start, double end) {
+	// Updates the loop region and repaints only if it has changed.
+	if (start < 0) {
+		start = -1;
+		end = -1;
+	}
+	if (start != loopStart || end != loopEnd) {
+		loopStart = start;
+		loopEnd = end;
+		repaint();
+	}
+}
+
 
 
 void WaveformDisplay::paint(juce::Graphics& g)
@@ -83,6 +109,15 @@ void WaveformDisplay::paint(juce::Graphics& g)
 		// Draws the waveform channel. The waveform is scaled to fit the component bounds.
 		audioThumb.drawChannel(g, getLocalBounds(), 0, audioThumb.getTotalLength(), 0, 0.55);
 
+		// Shades the loop region and draws its in and out points.
+		if (loopStart >= 0) {
+			g.setColour(juce::Colours::orange.withAlpha(0.25f));
+			g.fillRect((float)(loopStart * getWidth()), 0.0f, (float)((loopEnd - loopStart) * getWidth()), (float)getHeight());
+			g.setColour(juce::Colours::orange);
+			g.drawRect(loopStart * getWidth(), 0, 1, getHeight());
+			g.drawRect(loopEnd * getWidth(), 0, 1, getHeight());
+		}
+
 		// Draws a vertical line indicating the current position in the waveform.
 		g.setColour(juce::Colours::lightgreen);
 		g.drawRect(position * getWidth(), 0, 1, getHeight());
@@ -187,3 +222,19 @@ void WaveformDisplay::loadURL(juce::URL audioURL) {
 		DBG("Failed to load wfd");
 	}
 }
+
+void WaveformDisplay::loadReader(juce::AudioFormatReader* reader, juce::URL audioURL) {
+	// Same as loadURL(), except that the thumbnail reads from a reader that is already open. The hash is the one
+	// a URLInputSource would give, so that thumbnails cached from either path are shared.
+	isLoaded = false;
+	audioThumb.clear();
+	audioThumb.setReader(reader, audioURL.toString(true).hashCode64());
+	if (audioThumb.getTotalLength() > 0) {
+		isLoaded = true;
+		setPositionRelative(0);
+		cueTargets.clear();
+	}
+	else {
+		DBG("Failed to load wfd");
+	}
+}
@@ -27,12 +27,19 @@ public:
 	// Loads a track from the given URL and updates the display with the track's information.
 	void loadTrack(track track);
 
+	// Loads a track from a reader that has already been opened, which the display takes ownership of, so that the file
+	// is not parsed on the message thread. Falls back to the URL when the reader is nullptr.
+	void loadTrack(track track, juce::AudioFormatReader* reader);
+
 	// Sets the position of the playback marker relative to the waveform width.
 	void setPositionRelative(double pos);
 
 	// Updates the list of cue points (markers) in the waveform display based on the provided map.
 	void setCuePoints(std::map<juce::TextButton*, std::pair<double, float>>& _cueTargets);
 
+	// Sets the loop shown over the waveform, as fractions of the waveform width. A negative start hides it.
+	void setLoop(double start, double end);
+
 private:
 	// Paints the waveform and additional visual elements such as cue points and position markers.
 	void paint(juce::Graphics&) override;
@@ -61,6 +68,9 @@ private:
 	// Loads audio data from the given URL and prepares the waveform display.
 	void loadURL(juce::URL audioURL);
 
+	// Loads audio data from an open reader of the file at the given URL, which is used to look up the cached thumbnail.
+	void loadReader(juce::AudioFormatReader* reader, juce::URL audioURL);
+
 	// Indicates whether the mouse is currently over the waveform.
 	bool mouseEntered = false;
 
@@ -83,6 +93,10 @@ protected:
 	// List of cue points (markers) in the waveform display.
 	std::vector<std::pair<double, float>*> cueTargets;
 
+	// Start and end of the loop, as fractions of the waveform width, or -1 when there is no loop.
+	double loopStart = -1;
+	double loopEnd = -1;
+
 	// The color theme used for the waveform and markers.
 	juce::Colour theme;
 
@@ -43,6 +43,21 @@ void ZoomedWaveform::paint(juce::Graphics& g)
             g.fillRect(0.0f, 0.0f, (float)widthRect, (float)getHeight() - 1);
         }
 
+        // Shade the part of the loop that falls within the zoomed region, and draw its in and out points.
+        if (loopStart >= 0) {
+            double loopLeft = juce::jmap(juce::jlimit(left, right, loopStart * audioThumb.getTotalLength()), left, right, 0.0, (double)getWidth());
+            double loopRight = juce::jmap(juce::jlimit(left, right, loopEnd * audioThumb.getTotalLength()), left, right, 0.0, (double)getWidth());
+            g.setColour(juce::Colours::orange.withAlpha(0.25f));
+            g.fillRect((float)loopLeft, 0.0f, (float)(loopRight - loopLeft), (float)getHeight());
+            g.setColour(juce::Colours::orange);
+            if ((loopStart * audioThumb.getTotalLength()) > left && (loopStart * audioThumb.getTotalLength()) < right) {
+                g.drawRect(loopLeft, 0, 1, getHeight());
+            }
+            if ((loopEnd * audioThumb.getTotalLength()) > left && (loopEnd * audioThumb.getTotalLength()) < right) {
+                g.drawRect(loopRight, 0, 1, getHeight());
+            }
+        }
+
         // Draw cue points that fall within the zoomed region.
         for (auto i = 0; i < cueTargets.size(); ++i) {
             if ((cueTargets[i]->first * audioThumb.getTotalLength()) > left && (cueTargets[i]->first * audioThumb.getTotalLength()) < right) {